@@ -42,6 +42,7 @@
  * Forward declaration
  */
 static void console_logout(void);
+static void console_top(void);
 static void print_time(void);
 
 BEGIN_ALT_COMMAND(show)
@@ -50,6 +51,15 @@ BEGIN_ALT_COMMAND(show)
     ALT_COMMAND_FUNC0(scheduler, "scheduler", sched_dump)
     ALT_COMMAND_FUNC0(mutexes, "system mutexes", mutexes_dump)
     ALT_COMMAND_FUNC0(barriers, "system barriers", barriers_dump)
+    ALT_COMMAND_FUNC0(semaphores, "system semaphores", semaphores_dump)
+    ALT_COMMAND_FUNC0(condvars, "system condition variables", condvars_dump)
+    ALT_COMMAND_FUNC0(rwlocks, "system reader/writer locks", rwlocks_dump)
+    ALT_COMMAND_FUNC0(softirqs, "deferred interrupt work latency", softirqs_dump)
+    ALT_COMMAND_FUNC0(timers, "timers, alarms and coalesced expirations", deadlines_dump)
+    ALT_COMMAND_FUNC0(hrtimers, "high resolution timers lateness", hrtimers_dump)
+    ALT_COMMAND_FUNC0(tasks, "stackless task runners", tasks_dump)
+    ALT_COMMAND_FUNC0(slabs, "kernel object caches", slabs_dump)
+    ALT_COMMAND_FUNC0(heap, "heap and I/O memory usage, heap profile", heap_dump)
     ALT_COMMAND_FUNC0(system, "DiegOS memory layout", diegos_dump)
     ALT_COMMAND_FUNC0(date, "date and time", print_time)
 END_ALT_COMMAND()
@@ -58,6 +68,7 @@ CREATE_ALTERNATE(show)
 
 BEGIN_ALT_COMMAND(root)
     ALT_COMMAND_NEXT(show, "show system informations", show)
+    ALT_COMMAND_FUNC0(top, "thread CPU usage, any key to stop", console_top)
     ALT_COMMAND(help, "help !!!")
     ALT_COMMAND_FUNC0(logout, "Exit this session", console_logout)
 END_ALT_COMMAND()
@@ -101,6 +112,121 @@ static void print_banner(void)
 	puts("\n");
 }
 
+#define TOP_PERIOD	(1000)
+
+/*
+ * Print one line of the top table, the figures are the deltas since the
+ * previous snapshot; prev is NULL for a thread not present back then.
+ */
+static void top_line(const thread_stats_t *cur, const thread_stats_t *prev,
+		     uint64_t period, uint64_t per_msec)
+{
+	uint64_t run = cur->run_cycles, ready = cur->ready_cycles;
+	uint32_t vol = cur->voluntary, invol = cur->involuntary;
+	unsigned cpu, wait;
+
+	if (prev) {
+		run -= prev->run_cycles;
+		ready -= prev->ready_cycles;
+		vol -= prev->voluntary;
+		invol -= prev->involuntary;
+	}
+
+	cpu = (unsigned)((run * 1000ULL) / period);
+	wait = (unsigned)((ready * 1000ULL) / period);
+
+	printf("%-5u %-15s %4u %-8s %3u.%u %4u.%u %7u %7u %10llu\n",
+	       cur->tid, cur->name, cur->priority, cur->state, cpu / 10, cpu % 10,
+	       wait / 10, wait % 10, vol, invol, cur->run_cycles / per_msec);
+}
+
+/*
+ * Thread CPU usage, refreshed every TOP_PERIOD milliseconds.
+ * The first table shows the averages since boot time.
+ */
+static void console_top(void)
+{
+	thread_stats_t *cur = NULL, *prev = NULL, *tmp;
+	unsigned size = 0, ncur = 0, nprev = 0, i, j;
+	uint64_t cycles, prev_cycles = 0, msecs, prev_msecs = 0, period, per_msec;
+	struct pollfd waitinp;
+
+	while (console_is_on) {
+		/*
+		 * Snapshot, enlarge the buffers until all threads fit
+		 */
+		do {
+			if (ncur == size) {
+				size = (size) ? (size * 2) : (32);
+				tmp = realloc(cur, size * sizeof(*cur));
+				if (tmp) {
+					cur = tmp;
+					tmp = realloc(prev, size * sizeof(*prev));
+				}
+				if (!tmp) {
+					printf("no memory for %u threads\n", size);
+					free(cur);
+					free(prev);
+					return;
+				}
+				prev = tmp;
+			}
+			msecs = clock_get_milliseconds();
+			ncur = thread_stats_snapshot(cur, size, &cycles);
+		} while (ncur == size);
+
+		period = cycles - prev_cycles;
+		per_msec = (msecs > prev_msecs) ? (period / (msecs - prev_msecs)) : (0);
+		if (!period || !per_msec) {
+			period = 1;
+			per_msec = 1;
+		}
+
+		printf("\033[2J\033[H");
+		printf("%u threads, %llu cycles/msec, refresh %u msecs, any key to stop\n\n",
+		       ncur, per_msec, TOP_PERIOD);
+		printf("%-5s %-15s %4s %-8s %5s %6s %7s %7s %10s\n", "TID", "THREAD NAME",
+		       "PRIO", "STATE", "%CPU", "%WAIT", "VOLUNT", "INVOLUN", "TIME msecs");
+
+		/*
+		 * Both snapshots are sorted by TID, a TID reused by a new
+		 * thread is detected by its name
+		 */
+		for (i = 0, j = 0; i < ncur; i++) {
+			while ((j < nprev) && (prev[j].tid < cur[i].tid)) {
+				++j;
+			}
+			top_line(&cur[i], ((j < nprev) && (prev[j].tid == cur[i].tid) &&
+					   !strcmp(prev[j].name, cur[i].name)) ? (&prev[j]) : (NULL),
+				 period, per_msec);
+		}
+		fflush(stdout);
+
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		nprev = ncur;
+		prev_cycles = cycles;
+		prev_msecs = msecs;
+
+		/*
+		 * Keep the login session alive
+		 */
+		timeout = 0;
+
+		waitinp.fd = 0;
+		waitinp.events = 0;
+		waitinp.revents = POLLIN;
+		if (poll(&waitinp, 1, TOP_PERIOD) > 0) {
+			getchar();
+			break;
+		}
+	}
+
+	free(cur);
+	free(prev);
+}
+
 static void print_time(void)
 {
 	time_t tmp = time(NULL);
@@ -209,7 +335,7 @@ static void login_main_entry(void)
 	event_t *event;
 	STATUS retcode;
 	BOOL retlogin;
-	uint8_t tid;
+	tid_t tid;
 	time_t tmptime;
 
 	events = event_init_queue("Login");
@@ -291,7 +417,7 @@ static void login_main_entry(void)
 
 void console_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 	BOOL retcode;
 
 	system_parser_init(&alternates_root);
@@ -88,7 +88,7 @@ static void demo_thread_entry3(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 
 	mutex = thread_create_mutex("test mutex");
 
@@ -81,7 +81,7 @@ static void demo_thread_entry3(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 
 	spinlock_init(&spinlock);
 
@@ -103,7 +103,7 @@ static void demo_thread_entry3(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 
 	events = event_init_queue("Test");
 
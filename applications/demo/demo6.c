@@ -108,7 +108,7 @@ static void demo_thread_entry2(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 
 #if 0
 	thread_create("DemoTX", THREAD_PRIO_NORMAL, demo_thread_entry, 0, 4096, &pid);
@@ -111,7 +111,7 @@ static void demo_thread_entry(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 
 	thread_create("Demo", THREAD_PRIO_NORMAL, demo_thread_entry, 0, 4096, &pid);
 }
@@ -0,0 +1,108 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <stdio.h>
+
+/*
+ * Thread table stress.
+ * A controller thread spawns THREADS workers, each one yields
+ * SWITCH_LOOPS times and terminates. The first round grows the thread
+ * table from MAX_THREADS entries, the second one reuses the freed TIDs.
+ * Creation cost and context switch cost are reported for both rounds.
+ */
+
+#define THREADS		(1000)
+#define SWITCH_LOOPS	(100)
+
+static volatile unsigned started;
+static volatile unsigned done;
+
+static void worker_entry(void)
+{
+	unsigned i;
+
+	++started;
+
+	for (i = 0; i < SWITCH_LOOPS; i++) {
+		thread_suspend();
+	}
+
+	++done;
+}
+
+static void round_run(char prefix)
+{
+	char name[16];
+	uint64_t start, created, switched;
+	tid_t pid, max_tid = 0;
+	unsigned i;
+
+	started = 0;
+	done = 0;
+
+	start = clock_get_milliseconds();
+
+	for (i = 0; i < THREADS; i++) {
+		sprintf(name, "%c%u", prefix, i);
+		if (!thread_create(name, THREAD_PRIO_NORMAL, worker_entry, 0, 2048, &pid)) {
+			break;
+		}
+		if (pid > max_tid) {
+			max_tid = pid;
+		}
+	}
+
+	created = clock_get_milliseconds() - start;
+
+	start = clock_get_milliseconds();
+	while (done < i) {
+		thread_delay(10);
+	}
+	switched = clock_get_milliseconds() - start;
+
+	printf("round %c: %u threads, highest TID %u\n", prefix, i, max_tid);
+	if (!i) {
+		return;
+	}
+	printf("  create  %llu msecs, %llu nsecs/thread\n", created,
+	       (created * 1000000ULL) / i);
+	printf("  switch  %llu msecs, %llu nsecs/switch\n", switched,
+	       (switched * 1000000ULL) / ((uint64_t)i * SWITCH_LOOPS));
+}
+
+static void control_entry(void)
+{
+	round_run('a');
+
+	/*
+	 * Let the scheduler release the dead threads
+	 */
+	thread_delay(100);
+
+	round_run('b');
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Control", THREAD_PRIO_NORMAL - 1, control_entry, 0, 4096, &pid);
+}
@@ -123,7 +123,7 @@ static void demo_xxx_wait_on_brt(void)
 
 static void demo_thread_barriers(void)
 {
-        uint8_t pid;
+        tid_t pid;
         unsigned i;
         char name[6];
 
@@ -153,7 +153,7 @@ static void demo_thread_mutexes(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 
 	events = event_init_queue("Teste");
         barrier = barrier_create("Testb", TRUE);
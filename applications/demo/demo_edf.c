@@ -0,0 +1,110 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_dump.h>
+#include <diegos/delays.h>
+#include <stdio.h>
+
+/*
+ * Earliest deadline first threads, build with PREEMPTION=y.
+ * Three periodic threads burn part of their runtime every period while
+ * a best effort thread never yields; after RUN_MSECS the jobs, misses
+ * and overruns of each EDF thread are printed. A fourth thread asking
+ * for more bandwidth than left is refused.
+ */
+
+#define RUN_MSECS	(5000)
+
+static const struct {
+	const char *name;
+	edf_params_t params;
+	unsigned work;
+} tasks[] = {
+	{"Edf10", {2, 10, 10}, 1},
+	{"Edf20", {5, 15, 20}, 4},
+	{"Edf50", {10, 50, 50}, 8}
+};
+
+static tid_t tids[NELEMENTS(tasks)];
+static volatile unsigned started;
+static volatile BOOL stop;
+
+static void edf_entry(void)
+{
+	unsigned me = started++;
+
+	while (!stop) {
+		mdelay(tasks[me].work);
+		thread_edf_wait();
+	}
+
+	thread_terminate();
+}
+
+static void busy_entry(void)
+{
+	while (!stop) ;
+}
+
+static void report_entry(void)
+{
+	edf_params_t greedy = { 30, 50, 50 };
+	edf_stats_t stats;
+	tid_t pid;
+	unsigned i;
+
+	thread_create("BestEffort", THREAD_PRIO_NORMAL, busy_entry, 0, 2048, &pid);
+
+	for (i = 0; i < NELEMENTS(tasks); i++) {
+		if (!thread_create_edf(tasks[i].name, &tasks[i].params, edf_entry, 0, 2048,
+				       &tids[i])) {
+			printf("%s not admitted\n", tasks[i].name);
+			return;
+		}
+		while (started == i) {
+			thread_delay(1);
+		}
+	}
+
+	if (!thread_create_edf("Greedy", &greedy, edf_entry, 0, 2048, &pid)) {
+		printf("Greedy not admitted, as expected\n");
+	}
+
+	thread_delay(RUN_MSECS);
+
+	printf("thread    run/deadline/period   jobs     misses   overruns\n");
+	for (i = 0; i < NELEMENTS(tasks); i++) {
+		if (thread_edf_stats(tids[i], &stats)) {
+			printf("%-8s  %3u/%3u/%3u           %-8u %-8u %u\n", tasks[i].name,
+			       tasks[i].params.runtime, tasks[i].params.deadline,
+			       tasks[i].params.period, stats.jobs, stats.misses, stats.overruns);
+		}
+	}
+
+	stop = TRUE;
+	sched_dump();
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Report", THREAD_PRIO_REALTIME, report_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,88 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/hrtimers.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * High resolution timers accuracy.
+ * Two periodic timers pace at PERIOD_USECS for one second, the first one
+ * runs its callback in the clock interrupt, the second one in a softirq.
+ * The timers table reports the lateness of the callbacks in nanoseconds.
+ */
+
+#define PERIOD_USECS	(50)
+
+static volatile unsigned long counters[2];
+
+static void irq_cb(void *arg)
+{
+	(void)arg;
+	++counters[0];
+}
+
+static void softirq_cb(void *arg)
+{
+	(void)arg;
+	++counters[1];
+}
+
+static void pacing_entry(void)
+{
+	hrtimer_t *hrt[2];
+	uint64_t start;
+
+	hrt[0] = hrtimer_create("PaceIRQ", irq_cb, NULL, 0);
+	hrt[1] = hrtimer_create("PaceSIRQ", softirq_cb, NULL, HRTIMER_SOFTIRQ);
+	if (!hrt[0] || !hrt[1]) {
+		printf("cannot create the timers\n");
+		return;
+	}
+
+	start = clock_get_ns();
+	if ((EOK != hrtimer_start(hrt[0], PERIOD_USECS, PERIOD_USECS)) ||
+	    (EOK != hrtimer_start(hrt[1], PERIOD_USECS, PERIOD_USECS))) {
+		printf("cannot start the timers\n");
+		return;
+	}
+
+	thread_delay(1000);
+
+	hrtimer_cancel(hrt[0]);
+	hrtimer_cancel(hrt[1]);
+
+	printf("%llu usecs, %lu IRQ and %lu softirq expirations, %llu expected\n",
+	       (clock_get_ns() - start) / 1000ULL, counters[0], counters[1],
+	       ((clock_get_ns() - start) / 1000ULL) / PERIOD_USECS);
+
+	hrtimer_dump(NULL);
+
+	hrtimer_done(hrt[0]);
+	hrtimer_done(hrt[1]);
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Pacing", THREAD_PRIO_HIGH, pacing_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,95 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/devices.h>
+#include <diegos/io_rings.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Synchronous writes versus an I/O ring on the serial port.
+ * LINES short lines are written to uart0 one call at a time, then queued
+ * in batches of BATCH entries on a ring, which hands each batch to the
+ * driver write_multi_fn in a single call.
+ */
+
+#define LINES	(512)
+#define BATCH	(16)
+
+static const char line[] = "0123456789abcdef0123456789abcdef\r\n";
+
+static void ring_entry(void)
+{
+	uint64_t start, sync_msecs, ring_msecs;
+	io_ring_t *ring;
+	io_sqe_t *sqe;
+	io_cqe_t *cqe;
+	device_t *uart;
+	unsigned i, j, errors = 0;
+
+	uart = device_lookup("uart", 0);
+	ring = io_ring_create("uring", BATCH);
+	if (!uart || !ring) {
+		printf("cannot find uart0 or create the ring\n");
+		return;
+	}
+
+	start = clock_get_milliseconds();
+	for (i = 0; i < LINES; i++) {
+		device_io_tx(uart, line, strlen(line));
+	}
+	sync_msecs = clock_get_milliseconds() - start;
+
+	start = clock_get_milliseconds();
+	for (i = 0; i < LINES; i += BATCH) {
+		for (j = 0; j < BATCH; j++) {
+			sqe = io_ring_get_sqe(ring);
+			sqe->opcode = IO_OP_WRITE;
+			sqe->dev = uart;
+			sqe->buf = (void *)line;
+			sqe->bytes = strlen(line);
+			sqe->user_data = i + j;
+		}
+		io_ring_submit(ring);
+		io_ring_wait(ring, BATCH, 0);
+
+		while ((cqe = io_ring_peek_cqe(ring))) {
+			if ((EOK != cqe->status) || (cqe->bytes != strlen(line))) {
+				++errors;
+			}
+			io_ring_cqe_seen(ring);
+		}
+	}
+	ring_msecs = clock_get_milliseconds() - start;
+
+	io_ring_done(ring);
+
+	printf("lines   sync msecs   ring msecs   errors\n");
+	printf("%-5u   %-10llu   %-10llu   %u\n", LINES, sync_msecs, ring_msecs, errors);
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Ring", THREAD_PRIO_NORMAL, ring_entry, 0, 4096, &pid);
+}
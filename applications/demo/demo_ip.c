@@ -51,7 +51,7 @@ static void demo_thread_entry(void)
 
 void platform_run()
 {
-	uint8_t pid;
+	tid_t pid;
 
 	thread_create("IPDemo", THREAD_PRIO_NORMAL, demo_thread_entry, 0, 8192, &pid);
 }
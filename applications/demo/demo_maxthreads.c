@@ -36,7 +36,7 @@ static void demo_thread_entry(void)
 
 	memset(ehehe, 96, 4000);
 	ehehe[3999] = 0;
-	uint8_t t = 0;
+	tid_t t = 0;
 
 	while (t < my_thread_id() + 5) {
 		thread_lock_mutex(mutex);
@@ -73,7 +73,7 @@ static void demo_thread_entry(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 	volatile unsigned i = 0;
 	char name[10];
 	BOOL retcode;
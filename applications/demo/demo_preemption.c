@@ -0,0 +1,70 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_dump.h>
+#include <stdio.h>
+
+/*
+ * Round robin time slicing, build with PREEMPTION=y.
+ * Two CPU bound threads share THREAD_PRIO_NORMAL and never yield,
+ * a reporter thread prints their progress every second.
+ * Without preemption only the first one ever runs.
+ */
+
+static volatile unsigned long counters[2];
+
+static void busy_entry0(void)
+{
+	while (TRUE) {
+		++counters[0];
+	}
+}
+
+static void busy_entry1(void)
+{
+	while (TRUE) {
+		++counters[1];
+	}
+}
+
+static void report_entry(void)
+{
+	unsigned i;
+
+	for (i = 0; i < 10; i++) {
+		thread_delay(1000);
+		printf("busy0 %lu busy1 %lu\n", counters[0], counters[1]);
+	}
+
+	threads_dump();
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	if (!thread_set_time_slice(THREAD_PRIO_NORMAL, 10)) {
+		printf("Preemption is not enabled.\n");
+	}
+
+	thread_create("Busy0", THREAD_PRIO_NORMAL, busy_entry0, 0, 2048, &pid);
+	thread_create("Busy1", THREAD_PRIO_NORMAL, busy_entry1, 0, 2048, &pid);
+	thread_create("Report", THREAD_PRIO_HIGH, report_entry, 0, 4096, &pid);
+}
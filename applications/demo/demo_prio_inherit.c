@@ -0,0 +1,115 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/kernel_dump.h>
+#include <diegos/mutexes.h>
+#include <stdio.h>
+
+/*
+ * Priority inversion, build with PREEMPTION=y.
+ * A low priority thread holds a mutex for LOW_HOLD milliseconds, a high
+ * priority thread blocks on it while a medium priority thread burns the
+ * CPU for MEDIUM_BUSY milliseconds.
+ * With a plain mutex the high priority thread waits for the medium one,
+ * with MUTEX_PRIO_INHERIT the owner is boosted and the wait is bounded
+ * by LOW_HOLD only.
+ */
+
+#define LOW_HOLD	(50)
+#define MEDIUM_BUSY	(500)
+
+static mutex_t *mutex;
+static volatile BOOL low_done;
+static volatile BOOL medium_done;
+
+static void spin(unsigned msecs)
+{
+	uint64_t end = clock_get_milliseconds() + msecs;
+
+	while (clock_get_milliseconds() < end) ;
+}
+
+static void low_entry(void)
+{
+	thread_lock_mutex(mutex);
+	spin(LOW_HOLD);
+	thread_unlock_mutex(mutex);
+	low_done = TRUE;
+}
+
+static void medium_entry(void)
+{
+	spin(MEDIUM_BUSY);
+	medium_done = TRUE;
+}
+
+static uint64_t inversion(unsigned flags)
+{
+	uint64_t start, waited;
+	tid_t pid;
+
+	low_done = FALSE;
+	medium_done = FALSE;
+	mutex = thread_create_mutex_flags((flags) ? "pi" : "plain", flags);
+
+	thread_create("Low", THREAD_PRIO_NORMAL + 8, low_entry, 0, 2048, &pid);
+	thread_delay(10);
+
+	thread_create("Medium", THREAD_PRIO_NORMAL, medium_entry, 0, 2048, &pid);
+
+	start = clock_get_milliseconds();
+	thread_lock_mutex(mutex);
+	waited = clock_get_milliseconds() - start;
+	thread_unlock_mutex(mutex);
+
+	while (!low_done || !medium_done) {
+		thread_delay(10);
+	}
+
+	thread_destroy_mutex(mutex);
+
+	return (waited);
+}
+
+static void high_entry(void)
+{
+	uint64_t plain, pi;
+
+	if (!thread_set_time_slice(THREAD_PRIO_NORMAL, 10)) {
+		printf("Preemption is not enabled.\n");
+	}
+
+	plain = inversion(0);
+	pi = inversion(MUTEX_PRIO_INHERIT);
+
+	printf("mutex     msecs blocked\n");
+	printf("plain     %llu\n", plain);
+	printf("inherit   %llu\n", pi);
+
+	mutexes_dump();
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("High", THREAD_PRIO_HIGH, high_entry, 0, 4096, &pid);
+}
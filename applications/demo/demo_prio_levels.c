@@ -0,0 +1,103 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <stdio.h>
+
+/*
+ * Context switch cost versus the number of priority levels in use.
+ * Two threads ping-pong with thread_suspend() while filler threads,
+ * one per priority level, sit in the lower ready queues.
+ * With the ready bitmap the cost of a switch must not depend on how
+ * many levels are populated.
+ */
+
+#define PING_LOOPS	(200000UL)
+#define MAX_FILLERS	(12)
+
+static volatile BOOL stop_fillers = FALSE;
+static volatile unsigned long pings;
+static volatile unsigned pingers_done;
+
+static void filler_entry(void)
+{
+	while (!stop_fillers) {
+		thread_suspend();
+	}
+}
+
+static void ping_entry(void)
+{
+	while (pings) {
+		--pings;
+		thread_suspend();
+	}
+
+	++pingers_done;
+}
+
+static void bench_entry(void)
+{
+	char name[16];
+	uint64_t start, elapsed;
+	unsigned levels;
+	tid_t pid;
+
+	printf("levels   switches   msecs   nsecs/switch\n");
+
+	for (levels = 0; levels <= MAX_FILLERS; levels++) {
+		if (levels) {
+			sprintf(name, "fill%u", levels);
+			if (!thread_create(name, THREAD_PRIO_IDLE - levels, filler_entry,
+					   0, 1024, &pid)) {
+				printf("cannot create %s\n", name);
+				break;
+			}
+		}
+
+		pings = PING_LOOPS;
+		pingers_done = 0;
+
+		sprintf(name, "pingA%u", levels);
+		thread_create(name, THREAD_PRIO_HIGH + 1, ping_entry, 0, 2048, &pid);
+		sprintf(name, "pingB%u", levels);
+		thread_create(name, THREAD_PRIO_HIGH + 1, ping_entry, 0, 2048, &pid);
+
+		start = clock_get_milliseconds();
+
+		while (pingers_done != 2) {
+			thread_delay(10);
+		}
+
+		elapsed = clock_get_milliseconds() - start;
+
+		printf("%-6u   %-8lu   %-5llu   %llu\n", levels + 2, PING_LOOPS, elapsed,
+		       (elapsed * 1000000ULL) / PING_LOOPS);
+	}
+
+	stop_fillers = TRUE;
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Bench", THREAD_PRIO_HIGH, bench_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,98 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/kernel_dump.h>
+#include <diegos/timers.h>
+#include <stdio.h>
+
+/*
+ * Timer slack.
+ * TIMERS recursive timers with slightly different periods run for
+ * PHASE_MSECS without slack, then for PHASE_MSECS with SLACK_MSECS of
+ * slack: the expirations are the same, the clock interrupts are fewer.
+ */
+
+#define TIMERS		(16)
+#define PHASE_MSECS	(3000)
+#define SLACK_MSECS	(20)
+
+static volatile unsigned long expired;
+
+static void timer_cb(void *arg)
+{
+	(void)arg;
+	++expired;
+}
+
+static void phase(timer_t **tmr, unsigned slack)
+{
+	uint64_t irqs;
+	unsigned i;
+
+	expired = 0;
+	irqs = clock_get_interrupts();
+
+	for (i = 0; i < TIMERS; i++) {
+		timer_set_slack(tmr[i], slack);
+		timer_set(tmr[i], TRUE);
+	}
+
+	thread_delay(PHASE_MSECS);
+
+	for (i = 0; i < TIMERS; i++) {
+		timer_set(tmr[i], FALSE);
+	}
+
+	printf("slack %-3u   expirations %-6lu   clock interrupts %llu\n", slack, expired,
+	       clock_get_interrupts() - irqs);
+}
+
+static void slack_entry(void)
+{
+	timer_t *tmr[TIMERS];
+	char name[16];
+	unsigned i;
+
+	for (i = 0; i < TIMERS; i++) {
+		sprintf(name, "slack%u", i);
+		tmr[i] = timer_create(name, 100 + i * 3, TRUE, timer_cb, NULL);
+		if (!tmr[i]) {
+			printf("cannot create %s\n", name);
+			return;
+		}
+	}
+
+	phase(tmr, 0);
+	phase(tmr, SLACK_MSECS);
+
+	deadlines_dump();
+
+	for (i = 0; i < TIMERS; i++) {
+		timer_done(tmr[i]);
+	}
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Slack", THREAD_PRIO_HIGH, slack_entry, 0, 4096, &pid);
+}
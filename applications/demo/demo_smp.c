@@ -0,0 +1,106 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/kernel_dump.h>
+#include <stdio.h>
+
+/*
+ * CPU bound threads scaling across processors, build with SMP=y and run
+ * under qemu-system-i386 -smp 4.
+ * Every phase starts WORKERS threads that never yield and count loops
+ * until a common deadline, idle processors steal them from the busy one
+ * so that the total count grows with the number of processors.
+ */
+
+#define RUN_MSECS	(2000)
+#define MAX_WORKERS	(4)
+
+static volatile unsigned long counters[MAX_WORKERS];
+static volatile unsigned done;
+static volatile uint64_t deadline;
+static volatile unsigned started;
+
+static void worker_entry(void)
+{
+	unsigned i = started++;
+
+	while (clock_get_milliseconds() < deadline) {
+		++counters[i];
+	}
+
+	++done;
+}
+
+static unsigned long phase(unsigned workers)
+{
+	char name[16];
+	unsigned long total = 0;
+	unsigned i;
+	tid_t pid;
+
+	done = 0;
+	started = 0;
+	deadline = clock_get_milliseconds() + RUN_MSECS;
+
+	for (i = 0; i < workers; i++) {
+		counters[i] = 0;
+		sprintf(name, "Work%u_%u", workers, i);
+		thread_create(name, THREAD_PRIO_NORMAL, worker_entry, 0, 2048, &pid);
+	}
+
+	while (done != workers) {
+		thread_delay(100);
+	}
+
+	for (i = 0; i < workers; i++) {
+		total += counters[i];
+	}
+
+	return (total);
+}
+
+static void main_entry(void)
+{
+	unsigned long base, loops;
+	unsigned long long speedup;
+	unsigned workers;
+
+	base = phase(1);
+
+	printf("threads   loops        speedup\n");
+	printf("%-7u   %-10lu   1.00\n", 1, base);
+
+	for (workers = 2; workers <= MAX_WORKERS; workers <<= 1) {
+		loops = phase(workers);
+		speedup = (loops * 100ULL) / base;
+		printf("%-7u   %-10lu   %llu.%02llu\n", workers, loops, speedup / 100,
+		       speedup % 100);
+	}
+
+	threads_dump();
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Main", THREAD_PRIO_HIGH, main_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,110 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/spinlocks.h>
+#include <stdio.h>
+
+/*
+ * Ticket and MCS locks under contention, build with SMP=y and run under
+ * qemu-system-i386 -smp 4 to have threads really spinning.
+ * WORKERS threads increment a shared counter LOOPS times each, holding
+ * the lock under test, the counter must match at the end.
+ */
+
+#define WORKERS		(4)
+#define LOOPS		(200000UL)
+
+static spinlock_t ticket;
+static mcslock_t mcs;
+static BOOL use_mcs;
+static volatile unsigned long counter;
+static volatile unsigned done;
+
+static void worker_entry(void)
+{
+	mcs_node_t node;
+	unsigned long i;
+
+	for (i = 0; i < LOOPS; i++) {
+		if (use_mcs) {
+			mcslock_lock(&mcs, &node);
+			++counter;
+			mcslock_unlock(&mcs, &node);
+		} else {
+			spinlock_lock(&ticket);
+			++counter;
+			spinlock_unlock(&ticket);
+		}
+	}
+
+	__sync_fetch_and_add(&done, 1);
+}
+
+static void run(const char *name, BOOL mcs_lock)
+{
+	spinlock_stats_t stats;
+	uint64_t start, elapsed;
+	unsigned i;
+	tid_t pid;
+
+	use_mcs = mcs_lock;
+	counter = 0;
+	done = 0;
+
+	start = clock_get_milliseconds();
+
+	for (i = 0; i < WORKERS; i++) {
+		thread_create(name, THREAD_PRIO_NORMAL, worker_entry, 0, 2048, &pid);
+	}
+
+	while (done != WORKERS) {
+		thread_delay(10);
+	}
+
+	elapsed = clock_get_milliseconds() - start;
+
+	if (mcs_lock) {
+		mcslock_get_stats(&mcs, &stats, TRUE);
+	} else {
+		spinlock_get_stats(&ticket, &stats, TRUE);
+	}
+
+	printf("%-8s  %-5llu  %-9lu  %-9u  %-9u  %-10llu  %llu\n", name, elapsed, counter,
+	       stats.acquisitions, stats.contended, stats.spins, stats.max_hold);
+}
+
+static void main_entry(void)
+{
+	spinlock_init_flags(&ticket, SPINLOCK_STATS);
+	mcslock_init(&mcs, SPINLOCK_STATS);
+
+	printf("lock      msecs  counter    acquired   contended  spins       max hold\n");
+
+	run("ticket", FALSE);
+	run("mcs", TRUE);
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Main", THREAD_PRIO_HIGH, main_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,156 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_dump.h>
+#include <diegos/semaphores.h>
+#include <diegos/condvars.h>
+#include <diegos/rwlocks.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * Producer/consumer on a ring guarded by two counting semaphores,
+ * a condition variable signalling the end of the run and a
+ * reader/writer lock shared by two readers and a writer.
+ */
+
+#define RING_SIZE	(8)
+#define ITEMS		(10000)
+
+static sem_t *empty_slots;
+static sem_t *full_slots;
+static unsigned ring[RING_SIZE];
+
+static mutex_t *done_mutex;
+static cond_t *done_cond;
+static unsigned done_count;
+
+static rwlock_t *table_lock;
+static unsigned table[2];
+static volatile unsigned long reads, mismatches;
+
+static void finished(void)
+{
+	thread_lock_mutex(done_mutex);
+	++done_count;
+	condvar_signal(done_cond);
+	thread_unlock_mutex(done_mutex);
+}
+
+static void producer_entry(void)
+{
+	unsigned i;
+
+	for (i = 0; i < ITEMS; i++) {
+		semaphore_wait(empty_slots);
+		ring[i % RING_SIZE] = i;
+		semaphore_post(full_slots);
+	}
+
+	finished();
+}
+
+static void consumer_entry(void)
+{
+	unsigned i, errors = 0;
+
+	for (i = 0; i < ITEMS; i++) {
+		semaphore_wait(full_slots);
+		if (ring[i % RING_SIZE] != i) {
+			++errors;
+		}
+		semaphore_post(empty_slots);
+	}
+
+	printf("consumer: %u items, %u out of order\n", ITEMS, errors);
+	finished();
+}
+
+static void reader_entry(void)
+{
+	unsigned i;
+
+	for (i = 0; i < ITEMS; i++) {
+		if (EOK == rwlock_read_lock_timed(table_lock, 100)) {
+			if (table[0] != table[1]) {
+				++mismatches;
+			}
+			++reads;
+			rwlock_unlock(table_lock);
+		}
+		thread_suspend();
+	}
+
+	finished();
+}
+
+static void writer_entry(void)
+{
+	unsigned i;
+
+	for (i = 0; i < ITEMS / 10; i++) {
+		rwlock_write_lock(table_lock);
+		++table[0];
+		thread_suspend();
+		++table[1];
+		rwlock_unlock(table_lock);
+		thread_delay(1);
+	}
+
+	finished();
+}
+
+static void main_entry(void)
+{
+	tid_t pid;
+
+	empty_slots = semaphore_create("empty", RING_SIZE);
+	full_slots = semaphore_create("full", 0);
+	done_mutex = thread_create_mutex("done");
+	done_cond = condvar_create("done");
+	table_lock = rwlock_create("table");
+
+	thread_create("Producer", THREAD_PRIO_NORMAL, producer_entry, 0, 2048, &pid);
+	thread_create("Consumer", THREAD_PRIO_NORMAL, consumer_entry, 0, 4096, &pid);
+	thread_create("Reader0", THREAD_PRIO_NORMAL, reader_entry, 0, 2048, &pid);
+	thread_create("Reader1", THREAD_PRIO_NORMAL, reader_entry, 0, 2048, &pid);
+	thread_create("Writer", THREAD_PRIO_NORMAL - 1, writer_entry, 0, 2048, &pid);
+
+	thread_lock_mutex(done_mutex);
+	while (done_count < 5) {
+		if (ETIMEDOUT == condvar_wait_timed(done_cond, done_mutex, 5000)) {
+			printf("still waiting, %u threads done\n", done_count);
+		}
+	}
+	thread_unlock_mutex(done_mutex);
+
+	printf("readers: %lu reads, %lu torn\n", reads, mismatches);
+
+	semaphores_dump();
+	condvars_dump();
+	rwlocks_dump();
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Main", THREAD_PRIO_HIGH, main_entry, 0, 4096, &pid);
+}
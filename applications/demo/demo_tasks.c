@@ -0,0 +1,138 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/tasks.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/*
+ * Thousands of sessions multiplexed over a single thread.
+ * Each session is a stackless task waiting for events with a timeout,
+ * a driver thread sends events to random sessions. All the sessions
+ * cost SESSIONS * sizeof(struct session) bytes and one thread stack.
+ */
+
+#define SESSIONS	(10000)
+#define ROUNDS		(20)
+#define SENDS		(100000UL)
+
+struct session {
+	task_t task;
+	event_t ev;
+	event_t *got;
+	volatile BOOL pending;
+	uint16_t round;
+	uint16_t timeouts;
+	uint32_t events;
+};
+
+static struct session sessions[SESSIONS];
+static task_runner_t *runner;
+static volatile unsigned exited;
+
+static int session_fn(task_t *task)
+{
+	struct session *s = task->arg;
+
+	TASK_BEGIN(task);
+
+	for (s->round = 0; s->round < ROUNDS; s->round++) {
+		TASK_WAIT_EVENT(task, s->got, 50 + (s - sessions) % 50);
+		if (s->got) {
+			++s->events;
+			s->pending = FALSE;
+		} else {
+			++s->timeouts;
+		}
+	}
+
+	TASK_END(task);
+}
+
+static void session_exit(task_t *task)
+{
+	(void)task;
+	++exited;
+}
+
+static void runner_entry(void)
+{
+	task_runner_run(runner);
+}
+
+static void driver_entry(void)
+{
+	uint64_t start, elapsed;
+	unsigned long i, sent = 0, events = 0, timeouts = 0;
+	struct session *s;
+
+	start = clock_get_milliseconds();
+
+	for (i = 0; i < SESSIONS; i++) {
+		task_start(runner, &sessions[i].task, session_fn, &sessions[i]);
+	}
+
+	for (i = 0; (i < SENDS) && (exited < SESSIONS); i++) {
+		s = &sessions[rand() % SESSIONS];
+		if (!s->pending) {
+			s->pending = TRUE;
+			if (EOK == task_send(&s->task, &s->ev, NULL)) {
+				++sent;
+			} else {
+				s->pending = FALSE;
+			}
+		}
+		if (!(i % 64)) {
+			thread_delay(1);
+		}
+	}
+
+	while (exited < SESSIONS) {
+		thread_delay(100);
+	}
+
+	elapsed = clock_get_milliseconds() - start;
+
+	for (i = 0; i < SESSIONS; i++) {
+		events += sessions[i].events;
+		timeouts += sessions[i].timeouts;
+	}
+
+	printf("sessions   bytes   sent     events   timeouts   msecs\n");
+	printf("%-8u   %-5u   %-6lu   %-6lu   %-8lu   %llu\n", SESSIONS,
+	       (unsigned)(SESSIONS * sizeof(struct session)), sent, events, timeouts, elapsed);
+
+	task_runner_dump(runner);
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	runner = task_runner_create("Sessions", session_exit);
+	if (!runner) {
+		printf("cannot create the task runner\n");
+		return;
+	}
+
+	thread_create("Runner", THREAD_PRIO_NORMAL, runner_entry, 0, 4096, &pid);
+	thread_create("Driver", THREAD_PRIO_NORMAL, driver_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,76 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <stdio.h>
+
+/*
+ * Wake up jitter and clock interrupt load of a mostly idle system,
+ * build with TICKLESS=y and TICKLESS=n to compare.
+ * A single thread sleeps for a few different periods, every wake up
+ * is compared against the requested deadline.
+ */
+
+#define SLEEP_LOOPS	(50)
+
+static const unsigned periods[] = { 1, 5, 10, 50, 100, 500 };
+
+static void jitter_entry(void)
+{
+	uint64_t start, deadline, now, ints;
+	uint64_t late, late_min, late_max, late_sum;
+	unsigned i, j;
+
+	printf("period   late min   late avg   late max   clock ints/s\n");
+
+	for (i = 0; i < NELEMENTS(periods); i++) {
+		late_min = -1ULL;
+		late_max = 0;
+		late_sum = 0;
+		ints = clock_get_interrupts();
+		start = clock_get_milliseconds();
+
+		for (j = 0; j < SLEEP_LOOPS; j++) {
+			deadline = clock_get_milliseconds() + periods[i];
+			thread_delay(periods[i]);
+			now = clock_get_milliseconds();
+
+			late = (now > deadline) ? (now - deadline) : 0;
+			late_sum += late;
+			if (late < late_min)
+				late_min = late;
+			if (late > late_max)
+				late_max = late;
+		}
+
+		now = clock_get_milliseconds() - start;
+		ints = clock_get_interrupts() - ints;
+
+		printf("%-6u   %-8llu   %-8llu   %-8llu   %llu\n", periods[i], late_min,
+		       late_sum / SLEEP_LOOPS, late_max, (now) ? (ints * 1000ULL / now) : 0ULL);
+	}
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Jitter", THREAD_PRIO_HIGH, jitter_entry, 0, 4096, &pid);
+}
@@ -262,7 +262,7 @@ static void demo_thread_entry(void)
 
 void platform_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 	device_t *vga_dev = NULL;
 
 	vga_dev = device_lookup("vesa", 0);
@@ -0,0 +1,151 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/wait_objects.h>
+#include <diegos/poll.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * A single thread serving an events queue, a barrier, a semaphore,
+ * a mutex and the standard input, each one signalled at its own pace,
+ * with no helper thread per object.
+ */
+
+#define RUN_MSECS	(3000)
+
+static ev_queue_t *evq;
+static barrier_t *barrier;
+static sem_t *sem;
+static mutex_t *mutex;
+static event_t event;
+
+static void events_entry(void)
+{
+	while (TRUE) {
+		thread_delay(30);
+		if (!event_queue_size(evq)) {
+			event_put(evq, &event, NULL);
+		}
+	}
+}
+
+static void barrier_entry(void)
+{
+	while (TRUE) {
+		thread_delay(70);
+		barrier_open(barrier);
+	}
+}
+
+static void sem_entry(void)
+{
+	while (TRUE) {
+		thread_delay(110);
+		semaphore_post(sem);
+	}
+}
+
+static void mutex_entry(void)
+{
+	while (TRUE) {
+		thread_lock_mutex(mutex);
+		thread_delay(150);
+		thread_unlock_mutex(mutex);
+		thread_delay(10);
+	}
+}
+
+static void server_entry(void)
+{
+	static const char *names[] = { "events", "barrier", "semaphore", "mutex", "stdin" };
+	unsigned counters[NELEMENTS(names)] = { 0 };
+	wait_obj_t objs[NELEMENTS(names)];
+	uint64_t end;
+	unsigned i, fired, timeouts = 0;
+	tid_t pid;
+	int retval;
+
+	evq = event_init_queue("server");
+	event_watch_queue(evq);
+	barrier = barrier_create("server", TRUE);
+	sem = semaphore_create("server", 0);
+	mutex = thread_create_mutex("server");
+
+	objs[0].type = WAIT_OBJ_EVENTS;
+	objs[0].obj.evqueue = evq;
+	objs[1].type = WAIT_OBJ_BARRIER;
+	objs[1].obj.barrier = barrier;
+	objs[2].type = WAIT_OBJ_SEMAPHORE;
+	objs[2].obj.sem = sem;
+	objs[3].type = WAIT_OBJ_MUTEX;
+	objs[3].obj.mutex = mutex;
+	objs[4].type = WAIT_OBJ_FD;
+	objs[4].obj.fd = 0;
+	objs[4].revents = POLLIN;
+
+	thread_create("Events", THREAD_PRIO_NORMAL, events_entry, 0, 2048, &pid);
+	thread_create("Barrier", THREAD_PRIO_NORMAL, barrier_entry, 0, 2048, &pid);
+	thread_create("Sem", THREAD_PRIO_NORMAL, sem_entry, 0, 2048, &pid);
+	thread_create("Mutex", THREAD_PRIO_NORMAL, mutex_entry, 0, 2048, &pid);
+
+	end = clock_get_milliseconds() + RUN_MSECS;
+
+	while (clock_get_milliseconds() < end) {
+		retval = wait_for_objects(objs, NELEMENTS(objs), 500, &fired);
+
+		if (ETIMEDOUT == retval) {
+			++timeouts;
+			continue;
+		}
+
+		if (EOK != retval) {
+			printf("wait_for_objects failed with %d\n", retval);
+			return;
+		}
+
+		++counters[fired];
+
+		switch (fired) {
+		case 0:
+			while (event_get(evq)) ;
+			break;
+		case 3:
+			thread_unlock_mutex(mutex);
+			break;
+		case 4:
+			getchar();
+			break;
+		}
+	}
+
+	for (i = 0; i < NELEMENTS(names); i++) {
+		printf("%-10s %u\n", names[i], counters[i]);
+	}
+	printf("%-10s %u\n", "timeouts", timeouts);
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Server", THREAD_PRIO_HIGH, server_entry, 0, 4096, &pid);
+}
@@ -0,0 +1,103 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/events.h>
+#include <stdio.h>
+
+/*
+ * Wakeup latency versus the number of blocked threads.
+ * A driver thread posts an event to one of WAITERS threads, each one
+ * blocked on its own events queue, and yields so that the waiter runs.
+ * Blocked threads are resumed by the queue they wait on, so the cost of
+ * a wakeup must not depend on how many other threads are blocked.
+ */
+
+#define WAKE_LOOPS	(100000UL)
+#define WAITERS		(20)
+
+static ev_queue_t *queues[WAITERS];
+static volatile unsigned long wakeups;
+static volatile unsigned ready;
+
+static event_t events[WAITERS];
+
+static void waiter_entry(void)
+{
+	ev_queue_t *evq = queues[ready];
+
+	event_watch_queue(evq);
+	++ready;
+
+	while (TRUE) {
+		wait_for_events(evq);
+		while (event_get(evq)) {
+			++wakeups;
+		}
+	}
+}
+
+static void driver_entry(void)
+{
+	char name[16];
+	uint64_t start, elapsed;
+	unsigned long i;
+	unsigned waiters;
+	tid_t pid;
+
+	for (waiters = 0; waiters < WAITERS; waiters++) {
+		sprintf(name, "evq%u", waiters);
+		queues[waiters] = event_init_queue(name);
+		if (!queues[waiters]) {
+			printf("cannot create %s\n", name);
+			return;
+		}
+	}
+
+	for (waiters = 0; waiters < WAITERS; waiters++) {
+		sprintf(name, "wait%u", waiters);
+		thread_create(name, THREAD_PRIO_NORMAL - 1, waiter_entry, 0, 2048, &pid);
+		while (ready == waiters) {
+			thread_delay(10);
+		}
+	}
+
+	wakeups = 0;
+	start = clock_get_milliseconds();
+
+	for (i = 0; i < WAKE_LOOPS; i++) {
+		waiters = i % WAITERS;
+		event_put(queues[waiters], &events[waiters], NULL);
+		thread_suspend();
+	}
+
+	elapsed = clock_get_milliseconds() - start;
+
+	printf("waiters   wakeups   msecs   nsecs/wakeup\n");
+	printf("%-7u   %-7lu   %-5llu   %llu\n", WAITERS, wakeups, elapsed,
+	       (elapsed * 1000000ULL) / WAKE_LOOPS);
+}
+
+void platform_run(void)
+{
+	tid_t pid;
+
+	thread_create("Driver", THREAD_PRIO_NORMAL, driver_entry, 0, 4096, &pid);
+}
@@ -99,7 +99,7 @@ static void network_core_main_entry(void)
 
 void network_run(void)
 {
-	uint8_t pid;
+	tid_t pid;
 	BOOL retcode;
 
 	retcode =
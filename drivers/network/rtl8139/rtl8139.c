@@ -38,6 +38,7 @@
 #include <libs/pci_lib.h>
 #include <processor/ports.h>
 #include <diegos/interrupts.h>
+#include <diegos/softirqs.h>
 #include <diegos/delays.h>
 #include <diegos/drivers.h>
 #include <diegos/net_buffers.h>
@@ -88,6 +89,12 @@ static char *rx_buffer = NULL;
 static unsigned rx_cur_address = 0;
 static unsigned rx_ring_offset = 0;
 
+/*
+ * Interrupt status acknowledged by the handler, serviced by the softirq
+ */
+static volatile uint16_t isr_pending = 0;
+static softirq_t *rtl_softirq = NULL;
+
 static pci_bus_device_t *instance = NULL;
 
 static const uint16_t vid_did[] = {
@@ -422,6 +429,23 @@ static void rtl_interrupts(uint16_t isr)
 	}
 }
 
+/*
+ * Deferred interrupt work, packets are received with interrupts enabled
+ */
+static void rtl_softirq_handler(void *arg)
+{
+	uint16_t isr;
+
+	lock();
+	isr = isr_pending;
+	isr_pending = 0;
+	unlock();
+
+	kdrvprintf("rtl8139: interrupt, ISR=0x%04x\n", isr);
+
+	rtl_interrupts(isr);
+}
+
 /*
  * Interrupt handler
  */
@@ -431,9 +455,8 @@ static BOOL rtl_int_handler(void)
 	uint16_t isr = in_word(rtl_port + RL_ISR);
 	out_word(rtl_port + RL_ISR, isr);
 
-	kdrvprintf("rtl8139: interrupt, ISR=0x%04x\n", isr);
-
-	rtl_interrupts(isr);
+	isr_pending |= isr;
+	(void)softirq_raise(rtl_softirq);
 
 	return (TRUE);
 }
@@ -796,6 +819,13 @@ static int rtl_init(unsigned unitno)
 			rtl_init_config_info();
 			rtl_print_config_info();
 
+			if (!rtl_softirq) {
+				rtl_softirq = softirq_create("rtl8139", rtl_softirq_handler, NULL);
+				if (!rtl_softirq) {
+					return (ENOMEM);
+				}
+			}
+
 			/*
 			 * Interrupts need to be relocated following the x86 DiegOS mapping.
 			 * This could be done directly in the PCI library code, but for the sake
@@ -24,6 +24,7 @@
 #include <diegos/kernel.h>
 #include <diegos/poll.h>
 #include <diegos/interrupts.h>
+#include <diegos/softirqs.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -93,6 +94,13 @@ static unsigned overrun_errors = 0, parity_errors = 0, framing_errors = 0;
 static volatile unsigned flags = DRV_IS_CHAR | DRV_READ_BLOCK | DRV_WRITE_BLOCK;
 static wait_queue_t wq_w, wq_r;
 
+/*
+ * The interrupt handler drains the FIFOs, waiting threads are resumed
+ * by the softirq
+ */
+static volatile BOOL wake_r = FALSE, wake_w = FALSE;
+static softirq_t *uart_softirq = NULL;
+
 static inline void write_register(const uint16_t com, enum uart_registers reg, uint8_t data)
 {
 	out_byte(com + reg, data);
@@ -210,7 +218,7 @@ static void uart_handle_recv_data_fifo(void)
 		}
 	}
 
-	(void)thread_io_resume(&wq_r);
+	wake_r = TRUE;
 }
 
 static void uart_handle_recv_data_timeout(void)
@@ -233,7 +241,7 @@ static void uart_handle_recv_data_timeout(void)
 		flags &= ~DRV_READING;
 	}
 
-	(void)thread_io_resume(&wq_r);
+	wake_r = TRUE;
 }
 
 static void uart_handle_tx_data(void)
@@ -249,7 +257,7 @@ static void uart_handle_tx_data(void)
 		disable_uart_tx();
 	}
 
-	(void)thread_io_resume(&wq_w);
+	wake_w = TRUE;
 }
 
 static void uart_handle_modem_status(void)
@@ -264,6 +272,26 @@ static void uart_handle_modem_status(void)
 	}
 }
 
+static void uart_softirq_handler(void *arg)
+{
+	BOOL r, w;
+
+	lock();
+	r = wake_r;
+	w = wake_w;
+	wake_r = FALSE;
+	wake_w = FALSE;
+	unlock();
+
+	if (r) {
+		(void)thread_io_resume(&wq_r);
+	}
+
+	if (w) {
+		(void)thread_io_resume(&wq_w);
+	}
+}
+
 static BOOL uart_interrupt(void)
 {
 	uint8_t retval, intval;
@@ -296,6 +324,10 @@ static BOOL uart_interrupt(void)
 
 	} while (!(retval & IIR_NO_INT_PEND));
 
+	if (wake_r || wake_w) {
+		(void)softirq_raise(uart_softirq);
+	}
+
 	return (TRUE);
 }
 
@@ -331,6 +363,15 @@ static int uart_init(unsigned unitno)
 		flags |= (DRV_READ_BLOCK | DRV_WRITE_BLOCK);
 	}
 
+	if (!uart_softirq) {
+		uart_softirq = softirq_create("16550d", uart_softirq_handler, NULL);
+		if (!uart_softirq) {
+			free(tx_buf);
+			free(rx_buf);
+			return (ENOMEM);
+		}
+	}
+
 	if (EOK != add_int_cb(uart_interrupt, UART_IVT)) {
 		return (EGENERIC);
 	}
@@ -502,6 +543,27 @@ static int uart_write(const void *buf, unsigned bytes, unsigned unitno)
 	return (retval);
 }
 
+/*
+ * Write a list of buffers, used by I/O rings to pass whole batches
+ */
+static int uart_write_multi(const void **buf, const unsigned *bytes, unsigned items,
+			    unsigned unitno)
+{
+	unsigned i;
+
+	if (!buf || !bytes || unitno) {
+		return (EINVAL);
+	}
+
+	for (i = 0; i < items; i++) {
+		if (uart_write(buf[i], bytes[i], unitno) != (int)bytes[i]) {
+			return (EIO);
+		}
+	}
+
+	return (EOK);
+}
+
 static int uart_read(void *buf, unsigned bytes, unsigned unitno)
 {
 	unsigned copy_bytes;
@@ -639,6 +701,6 @@ char_driver_t uart16550d_drv = {
 	,
 	.write_fn = uart_write,
 	.read_fn = uart_read,
-	.write_multi_fn = NULL,
+	.write_multi_fn = uart_write_multi,
 	.read_multi_fn = NULL
 };
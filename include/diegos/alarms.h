@@ -105,6 +105,22 @@ int alarm_acknowledge(alarm_t * alm);
  */
 int alarm_update(alarm_t * alm, unsigned millisecs, BOOL recursive);
 
+/*
+ * Set the slack of an alarm, i.e. how many milliseconds its expiration
+ * can be delayed so that it is served by the same clock interrupt of
+ * other alarms, timers and timeouts. The slack is effective from the
+ * next time the alarm is armed.
+ *
+ * PARAMETERS IN
+ * alarm_t *alm - The alarm handle
+ * unsigned millisecs - the slack, 0 to expire exactly on time
+ *
+ * RETURNS
+ * EINVAL if alm is not a valid pointer
+ * EOK in any other case.
+ */
+int alarm_set_slack(alarm_t * alm, unsigned millisecs);
+
 /*
  * Remove an alarm.
  *
@@ -47,7 +47,8 @@ typedef struct barrier barrier_t;
  * const char *name - barrier name, can be NULL
  * BOOL autoclose   - if a barrier is open and there are pending threads on it,
  *                    the barrier will be automatically closed after resuming
- *                    the threads
+ *                    the threads, with no pending threads it will be closed
+ *                    by the first thread passing through
  *
  * RETURNS
  * A pointer to a barrier handle or NULL in case of failure.
@@ -49,7 +49,9 @@ typedef struct block_driver {
 	int (*read_fn)(void *buf, unsigned bytes, uint64_t start_block, unsigned unitno);
 	/*
 	 * Multi Write function, the data buffer list pointed by buf
-	 * will be output to the device
+	 * will be output to the device.
+	 * Multi functions return EOK if all the items are transferred, any
+	 * other value fails the whole list.
 	 */
 	int (*write_multi_fn)(const void **buf,
 			      const unsigned *bytes, const uint64_t * start_block, unsigned items,
@@ -39,13 +39,16 @@ typedef struct char_driver {
 	int (*read_fn)(void *buf, unsigned bytes, unsigned unitno);
 	/*
 	 * Multi Write function, the data buffer list pointed by buf
-	 * will be output to the device
+	 * will be output to the device.
+	 * Multi functions return EOK if all the items are transferred, any
+	 * other value fails the whole list.
 	 */
 	int (*write_multi_fn)(const void **buf,
 			      const unsigned *bytes, unsigned items, unsigned unitno);
 	/*
 	 * Multi Read function, the data buffer list pointed by buf
-	 * will be written with data
+	 * will be written with data, bytes is updated with the amount
+	 * read into each buffer
 	 */
 	int (*read_multi_fn)(void **buf, unsigned *bytes, unsigned items, unsigned unitno);
 
@@ -0,0 +1,129 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONDVARS_H_INCLUDED
+#define CONDVARS_H_INCLUDED
+
+#include <types_common.h>
+#include <diegos/mutexes.h>
+
+/*
+ * Condition variables API.
+ * A thread holding a mutex waits on a condition variable, atomically
+ * releasing the mutex; once signalled it is resumed holding the mutex again.
+ * Signalled threads are not resumed to compete for the mutex: they are
+ * moved to the mutex waiters list and resumed only when the lock is
+ * handed to them, so a broadcast resumes one thread at a time.
+ * All threads waiting on a condition variable at the same time must
+ * use the same mutex.
+ * This API cannot be used in interrupt context.
+ */
+
+typedef struct condvar cond_t;
+
+/*
+ * Create a condition variable providing a name (optional).
+ *
+ * PARAMETERS IN
+ * const char *name - condition variable name, can be NULL
+ *
+ * RETURNS
+ * A pointer to a condition variable handle or NULL in case of failure.
+ */
+cond_t *condvar_create(const char *name);
+
+/*
+ * Destroy a condition variable.
+ *
+ * PARAMETERS IN
+ * cond_t *cond - the condition variable to be destroyed
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if cond is invalid
+ * EBUSY if threads are waiting on the condition variable
+ */
+int condvar_done(cond_t * cond);
+
+/*
+ * Release the mutex and wait on the condition variable, the mutex
+ * is held again on return.
+ *
+ * PARAMETERS IN
+ * cond_t *cond - condition variable handle
+ * mutex_t *mtx - the mutex, locked by the running thread
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if cond or mtx are invalid
+ * EPERM if the thread does not own the mutex or cannot be set to wait state
+ */
+int condvar_wait(cond_t * cond, mutex_t * mtx);
+
+/*
+ * Release the mutex and wait on the condition variable until it is signalled
+ * or the timeout expires, the mutex is held again on return in any case.
+ *
+ * PARAMETERS IN
+ * cond_t *cond   - condition variable handle
+ * mutex_t *mtx   - the mutex, locked by the running thread
+ * unsigned msecs - the timeout in milliseconds, if 0, the thread will wait indefinitely.
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if cond or mtx are invalid
+ * EPERM if the thread does not own the mutex or cannot be set to wait state
+ * ETIMEDOUT if the timeout expires before the condition variable is signalled
+ */
+int condvar_wait_timed(cond_t * cond, mutex_t * mtx, unsigned msecs);
+
+/*
+ * Wake the most urgent thread waiting on the condition variable.
+ *
+ * PARAMETERS IN
+ * cond_t *cond - condition variable handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if cond is invalid
+ */
+int condvar_signal(cond_t * cond);
+
+/*
+ * Wake all threads waiting on the condition variable.
+ *
+ * PARAMETERS IN
+ * cond_t *cond - condition variable handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if cond is invalid
+ */
+int condvar_broadcast(cond_t * cond);
+
+/*
+ * Print the specified condition variable's status.
+ * If cond is null, all condition variables are processed.
+ *
+ * PARAMETERS IN
+ * const cond_t *cond - a specific condition variable to be dumped, or NULL to dump'em all
+ */
+void condvar_dump(const cond_t * cond);
+
+#endif
@@ -55,6 +55,26 @@ void set_delay(unsigned long lpm);
  */
 void calibrate_delay(unsigned long (*tickfn)(void));
 
+/*
+ * This function should be invoked at boot time by platform dependent code
+ * with the frequency of the processor cycle counter, measured against a
+ * known clock.
+ * Once set, delays and clock_get_ns() are based on the cycle counter and
+ * the delay loop is not used anymore.
+ *
+ * PARAMETERS IN
+ * unsigned long cpm - cycles per millisecond.
+ */
+void set_cycles(unsigned long cpm);
+
+/*
+ * Returns the frequency of the processor cycle counter.
+ *
+ * RETURNS
+ * unsigned long - cycles per millisecond, 0 if not set
+ */
+unsigned long cycles_per_msec(void);
+
 /*
  * Delay execution by at least msecs milliseconds.
  * The call is NOT suspensive.
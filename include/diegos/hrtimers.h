@@ -0,0 +1,110 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HRTIMERS_H_
+#define _HRTIMERS_H_
+
+#include <types_common.h>
+
+/*
+ * High resolution timers API.
+ * Deadlines are expressed in microseconds and tracked with the cycle
+ * counter clocksource, the CLK device runs in one-shot mode and is
+ * programmed to expire at the earliest deadline.
+ * Callbacks run in interrupt context with interrupts disabled, or in
+ * softirq context with interrupts enabled if the timer is created with
+ * HRTIMER_SOFTIRQ. In both cases they must not block.
+ * This API can be used in interrupt context.
+ *
+ * Flags:
+ * HRTIMER_SOFTIRQ - run the callback from a softirq instead of the
+ *                   clock interrupt handler.
+ */
+enum {
+	HRTIMER_SOFTIRQ = 1 << 0
+};
+
+typedef struct hrtimer hrtimer_t;
+typedef void (*hrtimer_cb)(void *arg);
+
+/*
+ * Create a high resolution timer, the timer is not armed.
+ *
+ * PARAMETERS IN
+ * const char *name - timer name, can be NULL
+ * hrtimer_cb cb    - callback invoked on expiration
+ * void *arg        - context to be passed to the callback
+ * unsigned flags   - HRTIMER_SOFTIRQ or 0
+ *
+ * RETURNS
+ * A pointer to a timer handle or NULL in case of failure.
+ */
+hrtimer_t *hrtimer_create(const char *name, hrtimer_cb cb, void *arg, unsigned flags);
+
+/*
+ * Arm a timer to expire usecs microseconds from now, an armed timer
+ * is re-armed.
+ * A periodic timer is re-armed on expiration period_usecs after its
+ * previous deadline, so that periods do not accumulate latencies.
+ *
+ * PARAMETERS IN
+ * hrtimer_t *hrt         - the timer
+ * uint32_t usecs         - microseconds to the first expiration
+ * uint32_t period_usecs  - period in microseconds, 0 for a one-shot timer
+ *
+ * RETURNS
+ * EINVAL if hrt is not a valid pointer
+ * EGENERIC if the timer cannot be armed
+ * EOK in any other case.
+ */
+int hrtimer_start(hrtimer_t * hrt, uint32_t usecs, uint32_t period_usecs);
+
+/*
+ * Disarm a timer, a callback deferred to softirq context and not yet
+ * executed is discarded.
+ *
+ * PARAMETERS IN
+ * hrtimer_t *hrt - the timer
+ */
+void hrtimer_cancel(hrtimer_t * hrt);
+
+/*
+ * Remove a timer.
+ *
+ * PARAMETERS IN
+ * hrtimer_t *hrt - the timer
+ *
+ * RETURNS
+ * EINVAL if hrt is not a valid pointer
+ * EOK in any other case.
+ */
+int hrtimer_done(hrtimer_t * hrt);
+
+/*
+ * Print the specified timer's statistics: expirations, overruns of
+ * periodic timers, average and maximum lateness in nanoseconds measured
+ * when the callback starts.
+ * If hrt is null, all timers are processed.
+ *
+ * PARAMETERS IN
+ * const hrtimer_t *hrt - a specific timer to be dumped, or NULL to dump'em all
+ */
+void hrtimer_dump(const hrtimer_t * hrt);
+
+#endif
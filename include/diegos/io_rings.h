@@ -0,0 +1,179 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IO_RINGS_H_INCLUDED
+#define IO_RINGS_H_INCLUDED
+
+#include <types_common.h>
+#include <diegos/devices.h>
+
+/*
+ * Asynchronous I/O rings API.
+ * A thread reserves entries in the submission ring, fills them and submits
+ * them in batches; a kernel thread dedicated to the ring performs the I/O
+ * and posts one completion per entry, in submission order, to the
+ * completion ring where the thread reaps them.
+ * Consecutive entries addressing the same device with the same opcode are
+ * passed in a single call to the driver's multi function, if available.
+ * Entries can be reserved as long as submitted entries not yet reaped are
+ * less than the ring size, so completions never overflow.
+ * A ring must be used by a single thread.
+ */
+
+typedef struct io_ring io_ring_t;
+
+enum io_ring_opcode {
+	/*
+	 * Read from a character or block device
+	 */
+	IO_OP_READ,
+	/*
+	 * Write to a character or block device
+	 */
+	IO_OP_WRITE,
+	/*
+	 * Receive a packet from a network device, buf is a struct packet
+	 */
+	IO_OP_NET_RX,
+	/*
+	 * Transmit a packet to a network device, buf is a struct packet
+	 */
+	IO_OP_NET_TX
+};
+
+/*
+ * Submission entry
+ */
+typedef struct io_sqe {
+	unsigned opcode;
+	device_t *dev;
+	void *buf;
+	/*
+	 * Size of buf, unused by network operations
+	 */
+	unsigned bytes;
+	/*
+	 * Start block of block devices
+	 */
+	uint64_t offset;
+	/*
+	 * Copied to the completion entry
+	 */
+	uint64_t user_data;
+} io_sqe_t;
+
+/*
+ * Completion entry
+ */
+typedef struct io_cqe {
+	uint64_t user_data;
+	/*
+	 * EOK or the error code of the operation
+	 */
+	int status;
+	/*
+	 * Bytes transferred
+	 */
+	unsigned bytes;
+} io_cqe_t;
+
+/*
+ * Create a ring and its kernel thread.
+ *
+ * PARAMETERS IN
+ * const char *name - ring name, can be NULL
+ * unsigned entries - ring size, rounded up to a power of 2, up to 256
+ *
+ * RETURNS
+ * A pointer to a ring handle or NULL in case of failure.
+ */
+io_ring_t *io_ring_create(const char *name, unsigned entries);
+
+/*
+ * Destroy a ring, its kernel thread terminates.
+ *
+ * PARAMETERS IN
+ * io_ring_t *ring - the ring to be destroyed
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if ring is invalid
+ * EBUSY if submitted entries are not completed yet
+ */
+int io_ring_done(io_ring_t * ring);
+
+/*
+ * Reserve the next submission entry, to be filled by the caller.
+ *
+ * PARAMETERS IN
+ * io_ring_t *ring - the ring
+ *
+ * RETURNS
+ * A pointer to the entry or NULL if the ring is full.
+ */
+io_sqe_t *io_ring_get_sqe(io_ring_t * ring);
+
+/*
+ * Submit all the reserved entries.
+ *
+ * PARAMETERS IN
+ * io_ring_t *ring - the ring
+ *
+ * RETURNS
+ * The number of submitted entries.
+ */
+unsigned io_ring_submit(io_ring_t * ring);
+
+/*
+ * Wait until at least min_complete completions can be reaped
+ * or the timeout expires.
+ *
+ * PARAMETERS IN
+ * io_ring_t *ring       - the ring
+ * unsigned min_complete - completions to wait for
+ * unsigned msecs        - the timeout in milliseconds, if 0, the thread will wait indefinitely.
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if ring is invalid or min_complete exceeds the submitted entries
+ * ETIMEDOUT if the timeout expires before
+ */
+int io_ring_wait(io_ring_t * ring, unsigned min_complete, unsigned msecs);
+
+/*
+ * Oldest completion not reaped yet, it stays in the ring until
+ * io_ring_cqe_seen() is called.
+ *
+ * PARAMETERS IN
+ * io_ring_t *ring - the ring
+ *
+ * RETURNS
+ * A pointer to the completion or NULL if there is none.
+ */
+io_cqe_t *io_ring_peek_cqe(io_ring_t * ring);
+
+/*
+ * Release the completion returned by io_ring_peek_cqe().
+ *
+ * PARAMETERS IN
+ * io_ring_t *ring - the ring
+ */
+void io_ring_cqe_seen(io_ring_t * ring);
+
+#endif
@@ -32,7 +32,7 @@ int thread_io_wait(wait_queue_t * wq);
 int thread_io_wait_timed(wait_queue_t * wq, unsigned msecs);
 
 /*
- * Resume all threads waiting on a wait queue.
+ * Resume all threads and tasks waiting on a wait queue.
  * This function is expected to be called from an interrupt context.
  */
 int thread_io_resume(wait_queue_t * wq);
@@ -38,15 +38,31 @@
 /*
  * As explained in threads.h, higher priorities
  * have lower values. The highest priority is
- * always 0. The lowest is up to this enumeration.
-  */
+ * always 0. The lowest is THREAD_PRIO_IDLE.
+ * There are THREAD_PRIO_LEVELS levels, the named
+ * priorities are spread across them so that any
+ * value in between can be used to fine tune a thread,
+ * i.e. THREAD_PRIO_NORMAL - 1 is slightly more urgent
+ * than THREAD_PRIO_NORMAL.
+ * THREAD_PRIO_EDF is the exception: the level is reserved
+ * to earliest deadline first threads, created with
+ * thread_create_edf() and sorted by deadline.
+ */
 typedef enum {
-	THREAD_PRIO_REALTIME,
-	THREAD_PRIO_HIGH,
-	THREAD_PRIO_NORMAL,
-	THREAD_PRIO_IDLE
+	THREAD_PRIO_REALTIME = 0,
+	THREAD_PRIO_EDF = 1,
+	THREAD_PRIO_HIGH = 8,
+	THREAD_PRIO_NORMAL = 16,
+	THREAD_PRIO_IDLE = 31,
+	THREAD_PRIO_LEVELS = 32
 } diegos_prio_t;
 
+/*
+ * Thread identifier, the TID space grows at runtime
+ * together with the number of threads.
+ */
+typedef uint32_t tid_t;
+
 /*
  * thread functions for voluntary suspension,
  * delaying or termination.
@@ -62,15 +78,104 @@ void thread_terminate(void);
 /*
  * thread management for out-of-context
  * creation or termination.
+ * thread_create() fails with errno set to EINVAL
+ * if prio is THREAD_PRIO_EDF.
  */
 BOOL thread_create(const char *name,
 		   diegos_prio_t prio,
-		   void (*entry_ptr)(void), void *stack, unsigned stack_size, uint8_t * tid);
+		   void (*entry_ptr)(void), void *stack, unsigned stack_size, tid_t * tid);
 
-void thread_kill(uint8_t tid);
+void thread_kill(tid_t tid);
 
-uint8_t my_thread_id(void);
+tid_t my_thread_id(void);
 
 const char *my_thread_name(void);
 
+/*
+ * Preemption control, effective only if the kernel is built
+ * with PREEMPTION enabled.
+ * The running thread cannot be preempted between a call to
+ * thread_preempt_disable() and the matching call to
+ * thread_preempt_enable(), calls nest.
+ */
+void thread_preempt_disable(void);
+
+void thread_preempt_enable(void);
+
+/*
+ * Set the time slice of all threads with priority prio,
+ * 0 disables time slicing for that priority.
+ * Returns FALSE if preemption is not enabled.
+ */
+BOOL thread_set_time_slice(diegos_prio_t prio, unsigned msecs);
+
+/*
+ * Earliest deadline first threads.
+ * A thread declares the runtime it needs every period and the deadline,
+ * relative to the start of the period, by which the runtime must be
+ * served; all values are in milliseconds and
+ * runtime <= deadline <= period.
+ * Threads are admitted only if the bandwidth (runtime / deadline) of all
+ * the EDF threads of the processor stays below 90%, they never move to
+ * another processor.
+ * A job ends calling thread_edf_wait(), which sleeps until the next
+ * period; a job still running at its deadline is a miss.
+ * With PREEMPTION a job exceeding its runtime is preempted and postponed
+ * to the next period, so that it cannot delay the other EDF threads.
+ */
+typedef struct edf_params {
+	unsigned runtime;
+	unsigned deadline;
+	unsigned period;
+} edf_params_t;
+
+typedef struct edf_stats {
+	uint32_t jobs;
+	uint32_t misses;
+	uint32_t overruns;
+} edf_stats_t;
+
+BOOL thread_create_edf(const char *name,
+		       const edf_params_t * params,
+		       void (*entry_ptr)(void), void *stack, unsigned stack_size, tid_t * tid);
+
+void thread_edf_wait(void);
+
+/*
+ * Get the jobs statistics of an EDF thread.
+ * Returns FALSE if tid is not an EDF thread.
+ */
+BOOL thread_edf_stats(tid_t tid, edf_stats_t * stats);
+
+/*
+ * CPU accounting of a thread, times are in processor cycles.
+ * The running thread is charged up to the time of the snapshot,
+ * as well as threads waiting in a ready queue.
+ */
+typedef struct thread_stats {
+	tid_t tid;
+	char name[16];
+	uint8_t priority;
+	const char *state;
+	uint64_t run_cycles;
+	uint64_t ready_cycles;
+	uint32_t voluntary;
+	uint32_t involuntary;
+} thread_stats_t;
+
+/*
+ * Take a snapshot of the CPU accounting of all threads, sorted by TID.
+ *
+ * PARAMETERS IN
+ * thread_stats_t *stats - array receiving the snapshot
+ * unsigned max          - size of the array in items
+ * uint64_t *cycles      - if not NULL, receives the cycle counter
+ *                         at the time of the snapshot
+ *
+ * RETURNS
+ * the number of items stored, if it is max the snapshot may be
+ * incomplete and a larger array is required.
+ */
+unsigned thread_stats_snapshot(thread_stats_t *stats, unsigned max, uint64_t *cycles);
+
 #endif				// KERNEL_H_INCLUDED
@@ -26,6 +26,24 @@ void mutexes_dump(void);
 
 void barriers_dump(void);
 
+void semaphores_dump(void);
+
+void condvars_dump(void);
+
+void rwlocks_dump(void);
+
+void softirqs_dump(void);
+
+void hrtimers_dump(void);
+
+void tasks_dump(void);
+
+void slabs_dump(void);
+
+void heap_dump(void);
+
+void deadlines_dump(void);
+
 void threads_check(void);
 
 void diegos_dump(void);
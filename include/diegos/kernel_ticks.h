@@ -51,6 +51,33 @@ uint64_t clock_get_seconds(void);
  */
 uint64_t clock_get_milliseconds(void);
 
+/*
+ * Get system nanoseconds from the processor cycle counter, cheap enough
+ * to timestamp latencies.
+ * Until the platform sets the cycle counter frequency the resolution
+ * is one millisecond.
+ *
+ * RETURN VALUES
+ * 64 bit counter of nanoseconds elapsed since the cycle counter setup.
+ */
+uint64_t clock_get_ns(void);
+
+/*
+ * Convert an amount of processor cycles to nanoseconds.
+ *
+ * RETURN VALUES
+ * the nanoseconds, 0 if the cycle counter frequency is unknown.
+ */
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+/*
+ * Get the number of interrupts served by the CLK device.
+ *
+ * RETURN VALUES
+ * 64 bit counter of clock interrupts since boot time.
+ */
+uint64_t clock_get_interrupts(void);
+
 /*
  * Convert milliseconds into system ticks.
  *
@@ -24,6 +24,17 @@
 
 typedef struct mutex mutex_t;
 
+/*
+ * Mutex creation flags.
+ * MUTEX_PRIO_INHERIT - the owner of the mutex runs at the priority of its
+ *                      most urgent waiter until it releases the lock, the
+ *                      boost is carried along chains of owners blocked on
+ *                      other priority inheritance mutexes.
+ */
+enum {
+	MUTEX_PRIO_INHERIT = 1 << 0
+};
+
 /*
  * Create a new mutex with the specified name.
  *
@@ -35,6 +46,19 @@ typedef struct mutex mutex_t;
  */
 mutex_t *thread_create_mutex(const char *name);
 
+/*
+ * Create a new mutex with the specified name and flags.
+ * Waiters of any mutex are granted the lock in priority order.
+ *
+ * PARAMETERS IN
+ * const char *name - the name of the mutex, for debugging purposes.
+ * unsigned flags   - MUTEX_PRIO_INHERIT or 0.
+ *
+ * RETURNS
+ * a pointer to the created mutex, or NULL on failure.
+ */
+mutex_t *thread_create_mutex_flags(const char *name, unsigned flags);
+
 /*
  * Locks a mutex.
  *
@@ -68,7 +68,9 @@ typedef struct net_driver {
 	int (*rx_fn)(struct packet * buf, unsigned unitno);
 	/*
 	 * Multi Write function, the data buffer list pointed by buf
-	 * will be output to the device
+	 * will be output to the device.
+	 * Multi functions return EOK if all the items are transferred, any
+	 * other value fails the whole list.
 	 */
 	int (*tx_multi_fn)(const struct packet ** buf, unsigned items, unsigned unitno);
 	/*
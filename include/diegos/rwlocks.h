@@ -0,0 +1,144 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RWLOCKS_H_INCLUDED
+#define RWLOCKS_H_INCLUDED
+
+#include <types_common.h>
+
+/*
+ * Reader/writer locks API.
+ * Any number of readers or a single writer can hold the lock.
+ * Writers are preferred: once a writer waits, new readers wait as well,
+ * so a stream of readers cannot starve writers.
+ * On release the lock is handed straight to the most urgent waiting writer,
+ * or to all the waiting readers if no writer waits; resumed threads already
+ * hold the lock and never retry.
+ * This API cannot be used in interrupt context.
+ */
+
+typedef struct rwlock rwlock_t;
+
+/*
+ * Create a reader/writer lock providing a name (optional).
+ *
+ * PARAMETERS IN
+ * const char *name - lock name, can be NULL
+ *
+ * RETURNS
+ * A pointer to a lock handle or NULL in case of failure.
+ */
+rwlock_t *rwlock_create(const char *name);
+
+/*
+ * Destroy a reader/writer lock.
+ *
+ * PARAMETERS IN
+ * rwlock_t *rwl - the lock to be destroyed
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if rwl is invalid
+ * EBUSY if the lock is held or threads are waiting on it
+ */
+int rwlock_done(rwlock_t * rwl);
+
+/*
+ * Lock for reading, the running thread waits while a writer holds
+ * or waits for the lock.
+ *
+ * PARAMETERS IN
+ * rwlock_t *rwl - lock handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if rwl is invalid
+ * EPERM if the thread cannot be set to wait state
+ */
+int rwlock_read_lock(rwlock_t * rwl);
+
+/*
+ * Lock for reading, with a timeout.
+ *
+ * PARAMETERS IN
+ * rwlock_t *rwl  - lock handle
+ * unsigned msecs - the timeout in milliseconds, if 0, the thread will wait indefinitely.
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if rwl is invalid
+ * EPERM if the thread cannot be set to wait state
+ * ETIMEDOUT if the timeout expires before the lock is held
+ */
+int rwlock_read_lock_timed(rwlock_t * rwl, unsigned msecs);
+
+/*
+ * Lock for writing, the running thread waits while the lock is held.
+ *
+ * PARAMETERS IN
+ * rwlock_t *rwl - lock handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if rwl is invalid
+ * EBUSY if the thread already holds the lock for writing
+ * EPERM if the thread cannot be set to wait state
+ */
+int rwlock_write_lock(rwlock_t * rwl);
+
+/*
+ * Lock for writing, with a timeout.
+ *
+ * PARAMETERS IN
+ * rwlock_t *rwl  - lock handle
+ * unsigned msecs - the timeout in milliseconds, if 0, the thread will wait indefinitely.
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if rwl is invalid
+ * EBUSY if the thread already holds the lock for writing
+ * EPERM if the thread cannot be set to wait state
+ * ETIMEDOUT if the timeout expires before the lock is held
+ */
+int rwlock_write_lock_timed(rwlock_t * rwl, unsigned msecs);
+
+/*
+ * Release the lock, held either for writing by the running thread
+ * or for reading.
+ *
+ * PARAMETERS IN
+ * rwlock_t *rwl - lock handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if rwl is invalid
+ * EPERM if the lock is not held
+ */
+int rwlock_unlock(rwlock_t * rwl);
+
+/*
+ * Print the specified lock's status.
+ * If rwl is null, all reader/writer locks are processed.
+ *
+ * PARAMETERS IN
+ * const rwlock_t *rwl - a specific lock to be dumped, or NULL to dump'em all
+ */
+void rwlock_dump(const rwlock_t * rwl);
+
+#endif
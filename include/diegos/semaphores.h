@@ -0,0 +1,128 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEMAPHORES_H_INCLUDED
+#define SEMAPHORES_H_INCLUDED
+
+#include <types_common.h>
+
+/*
+ * Counting semaphores API.
+ * A semaphore holds a number of units, semaphore_wait takes one unit
+ * or sets the running thread in wait state if there are none left,
+ * semaphore_post gives one unit back.
+ * A posted unit is handed straight to the most urgent waiting thread,
+ * which is resumed already owning it: no other thread can steal
+ * the unit in between and the waiter never retries.
+ * semaphore_post and semaphore_trywait can be used in interrupt context.
+ */
+
+typedef struct semaphore sem_t;
+
+/*
+ * Create a semaphore providing a name (optional) and
+ * the initial number of units.
+ *
+ * PARAMETERS IN
+ * const char *name - semaphore name, can be NULL
+ * unsigned count   - initial number of units
+ *
+ * RETURNS
+ * A pointer to a semaphore handle or NULL in case of failure.
+ */
+sem_t *semaphore_create(const char *name, unsigned count);
+
+/*
+ * Destroy a semaphore.
+ *
+ * PARAMETERS IN
+ * sem_t *sem - the semaphore to be destroyed
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if sem is invalid
+ * EBUSY if threads are waiting on the semaphore
+ */
+int semaphore_done(sem_t * sem);
+
+/*
+ * Take a unit, the running thread waits until one is available.
+ *
+ * PARAMETERS IN
+ * sem_t *sem - semaphore handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if sem is invalid
+ * EPERM if the thread cannot be set to wait state
+ */
+int semaphore_wait(sem_t * sem);
+
+/*
+ * Take a unit, the running thread waits until one is available
+ * or the timeout expires.
+ *
+ * PARAMETERS IN
+ * sem_t *sem     - semaphore handle
+ * unsigned msecs - the timeout in milliseconds, if 0, the thread will wait indefinitely.
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if sem is invalid
+ * EPERM if the thread cannot be set to wait state
+ * ETIMEDOUT if the timeout expires before a unit is available
+ */
+int semaphore_wait_timed(sem_t * sem, unsigned msecs);
+
+/*
+ * Take a unit if available, never waits.
+ *
+ * PARAMETERS IN
+ * sem_t *sem - semaphore handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if sem is invalid
+ * EAGAIN if no unit is available
+ */
+int semaphore_trywait(sem_t * sem);
+
+/*
+ * Give a unit back, the most urgent waiting thread is resumed
+ * owning it.
+ *
+ * PARAMETERS IN
+ * sem_t *sem - semaphore handle
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if sem is invalid
+ */
+int semaphore_post(sem_t * sem);
+
+/*
+ * Print the specified semaphore's status.
+ * If sem is null, all semaphores are processed.
+ *
+ * PARAMETERS IN
+ * const sem_t *sem - a specific semaphore to be dumped, or NULL to dump'em all
+ */
+void semaphore_dump(const sem_t * sem);
+
+#endif
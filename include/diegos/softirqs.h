@@ -0,0 +1,75 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTIRQS_H_INCLUDED
+#define SOFTIRQS_H_INCLUDED
+
+#include <types_common.h>
+
+/*
+ * Deferred interrupt work API.
+ * An interrupt handler acknowledges its device and raises a softirq, the
+ * softirq callback runs on exit from the outermost interrupt handler with
+ * interrupts enabled and the interrupt line unmasked, before returning to
+ * the interrupted thread.
+ * Softirqs are run in the order they are raised, a softirq raised again
+ * before running runs once; a callback can raise its own softirq.
+ * The time between the raise and the run is accounted per softirq.
+ * Callbacks must not block.
+ */
+
+typedef struct softirq softirq_t;
+
+typedef void (*softirq_fn)(void *arg);
+
+/*
+ * Create a softirq.
+ *
+ * PARAMETERS IN
+ * const char *name - softirq name, can be NULL
+ * softirq_fn fn    - the deferred work callback
+ * void *arg        - argument of the callback
+ *
+ * RETURNS
+ * A pointer to a softirq handle or NULL in case of failure.
+ */
+softirq_t *softirq_create(const char *name, softirq_fn fn, void *arg);
+
+/*
+ * Queue a softirq, to be called from interrupt handlers.
+ *
+ * PARAMETERS IN
+ * softirq_t *sirq - the softirq
+ *
+ * RETURNS
+ * TRUE if the softirq is queued
+ * FALSE if it is already queued or invalid
+ */
+BOOL softirq_raise(softirq_t * sirq);
+
+/*
+ * Print the specified softirq's statistics, latencies are in cycles.
+ * If sirq is null, all softirqs are processed.
+ *
+ * PARAMETERS IN
+ * const softirq_t *sirq - a specific softirq to be dumped, or NULL to dump'em all
+ */
+void softirq_dump(const softirq_t * sirq);
+
+#endif
@@ -20,15 +20,134 @@
 #ifndef SPINLOCKS_H_INCLUDED
 #define SPINLOCKS_H_INCLUDED
 
-typedef volatile long spinlock_t;
+#include <types_common.h>
+
+/*
+ * Spinlock creation flags.
+ * SPINLOCK_STATS - count acquisitions, contended acquisitions, spins and
+ *                  the maximum hold time of the lock.
+ */
+enum {
+	SPINLOCK_STATS = 1 << 0
+};
+
+/*
+ * Contention counters, updated by the lock owner only.
+ * Hold times are measured in processor cycles.
+ */
+typedef struct spinlock_stats {
+	uint32_t acquisitions;
+	uint32_t contended;
+	uint64_t spins;
+	uint64_t max_hold;
+} spinlock_stats_t;
+
+/*
+ * Ticket lock, waiters are granted the lock in FIFO order.
+ * A waiter that cannot be granted the lock soon yields the CPU, so the
+ * lock is usable by cooperative threads on a single processor too.
+ */
+typedef struct spinlock {
+	volatile unsigned next;
+	volatile unsigned owner;
+	unsigned flags;
+	uint64_t acquired;
+	spinlock_stats_t stats;
+} spinlock_t;
+
+/*
+ * MCS queue lock, every waiter spins on its own node, which is provided by
+ * the caller and must stay valid until the lock is released.
+ * Cache lines are not bounced between waiters, as it happens with a ticket
+ * lock under heavy contention.
+ */
+typedef struct mcs_node {
+	struct mcs_node *volatile next;
+	volatile BOOL locked;
+} mcs_node_t;
+
+typedef struct mcslock {
+	mcs_node_t *volatile tail;
+	unsigned flags;
+	uint64_t acquired;
+	spinlock_stats_t stats;
+} mcslock_t;
 
 /*
  * spinlock management
  */
 void spinlock_init(spinlock_t * sl);
 
+/*
+ * Init a ticket lock.
+ *
+ * PARAMETERS IN
+ * spinlock_t *sl - the lock
+ * unsigned flags - SPINLOCK_STATS or 0
+ */
+void spinlock_init_flags(spinlock_t * sl, unsigned flags);
+
 void spinlock_lock(spinlock_t * sl);
 
+/*
+ * Lock a ticket lock only if it is free.
+ *
+ * PARAMETERS IN
+ * spinlock_t *sl - the lock
+ *
+ * RETURNS
+ * TRUE if the lock is taken
+ * FALSE in any other case
+ */
+BOOL spinlock_trylock(spinlock_t * sl);
+
 void spinlock_unlock(spinlock_t * sl);
 
+/*
+ * Disable interrupts and lock, used with data shared with interrupt handlers.
+ * The waiter never yields, the lock must be held shortly and never across a
+ * blocking call.
+ *
+ * PARAMETERS IN
+ * spinlock_t *sl - the lock
+ *
+ * RETURNS
+ * the interrupt state to be passed to spinlock_unlock_irqrestore
+ */
+unsigned spinlock_lock_irqsave(spinlock_t * sl);
+
+void spinlock_unlock_irqrestore(spinlock_t * sl, unsigned flags);
+
+/*
+ * Copy the contention counters of a lock, optionally clearing them.
+ *
+ * PARAMETERS IN
+ * spinlock_t *sl - the lock
+ * BOOL reset     - clear the counters after the copy
+ *
+ * PARAMETERS OUT
+ * spinlock_stats_t *stats - the counters
+ *
+ * RETURNS
+ * TRUE if the lock has been initialized with SPINLOCK_STATS
+ * FALSE in any other case
+ */
+BOOL spinlock_get_stats(spinlock_t * sl, spinlock_stats_t * stats, BOOL reset);
+
+/*
+ * MCS lock management, same semantics of the ticket lock functions.
+ * The node passed to the unlock function must be the one used to lock.
+ */
+void mcslock_init(mcslock_t * ml, unsigned flags);
+
+void mcslock_lock(mcslock_t * ml, mcs_node_t * node);
+
+void mcslock_unlock(mcslock_t * ml, mcs_node_t * node);
+
+unsigned mcslock_lock_irqsave(mcslock_t * ml, mcs_node_t * node);
+
+void mcslock_unlock_irqrestore(mcslock_t * ml, mcs_node_t * node, unsigned flags);
+
+BOOL mcslock_get_stats(mcslock_t * ml, spinlock_stats_t * stats, BOOL reset);
+
 #endif				// SPINLOCKS_H_INCLUDED
@@ -0,0 +1,254 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TASKS_H_
+#define _TASKS_H_
+
+#include <errno.h>
+#include <types_common.h>
+#include <libs/queue_type.h>
+#include <libs/red_black_tree.h>
+#include <diegos/events.h>
+#include <diegos/io_waits.h>
+
+/*
+ * Stackless tasks API.
+ * A task is a function resumed by a task runner, many tasks share the
+ * runner thread and its stack. A task does not keep its locals across
+ * a wait: the function returns to the runner and is entered again at
+ * the wait point when the task is woken up, so any state that must
+ * survive a wait lives in the structure embedding the task.
+ * The resume point is set by the TASK_ macros below, which expand to
+ * the cases of a switch statement: a task function must wrap its body
+ * in TASK_BEGIN()/TASK_END() and cannot use switch statements spanning
+ * a wait.
+ *
+ * A task costs sizeof(task_t) bytes, allocated by the caller, plus a
+ * wait queue item while it waits on a wait_queue_t.
+ * A task waits for one kind of wakeup at a time: events sent to a task
+ * waiting for something else are queued and returned by the next
+ * TASK_WAIT_EVENT().
+ * Tasks of a runner never run in parallel, a task runs until it waits.
+ *
+ * Typical usage:
+ *
+ * static int session(task_t *task)
+ * {
+ *	struct session *s = task->arg;
+ *
+ *	TASK_BEGIN(task);
+ *	while (s->open) {
+ *		TASK_WAIT_EVENT(task, s->ev, 1000);
+ *		...
+ *	}
+ *	TASK_END(task);
+ * }
+ */
+
+enum {
+	TASK_WAITING,
+	TASK_EXITED
+};
+
+/*
+ * Wakeup sources, see task_t wait and woken fields
+ */
+enum {
+	TASK_WAKE_READY = 1 << 0,
+	TASK_WAKE_TIMER = 1 << 1,
+	TASK_WAKE_EVENT = 1 << 2,
+	TASK_WAKE_IO = 1 << 3
+};
+
+typedef struct task_runner task_runner_t;
+typedef struct task task_t;
+
+/*
+ * Task function, returns TASK_WAITING when the task waits and
+ * TASK_EXITED when it terminates, see TASK_BEGIN and TASK_END.
+ */
+typedef int (*task_fn)(task_t *task);
+
+/*
+ * Invoked by the runner thread when a task terminates, the task is no
+ * longer referenced by the runner and its memory can be released.
+ */
+typedef void (*task_exit_fn)(task_t *task);
+
+struct task {
+	/*
+	 * Must be the first field, sleeping tasks are sorted by deadline
+	 */
+	rbtree_node_t header;
+	queue_node ready;
+	queue_inst mailbox;
+	uint64_t deadline;
+	task_fn fn;
+	void *arg;
+	task_runner_t *runner;
+	uint16_t lc;
+	uint8_t wait;
+	uint8_t woken;
+};
+
+#define TASK_BEGIN(t)	switch ((t)->lc) { case 0:
+
+#define TASK_END(t)	} (t)->lc = 0; return (TASK_EXITED)
+
+#define TASK_EXIT(t)				\
+	do {					\
+		(t)->lc = 0;			\
+		return (TASK_EXITED);		\
+	} while (0)
+
+/*
+ * Let the other ready tasks run
+ */
+#define TASK_YIELD(t)				\
+	do {					\
+		(t)->lc = __LINE__;		\
+		task_yield(t);			\
+		return (TASK_WAITING);		\
+	case __LINE__:;				\
+	} while (0)
+
+/*
+ * Wait for msecs milliseconds
+ */
+#define TASK_SLEEP(t, msecs)					\
+	do {							\
+		(t)->lc = __LINE__;				\
+		if (EAGAIN == task_sleep((t), (msecs))) {	\
+			return (TASK_WAITING);			\
+	case __LINE__:;						\
+		}						\
+	} while (0)
+
+/*
+ * Wait for an event sent by task_send(), stored in ev.
+ * If msecs is not 0 and no event is received in msecs milliseconds,
+ * ev is set to NULL.
+ */
+#define TASK_WAIT_EVENT(t, ev, msecs)					\
+	do {								\
+		(t)->lc = __LINE__;					\
+		if (EAGAIN == task_event_wait((t), &(ev), (msecs))) {	\
+			return (TASK_WAITING);				\
+	case __LINE__:							\
+			(ev) = task_event_get(t);			\
+		}							\
+	} while (0)
+
+/*
+ * Wait until thread_io_resume() is called on wq
+ */
+#define TASK_WAIT_IO(t, wq)					\
+	do {							\
+		(t)->lc = __LINE__;				\
+		if (EAGAIN == task_io_wait((t), (wq))) {	\
+			return (TASK_WAITING);			\
+	case __LINE__:;						\
+		}						\
+	} while (0)
+
+/*
+ * Create a task runner, the thread running the tasks must call
+ * task_runner_run().
+ *
+ * PARAMETERS IN
+ * const char *name    - runner name, can be NULL
+ * task_exit_fn exitfn - invoked when a task terminates, can be NULL
+ *
+ * RETURNS
+ * A pointer to a task runner handle or NULL in case of failure.
+ */
+task_runner_t *task_runner_create(const char *name, task_exit_fn exitfn);
+
+/*
+ * Set the running thread as the runner thread and run the tasks,
+ * never returns unless runner is not valid or already run by another
+ * thread.
+ * The thread waits on an events queue while no task is ready.
+ *
+ * PARAMETERS IN
+ * task_runner_t *runner - the task runner
+ *
+ * RETURNS
+ * EINVAL if runner is not valid or already has a thread.
+ */
+int task_runner_run(task_runner_t * runner);
+
+/*
+ * Start a task, the task is ready and enters fn from TASK_BEGIN.
+ * Can be called from an interrupt context.
+ *
+ * PARAMETERS IN
+ * task_runner_t *runner - the task runner
+ * task_t *task          - the task, allocated by the caller
+ * task_fn fn            - the task function
+ * void *arg             - context stored in task->arg
+ *
+ * RETURNS
+ * EINVAL if parameters are not valid
+ * EOK in case of success
+ */
+int task_start(task_runner_t * runner, task_t * task, task_fn fn, void *arg);
+
+/*
+ * Send an event to a task, the task is woken up if waiting in
+ * TASK_WAIT_EVENT(), the event is queued in any other case.
+ * Memory management is the same of event_put().
+ * Can be called from an interrupt context.
+ *
+ * PARAMETERS IN
+ * task_t *task      - the task
+ * event_t *ev       - pointer to the event to be sent
+ * event_freefn fncb - function pointer to release memory
+ *
+ * RETURNS
+ * EINVAL if parameters are not valid
+ * EPERM if the task terminated or queuing failed
+ * EOK in case of success
+ */
+int task_send(task_t * task, event_t * ev, event_freefn fncb);
+
+/*
+ * Print to stdout the specified runner's tasks and statistics.
+ * If runner is null, all runners are processed.
+ *
+ * PARAMETERS IN
+ * task_runner_t *runner - a specific runner to be dumped, or NULL to dump'em all
+ */
+void task_runner_dump(task_runner_t * runner);
+
+/*
+ * Helpers of the TASK_ macros, not to be called directly.
+ * They return EAGAIN if the task must wait.
+ */
+void task_yield(task_t * task);
+
+int task_sleep(task_t * task, unsigned msecs);
+
+int task_event_wait(task_t * task, event_t ** ev, unsigned msecs);
+
+event_t *task_event_get(task_t * task);
+
+int task_io_wait(task_t * task, wait_queue_t * wq);
+
+#endif
@@ -75,7 +75,23 @@ void timer_set(timer_t * tmr, BOOL start);
  * EINVAL if tmr is not a valid pointer or millisecs is 0.
  * EOK in any other case.
  */
-int alarm_update(timer_t * tmr, unsigned millisecs, BOOL recursive);
+int timer_update(timer_t * tmr, unsigned millisecs, BOOL recursive);
+
+/*
+ * Set the slack of a timer, i.e. how many milliseconds its expiration
+ * can be delayed so that it is served by the same clock interrupt of
+ * other timers, alarms and timeouts. The slack is effective from the
+ * next time the timer is set.
+ *
+ * PARAMETERS IN
+ * timer_t *tmr       - The timer handle
+ * unsigned millisecs - the slack, 0 to expire exactly on time
+ *
+ * RETURNS
+ * EINVAL if tmr is not a valid pointer
+ * EOK in any other case.
+ */
+int timer_set_slack(timer_t * tmr, unsigned millisecs);
 
 /*
  * Remove a timer.
@@ -0,0 +1,96 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAIT_OBJECTS_H_INCLUDED
+#define WAIT_OBJECTS_H_INCLUDED
+
+#include <types_common.h>
+#include <diegos/events.h>
+#include <diegos/barriers.h>
+#include <diegos/mutexes.h>
+#include <diegos/semaphores.h>
+
+/*
+ * Wait on multiple objects API.
+ * A thread blocks on any mix of events queues, barriers, mutexes,
+ * semaphores and file descriptors, until the first of them is signalled
+ * or the timeout expires. This saves a helper thread per object.
+ * The object reported is consumed as a single wait on it would:
+ * a barrier is passed, a mutex is locked, a semaphore unit is taken;
+ * events queues and file descriptors are ready to be read.
+ * Objects later in the array are not consumed, if more objects are
+ * ready at once the first one in the array is reported.
+ * This API cannot be used in interrupt context.
+ */
+
+#define WAIT_OBJECTS_MAX	(8)
+
+typedef enum {
+	/* Events queue watched by the running thread */
+	WAIT_OBJ_EVENTS,
+	WAIT_OBJ_BARRIER,
+	/* Mutex, locked by the running thread when reported */
+	WAIT_OBJ_MUTEX,
+	/* Semaphore, a unit is taken when reported */
+	WAIT_OBJ_SEMAPHORE,
+	/* File descriptor, polled as by poll() */
+	WAIT_OBJ_FD
+} wait_obj_type_t;
+
+typedef struct wait_obj {
+	wait_obj_type_t type;
+	union {
+		ev_queue_t *evqueue;
+		barrier_t *barrier;
+		mutex_t *mutex;
+		sem_t *sem;
+		int fd;
+	} obj;
+	/*
+	 * File descriptors only, events read from the device and events
+	 * to be notified for, with the same meaning as in struct pollfd
+	 */
+	short events;
+	short revents;
+} wait_obj_t;
+
+/*
+ * Wait until any of the objects is signalled.
+ *
+ * PARAMETERS IN
+ * wait_obj_t objs[] - the objects, up to WAIT_OBJECTS_MAX
+ * unsigned count    - the number of objects
+ * unsigned msecs    - the timeout in milliseconds, if 0, the thread will wait indefinitely.
+ *
+ * PARAMETERS OUT
+ * unsigned *fired   - the index in objs of the object signalled
+ *
+ * RETURNS
+ * EOK in case of success
+ * EINVAL if any parameter or object is invalid
+ * EBUSY if the running thread already holds one of the mutexes
+ * EPERM if the running thread does not watch one of the events queues,
+ *       or cannot be set to wait state
+ * ENOMEM if file descriptors cannot be polled due to resources starvation
+ * ENOSYS if one of the file descriptors cannot be polled
+ * ETIMEDOUT if the timeout expires before any object is signalled
+ */
+int wait_for_objects(wait_obj_t objs[], unsigned count, unsigned msecs, unsigned *fired);
+
+#endif
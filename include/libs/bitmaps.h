@@ -22,6 +22,13 @@
 
 #include <types_common.h>
 
+/*
+ * Bitmaps are arrays of longs, bit 0 is the least significant bit of
+ * the first long.
+ * Searches work a long at a time: words with nothing to find are skipped
+ * with a single compare, the bit inside a word is located by bsf/bsr.
+ */
+
 /*
  * bits per long
  */
@@ -65,73 +72,77 @@ inline BOOL bitmap_is_set(long *bitmap, unsigned bitpos)
 	return (FALSE);
 }
 
-inline unsigned bitmap_first_is_set(long *bitmap, unsigned leninlongs)
-{
-	unsigned i = 0, j, k;
-
-	while (i < leninlongs) {
-		if (bitmap[i]) {
-			for (j = 1, k = 0; j; j += j, k++) {
-				if (bitmap[i] & j) {
-					return (i * BINL + k);
-				}
-			}
-		}
-		++i;
-	}
+/*
+ * Find the first set bit at or after start.
+ *
+ * PARAMETERS IN
+ * const long *bitmap - the bitmap
+ * unsigned nbits     - number of bits in the bitmap
+ * unsigned start     - first position to look at
+ *
+ * RETURNS
+ * the position of the bit, nbits if there is none
+ */
+unsigned bitmap_find_next_set(const long *bitmap, unsigned nbits, unsigned start);
 
-	return (leninlongs * sizeof(long) * 8);
-}
+/*
+ * Find the first clear bit at or after start, see bitmap_find_next_set
+ */
+unsigned bitmap_find_next_clear(const long *bitmap, unsigned nbits, unsigned start);
 
-inline unsigned bitmap_first_is_clear(long *bitmap, unsigned leninlongs)
-{
-	unsigned i = 0, j, k;
-
-	while (i < leninlongs) {
-		if (!bitmap[i]) {
-			return (i * BINL);
-		}
-		for (j = 1, k = 0; j; j += j, k++) {
-			if (!(bitmap[i] & j)) {
-				return (i * BINL + k);
-			}
-		}
-		++i;
-	}
+/*
+ * Find the last set bit.
+ *
+ * RETURNS
+ * the position of the bit, nbits if there is none
+ */
+unsigned bitmap_find_last_set(const long *bitmap, unsigned nbits);
 
-	return (leninlongs * BINL);
-}
+/*
+ * Find count contiguous clear bits.
+ *
+ * PARAMETERS IN
+ * const long *bitmap - the bitmap
+ * unsigned nbits     - number of bits in the bitmap
+ * unsigned count     - length of the run
+ *
+ * RETURNS
+ * the position of the first bit of the lowest run, nbits if there is none
+ */
+unsigned bitmap_find_clear_run(const long *bitmap, unsigned nbits, unsigned count);
+
+/*
+ * Set or clear count bits starting from start
+ */
+void bitmap_set_range(long *bitmap, unsigned start, unsigned count);
+
+void bitmap_clear_range(long *bitmap, unsigned start, unsigned count);
+
+/*
+ * Number of set bits among the first nbits
+ */
+unsigned bitmap_weight(const long *bitmap, unsigned nbits);
 
-inline void bitmap_for_each_set(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param)
+/*
+ * Invoke cbfn for each set (clear) bit, the callback can modify
+ * the bitmap.
+ */
+void bitmap_for_each_set(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param);
+
+void bitmap_for_each_clear(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param);
+
+/*
+ * First set (clear) bit of a bitmap leninlongs long,
+ * leninlongs * BINL if there is none
+ */
+inline unsigned bitmap_first_is_set(long *bitmap, unsigned leninlongs)
 {
-	unsigned i = 0, j, k;
-
-	while (i < leninlongs) {
-		if (bitmap[i]) {
-			for (j = 1, k = 0; j; j += j, k++) {
-				if (bitmap[i] & j) {
-					cbfn(bitmap, i * BINL + k, param);
-				}
-			}
-		}
-		++i;
-	}
+	return (bitmap_find_next_set(bitmap, leninlongs * BINL, 0));
 }
 
-inline void bitmap_for_each_clear(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param)
+inline unsigned bitmap_first_is_clear(long *bitmap, unsigned leninlongs)
 {
-	unsigned i = 0, j, k;
-
-	while (i < leninlongs) {
-		if (-1 != bitmap[i]) {
-			for (j = 1, k = 0; j; j += j, k++) {
-				if (!(bitmap[i] & j)) {
-					cbfn(bitmap, i * BINL + k, param);
-				}
-			}
-			++i;
-		}
-	}
+	return (bitmap_find_next_clear(bitmap, leninlongs * BINL, 0));
 }
 
 #endif
@@ -25,7 +25,8 @@
 typedef struct chunks_pool chunks_pool_t;
 
 /*
- * Create a new memory chunks pool.
+ * Create a new memory chunks pool, a wrapper of a slab cache
+ * (see libs/slab.h).
  *
  * const char *name - the name of the pool
  * unsigned aln     - alignment of the chunks, if null
@@ -55,6 +56,7 @@ void chunks_pool_free(chunks_pool_t * pool, void *ptr);
 /*
  * Destroys the pool - no destructor is invoked for the chunks,
  * memory will be deallocated only.
+ * The pool is not destroyed while some chunks are in use.
  */
 void chunks_pool_done(chunks_pool_t * pool);
 
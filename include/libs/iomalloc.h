@@ -27,6 +27,10 @@
  * with an I/O coherency protection scheme.
  * The returned pointer is aligned to the required address - or to the natural
  * alignment of the platform.
+ * I/O memory is managed by a buddy allocator: the size of a request is rounded
+ * up to a power of two, no less than 64 bytes, and the block is aligned to its
+ * size. Alignments are rounded up to a power of two, any alignment up to the
+ * page size is honoured.
  *
  * PARAMETERS IN
  * size_t size - the size of the requested memory area
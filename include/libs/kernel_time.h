@@ -46,10 +46,15 @@ struct time_util {
 	uint32_t min_counter;
 	/* Maximum counter value supported */
 	uint32_t max_counter;
-	/* Counter value per milliseconds integer part */
-	uint32_t cntr_ticks_per_msecs_int;
-	/* Counter value per milliseconds fractional part */
-	uint32_t cntr_ticks_per_msecs_fract;
+	/*
+	 * Multiply-shift factors converting counter values to milliseconds
+	 * and milliseconds to counter values, no division is performed at
+	 * run time.
+	 */
+	uint32_t msecs_mult;
+	uint32_t msecs_shift;
+	uint32_t counter_mult;
+	uint32_t counter_shift;
 	/* Accumulator for time base computing */
 	uint64_t elapsed_counter;
 };
@@ -69,6 +74,41 @@ struct time_util {
  */
 int kernel_time_init(uint32_t base_val, uint32_t min_val, uint32_t max_val, struct time_util *tu);
 
+/*
+ * Compute the multiply-shift factors converting a quantity counted at
+ * from_hz into the same quantity counted at to_hz, i.e.
+ * value * to_hz / from_hz == (value * mult) >> shift.
+ * The largest shift keeping mult in 32 bits is selected.
+ *
+ * PARAMETERS IN
+ * uint32_t from_hz - the source frequency
+ * uint32_t to_hz   - the destination frequency
+ *
+ * PARAMETERS OUT
+ * uint32_t *mult   - the multiplier
+ * uint32_t *shift  - the shift
+ *
+ * RETURNS
+ * EOK in success
+ * EINVAL if a frequency is 0 or the ratio cannot be represented
+ */
+int kernel_time_calc_mult_shift(uint32_t from_hz, uint32_t to_hz, uint32_t *mult,
+				uint32_t *shift);
+
+/*
+ * Compute (value * mult) >> shift without overflowing the intermediate
+ * product, the result must fit in 64 bits.
+ *
+ * PARAMETERS IN
+ * uint64_t value - the value to be converted
+ * uint32_t mult  - the multiplier
+ * uint32_t shift - the shift, up to 63
+ *
+ * RETURNS
+ * The converted value
+ */
+uint64_t kernel_time_mul_shift(uint64_t value, uint32_t mult, uint32_t shift);
+
 /*
  * Converts the counter value to milliseconds.
  * cntrticks is adjusted to the range stored in tu.
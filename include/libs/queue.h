@@ -32,6 +32,13 @@ STATUS queue_roll(queue_inst * queue);
 
 STATUS queue_insert(queue_inst * queue, queue_node * data, queue_node * after);
 
+/*
+ * Remove data from any position in the queue.
+ * The queue is singly linked, removal is linear in the position of data.
+ * Returns ENOENT if data is not in the queue.
+ */
+STATUS queue_remove(queue_inst * queue, queue_node * data);
+
 inline void *queue_head(queue_inst *queue)
 {
 	return ((queue) ? (queue->head) : (NULL));
@@ -0,0 +1,127 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <types_common.h>
+
+/*
+ * Object caches.
+ * A cache hands out objects of a single size carved from slabs, buffers
+ * allocated from the heap holding a number of objects each.
+ * Every slab keeps the list of its free objects, the cache keeps partial,
+ * full and empty slabs apart: allocating and freeing an object cost O(1),
+ * the heap is touched only when a slab is added or released.
+ * Objects are constructed when their slab is created and destroyed when
+ * it is released, so they must be returned to the cache in their
+ * constructed state.
+ * The first object of consecutive slabs is shifted by a cache line (the
+ * colour), so that objects with the same index do not compete for the
+ * same cache lines.
+ * The library does no locking, callers must serialize the accesses to
+ * the same cache.
+ */
+
+typedef struct slab_cache slab_cache_t;
+
+typedef void (*slab_ctor_fn)(void *obj);
+typedef void (*slab_dtor_fn)(void *obj);
+
+/*
+ * Create an objects cache.
+ *
+ * PARAMETERS IN
+ * const char *name   - the name of the cache
+ * size_t size        - size of an object
+ * size_t aln         - alignment of the objects, if null the objects
+ *                      will be pointer aligned, rounded up to a power of 2
+ * unsigned objs      - objects in a slab, if null the slab is sized
+ *                      to fit the objects in 1 KB
+ * slab_ctor_fn ctor  - object constructor, can be NULL
+ * slab_dtor_fn dtor  - object destructor, can be NULL
+ *
+ * RETURNS
+ * NULL on error, a valid pointer on success.
+ */
+slab_cache_t *slab_cache_create(const char *name, size_t size, size_t aln,
+				unsigned objs, slab_ctor_fn ctor, slab_dtor_fn dtor);
+
+/*
+ * Preallocate slabs for nobjs objects, those slabs are never released
+ * by the cache.
+ *
+ * PARAMETERS IN
+ * slab_cache_t *cache  - the cache
+ * unsigned nobjs       - number of objects
+ *
+ * RETURNS
+ * EOK on success, ENOMEM if the slabs cannot be allocated
+ */
+int slab_cache_reserve(slab_cache_t *cache, unsigned nobjs);
+
+/*
+ * Get an object from the cache
+ *
+ * RETURNS
+ * NULL if no memory is left, a constructed object on success.
+ */
+void *slab_alloc(slab_cache_t *cache);
+
+/*
+ * Return an object to the cache, pointers that do not belong to the
+ * cache and objects already free are ignored.
+ */
+void slab_free(slab_cache_t *cache, void *obj);
+
+/*
+ * Release the empty slabs of a cache to the heap.
+ *
+ * RETURNS
+ * the number of released slabs
+ */
+unsigned slab_cache_reap(slab_cache_t *cache);
+
+/*
+ * Release the empty slabs of all caches.
+ *
+ * RETURNS
+ * the number of released slabs
+ */
+unsigned slab_caches_reap(void);
+
+/*
+ * Destroy a cache, all objects must have been returned.
+ *
+ * RETURNS
+ * EOK on success, EBUSY if some objects are in use, EINVAL if cache is NULL
+ */
+int slab_cache_destroy(slab_cache_t *cache);
+
+/*
+ * Size of the objects handed out by the cache
+ */
+size_t slab_cache_objsize(const slab_cache_t *cache);
+
+/*
+ * Print cache stats, all caches if cache is NULL
+ */
+void slab_cache_dump(const slab_cache_t *cache);
+
+#endif
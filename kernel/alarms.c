@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -27,10 +28,12 @@
 #include <diegos/kernel_ticks.h>
 #include <diegos/interrupts.h>
 #include <libs/list.h>
+#include <libs/slab.h>
 
 #include "scheduler.h"
 #include "alarms_private.h"
 #include "clock.h"
+#include "timer_queue.h"
 #include "kprintf.h"
 
 enum {
@@ -44,6 +47,7 @@ enum {
 
 struct alarm {
 	list_node header;
+	tq_node_t node;
 	uint64_t expiration;
 	uint32_t flags;
 	ev_queue_t *notify;
@@ -54,41 +58,28 @@ struct alarm {
 
 static list_inst alarms_list;
 
-static uint32_t period = -1U;
+static slab_cache_t *alarms_cache = NULL;
 
-static void alarm_cb(uint64_t msecs)
+/*
+ * Timer queue callback, invoked in interrupt context.
+ * Recursive alarms are armed again by alarm_acknowledge().
+ */
+static void alarm_expire_cb(tq_node_t *node, uint64_t msecs)
 {
-	struct alarm *cursor;
-	period = -1U;
+	struct alarm *alm = (struct alarm *)((char *)node - offsetof(struct alarm, node));
 
-	if (!list_count(&alarms_list)) {
+	if (EOK != event_put(alm->notify, &alm->event, NULL)) {
+		kerrprintf("unable to queue alarm %s\n", alm->name);
+		/* Try again at the next millisecond */
+		tq_arm(&alm->node, msecs + 1);
 		return;
 	}
 
-	cursor = list_head(&alarms_list);
-
-	while (cursor) {
-		if (ALM_TRIGGERED == (cursor->flags & (ALM_TRIGGERED | ALM_EXPIRED))) {
-			if (msecs >= cursor->expiration) {
-				if (EOK != event_put(cursor->notify, &cursor->event, NULL)) {
-					kerrprintf("unable to queue alarm %s\n", cursor->name);
-				} else {
-					cursor->flags |= ALM_EXPIRED;
-					/* One shot */
-					if (!(cursor->flags & ALM_RECURSIVE)) {
-						cursor->flags &= ~ALM_TRIGGERED;
-					} else {
-						if (cursor->msecs < period)
-							period = cursor->msecs;
-					}
-				}
-			}
-		}
-
-		cursor = (alarm_t *) cursor->header.next;
+	alm->flags |= ALM_EXPIRED;
+	/* One shot */
+	if (!(alm->flags & ALM_RECURSIVE)) {
+		alm->flags &= ~ALM_TRIGGERED;
 	}
-
-	clock_set_period(period, CLK_INST_ALARMS);
 }
 
 BOOL init_alarms_lib()
@@ -98,6 +89,12 @@ BOOL init_alarms_lib()
 		return (FALSE);
 	}
 
+	alarms_cache = slab_cache_create("alarms", sizeof(struct alarm), 0, 0, NULL, NULL);
+	if (!alarms_cache) {
+		kerrprintf("failed creating alarms cache.\n");
+		return (FALSE);
+	}
+
 	return (TRUE);
 }
 
@@ -110,22 +107,18 @@ alarm_t *alarm_create(const char *name,
 		return (NULL);
 	}
 
-	ptr = malloc(sizeof(struct alarm));
+	lock();
+	ptr = slab_alloc(alarms_cache);
+	unlock();
 
 	if (!ptr) {
 		return (NULL);
 	}
 
-	if (list_count(&alarms_list) == 0) {
-		if (!clock_add_cb(alarm_cb, CLK_INST_ALARMS)) {
-			free(ptr);
-			kerrprintf("failed adding alarm callback!\n");
-			return (NULL);
-		}
-	}
-
 	if (EOK != list_prepend(&alarms_list, &ptr->header)) {
-		free(ptr);
+		lock();
+		slab_free(alarms_cache, ptr);
+		unlock();
 		return (NULL);
 	}
 
@@ -146,15 +139,7 @@ alarm_t *alarm_create(const char *name,
 	ptr->notify = evqueue;
 	ptr->event.classid = CLASS_ALARM;
 	ptr->event.eventid = alarmid;
-
-	/*
-	 * Shorten clock expiration if the required timeout
-	 * is lower than the last computed period.
-	 * Do not update the computed period, that's up to the
-	 * interrupt routine.
-	 */
-	if (millisecs < period)
-		clock_set_period(millisecs, CLK_INST_ALARMS);
+	tq_node_init(&ptr->node, alarm_expire_cb);
 
 	return (ptr);
 }
@@ -172,7 +157,9 @@ void alarm_set(alarm_t *alm, BOOL start)
 		alm->flags |= ALM_TRIGGERED;
 		alm->flags &= ~ALM_EXPIRED;
 		alm->expiration = alm->msecs + clock_get_milliseconds();
+		tq_arm(&alm->node, alm->expiration);
 	} else {
+		tq_cancel(&alm->node);
 		alm->flags &= ~ALM_TRIGGERED;
 		alm->flags |= ALM_EXPIRED;
 		alm->expiration = 0;
@@ -194,6 +181,7 @@ STATUS alarm_acknowledge(alarm_t *alm)
 	if (MATCH == (alm->flags & MATCH)) {
 		alm->expiration += alm->msecs;
 		alm->flags &= ~ALM_EXPIRED;
+		tq_arm(&alm->node, alm->expiration);
 	}
 
 	unlock();
@@ -209,17 +197,8 @@ STATUS alarm_update(alarm_t *alm, unsigned millisecs, BOOL recursive)
 
 	lock();
 
-	if (millisecs != alm->msecs) {
-		alm->msecs = millisecs;
-		/*
-		 * Shorten clock expiration if the required timeout
-		 * is lower than the last computed period.
-		 * Do not update the computed period, that's up to the
-		 * interrupt routine.
-		 */
-		if (millisecs < period)
-			clock_set_period(millisecs, CLK_INST_ALARMS);
-	}
+	/* The new period is effective from the next expiration */
+	alm->msecs = millisecs;
 
 	if (recursive && !(alm->flags & ALM_RECURSIVE)) {
 		alm->flags |= ALM_RECURSIVE;
@@ -232,6 +211,19 @@ STATUS alarm_update(alarm_t *alm, unsigned millisecs, BOOL recursive)
 	return (EOK);
 }
 
+STATUS alarm_set_slack(alarm_t *alm, unsigned millisecs)
+{
+	if (!alm) {
+		return (EINVAL);
+	}
+
+	lock();
+	tq_set_slack(&alm->node, millisecs);
+	unlock();
+
+	return (EOK);
+}
+
 STATUS alarm_done(alarm_t *alm)
 {
 	if (!alm) {
@@ -245,15 +237,11 @@ STATUS alarm_done(alarm_t *alm)
 		return (EGENERIC);
 	}
 
-	if (list_count(&alarms_list) == 0) {
-		clock_set_period(-1U, CLK_INST_ALARMS);
-		if (!clock_del_cb(alarm_cb, CLK_INST_ALARMS))
-			kerrprintf("failed removing alarm callback!\n");
-	}
+	tq_cancel(&alm->node);
 
-	unlock();
+	slab_free(alarms_cache, alm);
 
-	free(alm);
+	unlock();
 
 	return (EOK);
 }
@@ -275,16 +263,16 @@ static void dump_internal(const alarm_t *alm)
 	if (!alm->flags) {
 		strcat(tempbuf, "DISABLED");
 	}
-	printf("%-15s | %6u | %s\n", alm->name, alm->msecs, tempbuf);
+	printf("%-15s | %6u | %5u | %s\n", alm->name, alm->msecs, alm->node.slack, tempbuf);
 }
 
 void alarm_dump(const alarm_t *alm)
 {
 	if (!alm) {
-		printf("\n--- ALARMS TABLE -----------------------\n\n");
+		printf("\n--- ALARMS TABLE -------------------------------\n\n");
 	}
-	printf("%-15s   %6s   %s\n", "ALARM NAME", "PERIOD", "FLAGS");
-	printf("________________________________________\n");
+	printf("%-15s   %6s   %5s   %s\n", "ALARM NAME", "PERIOD", "SLACK", "FLAGS");
+	printf("________________________________________________\n");
 	if (alm) {
 		dump_internal(alm);
 	} else {
@@ -294,5 +282,5 @@ void alarm_dump(const alarm_t *alm)
 			alm = (alarm_t *) alm->header.next;
 		}
 	}
-	printf("----------------------------------------\n\n");
+	printf("------------------------------------------------\n\n");
 }
@@ -23,7 +23,6 @@
 #include <libs/list.h>
 #include <diegos/barriers.h>
 #include <diegos/interrupts.h>
-#include <libs/bitmaps.h>
 #include <string.h>
 
 #include "barriers_private.h"
@@ -35,13 +34,16 @@
 enum {
 	/* Barrier state, open or closed */
 	BARRIER_OPEN = (1 << 0),
-	/* Open barriers will be automatially closed in resume_on_barriers */
+	/*
+	 * Open barriers will be automatically closed once they release
+	 * the waiting threads, or the first thread passing through
+	 */
 	BARRIER_AUTOCLOSE = (1 << 1)
 };
 
 struct barrier {
 	list_node header;
-	long thread_ids[BITMAPLEN(DIEGOS_MAX_THREADS)];
+	list_inst waiters;
 	char name[16];
 	unsigned flags;
 };
@@ -61,7 +63,7 @@ barrier_t *barrier_create(const char *name, BOOL autoclose)
 		return (NULL);
 	}
 
-	memset(ptr->thread_ids, 0, sizeof(ptr->thread_ids));
+	list_init(&ptr->waiters);
 
 	if (name) {
 		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
@@ -85,7 +87,9 @@ int barrier_done(barrier_t *barrier)
 	if (!barrier)
 		return (EINVAL);
 
-	resume_on_barriers();
+	lock();
+	scheduler_resume_waiters(&barrier->waiters, THREAD_FLAG_WAIT_BARRIER, 0);
+	unlock();
 
 	retval = list_remove(&barriers_list, &barrier->header);
 	if (retval != EOK)
@@ -100,7 +104,10 @@ int barrier_open(barrier_t *barrier)
 {
 	lock();
 	if (barrier) {
-		barrier->flags |= BARRIER_OPEN;
+		if (!scheduler_resume_waiters(&barrier->waiters, THREAD_FLAG_WAIT_BARRIER, 0) ||
+		    !(barrier->flags & BARRIER_AUTOCLOSE)) {
+			barrier->flags |= BARRIER_OPEN;
+		}
 	}
 	unlock();
 
@@ -128,55 +135,56 @@ int wait_for_barrier(barrier_t *barrier)
 		return EINVAL;
 	}
 
+	scheduler_preempt_disable();
+
+	/*
+	 * Barriers may be opened by interrupt handlers, check and wait
+	 * with interrupts disabled or a wakeup could be lost.
+	 */
 	lock();
+
 	check = (barrier->flags & BARRIER_OPEN);
-	unlock();
+	if (check && (barrier->flags & BARRIER_AUTOCLOSE)) {
+		barrier->flags &= ~BARRIER_OPEN;
+	}
 
 	if (check) {
+		unlock();
+		scheduler_preempt_enable();
 		return EOK;
 	}
 
-	bitmap_set(barrier->thread_ids, scheduler_running_tid());
-
 	prev = scheduler_running_thread();
-	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_BARRIER, 0)) {
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_BARRIER, 0, &barrier->waiters)) {
+		unlock();
+		scheduler_preempt_enable();
 		return EPERM;
 	}
+
+	unlock();
+
 	schedule_thread();
 
 	next = scheduler_running_thread();
 	switch_context(&prev->context, next->context);
 
+	scheduler_preempt_enable();
+
 	return EOK;
 }
 
-int cancel_wait_for_barrier(uint8_t tid)
+int barrier_wait_prepare(barrier_t *barrier, wait_node_t *node)
 {
-	barrier_t *barrier = NULL;
-	thread_t *ptr = get_thread(tid);
-
-	if (!ptr) {
-		kerrprintf("No process with TID %d\n", tid);
-		return EINVAL;
-	}
-
-	if (!(ptr->flags & THREAD_FLAG_WAIT_BARRIER)) {
-		kerrprintf("Thread TID %d is not waiting on a barrier\n", tid);
-		return EPERM;
-	}
-
-	barrier = (barrier_t *) list_head(&barriers_list);
-
-	while (barrier) {
-		if (bitmap_is_set(barrier->thread_ids, tid)) {
-			bitmap_clear(barrier->thread_ids, tid);
-			return EOK;
+	if (barrier->flags & BARRIER_OPEN) {
+		if (barrier->flags & BARRIER_AUTOCLOSE) {
+			barrier->flags &= ~BARRIER_OPEN;
 		}
-		barrier = (barrier_t *) barrier->header.next;
+		return (EOK);
 	}
 
-	kerrprintf("Thread TID %d is not waiting on any barrier\n", tid);
-	return EINVAL;
+	node->list = &barrier->waiters;
+
+	return (EAGAIN);
 }
 
 BOOL init_barriers_lib()
@@ -188,34 +196,12 @@ BOOL init_barriers_lib()
 	return (TRUE);
 }
 
-static void resumecb(long *bitmap, unsigned pos, void *param)
-{
-	scheduler_resume_thread(THREAD_FLAG_WAIT_BARRIER, (uint8_t) pos);
-	bitmap_clear(bitmap, pos);
-}
-
-void resume_on_barriers()
-{
-	struct barrier *cur = (struct barrier *)list_head(&barriers_list);
-
-	while (cur) {
-		if (cur->flags & BARRIER_OPEN) {
-			bitmap_for_each_set(cur->thread_ids,
-					    BITMAPLEN(DIEGOS_MAX_THREADS), resumecb, NULL);
-			if (cur->flags & BARRIER_AUTOCLOSE) {
-				cur->flags &= ~BARRIER_OPEN;
-			}
-		}
-		cur = (barrier_t *) cur->header.next;
-	}
-}
-
 static void dump_internal(const barrier_t *barrier)
 {
-	printf("%-15s | %5s | %4s | %s\n",
+	printf("%-15s | %5s | %4s | %u\n",
 	       barrier->name,
 	       (barrier->flags & BARRIER_OPEN) ? "OPEN" : "CLOSED",
-	       (barrier->flags & BARRIER_AUTOCLOSE) ? "YES" : "NO", "N/A");
+	       (barrier->flags & BARRIER_AUTOCLOSE) ? "YES" : "NO", barrier->waiters.counter);
 }
 
 void barrier_dump(const barrier_t *barrier)
@@ -20,6 +20,9 @@
 #ifndef _BARRIERS_PRIVATE_H_
 #define _BARRIERS_PRIVATE_H_
 
+#include <diegos/barriers.h>
+#include "threads_data.h"
+
 /*
  * Initialize the barriers library.
  * Must be called internally by the kernel init
@@ -33,24 +36,16 @@
 BOOL init_barriers_lib(void);
 
 /*
- * Resume any waiting thread on open barriers.
- * Must be called internally by the scheduler.
- * The routine loops all barriers, open barriers are scanned for pending
- * (waiting) threads, if any, they are resumed.
- */
-void resume_on_barriers(void);
-
-/*
- * Cancel a wait for a barrier.
-  *
- * PARAMETERS IN
-  * uint8_t tid        - thread ID to cancel wait for
+ * Prepare a wait on a barrier as one of multiple objects.
+ * If the barrier is open the thread passes through, closing it if
+ * autoclose, otherwise the list field of node is set to the waiters
+ * list to link.
+ * Interrupts must be disabled.
  *
  * RETURNS
- * EOK in case of success
- * EINVAL if barrier is invalid
- * EPERM if the thread wait cannot be cancelled
+ * EOK the barrier is open
+ * EAGAIN the thread must wait
  */
-int cancel_wait_for_barrier(uint8_t tid);
+int barrier_wait_prepare(barrier_t * barrier, wait_node_t * node);
 
 #endif
@@ -20,11 +20,13 @@
 #include <diegos/devices.h>
 #include <diegos/interrupts.h>
 #include <diegos/kernel_ticks.h>
+#include <diegos/delays.h>
 #include <libs/kernel_time.h>
 #include <errno.h>
 #include <string.h>
 #include "clock.h"
 #include "kprintf.h"
+#include "platform_include.h"
 
 /*
  * boot ticks can be set to configure the current time and date
@@ -62,6 +64,112 @@ static device_t *clock = NULL;
  */
 static struct time_util sys_ticks;
 
+/*
+ * Nanoseconds to CLK device ticks
+ */
+static uint32_t ns_mult, ns_shift;
+
+/*
+ * Set when a countdown has been accounted as expired while its
+ * interrupt was pending, the handler must not account it again.
+ */
+static BOOL accounted = FALSE;
+
+/*
+ * Clock interrupts served since boot
+ */
+static uint64_t interrupts = 0;
+
+/*
+ * clock_get_ns() when the countdown was last started, one-shot
+ * expirations are accounted against it
+ */
+static uint64_t armed_ns = 0;
+
+#ifdef ENABLE_SMP
+/*
+ * Set when a period has been changed by a processor other than the boot
+ * one: the clock device belongs to the boot processor, which programs it.
+ */
+static BOOL resync = FALSE;
+
+/*
+ * Clock mode requested by a processor other than the boot one, -1U if none
+ */
+static unsigned resync_mode = -1U;
+#endif
+
+#ifdef ENABLE_TICKLESS
+/*
+ * Set while the idle thread runs the clock in one-shot mode
+ */
+static BOOL tickless = FALSE;
+
+/*
+ * Clock mode to be restored when leaving tickless mode
+ */
+static unsigned saved_mode = 0;
+#endif
+
+/*
+ * Account the clock ticks elapsed since the last expiration,
+ * must be called before re-triggering the countdown.
+ * Interrupts must be disabled.
+ */
+static void account_elapsed(void)
+{
+	uint32_t remaining = 0;
+
+	if (EOK != clock->cmn->ioctrl_fn(&remaining, CLK_GET_ELAPSED, 0)) {
+		return;
+	}
+
+	if (remaining < period) {
+		kernel_time_update_elapsed_counter(period - remaining, &sys_ticks);
+		if (!remaining) {
+			accounted = TRUE;
+		}
+	}
+}
+
+/*
+ * Start a countdown of value clock ticks.
+ * Interrupts must be disabled.
+ */
+static int clock_arm(uint32_t *value)
+{
+	int retcode = clock->cmn->ioctrl_fn(value, CLK_SET_PERIOD, 0);
+
+	if ((EOK == retcode) && cycles_per_msec()) {
+		armed_ns = clock_get_ns();
+	}
+
+	return (retcode);
+}
+
+/*
+ * Account an expired one-shot countdown. The countdown is started again
+ * by the interrupt handler, the interrupt latency would be lost at each
+ * expiration: with a cycle counter the time since the countdown started
+ * is accounted instead of the period.
+ * Interrupts must be disabled.
+ */
+static void account_oneshot(void)
+{
+	uint64_t ticks = period;
+
+	if (cycles_per_msec()) {
+		ticks = kernel_time_mul_shift(clock_get_ns() - armed_ns, ns_mult, ns_shift);
+		if (ticks < period) {
+			ticks = period;
+		} else if (ticks > -1U) {
+			ticks = -1U;
+		}
+	}
+
+	kernel_time_update_elapsed_counter((uint32_t) ticks, &sys_ticks);
+}
+
 /*
  * CLK device interrupt handler
  */
@@ -69,16 +177,28 @@ static void clock_int_handler(void)
 {
 	unsigned i;
 
-	kernel_time_update_elapsed_counter(period, &sys_ticks);
+	if (accounted) {
+		accounted = FALSE;
+	} else if (mode == 1) {
+		account_oneshot();
+	} else {
+		kernel_time_update_elapsed_counter(period, &sys_ticks);
+	}
+	++interrupts;
+
+	/*
+	 * Re-trigger the countdown before running the callbacks, the time
+	 * they take is accounted if they change the period.
+	 */
+	if (mode == 1) {
+		if (EOK != clock_arm(&period))
+			kprintf("FAILED\n");
+	}
 
 	for (i = 0; i < NELEMENTS(callbacks); i++) {
 		if (callbacks[i])
 			callbacks[i] (kernel_time_get_elapsed_msecs(&sys_ticks));
 	}
-	if (mode == 1) {
-		if (EOK != clock->cmn->ioctrl_fn(&period, CLK_SET_PERIOD, 0))
-			kprintf("FAILED\n");
-	}
 }
 
 /*
@@ -112,6 +232,10 @@ BOOL clock_init(void)
 		return (FALSE);
 	}
 
+	if (EOK != kernel_time_calc_mult_shift(1000000000UL, params[0], &ns_mult, &ns_shift)) {
+		return (FALSE);
+	}
+
 	if (EOK != clock->cmn->ioctrl_fn(&mode, CLK_SET_MODE, 0))
 		return (FALSE);
 
@@ -121,7 +245,7 @@ BOOL clock_init(void)
 
 	period = kernel_time_get_value(comp, &sys_ticks);
 
-	if (EOK != clock->cmn->ioctrl_fn(&period, CLK_SET_PERIOD, 0))
+	if (EOK != clock_arm(&period))
 		return (FALSE);
 
 	return (TRUE);
@@ -167,18 +291,47 @@ static BOOL clock_set_mode(unsigned newmode)
 {
 	int retcode = EINVAL;
 
+#ifdef ENABLE_TICKLESS
+	/*
+	 * The mode is restored when leaving tickless mode
+	 */
+	lock();
+	if (tickless) {
+		saved_mode = newmode;
+		unlock();
+		return (TRUE);
+	}
+	unlock();
+#endif
+
 	if (mode == newmode)
 		return (TRUE);
 
+#ifdef ENABLE_SMP
+	if (cpu_id()) {
+		lock();
+		resync_mode = newmode;
+		resync = TRUE;
+		unlock();
+		cpu_resched(0);
+		return (TRUE);
+	}
+#endif
+
 	if (clock) {
 		lock();
+		/*
+		 * Setting the mode stops the countdown, account what
+		 * elapsed of the current period first.
+		 */
+		account_elapsed();
 		retcode = clock->cmn->ioctrl_fn(&newmode, CLK_SET_MODE, 0);
 		if (EOK != retcode) {
 			unlock();
 			return (FALSE);
 		}
 		mode = newmode;
-		retcode = clock->cmn->ioctrl_fn(&period, CLK_SET_PERIOD, 0);
+		retcode = clock_arm(&period);
 		unlock();
 	}
 
@@ -207,30 +360,39 @@ static inline uint32_t get_lowest()
 	return retval;
 }
 
-BOOL clock_set_period(unsigned ms, enum clock_client_id instance)
+/*
+ * Program the CLK device with the lowest period requested
+ */
+static BOOL clock_program(void)
 {
 	int retcode = EINVAL;
 	uint32_t temp;
 
-	if (!(instance < CLK_INST_MAX))
-		return FALSE;
-
-	/* adjust ms value to be in range */
-	ms = kernel_time_adjust_msecs(ms, &sys_ticks);
-	/* store the new period as a clock value for this specific instance */
-	inst_period[instance] = kernel_time_get_value(ms, &sys_ticks);
 	/* select the lowest value to be configured system-wide */
 	temp = get_lowest();
 
 	if (temp == period)
 		return TRUE;
 
+#ifdef ENABLE_SMP
+	if (cpu_id()) {
+		resync = TRUE;
+		cpu_resched(0);
+		return TRUE;
+	}
+#endif
+
 	if (clock) {
 		/*
 		 * A reliable method to compensate lost ticks is still required !!!
+		 * In one-shot mode the countdown restarts with the new period,
+		 * the elapsed part of the old one can be accounted.
 		 */
 		lock();
-		retcode = clock->cmn->ioctrl_fn(&temp, CLK_SET_PERIOD, 0);
+		if (mode == 1) {
+			account_elapsed();
+		}
+		retcode = clock_arm(&temp);
 		unlock();
 		if (EOK == retcode) {
 			period = temp;
@@ -240,6 +402,129 @@ BOOL clock_set_period(unsigned ms, enum clock_client_id instance)
 	return ((EOK == retcode) ? TRUE : FALSE);
 }
 
+BOOL clock_set_period(unsigned ms, enum clock_client_id instance)
+{
+	if (!(instance < CLK_INST_MAX))
+		return FALSE;
+
+	/* adjust ms value to be in range */
+	ms = kernel_time_adjust_msecs(ms, &sys_ticks);
+	/* store the new period as a clock value for this specific instance */
+	inst_period[instance] = kernel_time_get_value(ms, &sys_ticks);
+
+	return (clock_program());
+}
+
+BOOL clock_set_period_ns(uint64_t nsecs, enum clock_client_id instance)
+{
+	uint64_t temp;
+
+	if (!(instance < CLK_INST_MAX))
+		return FALSE;
+
+	temp = kernel_time_mul_shift(nsecs, ns_mult, ns_shift);
+	if (temp > -1U)
+		temp = -1U;
+
+	inst_period[instance] = kernel_time_adjust_range((uint32_t) temp, &sys_ticks);
+
+	return (clock_program());
+}
+
+#ifdef ENABLE_SMP
+void clock_sync(void)
+{
+	lock();
+	if (resync) {
+		resync = FALSE;
+		if (-1U != resync_mode) {
+			clock_set_mode(resync_mode);
+			resync_mode = -1U;
+		}
+		clock_program();
+	}
+	unlock();
+}
+#endif
+
+#ifdef ENABLE_TICKLESS
+BOOL clock_tickless_enter(uint64_t deadline)
+{
+	uint64_t now = clock_get_milliseconds();
+	uint32_t newmode = 1;
+	uint32_t temp;
+
+	if (!clock || tickless || (deadline <= now)) {
+		return (FALSE);
+	}
+
+	if (deadline - now > -1U) {
+		deadline = now + -1U;
+	}
+
+	/* the counter value is clamped to the device range */
+	temp = kernel_time_get_value((uint32_t) (deadline - now), &sys_ticks);
+
+	lock();
+
+	/*
+	 * Setting the mode stops the countdown, account what
+	 * elapsed of the current period first.
+	 */
+	account_elapsed();
+
+	if ((EOK != clock->cmn->ioctrl_fn(&newmode, CLK_SET_MODE, 0)) ||
+	    (EOK != clock_arm(&temp))) {
+		newmode = mode;
+		clock->cmn->ioctrl_fn(&newmode, CLK_SET_MODE, 0);
+		clock_arm(&period);
+		unlock();
+		return (FALSE);
+	}
+
+	saved_mode = mode;
+	mode = 1;
+	period = temp;
+	tickless = TRUE;
+
+	unlock();
+
+	return (TRUE);
+}
+
+void clock_tickless_exit(void)
+{
+	uint32_t temp;
+
+	lock();
+
+	if (tickless) {
+		account_elapsed();
+		temp = kernel_time_adjust_range(get_lowest(), &sys_ticks);
+		if (EOK == clock->cmn->ioctrl_fn(&saved_mode, CLK_SET_MODE, 0)) {
+			mode = saved_mode;
+		}
+		if (EOK == clock_arm(&temp)) {
+			period = temp;
+		}
+		tickless = FALSE;
+	}
+
+	unlock();
+}
+#endif
+
+uint64_t clock_get_interrupts(void)
+{
+	uint64_t retval;
+
+	lock();
+	retval = interrupts;
+	unlock();
+
+	return (retval);
+}
+
 uint64_t clock_get_ticks(void)
 {
 	uint64_t temp = kernel_time_get_elapsed_msecs(&sys_ticks);
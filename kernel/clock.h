@@ -29,10 +29,10 @@
 enum clock_client_id {
 	/* The scheduler */
 	CLK_INST_SCHEDULER,
-	/* The alarms subsystem */
-	CLK_INST_ALARMS,
-	/* The timers subsystem */
-	CLK_INST_TIMERS,
+	/* The timer queue: thread delays, timers and alarms */
+	CLK_INST_TIMER_QUEUE,
+	/* The high resolution timers */
+	CLK_INST_HRTIMERS,
 	CLK_INST_MAX
 };
 
@@ -127,4 +127,55 @@ BOOL clock_set_oneshot(void);
  */
 BOOL clock_set_period(unsigned ms, enum clock_client_id instance);
 
+/*
+ * Set the CLK device period in nanoseconds, for clients requiring
+ * a resolution finer than one millisecond.
+ * The period is rounded down to the CLK device resolution and clamped
+ * to its range, (uint64_t)-1 withdraws the request.
+ *
+ * PARAMETERS IN
+ * uint64_t nsecs  - the period for a specific client instance
+ * clock_client_id - the client instance
+ *
+ * RETURN VALUES
+ * TRUE if the CLK device period has been set
+ * FALSE in any other case
+ */
+BOOL clock_set_period_ns(uint64_t nsecs, enum clock_client_id instance);
+
+#ifdef ENABLE_SMP
+/*
+ * Program the CLK device after another processor changed a period,
+ * the device is owned by the boot processor: other processors only
+ * record the new period and interrupt the boot processor, which
+ * calls this function.
+ */
+void clock_sync(void);
+#endif
+
+#ifdef ENABLE_TICKLESS
+/*
+ * Stop the periodic tick, the CLK device is set in one-shot mode to
+ * expire at deadline (or as late as the device can count).
+ * Clock ticks elapsed in the current period are accounted first.
+ * Called by the idle thread with interrupts disabled when no other
+ * thread is ready.
+ *
+ * PARAMETERS IN
+ * uint64_t deadline - expiration time in milliseconds since boot
+ *
+ * RETURN VALUES
+ * TRUE if the CLK device is in one-shot mode
+ * FALSE if the deadline is past or the CLK device failed
+ */
+BOOL clock_tickless_enter(uint64_t deadline);
+
+/*
+ * Restart the periodic tick after clock_tickless_enter(), accounting
+ * the clock ticks elapsed since the last expiration.
+ * Nothing is done if the clock is not tickless.
+ */
+void clock_tickless_exit(void);
+#endif
+
 #endif
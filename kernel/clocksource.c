@@ -0,0 +1,90 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <types_common.h>
+#include <libs/kernel_time.h>
+#include <diegos/delays.h>
+#include <diegos/kernel_ticks.h>
+
+#include "clocksource.h"
+#include "kprintf.h"
+#include "platform_include.h"
+
+/*
+ * Cycle counter clocksource, the counter frequency is measured once by
+ * platform code and all conversions are multiply-shift.
+ */
+static unsigned long cycles_msec = 0;
+static uint64_t boot_cycles = 0;
+
+/*
+ * Cycles to nanoseconds and back
+ */
+static uint32_t ns_mult, ns_shift;
+static uint32_t cyc_mult, cyc_shift;
+
+void set_cycles(unsigned long cpm)
+{
+	uint32_t nm, ns, cm, cs;
+
+	if (!cpm) {
+		return;
+	}
+
+	if ((EOK != kernel_time_calc_mult_shift(cpm, 1000000UL, &nm, &ns)) ||
+	    (EOK != kernel_time_calc_mult_shift(1000000UL, cpm, &cm, &cs))) {
+		kerrprintf("cannot use a cycle counter at %lu cycles/msec\n", cpm);
+		return;
+	}
+
+	ns_mult = nm;
+	ns_shift = ns;
+	cyc_mult = cm;
+	cyc_shift = cs;
+	boot_cycles = read_cycles();
+	cycles_msec = cpm;
+}
+
+unsigned long cycles_per_msec()
+{
+	return (cycles_msec);
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles)
+{
+	if (!cycles_msec) {
+		return (0);
+	}
+
+	return (kernel_time_mul_shift(cycles, ns_mult, ns_shift));
+}
+
+uint64_t clock_ns_to_cycles(uint64_t nsecs)
+{
+	return (kernel_time_mul_shift(nsecs, cyc_mult, cyc_shift) + 1);
+}
+
+uint64_t clock_get_ns()
+{
+	if (!cycles_msec) {
+		return (clock_get_milliseconds() * 1000000ULL);
+	}
+
+	return (kernel_time_mul_shift(read_cycles() - boot_cycles, ns_mult, ns_shift));
+}
@@ -0,0 +1,37 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CLOCKSOURCE_H_
+#define _CLOCKSOURCE_H_
+
+#include <types_common.h>
+
+/*
+ * Convert nanoseconds to cycles of the cycle counter, rounded up.
+ * Valid only if cycles_per_msec() is not 0.
+ *
+ * PARAMETERS IN
+ * uint64_t nsecs - the nanoseconds to be converted
+ *
+ * RETURNS
+ * the amount of cycles lasting at least nsecs
+ */
+uint64_t clock_ns_to_cycles(uint64_t nsecs);
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <libs/list.h>
+#include <diegos/condvars.h>
+#include <diegos/interrupts.h>
+
+#include "condvars_private.h"
+#include "mutex_private.h"
+#include "threads.h"
+#include "scheduler.h"
+#include "platform_include.h"
+#include "kprintf.h"
+
+struct condvar {
+	list_node header;
+	list_inst waiters;
+	char name[16];
+	/*
+	 * The mutex of the waiting threads
+	 */
+	struct mutex *mutex;
+};
+
+static list_inst condvars_list;
+
+cond_t *condvar_create(const char *name)
+{
+	struct condvar *ptr = malloc(sizeof(struct condvar));
+
+	if (!ptr) {
+		return (NULL);
+	}
+
+	list_init(&ptr->waiters);
+	ptr->mutex = NULL;
+
+	if (name) {
+		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
+	} else {
+		snprintf(ptr->name, sizeof(ptr->name), "Cond%x", (intptr_t) ptr);
+	}
+
+	lock();
+	if (EOK != list_append(&condvars_list, &ptr->header)) {
+		unlock();
+		free(ptr);
+		return (NULL);
+	}
+	unlock();
+
+	return (ptr);
+}
+
+int condvar_done(cond_t *cond)
+{
+	int retval;
+
+	if (!cond) {
+		return (EINVAL);
+	}
+
+	lock();
+	if (list_count(&cond->waiters)) {
+		unlock();
+		return (EBUSY);
+	}
+	retval = list_remove(&condvars_list, &cond->header);
+	unlock();
+
+	if (retval != EOK) {
+		kerrprintf("Invalid condition variable");
+	} else {
+		free(cond);
+	}
+
+	return (retval);
+}
+
+int condvar_wait(cond_t *cond, mutex_t *mtx)
+{
+	return (condvar_wait_timed(cond, mtx, 0));
+}
+
+int condvar_wait_timed(cond_t *cond, mutex_t *mtx, unsigned msecs)
+{
+	thread_t *prev, *next;
+	int retval = EOK;
+
+	if (!cond || !mtx) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+
+	if (!mutex_is_locked_by_me(mtx)) {
+		scheduler_preempt_enable();
+		return (EPERM);
+	}
+
+	/*
+	 * Releasing the mutex and waiting must be atomic,
+	 * or a signal could be lost.
+	 */
+	lock();
+
+	prev = scheduler_running_thread();
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_CONDVAR, msecs, &cond->waiters)) {
+		unlock();
+		scheduler_preempt_enable();
+		return (EPERM);
+	}
+
+	cond->mutex = mtx;
+	unlock_mutex(prev->tid, mtx);
+
+	unlock();
+
+	schedule_thread();
+
+	next = scheduler_running_thread();
+	switch_context(&prev->context, next->context);
+
+	/*
+	 * Signalled threads are resumed holding the mutex,
+	 * a timed out thread must lock it again.
+	 */
+	if (prev->wake_flags & THREAD_FLAG_WAIT_TIMEOUT) {
+		thread_lock_mutex(mtx);
+		retval = ETIMEDOUT;
+	}
+
+	scheduler_preempt_enable();
+
+	return (retval);
+}
+
+/*
+ * Hand up to max waiters over to the mutex, 0 means all of them
+ */
+static void signal_internal(cond_t *cond, unsigned max)
+{
+	wait_node_t *node;
+	unsigned count = 0;
+
+	lock();
+
+	while (list_count(&cond->waiters) && (!max || (count < max))) {
+		node = list_head(&cond->waiters);
+
+		if (mutex_requeue_waiter(cond->mutex, node->thread)) {
+			scheduler_resume_node(node, THREAD_FLAG_WAIT_CONDVAR);
+		}
+
+		/* Not waiting anymore, drop it anyway */
+		if (node->list == &cond->waiters) {
+			list_remove(&cond->waiters, &node->header);
+			node->list = NULL;
+		}
+
+		++count;
+	}
+
+	unlock();
+}
+
+int condvar_signal(cond_t *cond)
+{
+	if (!cond) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+	signal_internal(cond, 1);
+	scheduler_preempt_enable();
+
+	return (EOK);
+}
+
+int condvar_broadcast(cond_t *cond)
+{
+	if (!cond) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+	signal_internal(cond, 0);
+	scheduler_preempt_enable();
+
+	return (EOK);
+}
+
+BOOL init_condvars_lib()
+{
+	if (EOK != list_init(&condvars_list)) {
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+static void dump_internal(const cond_t *cond)
+{
+	/*
+	 * The mutex might be gone once there are no waiters
+	 */
+	printf("%-15s | %-15s | %u\n", cond->name,
+	       (cond->waiters.counter) ? (cond->mutex->name) : "-", cond->waiters.counter);
+}
+
+void condvar_dump(const cond_t *cond)
+{
+	if (!cond) {
+		printf("\n--- CONDITION VARIABLES TABLE ----------\n\n");
+	}
+	printf("%-15s   %-15s   %s\n", "CONDVAR NAME", "MUTEX", "WAITING THREADS");
+	printf("________________________________________\n");
+	if (cond) {
+		dump_internal(cond);
+	} else {
+		cond = list_head(&condvars_list);
+		while (cond) {
+			dump_internal(cond);
+			cond = (const cond_t *)cond->header.next;
+		}
+	}
+	printf("----------------------------------------\n\n");
+}
@@ -22,6 +22,7 @@
 #include <diegos/delays.h>
 
 #include "kprintf.h"
+#include "clocksource.h"
 #include "platform_include.h"
 
 #define BASE_VALUE (1UL << 6)
@@ -105,13 +106,35 @@ void calibrate_delay(unsigned long (*tickfn)(void))
 	loops_per_msec = finder;
 }
 
+/*
+ * Spin on the cycle counter
+ */
+static void cycles_delay(uint64_t cycles)
+{
+	uint64_t start = read_cycles();
+
+	while ((read_cycles() - start) < cycles) {
+		cpu_relax();
+	}
+}
+
 void mdelay(unsigned long msecs)
 {
+	if (cycles_per_msec()) {
+		cycles_delay((uint64_t)msecs * cycles_per_msec());
+		return;
+	}
+
 	delay_loop(loops_per_msec * msecs);
 }
 
 void udelay(unsigned long usecs)
 {
+	if (cycles_per_msec()) {
+		cycles_delay(clock_ns_to_cycles((uint64_t)usecs * 1000ULL));
+		return;
+	}
+
 	unsigned long temp = loops_per_msec * usecs / 1000;
 	if (((loops_per_msec * usecs) % 1000U) > 499)
 		temp++;
@@ -121,6 +144,11 @@ void udelay(unsigned long usecs)
 
 void ndelay(unsigned long nsecs)
 {
+	if (cycles_per_msec()) {
+		cycles_delay(clock_ns_to_cycles(nsecs));
+		return;
+	}
+
 	unsigned long temp = loops_per_msec * nsecs / 1000000;
 	if (((loops_per_msec * nsecs) % 1000000U) > 499999)
 		temp++;
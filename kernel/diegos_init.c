@@ -148,11 +148,15 @@ void DiegOS(void)
 	kmsgprintf("Floating Point instructions are supported.\n");
 #endif
 
-	/*
-	 * delay loop is reasonably a 2-instructions loop - a decrease
-	 * and a jump - on any processor.
-	 */
-	kmsgprintf("%d BogoMIPS\n", loops_per_second() / 500000);
+	if (cycles_per_msec()) {
+		kmsgprintf("cycle counter at %lu MHz\n", cycles_per_msec() / 1000);
+	} else {
+		/*
+		 * delay loop is reasonably a 2-instructions loop - a decrease
+		 * and a jump - on any processor.
+		 */
+		kmsgprintf("%d BogoMIPS\n", loops_per_second() / 500000);
+	}
 	/*
 	 * Init the kernel system libraries.
 	 */
@@ -23,7 +23,7 @@
 #include <string.h>
 #include <libs/list.h>
 #include <libs/queue.h>
-#include <libs/bitmaps.h>
+#include <libs/slab.h>
 #include <diegos/events.h>
 #include <diegos/interrupts.h>
 
@@ -36,25 +36,42 @@
 typedef struct ev_queue {
 	list_node header;
 	queue_inst msgqueue;
+	list_inst waiters;
 	char name[16];
-	uint8_t threadid;
+	tid_t threadid;
 } ev_queue_t;
 
 static list_inst events_list;
 
-static long thread_ids[BITMAPLEN(DIEGOS_MAX_THREADS)];
+static slab_cache_t *events_cache = NULL;
+
+/*
+ * Queues are returned to the cache drained, with no waiters
+ */
+static void event_queue_ctor(void *obj)
+{
+	ev_queue_t *ptr = obj;
+
+	queue_init(&ptr->msgqueue);
+	list_init(&ptr->waiters);
+}
 
 ev_queue_t *event_init_queue(const char *name)
 {
-	ev_queue_t *ptr = malloc(sizeof(ev_queue_t));
+	ev_queue_t *ptr;
+
+	lock();
+	ptr = slab_alloc(events_cache);
+	unlock();
 
 	if (!ptr) {
 		return (NULL);
 	}
 
-	if ((EOK != queue_init(&ptr->msgqueue)) ||
-	    (EOK != list_prepend(&events_list, &ptr->header))) {
-		free(ptr);
+	if (EOK != list_prepend(&events_list, &ptr->header)) {
+		lock();
+		slab_free(events_cache, ptr);
+		unlock();
 		return (NULL);
 	}
 
@@ -80,6 +97,13 @@ int event_done_queue(ev_queue_t *evqueue)
 
 	lock();
 
+	if (list_count(&evqueue->waiters)) {
+		unlock();
+		kerrprintf("TID %d is waiting on events queue %s\n", evqueue->threadid,
+			   evqueue->name);
+		return (EBUSY);
+	}
+
 	if (queue_count(&evqueue->msgqueue)) {
 		kwrnprintf("there are %d events left in queue %s\n",
 			   queue_count(&evqueue->msgqueue), evqueue->name);
@@ -91,7 +115,7 @@ int event_done_queue(ev_queue_t *evqueue)
 		retval = EGENERIC;
 	}
 
-	free(evqueue);
+	slab_free(events_cache, evqueue);
 
 	unlock();
 
@@ -136,6 +160,9 @@ int event_put(ev_queue_t *evqueue, event_t *ev, event_freefn fncb)
 
 	lock();
 	retcode = queue_enqueue(&evqueue->msgqueue, &ev->header);
+	if (EOK == retcode) {
+		scheduler_resume_waiters(&evqueue->waiters, THREAD_FLAG_WAIT_EVENT, 1);
+	}
 	unlock();
 
 	if (EOK != retcode) {
@@ -179,7 +206,11 @@ int wait_for_events(ev_queue_t *evqueue)
 	return wait_for_events_timed(evqueue, 0);
 }
 
-int wait_for_events_timed(ev_queue_t *evqueue, unsigned msecs)
+/*
+ * Wait for events, a queue already holding events is reported
+ * as an error unless quiet is set.
+ */
+static int wait_internal(ev_queue_t *evqueue, unsigned msecs, BOOL quiet)
 {
 	thread_t *prev, *next;
 
@@ -195,53 +226,79 @@ int wait_for_events_timed(ev_queue_t *evqueue, unsigned msecs)
 		return (EPERM);
 	}
 
+	scheduler_preempt_disable();
+
+	/*
+	 * Events may be queued by interrupt handlers, check and wait
+	 * with interrupts disabled or a wakeup could be lost.
+	 */
+	lock();
+
 	if (queue_count(&evqueue->msgqueue)) {
-		kerrprintf("events queue %s has events!\n", evqueue->name);
+		unlock();
+		scheduler_preempt_enable();
+		if (!quiet) {
+			kerrprintf("events queue %s has events!\n", evqueue->name);
+		}
 		return (EOK);
 	}
 
-	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_EVENT, msecs)) {
-		kerrprintf("Cannot wait for events TID %u\n", prev);
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_EVENT, msecs, &evqueue->waiters)) {
+		unlock();
+		scheduler_preempt_enable();
+		kerrprintf("Cannot wait for events TID %u\n", prev->tid);
 		return (EPERM);
 	}
 
-	bitmap_set(thread_ids, prev->tid);
+	unlock();
+
 	schedule_thread();
 	next = scheduler_running_thread();
 	switch_context(&prev->context, next->context);
 
+	scheduler_preempt_enable();
+
 	return (queue_count(&evqueue->msgqueue) ? EOK : ETIMEDOUT);
 }
 
-BOOL init_events_lib()
+int wait_for_events_timed(ev_queue_t *evqueue, unsigned msecs)
 {
-	if (EOK != list_init(&events_list)) {
-		return (FALSE);
+	return (wait_internal(evqueue, msecs, FALSE));
+}
+
+int event_wait_quiet(ev_queue_t *evqueue, unsigned msecs)
+{
+	return (wait_internal(evqueue, msecs, TRUE));
+}
+
+int event_wait_prepare(ev_queue_t *evqueue, wait_node_t *node)
+{
+	if (evqueue->threadid != scheduler_running_tid()) {
+		return (EPERM);
 	}
 
-	memset(thread_ids, 0, sizeof(thread_ids));
+	if (queue_count(&evqueue->msgqueue)) {
+		return (EOK);
+	}
 
-	return (TRUE);
+	node->list = &evqueue->waiters;
+
+	return (EAGAIN);
 }
 
-void resume_on_events()
+BOOL init_events_lib()
 {
-	ev_queue_t *cur = (ev_queue_t *) list_head(&events_list);
-
-	while (cur) {
-		/*
-		 * Should we drop the events if the queue is not watched?
-		 */
-		if ((cur->threadid != THREAD_TID_INVALID) &&
-		    (bitmap_is_set(thread_ids, cur->threadid)) && queue_count(&cur->msgqueue)) {
-			scheduler_resume_thread(THREAD_FLAG_WAIT_EVENT, cur->threadid);
-			bitmap_clear(thread_ids, cur->threadid);
-		}
-		cur = (ev_queue_t *) cur->header.next;
+	if (EOK != list_init(&events_list)) {
+		return (FALSE);
 	}
+
+	events_cache = slab_cache_create("event queues", sizeof(ev_queue_t), 0, 0,
+					 event_queue_ctor, NULL);
+
+	return ((events_cache) ? TRUE : FALSE);
 }
 
-int cancel_wait_for_events(uint8_t tid)
+int cancel_wait_for_events(tid_t tid)
 {
 	ev_queue_t *evqueue;
 	thread_t *ptr = get_thread(tid);
@@ -20,6 +20,9 @@
 #ifndef _EVENTS_PRIVATE_H_
 #define _EVENTS_PRIVATE_H_
 
+#include <diegos/events.h>
+#include "threads_data.h"
+
 /*
  * Initialize the events library.
  * Must be called internally by kernel init routine.
@@ -31,16 +34,32 @@
 BOOL init_events_lib(void);
 
 /*
- * Resume threads waiting for an event and put them
- * into the ready queue. This function must be called
- * internally by the scheduler when a new running thread
- * has to be selected.
- * The function will loop all the events' queue, if the
- * queue size is not 0, the thread waiting for the queue
- * will be set to READY state and moved into the ready queue.
+ * Stop a thread waiting for events from watching its
+ * events queue, called when the thread is killed.
+ */
+int cancel_wait_for_events(tid_t tid);
+
+/*
+ * Same as wait_for_events_timed(), for queues where events may be
+ * queued by interrupt handlers between the last check of the caller
+ * and the wait: finding events queued is a normal wakeup, not an error.
+ *
+ * RETURNS
+ * see wait_for_events_timed()
  */
-void resume_on_events(void);
+int event_wait_quiet(ev_queue_t * evqueue, unsigned msecs);
 
-int cancel_wait_for_events(uint8_t tid);
+/*
+ * Prepare a wait on an events queue as one of multiple objects.
+ * If the queue holds events the thread does not wait, otherwise the
+ * list field of node is set to the waiters list to link.
+ * Interrupts must be disabled.
+ *
+ * RETURNS
+ * EOK the queue holds events
+ * EAGAIN the thread must wait
+ * EPERM the running thread is not watching the queue
+ */
+int event_wait_prepare(ev_queue_t * evqueue, wait_node_t * node);
 
 #endif
@@ -0,0 +1,412 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <diegos/interrupts.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/softirqs.h>
+#include <diegos/hrtimers.h>
+#include <libs/list.h>
+#include <libs/queue.h>
+#include <libs/red_black_tree.h>
+
+#include "hrtimers_private.h"
+#include "clock.h"
+#include "kprintf.h"
+
+struct hrtimer {
+	list_node header;
+	rbtree_node_t node;
+	queue_node expired;
+	/*
+	 * Expiration time in nanoseconds, see clock_get_ns
+	 */
+	uint64_t deadline;
+	uint64_t period;
+	/*
+	 * Deadline of the expiration deferred to softirq context
+	 */
+	uint64_t fired;
+	hrtimer_cb cb;
+	void *arg;
+	unsigned flags;
+	BOOL armed;
+	BOOL queued;
+	char name[16];
+	uint32_t expirations;
+	uint32_t overruns;
+	uint64_t total_late;
+	uint64_t max_late;
+};
+
+#define NODE_TO_HRTIMER(ptr)	\
+	((struct hrtimer *)((char *)(ptr) - offsetof(struct hrtimer, node)))
+
+#define EXPIRED_TO_HRTIMER(ptr)	\
+	((struct hrtimer *)((char *)(ptr) - offsetof(struct hrtimer, expired)))
+
+static list_inst hrtimers_list;
+
+/*
+ * Armed timers sorted by deadline
+ */
+static rbtree_node_t *root = NULL;
+
+/*
+ * Cached leftmost timer, the earliest deadline
+ */
+static struct hrtimer *earliest = NULL;
+
+/*
+ * Expired HRTIMER_SOFTIRQ timers waiting for their callback
+ */
+static queue_inst expired_queue;
+
+static softirq_t *sirq = NULL;
+
+/*
+ * Timers expiring at the same time are sorted by address,
+ * the tree does not accept duplicated keys.
+ */
+static int hrt_cmp(const rbtree_node_t *a, const rbtree_node_t *b)
+{
+	const struct hrtimer *ha = NODE_TO_HRTIMER(a);
+	const struct hrtimer *hb = NODE_TO_HRTIMER(b);
+
+	if (ha->deadline != hb->deadline) {
+		return ((ha->deadline < hb->deadline) ? KEY_LOWER : KEY_GREATER);
+	}
+
+	if (ha != hb) {
+		return ((ha < hb) ? KEY_LOWER : KEY_GREATER);
+	}
+
+	return (KEY_EQUAL);
+}
+
+/*
+ * Program the clock to expire at the earliest deadline.
+ * Deadlines are not multiple of a tick, the CLK device is set in one-shot
+ * mode and programmed for each expiration while timers are armed, then
+ * it goes back to periodic mode.
+ * Interrupts must be disabled.
+ */
+static void hrt_program(uint64_t now)
+{
+	if (!earliest) {
+		clock_set_period_ns(-1ULL, CLK_INST_HRTIMERS);
+		clock_set_periodic();
+		return;
+	}
+
+	clock_set_oneshot();
+	clock_set_period_ns((earliest->deadline > now) ? (earliest->deadline - now) : 1,
+			    CLK_INST_HRTIMERS);
+}
+
+/*
+ * Unlink a timer from the tree, interrupts must be disabled
+ */
+static void hrt_unlink(struct hrtimer *hrt)
+{
+	if (hrt->armed) {
+		rbtree_extract(&root, &hrt->node, hrt_cmp);
+		hrt->armed = FALSE;
+		if (hrt == earliest) {
+			earliest = (root) ? NODE_TO_HRTIMER(rbtree_first(root)) : NULL;
+		}
+	}
+}
+
+/*
+ * Link a timer to the tree, interrupts must be disabled
+ */
+static BOOL hrt_link(struct hrtimer *hrt)
+{
+	if (!rbtree_insert(&root, &hrt->node, hrt_cmp)) {
+		return (FALSE);
+	}
+
+	hrt->armed = TRUE;
+
+	if (!earliest || (KEY_LOWER == hrt_cmp(&hrt->node, &earliest->node))) {
+		earliest = hrt;
+	}
+
+	return (TRUE);
+}
+
+static void hrt_account(struct hrtimer *hrt, uint64_t deadline)
+{
+	uint64_t late = clock_get_ns();
+
+	late = (late > deadline) ? (late - deadline) : 0;
+
+	++hrt->expirations;
+	hrt->total_late += late;
+	if (late > hrt->max_late) {
+		hrt->max_late = late;
+	}
+}
+
+/*
+ * Softirq callback, runs the deferred callbacks with interrupts enabled
+ */
+static void hrt_softirq(void *arg)
+{
+	struct hrtimer *hrt;
+	queue_node *ptr;
+	hrtimer_cb cb;
+	void *cbarg;
+
+	(void)arg;
+
+	while (TRUE) {
+		lock();
+
+		if (EOK != queue_dequeue(&expired_queue, &ptr)) {
+			unlock();
+			break;
+		}
+
+		hrt = EXPIRED_TO_HRTIMER(ptr);
+		hrt->queued = FALSE;
+		hrt_account(hrt, hrt->fired);
+		cb = hrt->cb;
+		cbarg = hrt->arg;
+
+		unlock();
+
+		cb(cbarg);
+	}
+}
+
+/*
+ * Clock callback, expire all timers whose deadline is past
+ */
+static void hrt_clock_cb(uint64_t msecs)
+{
+	struct hrtimer *hrt;
+	uint64_t now, deadline, skip;
+
+	(void)msecs;
+
+	lock();
+
+	now = clock_get_ns();
+
+	while (earliest && (earliest->deadline <= now)) {
+		hrt = earliest;
+		deadline = hrt->deadline;
+		hrt_unlink(hrt);
+
+		/*
+		 * Periodic timers are armed again before the callback runs,
+		 * periods lost while interrupts were disabled are overruns.
+		 */
+		if (hrt->period) {
+			skip = (now - deadline) / hrt->period;
+			hrt->overruns += (uint32_t) skip;
+			hrt->deadline = deadline + (skip + 1) * hrt->period;
+			if (!hrt_link(hrt)) {
+				kerrprintf("failed re-arming hrtimer %s\n", hrt->name);
+			}
+		}
+
+		if (hrt->flags & HRTIMER_SOFTIRQ) {
+			if (hrt->queued) {
+				++hrt->overruns;
+			} else if (EOK == queue_enqueue(&expired_queue, &hrt->expired)) {
+				hrt->fired = deadline;
+				hrt->queued = TRUE;
+				softirq_raise(sirq);
+			}
+		} else {
+			hrt_account(hrt, deadline);
+			hrt->cb(hrt->arg);
+		}
+	}
+
+	hrt_program(clock_get_ns());
+
+	unlock();
+}
+
+BOOL init_hrtimers_lib()
+{
+	root = NULL;
+	earliest = NULL;
+
+	if ((EOK != list_init(&hrtimers_list)) || (EOK != queue_init(&expired_queue))) {
+		return (FALSE);
+	}
+
+	sirq = softirq_create("HRTimers", hrt_softirq, NULL);
+	if (!sirq) {
+		return (FALSE);
+	}
+
+	return (clock_add_cb(hrt_clock_cb, CLK_INST_HRTIMERS));
+}
+
+BOOL hrtimers_armed()
+{
+	BOOL retval;
+
+	lock();
+	retval = (earliest) ? TRUE : FALSE;
+	unlock();
+
+	return (retval);
+}
+
+hrtimer_t *hrtimer_create(const char *name, hrtimer_cb cb, void *arg, unsigned flags)
+{
+	struct hrtimer *ptr;
+
+	if (!cb) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	ptr = calloc(1, sizeof(struct hrtimer));
+	if (!ptr) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+
+	ptr->cb = cb;
+	ptr->arg = arg;
+	ptr->flags = flags;
+
+	if (name) {
+		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
+	} else {
+		snprintf(ptr->name, sizeof(ptr->name), "HRTimer%x", (intptr_t) ptr);
+	}
+
+	lock();
+	if (EOK != list_append(&hrtimers_list, &ptr->header)) {
+		unlock();
+		free(ptr);
+		errno = EPERM;
+		return (NULL);
+	}
+	unlock();
+
+	return (ptr);
+}
+
+int hrtimer_start(hrtimer_t *hrt, uint32_t usecs, uint32_t period_usecs)
+{
+	uint64_t now;
+
+	if (!hrt) {
+		return (EINVAL);
+	}
+
+	lock();
+
+	hrt_unlink(hrt);
+
+	now = clock_get_ns();
+	hrt->deadline = now + (uint64_t) usecs *1000ULL;
+	hrt->period = (uint64_t) period_usecs *1000ULL;
+
+	if (!hrt_link(hrt)) {
+		unlock();
+		kerrprintf("failed arming hrtimer %s\n", hrt->name);
+		return (EGENERIC);
+	}
+
+	if (hrt == earliest) {
+		hrt_program(now);
+	}
+
+	unlock();
+
+	return (EOK);
+}
+
+void hrtimer_cancel(hrtimer_t *hrt)
+{
+	if (!hrt) {
+		return;
+	}
+
+	lock();
+
+	hrt_unlink(hrt);
+
+	if (hrt->queued) {
+		queue_remove(&expired_queue, &hrt->expired);
+		hrt->queued = FALSE;
+	}
+
+	unlock();
+}
+
+int hrtimer_done(hrtimer_t *hrt)
+{
+	if (!hrt) {
+		return (EINVAL);
+	}
+
+	lock();
+
+	hrtimer_cancel(hrt);
+	list_remove(&hrtimers_list, &hrt->header);
+
+	unlock();
+
+	free(hrt);
+
+	return (EOK);
+}
+
+static void dump_internal(const hrtimer_t *hrt)
+{
+	printf("%-15s | %-5s | %10u | %8u | %10llu | %10llu | %s\n", hrt->name,
+	       (hrt->flags & HRTIMER_SOFTIRQ) ? "SIRQ" : "IRQ", hrt->expirations, hrt->overruns,
+	       (hrt->expirations) ? (hrt->total_late / hrt->expirations) : (0ULL), hrt->max_late,
+	       (hrt->armed) ? "ARMED" : "");
+}
+
+void hrtimer_dump(const hrtimer_t *hrt)
+{
+	if (!hrt) {
+		printf("\n--- HRTIMERS TABLE ----------------------------------------------------------\n\n");
+	}
+	printf("%-15s   %-5s   %10s   %8s   %10s   %10s   %s\n", "HRTIMER NAME", "CTX", "EXPIRED",
+	       "OVERRUNS", "AVG LATE", "MAX LATE", "STATUS");
+	printf("_____________________________________________________________________________\n");
+	if (hrt) {
+		dump_internal(hrt);
+	} else {
+		hrt = list_head(&hrtimers_list);
+		while (hrt) {
+			dump_internal(hrt);
+			hrt = (const hrtimer_t *)hrt->header.next;
+		}
+	}
+	printf("-----------------------------------------------------------------------------\n\n");
+}
@@ -18,14 +18,52 @@
  */
 
 #include <diegos/kernel.h>
+#include <diegos/interrupts.h>
 
 #include "platform_include.h"
 #include "idle_thread.h"
+#include "scheduler.h"
+#include "timer_queue.h"
+#include "hrtimers_private.h"
+#include "clock.h"
 
 void idle_thread_entry()
 {
 	while (TRUE) {
+#if defined(ENABLE_SMP)
+		/*
+		 * Halt until an interrupt, or another processor, makes a
+		 * thread ready; the kernel lock must not be held while halted.
+		 * Only the boot processor receives the clock interrupt, so
+		 * the tick is never stopped.
+		 */
+		lock();
+		if (!scheduler_idle_work()) {
+			power_save_unlock();
+		} else {
+			unlock();
+		}
+#elif defined(ENABLE_TICKLESS)
+		/*
+		 * Nothing else to run, stop the tick until the next deadline
+		 * or until an interrupt makes a thread ready; armed high
+		 * resolution timers keep the CLK device programmed.
+		 * The tick must be restored before any other thread runs.
+		 */
+		scheduler_preempt_disable();
+		lock();
+		if (!scheduler_ready_threads(THREAD_PRIORITIES) && !hrtimers_armed() &&
+		    clock_tickless_enter(tq_earliest())) {
+			power_save_unlock();
+			clock_tickless_exit();
+		} else {
+			unlock();
+			power_save();
+		}
+		scheduler_preempt_enable();
+#else
 		power_save();
+#endif
 		thread_suspend();
 	}
 }
@@ -0,0 +1,511 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <libs/list.h>
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/interrupts.h>
+#include <diegos/semaphores.h>
+#include <diegos/net_buffers.h>
+#include <diegos/io_rings.h>
+
+#include "kprintf.h"
+
+#define IO_RING_MAX	(256)
+
+/*
+ * Maximum number of entries passed to a driver multi function
+ */
+#define IO_BATCH_MAX	(16)
+
+struct io_ring {
+	list_node header;
+	char name[16];
+	unsigned mask;
+	io_sqe_t *sq;
+	io_cqe_t *cq;
+	/*
+	 * Submission ring, the kernel thread consumes entries from
+	 * sq_head to sq_tail; sq_reserved entries past sq_tail are being
+	 * filled by the submitter.
+	 */
+	volatile unsigned sq_head;
+	volatile unsigned sq_tail;
+	unsigned sq_reserved;
+	/*
+	 * Completion ring, the submitter reaps entries from cq_head
+	 * to cq_tail.
+	 */
+	volatile unsigned cq_head;
+	volatile unsigned cq_tail;
+	/*
+	 * Posted on every submission and on every batch of completions
+	 */
+	sem_t *sq_sem;
+	sem_t *cq_sem;
+	volatile BOOL stop;
+};
+
+/*
+ * Rings waiting for their kernel thread to start
+ */
+static LIST_STATIC_INIT(starting_rings);
+
+static BOOL io_is_net(const device_t *dev)
+{
+	return ((dev->cmn->status_fn(dev->header.unitno) & DRV_IS_NET) ? (TRUE) : (FALSE));
+}
+
+/*
+ * Check an entry against its device
+ */
+static int io_check(const io_sqe_t *sqe)
+{
+	if (!sqe->dev || !sqe->dev->drv || !sqe->buf) {
+		return (EINVAL);
+	}
+
+	switch (sqe->opcode) {
+	case IO_OP_READ:
+		/* FALLTHRU */
+	case IO_OP_WRITE:
+		if (DEV_TYPE_BLOCK == sqe->dev->header.type) {
+			return (EOK);
+		}
+		if ((DEV_TYPE_CHAR == sqe->dev->header.type) && !io_is_net(sqe->dev)) {
+			return (EOK);
+		}
+		return (EPERM);
+
+	case IO_OP_NET_RX:
+		/* FALLTHRU */
+	case IO_OP_NET_TX:
+		if ((DEV_TYPE_CHAR == sqe->dev->header.type) && io_is_net(sqe->dev)) {
+			return (EOK);
+		}
+		return (EPERM);
+
+	default:
+		return (EINVAL);
+	}
+}
+
+/*
+ * Multi function of the driver servicing an entry, if any.
+ * Devices with custom read and write functions are serviced one entry
+ * at a time.
+ */
+static BOOL io_has_multi(const io_sqe_t *sqe)
+{
+	const device_t *dev = sqe->dev;
+
+	if (EOK != io_check(sqe)) {
+		return (FALSE);
+	}
+
+	switch (sqe->opcode) {
+	case IO_OP_READ:
+		if (DEV_TYPE_BLOCK == dev->header.type) {
+			return ((dev->bdrv->read_multi_fn) ? (TRUE) : (FALSE));
+		}
+		return ((!dev->header.read_fn && dev->cdrv->read_multi_fn) ? (TRUE) : (FALSE));
+
+	case IO_OP_WRITE:
+		if (DEV_TYPE_BLOCK == dev->header.type) {
+			return ((dev->bdrv->write_multi_fn) ? (TRUE) : (FALSE));
+		}
+		return ((!dev->header.write_fn && dev->cdrv->write_multi_fn) ? (TRUE) : (FALSE));
+
+	case IO_OP_NET_RX:
+		return ((dev->ndrv->rx_multi_fn) ? (TRUE) : (FALSE));
+
+	case IO_OP_NET_TX:
+		return ((dev->ndrv->tx_multi_fn) ? (TRUE) : (FALSE));
+	}
+
+	return (FALSE);
+}
+
+static void io_complete(io_ring_t *ring, const io_sqe_t *sqe, int status, unsigned bytes)
+{
+	io_cqe_t *cqe = &ring->cq[ring->cq_tail & ring->mask];
+
+	cqe->user_data = sqe->user_data;
+	cqe->status = status;
+	cqe->bytes = bytes;
+
+	__sync_synchronize();
+	ring->cq_tail++;
+}
+
+static void io_single(io_ring_t *ring, const io_sqe_t *sqe)
+{
+	device_t *dev = sqe->dev;
+	struct packet *pkt = sqe->buf;
+	int retcode = io_check(sqe);
+
+	if (EOK != retcode) {
+		io_complete(ring, sqe, retcode, 0);
+		return;
+	}
+
+	switch (sqe->opcode) {
+	case IO_OP_READ:
+		if (DEV_TYPE_BLOCK == dev->header.type) {
+			retcode = dev->bdrv->read_fn(sqe->buf, sqe->bytes, sqe->offset,
+						     dev->header.unitno);
+		} else if (dev->header.read_fn) {
+			retcode = dev->header.read_fn(sqe->buf, sqe->bytes, dev->cdrv,
+						      dev->header.unitno);
+		} else {
+			retcode = dev->cdrv->read_fn(sqe->buf, sqe->bytes, dev->header.unitno);
+		}
+		break;
+
+	case IO_OP_WRITE:
+		if (DEV_TYPE_BLOCK == dev->header.type) {
+			retcode = dev->bdrv->write_fn(sqe->buf, sqe->bytes, sqe->offset,
+						      dev->header.unitno);
+		} else if (dev->header.write_fn) {
+			retcode = dev->header.write_fn(sqe->buf, sqe->bytes, dev->cdrv,
+						       dev->header.unitno);
+		} else {
+			retcode = dev->cdrv->write_fn(sqe->buf, sqe->bytes, dev->header.unitno);
+		}
+		break;
+
+	case IO_OP_NET_RX:
+		retcode = dev->ndrv->rx_fn(pkt, dev->header.unitno);
+		io_complete(ring, sqe, retcode, (EOK == retcode) ? (pkt->data_payload_size) : (0));
+		return;
+
+	case IO_OP_NET_TX:
+		retcode = dev->ndrv->tx_fn(pkt, dev->header.unitno);
+		io_complete(ring, sqe, retcode, (EOK == retcode) ? (pkt->data_payload_size) : (0));
+		return;
+	}
+
+	/*
+	 * Character and block drivers return the bytes transferred
+	 */
+	if (retcode >= 0) {
+		io_complete(ring, sqe, EOK, retcode);
+	} else {
+		io_complete(ring, sqe, EIO, 0);
+	}
+}
+
+/*
+ * Service count entries sharing device and opcode with a single call
+ */
+static void io_multi(io_ring_t *ring, unsigned count)
+{
+	const io_sqe_t *sqe = &ring->sq[ring->sq_head & ring->mask];
+	device_t *dev = sqe->dev;
+	void *bufs[IO_BATCH_MAX];
+	unsigned bytes[IO_BATCH_MAX];
+	uint64_t blocks[IO_BATCH_MAX];
+	unsigned i, unitno = dev->header.unitno;
+	int retcode = EINVAL;
+
+	for (i = 0; i < count; i++) {
+		sqe = &ring->sq[(ring->sq_head + i) & ring->mask];
+		bufs[i] = sqe->buf;
+		bytes[i] = sqe->bytes;
+		blocks[i] = sqe->offset;
+	}
+
+	switch (sqe->opcode) {
+	case IO_OP_READ:
+		if (DEV_TYPE_BLOCK == dev->header.type) {
+			retcode = dev->bdrv->read_multi_fn(bufs, bytes, blocks, count, unitno);
+		} else {
+			retcode = dev->cdrv->read_multi_fn(bufs, bytes, count, unitno);
+		}
+		break;
+
+	case IO_OP_WRITE:
+		if (DEV_TYPE_BLOCK == dev->header.type) {
+			retcode = dev->bdrv->write_multi_fn((const void **)bufs, bytes, blocks, count,
+							    unitno);
+		} else {
+			retcode = dev->cdrv->write_multi_fn((const void **)bufs, bytes, count, unitno);
+		}
+		break;
+
+	case IO_OP_NET_RX:
+		retcode = dev->ndrv->rx_multi_fn((struct packet **)bufs, count, unitno);
+		break;
+
+	case IO_OP_NET_TX:
+		retcode = dev->ndrv->tx_multi_fn((const struct packet **)bufs, count, unitno);
+		break;
+	}
+
+	if (retcode < 0) {
+		retcode = EIO;
+	}
+
+	for (i = 0; i < count; i++) {
+		sqe = &ring->sq[(ring->sq_head + i) & ring->mask];
+		if (EOK != retcode) {
+			io_complete(ring, sqe, retcode, 0);
+		} else if ((IO_OP_NET_RX == sqe->opcode) || (IO_OP_NET_TX == sqe->opcode)) {
+			io_complete(ring, sqe, EOK, ((struct packet *)bufs[i])->data_payload_size);
+		} else {
+			io_complete(ring, sqe, EOK, bytes[i]);
+		}
+	}
+}
+
+/*
+ * Number of submitted entries that can be serviced with a single call
+ */
+static unsigned io_batch(io_ring_t *ring)
+{
+	const io_sqe_t *first = &ring->sq[ring->sq_head & ring->mask];
+	const io_sqe_t *next;
+	unsigned avail = ring->sq_tail - ring->sq_head;
+	unsigned count = 1;
+
+	if (!io_has_multi(first)) {
+		return (1);
+	}
+
+	while ((count < avail) && (count < IO_BATCH_MAX)) {
+		next = &ring->sq[(ring->sq_head + count) & ring->mask];
+		if ((next->dev != first->dev) || (next->opcode != first->opcode) || !next->buf) {
+			break;
+		}
+		count++;
+	}
+
+	return (count);
+}
+
+static void io_ring_free(io_ring_t *ring)
+{
+	if (ring->sq_sem) {
+		semaphore_done(ring->sq_sem);
+	}
+	if (ring->cq_sem) {
+		semaphore_done(ring->cq_sem);
+	}
+	free(ring->sq);
+	free(ring->cq);
+	free(ring);
+}
+
+/*
+ * Kernel thread of a ring, it services the submitted entries in order
+ */
+static void io_ring_thread(void)
+{
+	io_ring_t *ring;
+	unsigned count;
+
+	lock();
+	ring = list_head(&starting_rings);
+	if (ring) {
+		list_remove(&starting_rings, &ring->header);
+	}
+	unlock();
+
+	if (!ring) {
+		kerrprintf("I/O ring thread without ring\n");
+		return;
+	}
+
+	while (!ring->stop) {
+		(void)semaphore_wait(ring->sq_sem);
+
+		while (ring->sq_head != ring->sq_tail) {
+			count = io_batch(ring);
+			if (count > 1) {
+				io_multi(ring, count);
+			} else {
+				io_single(ring, &ring->sq[ring->sq_head & ring->mask]);
+			}
+			ring->sq_head += count;
+			(void)semaphore_post(ring->cq_sem);
+		}
+	}
+
+	io_ring_free(ring);
+}
+
+io_ring_t *io_ring_create(const char *name, unsigned entries)
+{
+	io_ring_t *ring;
+	unsigned size = 1;
+	tid_t tid;
+
+	if (!entries || (entries > IO_RING_MAX)) {
+		return (NULL);
+	}
+
+	while (size < entries) {
+		size <<= 1;
+	}
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		return (NULL);
+	}
+
+	ring->mask = size - 1;
+	ring->sq = calloc(size, sizeof(io_sqe_t));
+	ring->cq = calloc(size, sizeof(io_cqe_t));
+	ring->sq_sem = semaphore_create(name, 0);
+	ring->cq_sem = semaphore_create(name, 0);
+
+	if (!ring->sq || !ring->cq || !ring->sq_sem || !ring->cq_sem) {
+		io_ring_free(ring);
+		return (NULL);
+	}
+
+	if (name) {
+		snprintf(ring->name, sizeof(ring->name), "%s", name);
+	} else {
+		snprintf(ring->name, sizeof(ring->name), "IORing%x", (intptr_t) ring);
+	}
+
+	lock();
+	if (EOK != list_append(&starting_rings, &ring->header)) {
+		unlock();
+		io_ring_free(ring);
+		return (NULL);
+	}
+	unlock();
+
+	if (!thread_create(ring->name, THREAD_PRIO_HIGH, io_ring_thread, NULL, 4096, &tid)) {
+		lock();
+		list_remove(&starting_rings, &ring->header);
+		unlock();
+		io_ring_free(ring);
+		return (NULL);
+	}
+
+	return (ring);
+}
+
+int io_ring_done(io_ring_t *ring)
+{
+	if (!ring) {
+		return (EINVAL);
+	}
+
+	if (ring->sq_reserved || (ring->sq_tail != ring->cq_tail)) {
+		return (EBUSY);
+	}
+
+	/*
+	 * The kernel thread releases the ring
+	 */
+	ring->stop = TRUE;
+	(void)semaphore_post(ring->sq_sem);
+
+	return (EOK);
+}
+
+io_sqe_t *io_ring_get_sqe(io_ring_t *ring)
+{
+	unsigned next;
+
+	if (!ring) {
+		return (NULL);
+	}
+
+	next = ring->sq_tail + ring->sq_reserved;
+	if ((next - ring->cq_head) > ring->mask) {
+		return (NULL);
+	}
+
+	ring->sq_reserved++;
+
+	return (&ring->sq[next & ring->mask]);
+}
+
+unsigned io_ring_submit(io_ring_t *ring)
+{
+	unsigned count;
+
+	if (!ring || !ring->sq_reserved) {
+		return (0);
+	}
+
+	count = ring->sq_reserved;
+	ring->sq_reserved = 0;
+
+	__sync_synchronize();
+	ring->sq_tail += count;
+
+	(void)semaphore_post(ring->sq_sem);
+
+	return (count);
+}
+
+int io_ring_wait(io_ring_t *ring, unsigned min_complete, unsigned msecs)
+{
+	uint64_t deadline, now;
+	unsigned left = 0;
+
+	if (!ring || (min_complete > (ring->sq_tail - ring->cq_head))) {
+		return (EINVAL);
+	}
+
+	deadline = clock_get_milliseconds() + msecs;
+
+	while ((ring->cq_tail - ring->cq_head) < min_complete) {
+		if (msecs) {
+			now = clock_get_milliseconds();
+			if (now >= deadline) {
+				return (ETIMEDOUT);
+			}
+			left = (unsigned)(deadline - now);
+		}
+
+		/*
+		 * Units are posted per batch, a stale unit just makes
+		 * the loop check the ring once more
+		 */
+		(void)semaphore_wait_timed(ring->cq_sem, left);
+	}
+
+	return (EOK);
+}
+
+io_cqe_t *io_ring_peek_cqe(io_ring_t *ring)
+{
+	if (!ring || (ring->cq_head == ring->cq_tail)) {
+		return (NULL);
+	}
+
+	return (&ring->cq[ring->cq_head & ring->mask]);
+}
+
+void io_ring_cqe_seen(io_ring_t *ring)
+{
+	if (ring && (ring->cq_head != ring->cq_tail)) {
+		ring->cq_head++;
+	}
+}
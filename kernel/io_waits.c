@@ -21,12 +21,12 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <libs/chunks.h>
-#include <libs/bitmaps.h>
 #include <diegos/io_waits.h>
 #include <diegos/interrupts.h>
 
 #include "poll_private.h"
 #include "io_waits_private.h"
+#include "tasks_private.h"
 #include "threads.h"
 #include "kprintf.h"
 #include "scheduler.h"
@@ -41,8 +41,6 @@ static list_inst wait_queues;
 static chunks_pool_t *wait_queue_items;
 static chunks_pool_t *wait_queue_int_items;
 
-static long thread_ids[BITMAPLEN(DIEGOS_MAX_THREADS)];
-
 int thread_io_wait_init(wait_queue_t *wq)
 {
 	struct wait_queue_int *temp;
@@ -103,8 +101,8 @@ static int thread_io_wait_internal(wait_queue_t *wq, unsigned flags, unsigned ms
 
 	prev = scheduler_running_thread();
 
-	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_COMPLETION, msecs)) {
-		kerrprintf("TID %u Cannot wait for I/O\n", prev);
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_COMPLETION, msecs, NULL)) {
+		kerrprintf("TID %u Cannot wait for I/O\n", prev->tid);
 		list_remove(wq, &temp->header);
 		chunks_pool_free(wait_queue_items, temp);
 		unlock();
@@ -118,20 +116,19 @@ static int thread_io_wait_internal(wait_queue_t *wq, unsigned flags, unsigned ms
 	switch_context(&prev->context, next->context);
 
 	retcode = EOK;
-	// This should defitively be improved
-	if (msecs) {
+	/*
+	 * thread_io_resume() releases the item when it resumes the thread.
+	 * A timed out wait owns its item: it is still queued, unless a
+	 * resume raced with the timeout and only unlinked it.
+	 */
+	if (prev->wake_flags & THREAD_FLAG_WAIT_TIMEOUT) {
 		lock();
-		if (list_count(wq)) {
-			temp = list_head(wq);
-			while (temp) {
-				if (temp->tid == scheduler_running_tid()) {
-					retcode = ETIMEDOUT;
-					break;
-				}
-				temp = (struct wait_queue_item *)temp->header.next;
-			}
+		if (temp->header.prev || (list_head(wq) == temp)) {
+			list_remove(wq, &temp->header);
 		}
+		chunks_pool_free(wait_queue_items, temp);
 		unlock();
+		retcode = ETIMEDOUT;
 	}
 
 	return (retcode);
@@ -139,12 +136,18 @@ static int thread_io_wait_internal(wait_queue_t *wq, unsigned flags, unsigned ms
 
 int thread_io_wait(wait_queue_t *wq)
 {
-	return (thread_io_wait_internal(wq, IO_WAIT_DEFAULT, 0));
+	return (thread_io_wait_timed(wq, 0));
 }
 
 int thread_io_wait_timed(wait_queue_t *wq, unsigned msecs)
 {
-	return (thread_io_wait_internal(wq, IO_WAIT_DEFAULT, msecs));
+	int retcode;
+
+	scheduler_preempt_disable();
+	retcode = thread_io_wait_internal(wq, IO_WAIT_DEFAULT, msecs);
+	scheduler_preempt_enable();
+
+	return (retcode);
 }
 
 int thread_io_resume(wait_queue_t *wq)
@@ -160,8 +163,16 @@ int thread_io_resume(wait_queue_t *wq)
 		cursor = list_head(wq);
 		if (IO_WAIT_POLL == cursor->flags) {
 			(void)poll_wakeup(cursor);
-		} else {
-			bitmap_set(thread_ids, cursor->tid);
+		} else if (IO_WAIT_TASK == cursor->flags) {
+			task_io_resume(cursor->pt);
+		} else if (!scheduler_resume_thread(THREAD_FLAG_WAIT_COMPLETION, cursor->tid)) {
+			/*
+			 * The wait timed out, the waiter releases the item
+			 */
+			if (EOK != list_remove(wq, &cursor->header)) {
+				break;
+			}
+			continue;
 		}
 		if (EOK != list_remove(wq, &cursor->header)) {
 			break;
@@ -198,8 +209,6 @@ BOOL init_io_wait_lib()
 		return (FALSE);
 	}
 
-	memset(thread_ids, 0, sizeof(thread_ids));
-
 	return (TRUE);
 }
 
@@ -247,22 +256,7 @@ int io_wait_remove(struct wait_queue_item *item, wait_queue_t *wq)
 	return (retcode);
 }
 
-static void resumecb(long *bitmap, unsigned pos, void *param)
-{
-	if (!scheduler_resume_thread(THREAD_FLAG_WAIT_COMPLETION, (uint8_t) pos)) {
-		kerrprintf("TID %u Cannot be resumed for I/O\n", pos);
-	}
-	bitmap_clear(bitmap, pos);
-}
-
-void resume_on_io_wait()
-{
-	lock();
-	bitmap_for_each_set(thread_ids, BITMAPLEN(DIEGOS_MAX_THREADS), resumecb, NULL);
-	unlock();
-}
-
-int cancel_io_waits(uint8_t tid)
+int cancel_io_waits(tid_t tid)
 {
 	struct wait_queue_int *wq_int;
 	struct wait_queue_item *wq_item;
@@ -275,7 +269,7 @@ int cancel_io_waits(uint8_t tid)
 		temp = list_head(wq_int->wq);
 		while (temp) {
 			wq_item = (struct wait_queue_item *)temp;
-			if (wq_item->tid == tid) {
+			if ((IO_WAIT_DEFAULT == wq_item->flags) && (wq_item->tid == tid)) {
 				list_remove(wq_int->wq, &wq_item->header);
 				chunks_pool_free(wait_queue_items, wq_item);
 				break;
@@ -284,7 +278,6 @@ int cancel_io_waits(uint8_t tid)
 		}
 		ptr = ptr->next;
 	}
-	bitmap_clear(thread_ids, tid);
 	unlock();
 
 	return EOK;
@@ -20,18 +20,20 @@
 #ifndef IO_WAITS_PRIVATE_H_INCLUDED
 #define IO_WAITS_PRIVATE_H_INCLUDED
 
+#include <diegos/kernel.h>
 #include <diegos/io_waits.h>
 
 enum {
 	IO_WAIT_DEFAULT,
-	IO_WAIT_POLL
+	IO_WAIT_POLL,
+	IO_WAIT_TASK
 };
 
 struct wait_queue_item {
 	list_node header;
 	unsigned char flags;
 	union {
-		uint8_t tid;
+		tid_t tid;
 		void *pt;
 	};
 };
@@ -55,8 +57,6 @@ int io_wait_add(struct wait_queue_item *item, wait_queue_t * wq);
 
 int io_wait_remove(struct wait_queue_item *item, wait_queue_t * wq);
 
-void resume_on_io_wait(void);
-
-int cancel_io_waits(uint8_t tid);
+int cancel_io_waits(tid_t tid);
 
 #endif				// IO_WAITS_PRIVATE_H_INCLUDED
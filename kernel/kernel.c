@@ -25,6 +25,7 @@
 #include <diegos/kernel_ticks.h>
 #include <diegos/mutexes.h>
 #include <diegos/devices.h>
+#include <diegos/interrupts.h>
 
 #include "kernel_private.h"
 #include "threads.h"
@@ -33,10 +34,17 @@
 #include "idle_thread.h"
 #include "mutex_private.h"
 #include "clock.h"
+#include "timer_queue.h"
 #include "events_private.h"
 #include "alarms_private.h"
 #include "timers_private.h"
 #include "barriers_private.h"
+#include "semaphores_private.h"
+#include "condvars_private.h"
+#include "rwlocks_private.h"
+#include "softirqs_private.h"
+#include "hrtimers_private.h"
+#include "tasks_private.h"
 #include "io_waits_private.h"
 #include "devices_private.h"
 #include "net_interfaces_private.h"
@@ -46,6 +54,7 @@
 #include "platform_include.h"
 
 static const char *messages[] = { "cannot init clock",
+	"cannot init timer queue",
 	"cannot init scheduler"
 };
 
@@ -55,6 +64,12 @@ static const char *messages2[] = { "cannot init threads",
 	"cannot init alarms",
 	"cannot int timers",
 	"cannot init barriers",
+	"cannot init semaphores",
+	"cannot init condition variables",
+	"cannot init rwlocks",
+	"cannot init softirqs",
+	"cannot init hrtimers",
+	"cannot init tasks",
 	"cannot init I/O waits",
 	"cannot init poll",
 	"cannot init network buffers",
@@ -66,6 +81,7 @@ static const char *messages2[] = { "cannot init threads",
 typedef BOOL(*initlibfn) (void);
 
 static const initlibfn init_array[] = { clock_init,
+	timer_queue_init,
 	scheduler_init
 };
 
@@ -75,6 +91,12 @@ static const initlibfn libs_init_array[] = { init_thread_lib,
 	init_alarms_lib,
 	init_timers_lib,
 	init_barriers_lib,
+	init_semaphores_lib,
+	init_condvars_lib,
+	init_rwlocks_lib,
+	init_softirqs_lib,
+	init_hrtimers_lib,
+	init_tasks_lib,
 	init_io_wait_lib,
 	init_poll_lib,
 	init_network_lib,
@@ -121,7 +143,7 @@ void kernel_libs_init()
 
 void kernel_threads_init()
 {
-	uint8_t tid;
+	tid_t tid;
 
 	tid = init_thread("Idle", THREAD_PRIO_IDLE, idle_thread_entry, NULL, 1 * KBYTE);
 
@@ -130,7 +152,7 @@ void kernel_threads_init()
 		return;
 	}
 
-	if (!scheduler_add_thread(tid)) {
+	if (!scheduler_add_idle(tid)) {
 		kernel_panic("cannot add IDLE to the scheduler.");
 	}
 
@@ -154,6 +176,38 @@ void kernel_panic(const char *msg)
 	abort();
 }
 
+#ifdef ENABLE_SMP
+/*
+ * Entry point of the application processors: each one creates its own
+ * idle thread and starts scheduling, stealing work from the others.
+ */
+static void kernel_ap_entry(void)
+{
+	char name[THREAD_NAME_MAX + 1];
+	thread_t *idle;
+	tid_t tid;
+
+	/*
+	 * Released by the first thread switched in
+	 */
+	kernel_lock_acquire();
+
+	sprintf(name, "Idle%u", cpu_id());
+	tid = init_thread(name, THREAD_PRIO_IDLE, idle_thread_entry, NULL, 1 * KBYTE);
+
+	if ((THREAD_TID_INVALID == tid) || !scheduler_add_idle(tid)) {
+		kernel_panic("cannot create an IDLE thread.");
+		return;
+	}
+
+	schedule_thread();
+
+	idle = scheduler_running_thread();
+
+	load_context(idle->context);
+}
+#endif
+
 void kernel_run()
 {
 	thread_t *init;
@@ -165,6 +219,15 @@ void kernel_run()
 
 	kprintf("system is running.\n");
 
+#ifdef ENABLE_SMP
+	kprintf("%u processors online.\n", start_cpus(kernel_ap_entry, DIEGOS_MAX_CPUS));
+
+	/*
+	 * Released by the first thread switched in
+	 */
+	kernel_lock_acquire();
+#endif
+
 	schedule_thread();
 
 	init = scheduler_running_thread();
@@ -174,9 +237,9 @@ void kernel_run()
 
 void kernel_done()
 {
-	uint8_t i;
+	tid_t i;
 
-	for (i = 0; i < THREAD_TID_INVALID; i++) {
+	for (i = 0; i < thread_table_size(); i++) {
 		if (get_thread(i)) {
 			thread_kill(i);
 		}
@@ -199,6 +262,8 @@ void thread_suspend()
 
 	prev = scheduler_running_thread();
 
+	scheduler_preempt_disable();
+
 	if (!scheduler_suspend_thread()) {
 		kernel_panic("cannot suspend a thread.\n");
 		return;
@@ -209,21 +274,22 @@ void thread_suspend()
 	next = scheduler_running_thread();
 
 	/* No one to wait for */
-	if (prev == next) {
-		return;
+	if (prev != next) {
+		switch_context(&prev->context, next->context);
 	}
 
-	switch_context(&prev->context, next->context);
+	scheduler_preempt_enable();
 }
 
 void thread_may_suspend()
 {
 	thread_t *prev = scheduler_running_thread();
-	uint8_t total;
+	unsigned total;
 
+	scheduler_preempt_disable();
 	update_schedule();
-
 	total = scheduler_ready_threads(prev->priority);
+	scheduler_preempt_enable();
 
 	if (!total) {
 		return;
@@ -241,6 +307,8 @@ void thread_delay(unsigned msecs)
 
 	prev = scheduler_running_thread();
 
+	scheduler_preempt_disable();
+
 	if (!scheduler_delay_thread(msecs)) {
 		kerrprintf("cannot delay thread %d for %u ms.\n", prev->tid, msecs);
 		kernel_panic("cannot delay a thread.\n");
@@ -252,12 +320,17 @@ void thread_delay(unsigned msecs)
 	next = scheduler_running_thread();
 
 	switch_context(&prev->context, next->context);
+
+	scheduler_preempt_enable();
 }
 
 void thread_terminate()
 {
 	thread_t *me = scheduler_running_thread();
 
+	/* No way back, preemption is never enabled again */
+	scheduler_preempt_disable();
+
 	if (!scheduler_remove_thread(me->tid)) {
 		kerrprintf("killing my TID %d failed\n", me->tid);
 		kernel_panic("cannot terminate myself.\n");
@@ -270,17 +343,28 @@ void thread_terminate()
 
 BOOL thread_create(const char *name,
 		   diegos_prio_t prio,
-		   void (*entry_ptr)(void), void *stack, unsigned stack_size, uint8_t *tid)
+		   void (*entry_ptr)(void), void *stack, unsigned stack_size, tid_t *tid)
 {
-	uint8_t ntid;
+	tid_t ntid;
 
 	if (!tid || !stack_size || !entry_ptr || !name) {
 		return (FALSE);
 	}
 
+	/*
+	 * The level belongs to the deadline threads, see thread_create_edf()
+	 */
+	if (THREAD_PRIO_EDF == prio) {
+		errno = EINVAL;
+		return (FALSE);
+	}
+
+	scheduler_preempt_disable();
+
 	ntid = init_thread(name, prio, entry_ptr, stack, stack_size);
 
 	if (THREAD_TID_INVALID == ntid) {
+		scheduler_preempt_enable();
 		kerrprintf("cannot init a new thread.\n");
 		return (FALSE);
 	}
@@ -290,28 +374,34 @@ BOOL thread_create(const char *name,
 		return (FALSE);
 	}
 
+	scheduler_preempt_enable();
+
 	*tid = ntid;
 
 	return (TRUE);
 }
 
-void thread_kill(uint8_t tid)
+void thread_kill(tid_t tid)
 {
 	if (tid == scheduler_running_tid()) {
 		kprintf("cannot kill the running process\n");
 		return;
 	}
 
+	scheduler_preempt_disable();
+
 	if (!scheduler_remove_thread(tid)) {
 		kerrprintf("killing TID %d failed\n", tid);
 		kernel_panic("cannot terminate a thread.\n");
 		return;
 	}
 
+	scheduler_preempt_enable();
+
 	kprintf("TID %d scheduled to die\n", tid);
 }
 
-uint8_t my_thread_id()
+tid_t my_thread_id()
 {
 	return (scheduler_running_tid());
 }
@@ -323,13 +413,171 @@ const char *my_thread_name()
 	return ((myself) ? (myself->name) : (NULL));
 }
 
+void thread_preempt_disable()
+{
+	scheduler_preempt_disable();
+}
+
+void thread_preempt_enable()
+{
+	scheduler_preempt_enable();
+}
+
+BOOL thread_create_edf(const char *name,
+		       const edf_params_t *params,
+		       void (*entry_ptr)(void), void *stack, unsigned stack_size, tid_t *tid)
+{
+	tid_t ntid;
+
+	if (!tid || !params || !stack_size || !entry_ptr || !name) {
+		return (FALSE);
+	}
+
+	scheduler_preempt_disable();
+
+	ntid = init_thread(name, THREAD_PRIO_EDF, entry_ptr, stack, stack_size);
+
+	if (THREAD_TID_INVALID == ntid) {
+		scheduler_preempt_enable();
+		kerrprintf("cannot init a new thread.\n");
+		return (FALSE);
+	}
+
+	if (!scheduler_edf_admit(get_thread(ntid), params->runtime, params->deadline,
+				 params->period)) {
+		done_thread(ntid);
+		scheduler_preempt_enable();
+		return (FALSE);
+	}
+
+	if (!scheduler_add_thread(ntid)) {
+		kernel_panic("cannot schedule a thread.\n");
+		return (FALSE);
+	}
+
+	scheduler_preempt_enable();
+
+	*tid = ntid;
+
+	return (TRUE);
+}
+
+void thread_edf_wait()
+{
+	thread_t *prev, *next;
+
+	prev = scheduler_running_thread();
+
+	scheduler_preempt_disable();
+
+	if (!scheduler_edf_wait()) {
+		scheduler_preempt_enable();
+		return;
+	}
+
+	schedule_thread();
+
+	next = scheduler_running_thread();
+
+	switch_context(&prev->context, next->context);
+
+	scheduler_preempt_enable();
+}
+
+BOOL thread_edf_stats(tid_t tid, edf_stats_t *stats)
+{
+	thread_t *ptr;
+	BOOL retval = FALSE;
+
+	if (!stats) {
+		return (FALSE);
+	}
+
+	lock();
+
+	ptr = get_thread(tid);
+	if (ptr && ptr->edf_period) {
+		stats->jobs = ptr->edf_jobs;
+		stats->misses = ptr->edf_misses;
+		stats->overruns = ptr->edf_overruns;
+		retval = TRUE;
+	}
+
+	unlock();
+
+	return (retval);
+}
+
+BOOL thread_set_time_slice(diegos_prio_t prio, unsigned msecs)
+{
+	return (scheduler_set_quantum(prio, msecs));
+}
+
+unsigned thread_stats_snapshot(thread_stats_t *stats, unsigned max, uint64_t *cycles)
+{
+	thread_t *ptr;
+	uint64_t now;
+	unsigned count = 0;
+	tid_t i;
+
+	if (!stats || !max) {
+		return (0);
+	}
+
+	lock();
+
+	now = read_cycles();
+
+	for (i = 0; (i < thread_table_size()) && (count < max); i++) {
+		ptr = get_thread(i);
+		if (!ptr) {
+			continue;
+		}
+
+		stats[count].tid = ptr->tid;
+		strncpy(stats[count].name, ptr->name, sizeof(stats[count].name) - 1);
+		stats[count].name[sizeof(stats[count].name) - 1] = 0;
+		stats[count].priority = ptr->priority;
+		stats[count].state = state2str(ptr->state);
+		stats[count].run_cycles = ptr->run_cycles;
+		stats[count].ready_cycles = ptr->ready_cycles;
+		stats[count].voluntary = ptr->voluntary;
+		stats[count].involuntary = ptr->involuntary;
+
+		if (THREAD_RUNNING == ptr->state) {
+			stats[count].run_cycles += now - ptr->run_stamp;
+		} else if (THREAD_READY == ptr->state) {
+			stats[count].ready_cycles += now - ptr->ready_stamp;
+		}
+
+		++count;
+	}
+
+	unlock();
+
+	if (cycles) {
+		*cycles = now;
+	}
+
+	return (count);
+}
+
 /********************************************************
  **************** M U T E X E S *************************
  ********************************************************/
 
 mutex_t *thread_create_mutex(const char *name)
 {
-	mutex_t *tmp = init_mutex(name);
+	return (thread_create_mutex_flags(name, 0));
+}
+
+mutex_t *thread_create_mutex_flags(const char *name, unsigned flags)
+{
+	mutex_t *tmp;
+
+	scheduler_preempt_disable();
+	tmp = init_mutex(name, flags);
+	scheduler_preempt_enable();
 
 	if (!tmp) {
 		kernel_panic("cannot create a mutex.\n");
@@ -343,54 +591,53 @@ int thread_lock_mutex(mutex_t *mtx)
 	return thread_lock_mutex_timed(mtx, 0);
 }
 
-int thread_lock_mutex_timed(mutex_t *mtx, unsigned msecs)
+static int lock_mutex_internal(mutex_t *mtx, unsigned msecs)
 {
 	thread_t *prev, *next;
-	BOOL is_locked;
-
-	if (!mtx) {
-		return (EINVAL);
-	}
+	int retcode;
 
 	prev = scheduler_running_thread();
 
-	is_locked = mutex_is_locked(mtx);
+	retcode = lock_mutex(mtx, msecs);
 
-	if (lock_mutex(prev->tid, mtx) && is_locked) {
-		scheduler_wait_thread(THREAD_FLAG_WAIT_MUTEX, msecs);
+	if (EAGAIN == retcode) {
 		schedule_thread();
 		next = scheduler_running_thread();
 		switch_context(&prev->context, next->context);
-		if (msecs) {
-			return (mutex_is_locked_by_me(mtx)) ? (EOK) : (ETIMEDOUT);
-		}
-		return (EOK);
+		retcode = (lock_mutex_wait_done(mtx)) ? (EOK) : (ETIMEDOUT);
 	}
 
-	return (EBUSY);
+	return (retcode);
 }
 
-int thread_unlock_mutex(mutex_t *mtx)
+int thread_lock_mutex_timed(mutex_t *mtx, unsigned msecs)
 {
-	uint8_t ptid;
-	thread_t *prev;
+	int retcode;
 
 	if (!mtx) {
 		return (EINVAL);
 	}
 
-	if (unlock_mutex(my_thread_id(), mtx)) {
-		ptid = mtx->locker_tid;
-		prev = get_thread(ptid);
+	scheduler_preempt_disable();
+	retcode = lock_mutex_internal(mtx, msecs);
+	scheduler_preempt_enable();
 
-		if (prev) {
-			scheduler_resume_thread(THREAD_FLAG_WAIT_MUTEX, ptid);
-		}
+	return (retcode);
+}
 
-		return (EOK);
+int thread_unlock_mutex(mutex_t *mtx)
+{
+	int retcode;
+
+	if (!mtx) {
+		return (EINVAL);
 	}
 
-	return (EPERM);
+	scheduler_preempt_disable();
+	retcode = (unlock_mutex(my_thread_id(), mtx)) ? (EOK) : (EPERM);
+	scheduler_preempt_enable();
+
+	return (retcode);
 }
 
 BOOL thread_mutex_is_locked(mutex_t *mtx)
@@ -400,6 +647,8 @@ BOOL thread_mutex_is_locked(mutex_t *mtx)
 
 int thread_destroy_mutex(mutex_t *mtx)
 {
+	BOOL is_done;
+
 	if (!mtx) {
 		return (EINVAL);
 	}
@@ -408,7 +657,11 @@ int thread_destroy_mutex(mutex_t *mtx)
 		return (EBUSY);
 	}
 
-	if (!done_mutex(mtx)) {
+	scheduler_preempt_disable();
+	is_done = done_mutex(mtx);
+	scheduler_preempt_enable();
+
+	if (!is_done) {
 		kerrprintf("Cannot destroy Mutex %s\n", ((struct mutex *)mtx)->name);
 		return (EINVAL);
 	}
@@ -20,31 +20,50 @@
 #include <stdio.h>
 #include <diegos/kernel_dump.h>
 #include <diegos/barriers.h>
+#include <diegos/semaphores.h>
+#include <diegos/condvars.h>
+#include <diegos/rwlocks.h>
+#include <diegos/softirqs.h>
+#include <diegos/hrtimers.h>
+#include <diegos/tasks.h>
+#include <diegos/timers.h>
+#include <diegos/alarms.h>
 #include <diegos/net_interfaces.h>
+#include <libs/slab.h>
 
 #include "threads.h"
 #include "scheduler.h"
 #include "mutex_private.h"
+#include "timer_queue.h"
 #include "platform_include.h"
 
 extern long _text_start, _text_end, _data_start, _data_end, _bss_start, _bss_end;
 
+extern void diegos_malloc_stats(unsigned long bytes[2]);
+extern void diegos_malloc_frag(unsigned long frag[3]);
+extern void diegos_iomalloc_stats(unsigned long bytes[2]);
+extern void diegos_iomalloc_frag(unsigned long frag[3]);
+extern unsigned diegos_iomalloc_histogram(unsigned long *blocks, unsigned len);
+extern void diegos_heap_profile_dump(void);
+
 void threads_dump()
 {
 	uint32_t i;
 	thread_t *ptr;
 
-	printf("\n--- THREADS TABLE ----------------------------------------------\n\n");
-	printf("%-15s   %3s   %6s   %s\n", "THREAD NAME", "TID", "STACK", "STATE");
-	printf("______________________________________________\n");
-	for (i = 0; i < DIEGOS_MAX_THREADS; i++) {
+	printf("\n--- THREADS TABLE -------------------------------------------------------\n\n");
+	printf("%-15s   %3s   %6s   %6s   %-8s   %s\n", "THREAD NAME", "TID", "STACK", "USED",
+	       "STATE", "PREEMPTED");
+	printf("_______________________________________________________________________\n");
+	for (i = 0; i < thread_table_size(); i++) {
 		ptr = get_thread(i);
 		if (ptr) {
-			printf("%-15s | %3u | %6u | %s\n",
-			       ptr->name, ptr->tid, ptr->stack_size, state2str(ptr->state));
+			printf("%-15s | %3u | %6u | %6u | %-8s | %u\n",
+			       ptr->name, ptr->tid, ptr->stack_size, thread_stack_used(ptr),
+			       state2str(ptr->state), ptr->involuntary);
 		}
 	}
-	printf("-----------------------------------------------------------------\n\n");
+	printf("--------------------------------------------------------------------------\n\n");
 }
 
 void mutexes_dump()
@@ -57,6 +76,79 @@ void barriers_dump()
 	barrier_dump(NULL);
 }
 
+void semaphores_dump()
+{
+	semaphore_dump(NULL);
+}
+
+void condvars_dump()
+{
+	condvar_dump(NULL);
+}
+
+void rwlocks_dump()
+{
+	rwlock_dump(NULL);
+}
+
+void softirqs_dump()
+{
+	softirq_dump(NULL);
+}
+
+void hrtimers_dump()
+{
+	hrtimer_dump(NULL);
+}
+
+void tasks_dump()
+{
+	task_runner_dump(NULL);
+}
+
+void slabs_dump()
+{
+	slab_cache_dump(NULL);
+}
+
+void deadlines_dump()
+{
+	timers_dump(NULL);
+	alarm_dump(NULL);
+	tq_dump();
+}
+
+void heap_dump()
+{
+	unsigned long bytes[2], frag[3], blocks[16];
+	unsigned i, len;
+
+	printf("\n--- HEAP TABLE --------------------------------------------------------\n\n");
+	printf("%-6s   %10s   %10s   %11s   %13s   %5s\n", "HEAP", "FREE", "ALLOCATED",
+	       "FREE BLOCKS", "LARGEST BLOCK", "FRAG%");
+	printf("_______________________________________________________________________\n");
+	diegos_malloc_stats(bytes);
+	diegos_malloc_frag(frag);
+	printf("%-6s | %10lu | %10lu | %11lu | %13lu | %5lu\n", "heap", bytes[0], bytes[1],
+	       frag[0], frag[1], frag[2]);
+	diegos_iomalloc_stats(bytes);
+	diegos_iomalloc_frag(frag);
+	printf("%-6s | %10lu | %10lu | %11lu | %13lu | %5lu\n", "I/O", bytes[0], bytes[1],
+	       frag[0], frag[1], frag[2]);
+	printf("-----------------------------------------------------------------------\n\n");
+
+	len = diegos_iomalloc_histogram(blocks, sizeof(blocks) / sizeof(blocks[0]));
+	printf("I/O free blocks:");
+	for (i = 0; i < len; i++) {
+		if (blocks[i]) {
+			printf(" %lux%lu", blocks[i], 64UL << i);
+		}
+	}
+	printf("\n");
+
+	diegos_heap_profile_dump();
+}
+
 void threads_check()
 {
 	check_thread_stack();
@@ -18,38 +18,88 @@
  */
 
 #include <libs/iomalloc.h>
+#include <libs/list.h>
+#include <libs/bitmaps.h>
 #include <types_common.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <diegos/kernel.h>
 
 /*
- * 8 bytes for 32-bit platforms
- * 12/16 bytes for 64-bit platforms
+ * Binary buddy allocator.
+ * I/O memory is split in blocks whose size is a power of two, a block of
+ * 2^k bytes starts at an offset multiple of 2^k from the beginning of I/O
+ * memory and its buddy is the block at offset ^ 2^k.
+ * Allocations are rounded up to a block, the block is split in halves
+ * down to the requested order; on release a block is merged with its buddy
+ * as long as the buddy is free too.
+ * Free blocks are linked in a list per order, a bitmap tells which lists
+ * are not empty.
+ * Block boundaries are tracked by a tag per minimum block, kept in the
+ * heap: the I/O memory is not touched but to link the free blocks.
  */
 
-struct mempart {
-	uintptr_t pointer;
-	size_t size;
-};
+/*
+ * Smallest block, a cache line
+ */
+#define MIN_ORDER	(6)
+#define MIN_BLOCK	(1UL << MIN_ORDER)
+
+#define ORDERS		(sizeof(long) * 8 - 1)
+
+/*
+ * Blocks are at least aligned to a page, provided the start of I/O memory is
+ */
+#define PAGE_SIZE	(4096UL)
 
 /*
- * I/O locations
+ * Tag of the first minimum block of a block: the order of the block and
+ * whether it is free. Tags of the other minimum blocks are 0.
  */
-static struct mempart storage[MAX_IO_ALLOCS];
+#define TAG_FREE	(0x80)
+#define TAG_ORDER(t)	((t) & ~TAG_FREE)
+
+/*
+ * I/O memory is shared by all threads, it must not be
+ * modified by two threads at once.
+ */
+#if defined(ENABLE_PREEMPTION) || defined(ENABLE_SMP)
+#define IOMEM_LOCK()	thread_preempt_disable()
+#define IOMEM_UNLOCK()	thread_preempt_enable()
+#else
+#define IOMEM_LOCK()
+#define IOMEM_UNLOCK()
+#endif
+
 /*
- * number of locations in use
+ * Free blocks of each order
  */
-static unsigned stored = 0;
+static list_inst free_lists[ORDERS];
+
+/*
+ * Orders with at least a free block
+ */
+static long free_orders[BITMAPLEN(ORDERS)];
+
+/*
+ * One tag per minimum block
+ */
+static uint8_t *tags = NULL;
+
 /*
  * Beginning of I/O memory
  */
 static uintptr_t start_of_memory = 0;
 /*
- * End of I/O memory
+ * Bytes managed by the allocator, a multiple of MIN_BLOCK
  */
-static uintptr_t end_of_memory = 0;
+static unsigned long memory_size = 0;
+/*
+ * Largest alignment the blocks can have
+ */
+static unsigned long max_aln = 0;
 
 /*
  * Yes this should definitively be some typecasted variable,
@@ -59,160 +109,131 @@ static uintptr_t end_of_memory = 0;
 static unsigned long freebytes = 0;
 static unsigned long allocbytes = 0;
 
-/*
- * Sorting routine
- */
-static int compare(const void *a, const void *b)
+static inline unsigned order_of(unsigned long size)
+{
+	unsigned order = MIN_ORDER;
+
+	while ((1UL << order) < size) {
+		++order;
+	}
+
+	return (order);
+}
+
+static void push_free(uintptr_t offset, unsigned order)
+{
+	tags[offset >> MIN_ORDER] = order | TAG_FREE;
+	list_prepend(&free_lists[order], (list_node *) (start_of_memory + offset));
+	bitmap_set(free_orders, order);
+}
+
+static void pop_free(uintptr_t offset, unsigned order)
 {
-	struct mempart *aa = (struct mempart *)a;
-	struct mempart *bb = (struct mempart *)b;
-
-	if (aa->pointer > bb->pointer)
-		return 1;
-	if (aa->pointer < bb->pointer)
-		return -1;
-	return 0;
+	tags[offset >> MIN_ORDER] = 0;
+	list_remove(&free_lists[order], (list_node *) (start_of_memory + offset));
+	if (!list_count(&free_lists[order])) {
+		bitmap_clear(free_orders, order);
+	}
 }
 
 /*
  * This should not be called by platform specific code,
  * to avoid cross functional issues.
+ * The heap must be initialized already.
  */
 STATUS iomalloc_init(const void *start, const void *end)
 {
+	uintptr_t offset;
+	unsigned order;
+
 	if (start > end)
 		return (EINVAL);
 
-	if ((uintptr_t) (start) & (sizeof(long) - 1))
+	start_of_memory = ALN((uintptr_t) start, PAGE_SIZE);
+	if (start_of_memory >= (uintptr_t) end)
 		return (EINVAL);
 
-	if ((uintptr_t) (end) & (sizeof(long) - 1))
-		return (EINVAL);
+	memory_size = ((uintptr_t) end - start_of_memory) & ~(MIN_BLOCK - 1);
+	max_aln = start_of_memory & -start_of_memory;
 
-	start_of_memory = (uintptr_t) start;
-	end_of_memory = (uintptr_t) end;
-	allocbytes = 0;
-	freebytes = end_of_memory - start_of_memory;
-	memset(storage, 0, sizeof(storage));
+	tags = calloc(memory_size >> MIN_ORDER, sizeof(uint8_t));
+	if (!tags)
+		return (ENOMEM);
 
-	return (EOK);
-}
-
-static void *simple_alloc(struct mempart *location, uintptr_t cursor, size_t aln, size_t newsize)
-{
-	uintptr_t temp;
+	for (order = 0; order < ORDERS; order++) {
+		list_init(&free_lists[order]);
+	}
+	memset(free_orders, 0, sizeof(free_orders));
 
-	temp = location->pointer = MULT(cursor, aln);
-	location->size = newsize;
 	/*
-	 * This check is meaningful only when the first free storage slot
-	 * is in use, but limiting the check would probably make things more
-	 * complicated than they are.
-	 * So we always check if we are overrunning the buffer, actually this
-	 * can happen only when not allocating memory in a carved hole, but
-	 * we do not care.
+	 * Carve the largest blocks fitting the memory, each one aligned
+	 * to its size
 	 */
-	if (location->pointer + location->size > end_of_memory) {
-		temp = location->pointer = location->size = 0;
-	} else {
-		allocbytes += newsize;
-		freebytes -= newsize;
-		++stored;
+	for (offset = 0; offset < memory_size; offset += 1UL << order) {
+		for (order = MIN_ORDER; order < ORDERS - 1; order++) {
+			if ((offset & (1UL << order)) ||
+			    (offset + (1UL << (order + 1)) > memory_size)) {
+				break;
+			}
+		}
+		push_free(offset, order);
 	}
 
-	return (void *)(temp);
+	allocbytes = 0;
+	freebytes = memory_size;
+
+	return (EOK);
 }
 
-static void *iomalloc_internal(size_t newsize, size_t aln)
+static void *iomalloc_internal(unsigned order)
 {
-	/*
-	 * First allocation ? suspicious warning with O1 but not O2...
-	 */
-	uintptr_t cursor = storage->pointer;
-	struct mempart *this = storage;
-	struct mempart *dst = storage + stored;
-	struct mempart *src = dst - 1;
+	uintptr_t offset;
+	unsigned cur;
 
-	if (stored == MAX_IO_ALLOCS)
+	cur = bitmap_find_next_set(free_orders, ORDERS, order);
+	if (cur >= ORDERS)
 		return (NULL);
 
-	if (stored == 0)
-		return simple_alloc(this, start_of_memory, aln, newsize);
+	offset = (uintptr_t) list_head(&free_lists[cur]) - start_of_memory;
+	pop_free(offset, cur);
 
 	/*
-	 * Loop locations in use, there might be a hole
-	 * to be filled.
-	 * If no hole is found, 'this' will point to the first unused storage slot,
-	 * and its content will be zeroed (i.e. pointer == 0).
-	 * This condition is detected at the end of the loop.
-	 * The value assigned to cursor is the first available location in memory, i. e.
-	 * the memory starting at the end of the last allocated block of memory.
-	 * NOTE: The code below is guaranteed to have at least one item in storage,
-	 * and at least one item free.
+	 * Split down to the requested order, the upper halves are free
 	 */
-	while (this->pointer) {
-		/*
-		 * Do we have a memory hole?
-		 */
-		if (this->pointer + this->size < (this + 1)->pointer) {
-			/*
-			 * Is it big enough?
-			 */
-			cursor = MULT(this->pointer + this->size, aln);
-			if (cursor + newsize < (this + 1)->pointer) {
-				/*
-				 * Keep in mind that this code will not be invoked if
-				 * 'stored' equals MAX_IO_ALLOCS; so 'stored' points to the
-				 * first free item in storage.
-				 * All slots following 'this' are moved one step down to the end
-				 * of the storage.
-				 * 'this' is now a hole to be used by simple_malloc, i.e. to be overwritten.
-				 * NOTE: carving a hole keeps the set ordered!
-				 */
-
-				while (dst != this)
-					*dst-- = *src--;
-
-				/*
-				 * Break! We carved a hole.
-				 */
-
-				break;
-			}
-		}
-		++this;
+	while (cur > order) {
+		--cur;
+		push_free(offset + (1UL << cur), cur);
 	}
 
-	/*
-	 * This is guaranteed to point to a valid storage item, unused items
-	 * are zeroed.
-	 */
-	if (this->pointer == 0) {
-		cursor = MULT((this - 1)->pointer + (this - 1)->size, aln);
-	}
+	tags[offset >> MIN_ORDER] = order;
+	allocbytes += 1UL << order;
+	freebytes -= 1UL << order;
 
-	return simple_alloc(this, cursor, aln, newsize);
+	return ((void *)(start_of_memory + offset));
 }
 
 void *iomalloc(size_t size, size_t aln)
 {
-	size_t newsize;
-	void *retval;
+	unsigned order;
+	void *retval = NULL;
 
 	if (!size)
 		return (NULL);
 
 	/*
-	 * Make aln a nice multiple of.
+	 * A block is aligned to its size, as long as the start of
+	 * I/O memory is aligned at least as much.
 	 */
-	if (!aln)
-		aln = sizeof(long);
-
-	/*
-	 * Make newsize be a multiple of long
-	 * */
-	newsize = ALN(size, sizeof(long));
-	retval = iomalloc_internal(newsize, aln);
+	order = order_of(size);
+	if (aln > (1UL << order))
+		order = order_of(aln);
+
+	if ((order < ORDERS) && ((1UL << order) <= memory_size) &&
+	    (!aln || (aln <= max_aln))) {
+		IOMEM_LOCK();
+		retval = iomalloc_internal(order);
+		IOMEM_UNLOCK();
+	}
 
 	/*
 	 * Nope, we cannot accomodate this request...
@@ -223,43 +244,111 @@ void *iomalloc(size_t size, size_t aln)
 	return (retval);
 }
 
-/*
- * NOTE: deletion keeps the set ordered!
- */
 void iofree(void *ptr)
 {
-	struct mempart key = {
-		.pointer = (uintptr_t) ptr,
-		.size = 0
-	};
-	struct mempart *retval = NULL;
+	uintptr_t offset, buddy;
+	unsigned order;
 
-	if (!ptr)
+	if (!ptr || ((uintptr_t) ptr < start_of_memory))
 		return;
 
-	retval = bsearch(&key, storage, stored, sizeof(storage[0]), compare);
+	offset = (uintptr_t) ptr - start_of_memory;
 
 	//FIXME should assert ?
-	if (!retval)
+	if ((offset >= memory_size) || (offset & (MIN_BLOCK - 1)))
 		return;
 
-	freebytes += retval->size;
-	allocbytes -= retval->size;
+	IOMEM_LOCK();
+
+	order = tags[offset >> MIN_ORDER];
 
-	while (retval < storage + stored - 1) {
-		*retval = *(retval + 1);
-		++retval;
+	/*
+	 * Not the start of a block in use
+	 */
+	if (!order || (order & TAG_FREE)) {
+		IOMEM_UNLOCK();
+		return;
+	}
+
+	allocbytes -= 1UL << order;
+	freebytes += 1UL << order;
+
+	/*
+	 * Merge with the buddy as long as it is free
+	 */
+	while (order < ORDERS - 1) {
+		buddy = offset ^ (1UL << order);
+		if ((buddy + (1UL << order) > memory_size) ||
+		    (tags[buddy >> MIN_ORDER] != (order | TAG_FREE))) {
+			break;
+		}
+		pop_free(buddy, order);
+		offset &= ~(1UL << order);
+		++order;
 	}
 
-	retval->pointer = retval->size = 0;
-	stored--;
+	tags[((uintptr_t) ptr - start_of_memory) >> MIN_ORDER] = 0;
+	push_free(offset, order);
+
+	IOMEM_UNLOCK();
 }
 
 /*
- * This is a custom call for DiegOS
+ * This is a custom call for DiegOS:
+ * bytes[0] free bytes, bytes[1] allocated bytes, allocations are
+ * rounded up to a power of two
  */
 void diegos_iomalloc_stats(unsigned long bytes[2])
 {
 	bytes[0] = freebytes;
 	bytes[1] = allocbytes;
 }
+
+/*
+ * This is a custom call for DiegOS, I/O memory fragmentation:
+ * frag[0] number of free blocks
+ * frag[1] largest free block in bytes, the largest allocation that
+ *         can succeed
+ * frag[2] fragmentation in percent, the share of the free bytes
+ *         that is not in the largest free block
+ */
+void diegos_iomalloc_frag(unsigned long frag[3])
+{
+	unsigned long blocks = 0, largest = 0;
+	unsigned order;
+
+	IOMEM_LOCK();
+
+	for (order = MIN_ORDER; order < ORDERS; order++) {
+		blocks += list_count(&free_lists[order]);
+		if (list_count(&free_lists[order])) {
+			largest = 1UL << order;
+		}
+	}
+
+	frag[0] = blocks;
+	frag[1] = largest;
+	frag[2] = (freebytes) ? (((freebytes - largest) * 100UL) / freebytes) : (0);
+
+	IOMEM_UNLOCK();
+}
+
+/*
+ * This is a custom call for DiegOS, free blocks histogram:
+ * blocks[i] is the number of free blocks of (64 << i) bytes.
+ * Returns the number of entries filled, up to len.
+ */
+unsigned diegos_iomalloc_histogram(unsigned long *blocks, unsigned len)
+{
+	unsigned i;
+
+	IOMEM_LOCK();
+
+	for (i = 0; (i < len) && (MIN_ORDER + i < ORDERS); i++) {
+		blocks[i] = list_count(&free_lists[MIN_ORDER + i]);
+	}
+
+	IOMEM_UNLOCK();
+
+	return (i);
+}
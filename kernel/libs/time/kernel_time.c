@@ -20,6 +20,57 @@
 #include <errno.h>
 #include <libs/kernel_time.h>
 
+int kernel_time_calc_mult_shift(uint32_t from_hz, uint32_t to_hz, uint32_t *mult,
+				uint32_t *shift)
+{
+	uint64_t tmp, best = 0;
+	uint32_t sft, best_sft = 0;
+
+	if (!from_hz || !to_hz || !mult || !shift)
+		return EINVAL;
+
+	/*
+	 * to_hz << sft must fit in 64 bits
+	 */
+	for (sft = 0; (sft < 64) && !(((uint64_t)to_hz << sft) >> 63); sft++) {
+		/* rounded to the nearest, the error is not biased */
+		tmp = (((uint64_t)to_hz << sft) + from_hz / 2) / from_hz;
+		if (tmp > UINT32_MAX)
+			break;
+		best = tmp;
+		best_sft = sft;
+	}
+
+	if (!best)
+		return EINVAL;
+
+	*mult = (uint32_t)best;
+	*shift = best_sft;
+
+	return (EOK);
+}
+
+uint64_t kernel_time_mul_shift(uint64_t value, uint32_t mult, uint32_t shift)
+{
+	uint64_t lo = (uint64_t)(uint32_t)value * mult;
+	uint64_t hi = (value >> 32) * mult;
+	uint64_t mid, upper;
+
+	/*
+	 * 96 bit product: upper holds bits 32 to 95, lo bits 0 to 31
+	 */
+	mid = (lo >> 32) + (uint32_t)hi;
+	upper = ((hi >> 32) + (mid >> 32)) << 32 | (uint32_t)mid;
+
+	if (shift >= 32)
+		return (upper >> (shift - 32));
+
+	if (!shift)
+		return ((upper << 32) | (uint32_t)lo);
+
+	return ((upper << (32 - shift)) | ((uint32_t)lo >> shift));
+}
+
 int kernel_time_init(uint32_t base_val, uint32_t min_val, uint32_t max_val, struct time_util *tu)
 {
 	if (!base_val || !min_val || !max_val || !tu)
@@ -28,25 +79,30 @@ int kernel_time_init(uint32_t base_val, uint32_t min_val, uint32_t max_val, stru
 	tu->base_counter = base_val;
 	tu->min_counter = min_val;
 	tu->max_counter = max_val;
-	tu->cntr_ticks_per_msecs_int = base_val / 1000UL;
-	tu->cntr_ticks_per_msecs_fract = base_val % 1000UL;
 	tu->elapsed_counter = 0;
 
+	if (EOK != kernel_time_calc_mult_shift(base_val, 1000UL, &tu->msecs_mult,
+					       &tu->msecs_shift))
+		return EINVAL;
+
+	if (EOK != kernel_time_calc_mult_shift(1000UL, base_val, &tu->counter_mult,
+					       &tu->counter_shift))
+		return EINVAL;
+
 	return (EOK);
 }
 
 uint32_t kernel_time_get_msecs(uint32_t cntrticks, const struct time_util *tu)
 {
-	uint32_t retval = 0;
-	uint32_t fract = 0;
+	uint64_t retval;
 
 	cntrticks = kernel_time_adjust_range(cntrticks, tu);
-	retval = cntrticks / tu->cntr_ticks_per_msecs_int;
-	fract = cntrticks % tu->cntr_ticks_per_msecs_int;
+	retval = (uint64_t)cntrticks * tu->msecs_mult;
 	/* rounding */
-	if (fract >= tu->cntr_ticks_per_msecs_int / 2)
-		retval++;
-	return (retval);
+	if (tu->msecs_shift)
+		retval += 1ULL << (tu->msecs_shift - 1);
+
+	return ((uint32_t)(retval >> tu->msecs_shift));
 }
 
 uint64_t kernel_time_get_elapsed_msecs(const struct time_util *tu)
@@ -54,20 +110,8 @@ uint64_t kernel_time_get_elapsed_msecs(const struct time_util *tu)
 	uint64_t retval = 0ULL;
 
 	if (tu) {
-		/*
-		 * Split computation: compute integer seconds
-		 */
-		retval = tu->elapsed_counter / (uint64_t) tu->base_counter;
-		/*
-		 * Transform into milliseconds
-		 */
-		retval *= 1000ULL;
-		/*
-		 * Add remainder in milliseconds
-		 */
-		retval +=
-		    1000ULL * (tu->elapsed_counter % (uint64_t) tu->base_counter) /
-		    (uint64_t) tu->base_counter;
+		retval = kernel_time_mul_shift(tu->elapsed_counter, tu->msecs_mult,
+					       tu->msecs_shift);
 	}
 
 	return (retval);
@@ -75,15 +119,18 @@ uint64_t kernel_time_get_elapsed_msecs(const struct time_util *tu)
 
 uint32_t kernel_time_get_value(uint32_t msecs, const struct time_util *tu)
 {
+	uint64_t retval;
+
 	if (!msecs || !tu)
 		return 0;
 
-	uint64_t retval = msecs * tu->cntr_ticks_per_msecs_int;
-	uint64_t fract = msecs * tu->cntr_ticks_per_msecs_fract;
-	/* rounding fract */
-	fract += 500ULL;
-	fract /= 1000ULL;
-	retval += fract;
+	retval = (uint64_t)msecs * tu->counter_mult;
+	/* rounding */
+	if (tu->counter_shift)
+		retval += 1ULL << (tu->counter_shift - 1);
+	retval >>= tu->counter_shift;
+	if (retval > UINT32_MAX)
+		retval = UINT32_MAX;
 
 	return (kernel_time_adjust_range((uint32_t)retval, tu));
 }
@@ -93,8 +140,8 @@ int kernel_time_get_minmax_msecs(uint32_t msecs[], const struct time_util *tu)
 	if (!msecs || !tu)
 		return EINVAL;
 
-	msecs[0] = 1000ULL * tu->min_counter / tu->base_counter;
-	msecs[1] = 1000ULL * tu->max_counter / tu->base_counter;
+	msecs[0] = ((uint64_t)tu->min_counter * tu->msecs_mult) >> tu->msecs_shift;
+	msecs[1] = ((uint64_t)tu->max_counter * tu->msecs_mult) >> tu->msecs_shift;
 
 	return (EOK);
 }
@@ -19,17 +19,31 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <libs/list.h>
+#include <libs/slab.h>
+#include <diegos/interrupts.h>
+#include <diegos/mutexes.h>
 
 #include "threads.h"
 #include "scheduler.h"
 #include "mutex_private.h"
 #include "kprintf.h"
 
+#define HELD_TO_MUTEX(ptr)	\
+	((struct mutex *)((char *)(ptr) - offsetof(struct mutex, held)))
+
 static list_inst mutexes_list;
 
+static slab_cache_t *mutexes_cache = NULL;
+
+static void mutex_ctor(void *obj)
+{
+	list_init(&((struct mutex *)obj)->waiters);
+}
+
 BOOL init_mutex_lib()
 {
 	if (EOK != list_init(&mutexes_list)) {
@@ -37,14 +51,22 @@ BOOL init_mutex_lib()
 		return (FALSE);
 	}
 
+	mutexes_cache = slab_cache_create("mutexes", sizeof(struct mutex), 0, 0, mutex_ctor, NULL);
+	if (!mutexes_cache) {
+		kerrprintf("failed creating mutexes cache.\n");
+		return (FALSE);
+	}
+
 	return (TRUE);
 }
 
-struct mutex *init_mutex(const char *name)
+struct mutex *init_mutex(const char *name, unsigned flags)
 {
 	struct mutex *tmp;
 
-	tmp = malloc(sizeof(*tmp));
+	lock();
+	tmp = slab_alloc(mutexes_cache);
+	unlock();
 
 	if (!tmp) {
 		return (NULL);
@@ -56,12 +78,12 @@ struct mutex *init_mutex(const char *name)
 		snprintf(tmp->name, sizeof(tmp->name), "Mutex%x", (intptr_t) tmp);
 	}
 	tmp->locker_tid = THREAD_TID_INVALID;
-
-	cbuffer_init(&tmp->thread_ids, DIEGOS_MAX_THREADS);
-	memset(tmp->ids_buffer, THREAD_TID_INVALID, sizeof(tmp->ids_buffer));
+	tmp->flags = flags & MUTEX_PRIO_INHERIT;
 
 	if (EOK != list_prepend(&mutexes_list, &tmp->header)) {
-		free(tmp);
+		lock();
+		slab_free(mutexes_cache, tmp);
+		unlock();
 		return (NULL);
 	}
 
@@ -78,7 +100,7 @@ BOOL done_mutex(struct mutex *mtx)
 		return (FALSE);
 	}
 
-	if (!cbuffer_is_empty(&mtx->thread_ids)) {
+	if (list_count(&mtx->waiters)) {
 		return (FALSE);
 	}
 
@@ -86,80 +108,270 @@ BOOL done_mutex(struct mutex *mtx)
 		return (FALSE);
 	}
 
-	memset(mtx, 0, sizeof(*mtx));
-	free(mtx);
+	lock();
+	slab_free(mutexes_cache, mtx);
+	unlock();
 
 	return (TRUE);
 }
 
-BOOL lock_mutex(uint8_t tid, struct mutex *mtx)
+/*
+ * The most urgent waiter, waiters are sorted by priority
+ */
+static inline thread_t *top_waiter(struct mutex *mtx)
 {
-	thread_t *ptr;
+	list_node *node = list_head(&mtx->waiters);
 
-	if (!mtx) {
-		return (FALSE);
+	return ((node) ? (WAIT_NODE_TO_THREAD(node)) : (NULL));
+}
+
+/*
+ * Hand mtx over to a new owner, NULL to release it, moving it between
+ * the held_mutexes lists of the owners.
+ * Interrupts must be disabled.
+ */
+static void set_owner(struct mutex *mtx, thread_t *owner)
+{
+	thread_t *prev = get_thread(mtx->locker_tid);
+
+	if (prev) {
+		list_remove(&prev->held_mutexes, &mtx->held);
 	}
 
-	ptr = get_thread(tid);
+	if (owner) {
+		mtx->locker_tid = owner->tid;
+		list_append(&owner->held_mutexes, &mtx->held);
+	} else {
+		mtx->locker_tid = THREAD_TID_INVALID;
+	}
+}
 
-	if (!ptr) {
-		return (FALSE);
+/*
+ * Raise the owner of mtx to prio, then the owner of the mutex it is
+ * blocked on and so on along the chain.
+ * The walk stops at a plain mutex or at an owner already running at prio
+ * or above; it is bounded by the number of threads, so a deadlock cycle
+ * cannot loop forever.
+ * Interrupts must be disabled.
+ */
+static void prio_propagate(struct mutex *mtx, uint8_t prio)
+{
+	thread_t *owner;
+	unsigned depth = 0;
+
+	while (mtx && (mtx->flags & MUTEX_PRIO_INHERIT) && (depth++ < thread_count())) {
+		owner = get_thread(mtx->locker_tid);
+
+		if (!owner || (owner->priority <= prio)) {
+			break;
+		}
+
+		scheduler_set_priority(owner, prio);
+		mtx = owner->blocked_on;
 	}
+}
 
-	if (tid == mtx->locker_tid) {
-		return (FALSE);
+/*
+ * Restore the priority of a thread to the highest among its base priority
+ * and the top waiters of the priority inheritance mutexes it still holds.
+ * Threads never boosted are skipped at no cost.
+ * Interrupts must be disabled.
+ */
+static void prio_restore(thread_t *ptr)
+{
+	list_node *node;
+	struct mutex *curr;
+	thread_t *top;
+	uint8_t prio = ptr->base_priority;
+
+	if (ptr->priority == prio) {
+		return;
+	}
+
+	node = list_head(&ptr->held_mutexes);
+
+	while (node) {
+		curr = HELD_TO_MUTEX(node);
+		if (curr->flags & MUTEX_PRIO_INHERIT) {
+			top = top_waiter(curr);
+			if (top && (top->priority < prio)) {
+				prio = top->priority;
+			}
+		}
+		node = node->next;
+	}
+
+	scheduler_set_priority(ptr, prio);
+}
+
+/*
+ * A waiter left mtx: restore the owner, then the owner of the mutex it
+ * is blocked on and so on along the chain, as prio_propagate raised them.
+ * The walk stops at a plain mutex or at an owner whose priority does not
+ * change, as nothing changes further on.
+ * Interrupts must be disabled.
+ */
+static void prio_restore_chain(struct mutex *mtx)
+{
+	thread_t *owner;
+	unsigned depth = 0;
+	uint8_t prio;
+
+	while (mtx && (mtx->flags & MUTEX_PRIO_INHERIT) && (depth++ < thread_count())) {
+		owner = get_thread(mtx->locker_tid);
+
+		if (!owner) {
+			break;
+		}
+
+		prio = owner->priority;
+		prio_restore(owner);
+
+		if (owner->priority == prio) {
+			break;
+		}
+
+		mtx = owner->blocked_on;
+	}
+}
+
+int lock_mutex(struct mutex *mtx, unsigned msecs)
+{
+	thread_t *ptr = scheduler_running_thread();
+
+	if (!mtx || !ptr) {
+		return (EINVAL);
+	}
+
+	lock();
+
+	if (ptr->tid == mtx->locker_tid) {
+		unlock();
+		return (EBUSY);
 	}
 
 	if (THREAD_TID_INVALID == mtx->locker_tid) {
-		mtx->locker_tid = tid;
-		return (TRUE);
+		set_owner(mtx, ptr);
+		unlock();
+		return (EOK);
 	}
 
-	if (cbuffer_free_space(&mtx->thread_ids) == 0) {
-		return (FALSE);
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_MUTEX, msecs, &mtx->waiters)) {
+		unlock();
+		return (EPERM);
 	}
 
-	mtx->ids_buffer[mtx->thread_ids.tail] = tid;
-	cbuffer_add(&mtx->thread_ids);
+	ptr->blocked_on = mtx;
+	prio_propagate(mtx, ptr->priority);
 
-	return (TRUE);
+	unlock();
+
+	return (EAGAIN);
+}
+
+BOOL lock_mutex_wait_done(struct mutex *mtx)
+{
+	thread_t *ptr = scheduler_running_thread();
+	BOOL retval;
+
+	lock();
+
+	ptr->blocked_on = NULL;
+	retval = (ptr->tid == mtx->locker_tid) ? (TRUE) : (FALSE);
+
+	if (!retval) {
+		prio_restore_chain(mtx);
+	}
+
+	unlock();
+
+	return (retval);
 }
 
-BOOL unlock_mutex(uint8_t tid, struct mutex *mtx)
+BOOL unlock_mutex(tid_t tid, struct mutex *mtx)
 {
-	thread_t *ptr;
+	thread_t *ptr, *next;
+	wait_node_t *node;
 
 	if (!mtx) {
 		return (FALSE);
 	}
 
+	lock();
+
 	if ((THREAD_TID_INVALID == mtx->locker_tid) || (tid != mtx->locker_tid)) {
+		unlock();
 		return (FALSE);
 	}
 
-	if (cbuffer_is_empty(&mtx->thread_ids) == FALSE) {
-		/*
-		 * Clean up cancelled threads
-		 */
-		while (mtx->ids_buffer[mtx->thread_ids.head] == THREAD_TID_INVALID) {
-			cbuffer_remove(&mtx->thread_ids);
-			if (cbuffer_is_empty(&mtx->thread_ids)) {
-				break;
-			}
-		}
+	node = list_head(&mtx->waiters);
+	next = (node) ? (node->thread) : (NULL);
+	set_owner(mtx, next);
+
+	/*
+	 * Drop the boost before waking the new owner up,
+	 * so that a preemption is requested if it is more urgent.
+	 */
+	ptr = get_thread(tid);
+	if (ptr) {
+		prio_restore(ptr);
 	}
 
-	if (cbuffer_is_empty(&mtx->thread_ids) == FALSE) {
-		ptr = get_thread(mtx->ids_buffer[mtx->thread_ids.head]);
-		cbuffer_remove(&mtx->thread_ids);
-		mtx->locker_tid = ptr->tid;
-	} else {
-		mtx->locker_tid = THREAD_TID_INVALID;
+	if (next) {
+		next->blocked_on = NULL;
+		scheduler_resume_node(node, THREAD_FLAG_WAIT_MUTEX);
 	}
 
+	unlock();
+
 	return (TRUE);
 }
 
+BOOL mutex_requeue_waiter(struct mutex *mtx, thread_t *ptr)
+{
+	if (THREAD_TID_INVALID == mtx->locker_tid) {
+		set_owner(mtx, ptr);
+		return (TRUE);
+	}
+
+	if (!scheduler_requeue_thread(ptr, THREAD_FLAG_WAIT_MUTEX, &mtx->waiters)) {
+		return (FALSE);
+	}
+
+	ptr->blocked_on = mtx;
+	prio_propagate(mtx, ptr->priority);
+
+	return (FALSE);
+}
+
+int mutex_wait_prepare(struct mutex *mtx, wait_node_t *node)
+{
+	thread_t *ptr = scheduler_running_thread();
+
+	if (ptr->tid == mtx->locker_tid) {
+		return (EBUSY);
+	}
+
+	if (THREAD_TID_INVALID == mtx->locker_tid) {
+		set_owner(mtx, ptr);
+		return (EOK);
+	}
+
+	node->list = &mtx->waiters;
+
+	return (EAGAIN);
+}
+
+void mutex_boost_owner(struct mutex *mtx, uint8_t prio)
+{
+	prio_propagate(mtx, prio);
+}
+
+void mutex_restore_owner(struct mutex *mtx)
+{
+	prio_restore_chain(mtx);
+}
+
 BOOL mutex_is_locked(struct mutex *mtx)
 {
 	return ((mtx && (THREAD_TID_INVALID != mtx->locker_tid))
@@ -172,33 +384,51 @@ BOOL mutex_is_locked_by_me(struct mutex *mtx)
 		? (TRUE) : (FALSE));
 }
 
-int cancel_wait_on_mutex(uint8_t tid)
+int cancel_wait_on_mutex(tid_t tid)
 {
-	unsigned i;
-	struct mutex *curr = list_head(&mutexes_list);
+	thread_t *ptr = get_thread(tid);
+	struct mutex *curr;
 
-	while (curr) {
-		if (curr->locker_tid == tid) {
-			return (unlock_mutex(tid, curr)) ? (EOK) : (EPERM);
-		} else if (!cbuffer_is_empty(&curr->thread_ids)) {
-			for (i = curr->thread_ids.head;
-			     i != curr->thread_ids.tail; i = (i + 1) % curr->thread_ids.bufsize) {
-				if (curr->ids_buffer[i] == tid) {
-					curr->ids_buffer[i] = THREAD_TID_INVALID;
-					return (EOK);
-				}
-			}
+	if (!ptr) {
+		return (EINVAL);
+	}
+
+	while (list_count(&ptr->held_mutexes)) {
+		curr = HELD_TO_MUTEX(list_head(&ptr->held_mutexes));
+		if (!unlock_mutex(tid, curr)) {
+			break;
 		}
-		curr = (struct mutex *)curr->header.next;
 	}
 
-	return (EINVAL);
+	curr = ptr->blocked_on;
+	if (curr) {
+		if (ptr->wait_node.list == &curr->waiters) {
+			list_remove(&curr->waiters, &ptr->wait_node.header);
+			ptr->wait_node.list = NULL;
+		}
+		ptr->blocked_on = NULL;
+
+		prio_restore_chain(curr);
+	}
+
+	return (EOK);
 }
 
 static void dump_internal(struct mutex *mtx)
 {
-	printf("%-15s | %11u | %8s | %s\n",
-	       mtx->name, mtx->locker_tid, mutex_is_locked(mtx) ? "LOCKED" : "UNLOCKED", "N/A");
+	list_node *node;
+
+	printf("%-15s | %11u | %8s | %2s |", mtx->name, mtx->locker_tid,
+	       mutex_is_locked(mtx) ? "LOCKED" : "UNLOCKED",
+	       (mtx->flags & MUTEX_PRIO_INHERIT) ? "PI" : "");
+
+	node = list_head(&mtx->waiters);
+	while (node) {
+		printf(" %u", WAIT_NODE_TO_THREAD(node)->tid);
+		node = node->next;
+	}
+
+	printf("\n");
 }
 
 void dump_mutex(struct mutex *mtx)
@@ -206,7 +436,7 @@ void dump_mutex(struct mutex *mtx)
 	if (!mtx) {
 		printf("\n--- MUTEXES TABLE ----------------------\n\n");
 	}
-	printf("%-15s   %11s   %8s   %s\n", "MUTEX NAME", "LOCKER TID", "STATE", "WAITING TIDs");
+	printf("%-15s   %11s   %8s   %2s   %s\n", "MUTEX NAME", "LOCKER TID", "STATE", "", "WAITING TIDs");
 	printf("______________________________________________\n");
 	if (mtx) {
 		dump_internal(mtx);
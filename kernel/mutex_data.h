@@ -20,13 +20,21 @@
 #ifndef MUTEX_DATA_H_INCLUDED
 #define MUTEX_DATA_H_INCLUDED
 
-#include <libs/cbuffers.h>
+#include <diegos/kernel.h>
+#include <libs/list_type.h>
 
 struct mutex {
 	list_node header;
-	struct cbuffer thread_ids;
-	uint8_t ids_buffer[DIEGOS_MAX_THREADS];
-	uint8_t locker_tid;
+	/*
+	 * Waiting threads sorted by priority
+	 */
+	list_inst waiters;
+	/*
+	 * Link in the held_mutexes list of the owner
+	 */
+	list_node held;
+	tid_t locker_tid;
+	uint8_t flags;
 	char name[16];
 };
 
@@ -25,6 +25,7 @@
 #include <libs/list_type.h>
 
 #include "mutex_data.h"
+#include "threads_data.h"
 
 /*
  * Initialize the mutex library.
@@ -42,12 +43,13 @@ BOOL init_mutex_lib(void);
  * PARAMETERS IN
  * const char *name - name of the mutex, optional. If no name is provided,
  *                    a default willb e generated.
+ * unsigned flags   - MUTEX_PRIO_INHERIT or 0.
  *
  * RETURNS
  * TRUE success.
  * FALSE any other case.
  */
-struct mutex *init_mutex(const char *name);
+struct mutex *init_mutex(const char *name, unsigned flags);
 
 /*
  * Terminate a mutex.
@@ -62,28 +64,96 @@ struct mutex *init_mutex(const char *name);
 BOOL done_mutex(struct mutex *mtx);
 
 /*
- * Acquire a lock on a mutex. Once a thread acquired a lock,
- * other threads trying the same will be put in a wait FIFO queue.
- * A thread can call lock_mutex multiple times before releasing the lock;
- * calls other than the first are no-op.
+ * Acquire a lock on a mutex for the running thread. If another thread
+ * holds the lock, the running thread is put in the waiters list of the
+ * mutex, sorted by priority, and marked as WAITING: the caller must
+ * switch it out.
+ * With MUTEX_PRIO_INHERIT the owner, and the owners of the mutexes
+ * it is blocked on in turn, are raised to the waiter priority.
  *
  * PARAMETERS IN
- * uint8_t tid - the TID of the locking thread.
  * struct mutex *mtx - the mutex to be locked.
+ * unsigned msecs    - timeout of the wait in milliseconds, 0 waits forever.
+ *
+ * RETURNS
+ * EOK the lock is acquired.
+ * EAGAIN the running thread waits for the lock.
+ * EBUSY the running thread already holds the lock.
+ * EPERM the running thread cannot wait.
+ */
+int lock_mutex(struct mutex *mtx, unsigned msecs);
+
+/*
+ * Complete a wait started by lock_mutex, after the running thread
+ * has been resumed either by the owner or by the timeout.
+ * If the lock was not granted, the priority of the owner is
+ * computed again without the running thread.
+ *
+ * PARAMETERS IN
+ * struct mutex *mtx - the mutex waited on.
+ *
+ * RETURNS
+ * TRUE the running thread holds the lock.
+ * FALSE the wait timed out.
  */
-BOOL lock_mutex(uint8_t tid, struct mutex *mtx);
+BOOL lock_mutex_wait_done(struct mutex *mtx);
 
 /*
- * Release a lock on a mutex. When a thread releases a lock, the first
- * thread found in the waiting queue is woken up and given a new lock
- * on the mutex.
- * If the waiting queue is empty, the mutex is unlocked.
+ * Release a lock on a mutex. The highest priority waiter, the first one
+ * among waiters of the same priority, is given the lock and woken up.
+ * If there are no waiters, the mutex is unlocked.
+ * The priority of the releasing thread is restored to the highest
+ * among its base priority and the waiters of the mutexes it still holds.
  *
  * PARAMETERS IN
- * uint8_t tid - the TID of the locking thread.
+ * tid_t tid - the TID of the locking thread.
  * struct mutex *mtx - the mutex to be locked.
  */
-BOOL unlock_mutex(uint8_t tid, struct mutex *mtx);
+BOOL unlock_mutex(tid_t tid, struct mutex *mtx);
+
+/*
+ * Hand a thread waiting on another object over to a mutex: the thread
+ * is given the lock if the mutex is free, otherwise it is moved to the
+ * waiters list of the mutex as if it had called lock_mutex.
+ * Used by condition variables, signalled waiters are resumed only once
+ * they hold the mutex.
+ * Interrupts must be disabled.
+ *
+ * PARAMETERS IN
+ * struct mutex *mtx - the mutex
+ * thread_t *ptr     - the waiting thread
+ *
+ * RETURNS
+ * TRUE the thread holds the lock and must be resumed by the caller.
+ * FALSE the thread waits for the lock.
+ */
+BOOL mutex_requeue_waiter(struct mutex *mtx, thread_t *ptr);
+
+/*
+ * Prepare a wait on a mutex as one of multiple objects.
+ * If the mutex is free it is locked by the running thread, otherwise
+ * the list field of node is set to the waiters list to link.
+ * Interrupts must be disabled.
+ *
+ * RETURNS
+ * EOK the mutex is locked by the running thread
+ * EAGAIN the thread must wait
+ * EBUSY the running thread already holds the lock
+ */
+int mutex_wait_prepare(struct mutex *mtx, wait_node_t *node);
+
+/*
+ * Raise the owner of a priority inheritance mutex, and the owners
+ * it is blocked on in turn, to prio.
+ * Interrupts must be disabled.
+ */
+void mutex_boost_owner(struct mutex *mtx, uint8_t prio);
+
+/*
+ * Undo mutex_boost_owner() once the waiter gave up waiting on mtx.
+ * Interrupts must be disabled.
+ */
+void mutex_restore_owner(struct mutex *mtx);
 
 /*
  * Test if a mutex is locked by any thread.
@@ -106,18 +176,19 @@ BOOL mutex_is_locked(struct mutex *mtx);
 BOOL mutex_is_locked_by_me(struct mutex *mtx);
 
 /*
- * Cancel the wait on a mutex for a specific thread.
- * This function is called when a thread is terminated or when it is
- * explicitly cancelled by another thread.
+ * Cancel the wait on a mutex for a specific thread and release
+ * all the mutexes it holds.
+ * This function is called with interrupts disabled when a thread is
+ * terminated or when it is explicitly cancelled by another thread.
  *
  * PARAMETERS IN
- * uint8_t tid - the TID of the thread to be cancelled.
+ * tid_t tid - the TID of the thread to be cancelled.
  *
  * RETURNS
  * 0 if the cancellation was successful.
  * -1 if the cancellation failed.
  */
-int cancel_wait_on_mutex(uint8_t tid);
+int cancel_wait_on_mutex(tid_t tid);
 
 /*
  * Print to stdout either a single mutex structure and state, or the whole
@@ -20,6 +20,8 @@
 #ifndef _PLATFORM_INCLUDE_H_
 #define _PLATFORM_INCLUDE_H_
 
+#include <types_common.h>
+
 /*
  * The following externs *must* be defined for
  * every processor in use. the platform makefile
@@ -59,6 +61,19 @@ extern void switch_context(void **from, const void *to);
  */
 extern void load_context(const void *to);
 
+/*
+ * Free running processor cycle counter, used for CPU accounting.
+ * The counter must be monotonic and must not wrap in the system uptime.
+ */
+extern uint64_t read_cycles(void);
+
+/*
+ * Context preparation: allocate any per thread context memory
+ * (i.e. FP/SIMD save areas) for a new TID.
+ * Returns FALSE if the memory cannot be allocated.
+ */
+extern BOOL prepare_context(unsigned tid);
+
 /*
  * Context cleaning: release or re-init context memory.
  * Interrupts MUST BE DISABLED entering the function, and REENABLED
@@ -115,6 +130,79 @@ extern void enable_interrupts(void);
  */
 extern void power_save(void);
 
+/*
+ * Power save function for a caller holding lock(); the lock is
+ * released and the cpu halted atomically, no interrupt can be
+ * served in between.
+ * Interrupts are enabled on return.
+ */
+extern void power_save_unlock(void);
+
+/*
+ * Disable interrupts returning the previous state, restore it.
+ */
+extern unsigned cpu_irq_save(void);
+
+extern void cpu_irq_restore(unsigned flags);
+
+/*
+ * Spin loop hint, called while busy waiting on a shared variable.
+ */
+extern void cpu_relax(void);
+
+/*
+ * Interrupt handlers run on a per processor interrupt stack, not on the
+ * stack of the interrupted thread.
+ * Returns the high water mark in bytes of the interrupt stack of cpu,
+ * its size is stored in size if not NULL.
+ */
+extern unsigned int_stack_used(unsigned cpu, unsigned *size);
+
+/*
+ * Interrupt nesting level of the running processor, 0 when not serving
+ * an interrupt. Softirqs run at level 1 with interrupts enabled.
+ * Must be called with interrupts disabled.
+ */
+extern unsigned int_nesting_level(void);
+
+#ifdef ENABLE_SMP
+/*
+ * Symmetric multiprocessing.
+ * The kernel runs on all processors serialized by a single recursive
+ * kernel lock: lock() takes it besides disabling interrupts, interrupt
+ * handlers hold it while running and the scheduler holds it while
+ * preemption is disabled.
+ */
+
+/*
+ * Index of the running processor, 0 is the boot processor.
+ * The value is stable only with interrupts disabled or with the
+ * kernel lock held.
+ */
+extern unsigned cpu_id(void);
+
+/*
+ * Take and release the kernel lock, calls nest on the same processor.
+ */
+extern void kernel_lock_acquire(void);
+
+extern void kernel_lock_release(void);
+
+/*
+ * Start the application processors, each one calls entry with
+ * interrupts disabled and the kernel lock not held; entry must not return.
+ * Returns the number of processors online, the boot one included,
+ * never more than max.
+ */
+extern unsigned start_cpus(void (*entry)(void), unsigned max);
+
+/*
+ * Interrupt a processor: it calls scheduler_ipi() and checks for a
+ * pending preemption on exit from the interrupt.
+ */
+extern void cpu_resched(unsigned cpu);
+#endif
+
 /*
  * Loop delay function; this function is a "waste loop" to implement
  * nsleep and/or usleep.
@@ -24,7 +24,6 @@
 #include <errno.h>
 #include <libs/list.h>
 #include <libs/chunks.h>
-#include <libs/bitmaps.h>
 #include <string.h>
 
 #include "scheduler.h"
@@ -62,13 +61,12 @@ typedef struct poll_table {
 	/*
 	 * Thread to be woken up
 	 */
-	uint8_t tid;
+	tid_t tid;
 } poll_table_t;
 
 static chunks_pool_t *poll_items = NULL;
 static chunks_pool_t *poll_tables = NULL;
 static list_inst poll_table_list;
-static long thread_ids[BITMAPLEN(DIEGOS_MAX_THREADS)];
 
 static void cleanup(poll_table_t *table)
 {
@@ -86,7 +84,7 @@ static void cleanup(poll_table_t *table)
 	chunks_pool_free(poll_tables, table);
 }
 
-int poll(struct pollfd ufds[], unsigned nfds, int timeout)
+static int poll_internal(struct pollfd ufds[], unsigned nfds, int timeout)
 {
 	poll_table_t *newtable;
 	unsigned i;
@@ -132,19 +130,30 @@ int poll(struct pollfd ufds[], unsigned nfds, int timeout)
 		}
 	}
 
+	/*
+	 * Devices signal the table from interrupt handlers, check and wait
+	 * with interrupts disabled or a wakeup could be lost.
+	 */
+	lock();
+
 	if (!newtable->signalled && (timeout != 0)) {
 		to = (timeout < 0) ? 0 : timeout;
 		prev = scheduler_running_thread();
 
-		if (!scheduler_wait_thread(THREAD_FLAG_WAIT_COMPLETION, to)) {
-			kerrprintf("TID %u Cannot wait for poll\n", prev);
+		if (!scheduler_wait_thread(THREAD_FLAG_WAIT_COMPLETION, to, NULL)) {
+			unlock();
+			kerrprintf("TID %u Cannot wait for poll\n", prev->tid);
 			cleanup(newtable);
 			return EPERM;
 		}
 
+		unlock();
+
 		schedule_thread();
 		next = scheduler_running_thread();
 		switch_context(&prev->context, next->context);
+	} else {
+		unlock();
 	}
 
 	for (i = 0; i < nfds; i++) {
@@ -169,6 +178,17 @@ int poll(struct pollfd ufds[], unsigned nfds, int timeout)
 	return (retvalue) ? retvalue : ETIMEDOUT;
 }
 
+int poll(struct pollfd ufds[], unsigned nfds, int timeout)
+{
+	int retcode;
+
+	scheduler_preempt_disable();
+	retcode = poll_internal(ufds, nfds, timeout);
+	scheduler_preempt_enable();
+
+	return (retcode);
+}
+
 int poll_network(struct pollfd ufds[], unsigned nfds, int timeout)
 {
 #if 0
@@ -291,6 +311,56 @@ int poll_wait(wait_queue_t *wq, poll_table_t *table)
  * Private section
  */
 
+poll_table_t *poll_table_create()
+{
+	poll_table_t *newtable = chunks_pool_malloc(poll_tables);
+
+	if (!newtable) {
+		return (NULL);
+	}
+
+	if ((EOK != list_prepend(&poll_table_list, &newtable->header)) ||
+	    (EOK != queue_init(&newtable->table))) {
+		chunks_pool_free(poll_tables, newtable);
+		return (NULL);
+	}
+
+	newtable->signalled = 0;
+	newtable->tid = scheduler_running_tid();
+
+	return (newtable);
+}
+
+void poll_table_destroy(poll_table_t *table)
+{
+	if (table) {
+		cleanup(table);
+	}
+}
+
+int poll_table_add(poll_table_t *table, int fd, short revents, short *events)
+{
+	fd_data_t *cursor = fdget(fd);
+
+	if (!cursor) {
+		return (EBADF);
+	}
+
+	if (EOK != device_poll(cursor->rawdev, table, events)) {
+		kerrprintf("Device %s failed polling\n", cursor->rawdev->header.name);
+		return (ENOSYS);
+	}
+
+	*events &= revents;
+
+	return (EOK);
+}
+
+BOOL poll_table_signalled(poll_table_t *table)
+{
+	return ((table->signalled) ? (TRUE) : (FALSE));
+}
+
 BOOL init_poll_lib()
 {
 	if (EOK != list_init(&poll_table_list)) {
@@ -312,8 +382,6 @@ BOOL init_poll_lib()
 		return (FALSE);
 	}
 
-	memset(thread_ids, 0, sizeof(thread_ids));
-
 	return (TRUE);
 }
 
@@ -329,24 +397,13 @@ int poll_wakeup(struct wait_queue_item *wqi)
 	pt = (poll_table_t *) wqi->pt;
 	if (!pt->signalled) {
 		pt->signalled = 1;
-		bitmap_set(thread_ids, pt->tid);
+		/*
+		 * The thread may still be collecting the devices state,
+		 * then it will find the table signalled and won't wait.
+		 */
+		scheduler_resume_thread(THREAD_FLAG_WAIT_COMPLETION, pt->tid);
 	}
 	unlock();
 
 	return EOK;
 }
-
-static void resumecb(long *bitmap, unsigned pos, void *param)
-{
-	if (!scheduler_resume_thread(THREAD_FLAG_WAIT_COMPLETION, (uint8_t) pos)) {
-		kerrprintf("TID %u cannot be resumed from poll\n", pos);
-	}
-	bitmap_clear(bitmap, pos);
-}
-
-void resume_on_poll()
-{
-	lock();
-	bitmap_for_each_set(thread_ids, BITMAPLEN(DIEGOS_MAX_THREADS), resumecb, NULL);
-	unlock();
-}
@@ -20,12 +20,44 @@
 #ifndef _POLL_PRIVATE_H_
 #define _POLL_PRIVATE_H_
 
+#include <diegos/poll.h>
 #include "io_waits_private.h"
 
 BOOL init_poll_lib(void);
 
 int poll_wakeup(struct wait_queue_item *wqi);
 
-void resume_on_poll(void);
+/*
+ * Poll tables for waits on file descriptors mixed with other objects.
+ * A table is created for the running thread, file descriptors are
+ * added to it and it resumes the thread with THREAD_FLAG_WAIT_COMPLETION
+ * once any of them is signalled.
+ */
+poll_table_t *poll_table_create(void);
+
+void poll_table_destroy(poll_table_t * table);
+
+/*
+ * Add a file descriptor to a table and read its events.
+ *
+ * PARAMETERS IN
+ * poll_table_t *table - the table, NULL just reads the events
+ * int fd              - the file descriptor
+ * short revents       - events to be notified for
+ *
+ * PARAMETERS OUT
+ * short *events       - events read from the device, masked by revents
+ *
+ * RETURNS
+ * EOK in case of success
+ * EBADF if fd is not valid
+ * ENOSYS if the device cannot be polled
+ */
+int poll_table_add(poll_table_t * table, int fd, short revents, short *events);
+
+/*
+ * Test if any device in the table signalled, interrupts must be disabled.
+ */
+BOOL poll_table_signalled(poll_table_t * table);
 
 #endif
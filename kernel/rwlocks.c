@@ -0,0 +1,288 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <libs/list.h>
+#include <diegos/rwlocks.h>
+#include <diegos/interrupts.h>
+
+#include "rwlocks_private.h"
+#include "threads.h"
+#include "scheduler.h"
+#include "platform_include.h"
+#include "kprintf.h"
+
+struct rwlock {
+	list_node header;
+	/*
+	 * Waiting readers and writers, sorted by priority
+	 */
+	list_inst readers;
+	list_inst writers;
+	char name[16];
+	/*
+	 * Number of readers holding the lock
+	 */
+	unsigned nreaders;
+	tid_t writer_tid;
+};
+
+static list_inst rwlocks_list;
+
+rwlock_t *rwlock_create(const char *name)
+{
+	struct rwlock *ptr = malloc(sizeof(struct rwlock));
+
+	if (!ptr) {
+		return (NULL);
+	}
+
+	list_init(&ptr->readers);
+	list_init(&ptr->writers);
+	ptr->nreaders = 0;
+	ptr->writer_tid = THREAD_TID_INVALID;
+
+	if (name) {
+		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
+	} else {
+		snprintf(ptr->name, sizeof(ptr->name), "RWLock%x", (intptr_t) ptr);
+	}
+
+	lock();
+	if (EOK != list_append(&rwlocks_list, &ptr->header)) {
+		unlock();
+		free(ptr);
+		return (NULL);
+	}
+	unlock();
+
+	return (ptr);
+}
+
+int rwlock_done(rwlock_t *rwl)
+{
+	int retval;
+
+	if (!rwl) {
+		return (EINVAL);
+	}
+
+	lock();
+	if (rwl->nreaders || (THREAD_TID_INVALID != rwl->writer_tid) ||
+	    list_count(&rwl->readers) || list_count(&rwl->writers)) {
+		unlock();
+		return (EBUSY);
+	}
+	retval = list_remove(&rwlocks_list, &rwl->header);
+	unlock();
+
+	if (retval != EOK) {
+		kerrprintf("Invalid rwlock");
+	} else {
+		free(rwl);
+	}
+
+	return (retval);
+}
+
+/*
+ * Hand a free lock over to the most urgent waiting writer,
+ * or to all the waiting readers if no writer waits.
+ * Interrupts must be disabled.
+ */
+static void grant_internal(rwlock_t *rwl)
+{
+	wait_node_t *node;
+
+	if (THREAD_TID_INVALID != rwl->writer_tid) {
+		return;
+	}
+
+	if (list_count(&rwl->writers)) {
+		if (!rwl->nreaders) {
+			node = list_head(&rwl->writers);
+			rwl->writer_tid = node->thread->tid;
+			scheduler_resume_node(node, THREAD_FLAG_WAIT_RWLOCK);
+		}
+		return;
+	}
+
+	rwl->nreaders += scheduler_resume_waiters(&rwl->readers, THREAD_FLAG_WAIT_RWLOCK, 0);
+}
+
+/*
+ * Wait on a list of the lock, interrupts are disabled on entry
+ * and enabled on exit.
+ */
+static int wait_internal(rwlock_t *rwl, list_inst *waiters, unsigned msecs)
+{
+	thread_t *prev, *next;
+
+	prev = scheduler_running_thread();
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_RWLOCK, msecs, waiters)) {
+		unlock();
+		return (EPERM);
+	}
+
+	unlock();
+
+	schedule_thread();
+
+	next = scheduler_running_thread();
+	switch_context(&prev->context, next->context);
+
+	/*
+	 * The lock is handed over before resuming the thread
+	 */
+	if (prev->wake_flags & THREAD_FLAG_WAIT_RWLOCK) {
+		return (EOK);
+	}
+
+	/*
+	 * A writer giving up may let the readers queued behind it go
+	 */
+	lock();
+	grant_internal(rwl);
+	unlock();
+
+	return (ETIMEDOUT);
+}
+
+int rwlock_read_lock(rwlock_t *rwl)
+{
+	return (rwlock_read_lock_timed(rwl, 0));
+}
+
+int rwlock_read_lock_timed(rwlock_t *rwl, unsigned msecs)
+{
+	int retval = EOK;
+
+	if (!rwl) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+	lock();
+
+	if ((THREAD_TID_INVALID == rwl->writer_tid) && !list_count(&rwl->writers)) {
+		++rwl->nreaders;
+		unlock();
+	} else {
+		retval = wait_internal(rwl, &rwl->readers, msecs);
+	}
+
+	scheduler_preempt_enable();
+
+	return (retval);
+}
+
+int rwlock_write_lock(rwlock_t *rwl)
+{
+	return (rwlock_write_lock_timed(rwl, 0));
+}
+
+int rwlock_write_lock_timed(rwlock_t *rwl, unsigned msecs)
+{
+	int retval = EOK;
+
+	if (!rwl) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+	lock();
+
+	if (scheduler_running_tid() == rwl->writer_tid) {
+		unlock();
+		retval = EBUSY;
+	} else if ((THREAD_TID_INVALID == rwl->writer_tid) && !rwl->nreaders) {
+		rwl->writer_tid = scheduler_running_tid();
+		unlock();
+	} else {
+		retval = wait_internal(rwl, &rwl->writers, msecs);
+	}
+
+	scheduler_preempt_enable();
+
+	return (retval);
+}
+
+int rwlock_unlock(rwlock_t *rwl)
+{
+	int retval = EOK;
+
+	if (!rwl) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+	lock();
+
+	if (scheduler_running_tid() == rwl->writer_tid) {
+		rwl->writer_tid = THREAD_TID_INVALID;
+		grant_internal(rwl);
+	} else if (rwl->nreaders) {
+		--rwl->nreaders;
+		grant_internal(rwl);
+	} else {
+		retval = EPERM;
+	}
+
+	unlock();
+	scheduler_preempt_enable();
+
+	return (retval);
+}
+
+BOOL init_rwlocks_lib()
+{
+	if (EOK != list_init(&rwlocks_list)) {
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+static void dump_internal(const rwlock_t *rwl)
+{
+	printf("%-15s | %10u | %7u | %7u | %u\n", rwl->name, rwl->writer_tid, rwl->nreaders,
+	       rwl->writers.counter, rwl->readers.counter);
+}
+
+void rwlock_dump(const rwlock_t *rwl)
+{
+	if (!rwl) {
+		printf("\n--- RWLOCKS TABLE ----------------------------------------------\n\n");
+	}
+	printf("%-15s   %10s   %7s   %7s   %s\n", "RWLOCK NAME", "WRITER TID", "READERS",
+	       "WAIT WR", "WAIT RD");
+	printf("________________________________________________________________\n");
+	if (rwl) {
+		dump_internal(rwl);
+	} else {
+		rwl = list_head(&rwlocks_list);
+		while (rwl) {
+			dump_internal(rwl);
+			rwl = (const rwlock_t *)rwl->header.next;
+		}
+	}
+	printf("----------------------------------------------------------------\n\n");
+}
@@ -21,9 +21,11 @@
 #include <errno.h>
 #include <diegos/interrupts.h>
 #include <diegos/kernel_ticks.h>
+#include <diegos/delays.h>
 
 #include "threads.h"
 #include "clock.h"
+#include "timer_queue.h"
 #include "scheduler.h"
 #include "kprintf.h"
 #include "events_private.h"
@@ -31,35 +33,102 @@
 #include "io_waits_private.h"
 #include "poll_private.h"
 #include "mutex_private.h"
+#include "platform_include.h"
 
 /*
- * Maximum delay for the system clock tick.
- * The scheduler will not delay more than this value
- * to re-awake delayed threads.
- * Sleeping threads are checked at every call to schedule_thread().
- * If a thread is delayed for more than SCHED_DELAY_MAX, the scheduler
- * will re-check the delayed queue after SCHED_DELAY_MAX milliseconds or less.
+ * Maximum delay for the system clock tick requested by the scheduler.
+ * Sleeping threads are woken up by the timer queue, which programs
+ * the clock on its own; the scheduler clock instance only makes sure
+ * the clock fires at least every SCHED_DELAY_MAX milliseconds.
  * This avoids problems with very long delays and clock overflows.
- * The scheduler clock period is somewhat quantized.
  * The value is in milliseconds.
  */
 #define SCHED_DELAY_MAX (10*1000UL)
 
 /*
- * Pointer to the currently running thread.
- * Only one thread can be running at a time.
- * The scheduler does not support multiple processors yet.
+ * Processors served by the scheduler.
+ * With SMP every processor has its own running thread, ready queues and
+ * idle thread; the scheduler state is protected by the kernel lock, which
+ * lock() takes on every processor.
  */
-static thread_t *running = NULL;
+#ifdef ENABLE_SMP
+#define SCHED_CPUS	(DIEGOS_MAX_CPUS)
+#define SCHED_CPU()	(cpu_id())
+#else
+#define SCHED_CPUS	(1)
+#define SCHED_CPU()	(0)
+#endif
+
+#if (THREAD_PRIORITIES > 32)
+#error "THREAD_PRIORITIES cannot exceed the ready bitmap width (32)"
+#endif
 
 /*
- * Ready queues for each priority level.
- * All threads in these queues are in READY state.
- * Transition to or from this list must not happen
- * while interrupts are disabled.
- * State transitions must not be performed while in an interrupt context.
+ * Bandwidth available to EDF threads on a processor, in thousandths
  */
-static queue_inst ready_queues[THREAD_PRIORITIES];
+#define EDF_UTIL_MAX	(900)
+
+/*
+ * Ready queues holding threads that can run on a processor, the idle
+ * thread excluded, and ready queues holding threads that can move to
+ * another processor: idle and EDF threads never leave their own.
+ */
+#define LOCAL_MASK	(~(1UL << THREAD_PRIO_IDLE))
+#define STEAL_MASK	(LOCAL_MASK & ~(1UL << THREAD_PRIO_EDF))
+
+typedef struct sched_cpu {
+	/*
+	 * Pointer to the thread running on the processor
+	 */
+	thread_t *running;
+	/*
+	 * Idle thread of the processor
+	 */
+	thread_t *idle;
+	/*
+	 * Ready queues for each priority level.
+	 * All threads in these queues are in READY state.
+	 * Waiting threads are moved into these queues directly by the object
+	 * they wait on when it is signalled, possibly from an interrupt context:
+	 * the ready queues and the ready bitmap must be accessed
+	 * with interrupts disabled.
+	 */
+	queue_inst ready_queues[THREAD_PRIORITIES];
+	/*
+	 * Bitmap of the non empty ready queues, bit N is set if ready_queues[N]
+	 * holds at least one thread.
+	 * The highest priority ready queue is the least significant bit set,
+	 * so selecting the next thread is a single bit scan no matter how
+	 * many priority levels are in use.
+	 */
+	uint32_t ready_map;
+	/*
+	 * Set while scheduler_preempt() selects a new running thread, so that
+	 * the switch is accounted as involuntary.
+	 */
+	BOOL preempting;
+	/*
+	 * Bandwidth reserved by the EDF threads, in thousandths
+	 */
+	unsigned edf_util;
+#ifdef ENABLE_PREEMPTION
+	/*
+	 * Expiration of the running thread's time slice, in milliseconds since boot.
+	 */
+	uint64_t slice_end;
+#endif
+} sched_cpu_t;
+
+static sched_cpu_t cpus[SCHED_CPUS];
+
+/*
+ * Scheduler state of the running processor, stable with interrupts
+ * disabled or preemption disabled.
+ */
+static inline sched_cpu_t *this_cpu(void)
+{
+	return (&cpus[SCHED_CPU()]);
+}
 
 /*
  * Dead queue for threads that have terminated.
@@ -79,48 +148,385 @@ static queue_inst dead_queue = {
 };
 
 /*
- * Delayed queue for threads that are sleeping.
- * Threads in this queue are waiting for a delay to expire.
- * Transition from/to DELAYED state must not happen while interrupts are disabled.
+ * Preemption request, set by the clock callback when the running thread
+ * has exhausted its time slice. The platform checks this flag on exit from
+ * the outermost interrupt and calls scheduler_preempt() if set.
+ * One per processor.
  */
-static queue_inst delay_queue = {
-	.head = NULL,
-	.tail = NULL,
-	.counter = 0
-};
+volatile unsigned scheduler_preempt_pending[SCHED_CPUS];
 
 /*
- * Wait queue for threads that are waiting on events or a timeout.
- * Threads in this queue are waiting for a delay to expire or for an alarm to
- * trigger or for I/O to complete with timeout.
- * Transition from/to WAITING state must not happen while interrupts are disabled.
+ * Set when the running thread has been changed by schedule_thread() but
+ * the processor is still executing the previous one; the platform clears
+ * it as soon as the new context is loaded.
+ * No preemption can take place in between.
+ * One per processor.
  */
-static queue_inst wait_queue = {
-	.head = NULL,
-	.tail = NULL,
-	.counter = 0
-};
+volatile unsigned scheduler_switch_pending[SCHED_CPUS];
+
+/*
+ * TRUE if a is an EDF job more urgent than b, running at the same level.
+ * Threads boosted to THREAD_PRIO_EDF by priority inheritance have no
+ * deadline and come after the EDF jobs.
+ */
+static inline BOOL edf_before(const thread_t *a, const thread_t *b)
+{
+	if ((THREAD_PRIO_EDF != a->priority) || (THREAD_PRIO_EDF != b->priority) ||
+	    !a->edf_period) {
+		return (FALSE);
+	}
 
-static uint32_t new_delay_wq = SCHED_DELAY_MAX;
-static uint32_t new_delay_dq = SCHED_DELAY_MAX;
+	return ((!b->edf_period || (a->edf_abs_deadline < b->edf_abs_deadline)) ? TRUE : FALSE);
+}
 
+#ifdef ENABLE_PREEMPTION
 /*
- * Compute remaining delay for a thread.
- * The output parameter is updated only if the thread delay is greater than
- * the current time and less than the current new delay.
- * nd is updated only if the remaining delay is not null and the same is lesser
- * than nd.
- * Calling this function repeatedly updates nd to be the minimum remaining delay for
- * the threads involved.
+ * Time slice of each priority level in milliseconds, 0 disables
+ * time slicing for the level.
  */
-static inline void update_new_delay(uint64_t now, thread_t *ptr, uint32_t *nd)
+static unsigned quantum[THREAD_PRIORITIES];
+
+/*
+ * Shortest time slice in use, the scheduler clock must expire at least
+ * this often to enforce the slices.
+ */
+static unsigned quantum_min = DEFAULT_TIME_SLICE;
+
+/*
+ * Clock callback, flag a preemption if the running thread has used up its
+ * time slice and another thread of the same (or higher) priority is ready.
+ * Threads woken up by the timer queue request a preemption on their own.
+ * The clock interrupts the boot processor only, which checks the time
+ * slices of all the processors.
+ */
+static void scheduler_clock_cb(uint64_t msecs)
 {
-	if (ptr->delay > now) {
-		if (ptr->delay - now < *nd) {
-			*nd = ptr->delay - now;
+	thread_t *ptr;
+	unsigned i;
+
+	for (i = 0; i < SCHED_CPUS; i++) {
+		ptr = cpus[i].running;
+
+		/*
+		 * EDF jobs are not time sliced, a job past its runtime
+		 * is preempted and postponed when anything as urgent waits.
+		 */
+		if (ptr && ptr->edf_period && (THREAD_PRIO_EDF == ptr->priority)) {
+			if (ptr->edf_budget &&
+			    (ptr->edf_used + (read_cycles() - ptr->run_stamp) >= ptr->edf_budget) &&
+			    (cpus[i].ready_map & ((2UL << ptr->priority) - 1))) {
+				scheduler_preempt_pending[i] = 1;
+#ifdef ENABLE_SMP
+				cpu_resched(i);
+#endif
+			}
+			continue;
+		}
+
+		if (ptr && quantum[ptr->priority] && (msecs >= cpus[i].slice_end) &&
+		    (cpus[i].ready_map & ((2UL << ptr->priority) - 1))) {
+			scheduler_preempt_pending[i] = 1;
+#ifdef ENABLE_SMP
+			cpu_resched(i);
+#endif
 		}
 	}
 }
+#endif
+
+/*
+ * Find the highest priority non empty ready queue in a bitmap.
+ * The bitmap must not be 0.
+ */
+static inline unsigned ready_first(uint32_t map)
+{
+	return ((unsigned)__builtin_ctz(map));
+}
+
+/*
+ * Count the ready threads of a processor in the queues of a bitmap.
+ */
+static unsigned ready_count(sched_cpu_t *cpu, uint32_t map)
+{
+	unsigned total = 0;
+
+	map &= cpu->ready_map;
+	while (map) {
+		total += queue_count(&cpu->ready_queues[ready_first(map)]);
+		map &= map - 1;
+	}
+
+	return (total);
+}
+
+#ifdef ENABLE_SMP
+/*
+ * A thread has been queued: interrupt its processor if running something
+ * less urgent, otherwise wake up an idle processor to steal it, unless
+ * the thread is the running one and nothing else waits.
+ * Interrupts must be disabled.
+ */
+static void ready_kick(thread_t *ptr)
+{
+	sched_cpu_t *cpu = &cpus[ptr->cpu];
+	unsigned i;
+
+	if (cpu->running &&
+	    ((ptr->priority < cpu->running->priority) || edf_before(ptr, cpu->running))) {
+		scheduler_preempt_pending[ptr->cpu] = 1;
+		cpu_resched(ptr->cpu);
+		return;
+	}
+
+	if (!(STEAL_MASK & (1UL << ptr->priority))) {
+		return;
+	}
+
+	if ((ptr == cpu->running) && (ready_count(cpu, STEAL_MASK) < 2)) {
+		return;
+	}
+
+	for (i = 0; i < SCHED_CPUS; i++) {
+		if (cpus[i].idle && (cpus[i].running == cpus[i].idle) && (i != SCHED_CPU())) {
+			cpu_resched(i);
+			return;
+		}
+	}
+}
+
+/*
+ * Move the most urgent ready thread of the other processors to the
+ * ready queues of this one.
+ * Interrupts must be disabled.
+ */
+static BOOL ready_steal(unsigned id)
+{
+	thread_t *ptr = NULL;
+	unsigned i, best = THREAD_PRIO_IDLE, from = id;
+	uint32_t map;
+
+	for (i = 0; i < SCHED_CPUS; i++) {
+		map = cpus[i].ready_map & STEAL_MASK;
+		if ((i != id) && map && (ready_first(map) < best)) {
+			best = ready_first(map);
+			from = i;
+		}
+	}
+
+	if ((from == id) ||
+	    (EOK != queue_dequeue(&cpus[from].ready_queues[best], (queue_node **) & ptr))) {
+		return (FALSE);
+	}
+
+	if (!queue_count(&cpus[from].ready_queues[best])) {
+		cpus[from].ready_map &= ~(1UL << best);
+	}
+
+	ptr->cpu = id;
+	if (EOK != queue_enqueue(&cpus[id].ready_queues[best], &ptr->header)) {
+		kerrprintf("TID %d lost moving to CPU %u\n", ptr->tid, id);
+		return (FALSE);
+	}
+	cpus[id].ready_map |= (1UL << best);
+
+	return (TRUE);
+}
+#endif
+
+/*
+ * Charge the running EDF job with its last run right now, rather
+ * than at the next context switch.
+ */
+static inline void edf_charge(thread_t *ptr)
+{
+	uint64_t now;
+
+	if (THREAD_RUNNING == ptr->state) {
+		now = read_cycles();
+		ptr->run_cycles += now - ptr->run_stamp;
+		ptr->edf_used += now - ptr->run_stamp;
+		ptr->run_stamp = now;
+	}
+}
+
+/*
+ * Insert a thread in the EDF ready queue, sorted by deadline.
+ * A job which used up its runtime is postponed to the next period first.
+ * Threads with no deadline go to the tail.
+ */
+static STATUS edf_enqueue(queue_inst *queue, thread_t *ptr)
+{
+	thread_t *prev = NULL, *cursor;
+
+	if (!ptr->edf_period) {
+		return (queue_enqueue(queue, &ptr->header));
+	}
+
+	edf_charge(ptr);
+
+	if (ptr->edf_budget && (ptr->edf_used >= ptr->edf_budget)) {
+		++ptr->edf_overruns;
+		ptr->edf_abs_deadline += ptr->edf_period;
+		ptr->edf_used = 0;
+	}
+
+	cursor = queue_head(queue);
+	while (cursor && cursor->edf_period && (cursor->edf_abs_deadline <= ptr->edf_abs_deadline)) {
+		prev = cursor;
+		cursor = (thread_t *) cursor->header.next;
+	}
+
+	return (queue_insert(queue, &ptr->header, (prev) ? (&prev->header) : (NULL)));
+}
+
+/*
+ * Append a thread to the ready queue matching its priority, on the
+ * processor it last ran on, and flag the queue as non empty.
+ */
+static inline STATUS ready_enqueue(thread_t *ptr)
+{
+	sched_cpu_t *cpu = &cpus[ptr->cpu];
+	STATUS retcode = (THREAD_PRIO_EDF == ptr->priority) ?
+	    edf_enqueue(&cpu->ready_queues[ptr->priority], ptr) :
+	    queue_enqueue(&cpu->ready_queues[ptr->priority], &ptr->header);
+
+	if (EOK == retcode) {
+		cpu->ready_map |= (1UL << ptr->priority);
+		ptr->ready_stamp = read_cycles();
+#ifdef ENABLE_SMP
+		ready_kick(ptr);
+#endif
+	}
+
+	return (retcode);
+}
+
+/*
+ * Insert a thread in a waiters list sorted by priority, threads of the
+ * same priority are kept in FIFO order.
+ * The scan starts from the tail, so it costs nothing when all the
+ * waiters share the same priority.
+ * Interrupts must be disabled.
+ */
+static STATUS waiters_insert(list_inst *waiters, wait_node_t *node)
+{
+	list_node *prev = list_tail(waiters);
+	STATUS retcode;
+
+	while (prev && (WAIT_NODE_TO_THREAD(prev)->priority > node->thread->priority)) {
+		prev = prev->prev;
+	}
+
+	retcode = list_add(waiters, prev, &node->header);
+	node->list = (EOK == retcode) ? (waiters) : (NULL);
+
+	return (retcode);
+}
+
+/*
+ * Unlink a node from its waiters list, if linked.
+ * Interrupts must be disabled.
+ */
+static inline void node_unlink(wait_node_t *node)
+{
+	if (node->list) {
+		list_remove(node->list, &node->header);
+		node->list = NULL;
+	}
+}
+
+/*
+ * Move a node to its position in the waiters list after
+ * a priority change.
+ * Interrupts must be disabled.
+ */
+static void node_resort(wait_node_t *node)
+{
+	list_inst *waiters = node->list;
+
+	if (waiters) {
+		node_unlink(node);
+		waiters_insert(waiters, node);
+	}
+}
+
+/*
+ * Unlink a waiting thread from the object it is waiting on
+ * and from the timer queue.
+ * Interrupts must be disabled.
+ */
+static void wait_unlink(thread_t *ptr)
+{
+	unsigned i;
+
+	if (ptr->wait_set) {
+		for (i = 0; i < ptr->wait_set_size; i++) {
+			node_unlink(&ptr->wait_set[i]);
+		}
+		ptr->wait_set = NULL;
+		ptr->wait_set_size = 0;
+	}
+
+	node_unlink(&ptr->wait_node);
+
+	if (ptr->flags & THREAD_FLAG_WAIT_TIMEOUT) {
+		tq_cancel(&ptr->timeout);
+	}
+
+	ptr->flags &= ~THREAD_MASK_WAIT;
+}
+
+/*
+ * Move a waiting thread straight into its ready queue.
+ * The thread must be waiting for any of flags.
+ * Interrupts must be disabled.
+ */
+static BOOL wake_thread(thread_t *ptr, wait_node_t *node, uint32_t flags)
+{
+#ifdef ENABLE_PREEMPTION
+	sched_cpu_t *cpu = this_cpu();
+#endif
+
+	if ((THREAD_WAITING != ptr->state) || !(ptr->flags & flags & THREAD_MASK_WAIT)) {
+		return (FALSE);
+	}
+
+	ptr->wake_flags = ptr->flags & flags & THREAD_MASK_WAIT;
+	ptr->wake_node = node;
+	wait_unlink(ptr);
+	ptr->state = THREAD_READY;
+
+#ifdef ENABLE_PREEMPTION
+	/*
+	 * A more urgent thread is ready, preempt the running one
+	 * as soon as possible rather than at its next time slice.
+	 * Other processors are interrupted by ready_enqueue().
+	 */
+	if ((&cpus[ptr->cpu] == cpu) && cpu->running &&
+	    ((ptr->priority < cpu->running->priority) || edf_before(ptr, cpu->running))) {
+		scheduler_preempt_pending[SCHED_CPU()] = 1;
+	}
+#endif
+
+	return ((EOK == ready_enqueue(ptr)) ? (TRUE) : (FALSE));
+}
+
+/*
+ * Timer queue callback of a sleeping thread or of a thread waiting
+ * with a timeout, invoked in interrupt context.
+ */
+static void thread_timeout_cb(tq_node_t *node, uint64_t msecs)
+{
+	thread_t *ptr = (thread_t *) ((char *)node - offsetof(thread_t, timeout));
+
+	(void)msecs;
+
+	/*
+	 * Threads waiting on an object are unlinked from it,
+	 * the object was not signalled in time.
+	 */
+	wake_thread(ptr, NULL, THREAD_FLAG_WAIT_TIMEOUT);
+}
 
 /*
  * Perform house keeping, destroying dead threads waiting
@@ -135,7 +541,7 @@ static inline void update_new_delay(uint64_t now, thread_t *ptr, uint32_t *nd)
  * all non running threads at once.
  */
 
-static inline BOOL should_do_house_keeping(void)
+static inline BOOL should_do_house_keeping(thread_t *running)
 {
 	uint32_t temp = queue_count(&dead_queue);
 
@@ -149,7 +555,7 @@ static inline BOOL should_do_house_keeping(void)
 /*
  * Empties the dead queue.
  */
-static inline void house_keeping(void)
+static inline void house_keeping(thread_t *running)
 {
 	thread_t *temp = NULL;
 	unsigned i = queue_count(&dead_queue);
@@ -157,6 +563,12 @@ static inline void house_keeping(void)
 	while (i && (EOK == queue_dequeue(&dead_queue, (queue_node **) & temp))) {
 
 		if (temp->tid != running->tid) {
+			/*
+			 * Give the bandwidth of an EDF thread back
+			 */
+			lock();
+			cpus[temp->cpu].edf_util -= temp->edf_util;
+			unlock();
 			if (!done_thread(temp->tid)) {
 				kerrprintf("could not kill tid %d\n", temp->tid);
 			}
@@ -169,15 +581,49 @@ static inline void house_keeping(void)
 	}
 }
 
+/*
+ * CPU accounting, done when the next running thread is selected:
+ * the context switch follows right after.
+ * The previous thread is charged with the time it has been running,
+ * the next one with the time it has been waiting in a ready queue.
+ */
+static inline void account_switch(sched_cpu_t *cpu, thread_t *prev, thread_t *next)
+{
+	uint64_t now = read_cycles();
+
+	next->ready_cycles += now - next->ready_stamp;
+
+	if (prev == next) {
+		return;
+	}
+
+	if (prev) {
+		prev->run_cycles += now - prev->run_stamp;
+		prev->edf_used += now - prev->run_stamp;
+		if (cpu->preempting) {
+			++prev->involuntary;
+		} else {
+			++prev->voluntary;
+		}
+	}
+
+	next->run_stamp = now;
+}
+
 /*
  * Select a new running thread from the ready queue.
  * At the same time moves dead threads to the dead queue.
  */
-static inline BOOL new_runner(unsigned q)
+static inline BOOL new_runner(unsigned id, unsigned q)
 {
+	sched_cpu_t *cpu = &cpus[id];
 	thread_t *temp = NULL;
 
-	while (EOK == queue_dequeue(&ready_queues[q], (queue_node **) & temp)) {
+	while (EOK == queue_dequeue(&cpu->ready_queues[q], (queue_node **) & temp)) {
+
+		if (!queue_count(&cpu->ready_queues[q])) {
+			cpu->ready_map &= ~(1UL << q);
+		}
 
 		if (temp->flags & THREAD_FLAG_TERMINATE) {
 
@@ -187,340 +633,446 @@ static inline BOOL new_runner(unsigned q)
 				temp->state = THREAD_DEAD;
 			}
 		} else {
-			running = temp;
-			running->state = THREAD_RUNNING;
+#ifdef ENABLE_PREEMPTION
+			/*
+			 * Flag the switch before changing the running thread,
+			 * the clock interrupt must not see the new running
+			 * thread while still executing the old one.
+			 */
+			if (temp != cpu->running) {
+				scheduler_switch_pending[id] = 1;
+			}
+			cpu->slice_end = clock_get_milliseconds() + quantum[temp->priority];
+#endif
+			account_switch(cpu, cpu->running, temp);
+			cpu->running = temp;
+			temp->state = THREAD_RUNNING;
+			temp->cpu = id;
 			return (TRUE);
 		}
 	}
 
+	cpu->ready_map &= ~(1UL << q);
 	kerrprintf("could not schedule PRIO %d", q);
 
 	return (FALSE);
 }
 
-/*
- * Check the wait queue for threads whose delay has expired and are still waiting
- * and resume them.
- * Check also for threads that became ready and move the to the ready qeues.
- * It is not assumed that threads in the wait queue are sorted by delay
- * expiration time.
- * Also, the threads in the wait queue have their delay field set
- * to the absolute expiration time (in milliseconds since boot).
- */
-static void schedule_waiting(void)
+void schedule_thread()
 {
-	uint64_t expiration = clock_get_milliseconds();
-	thread_t *ptr, *temp;
-	unsigned i;
-	queue_inst *rqueue;
-
-	new_delay_wq = SCHED_DELAY_MAX;
-
-	i = queue_count(&wait_queue);
-	while (i--) {
-		ptr = queue_head(&wait_queue);
-		rqueue = ready_queues + ptr->priority;
-
-		switch (ptr->state) {
-		case THREAD_WAITING:
-			if (ptr->flags & THREAD_FLAG_TERMINATE) {
-				if (EOK != queue_dequeue(&wait_queue, (queue_node **) & temp)) {
-					kerrprintf("failed extracting TID %d from wait queue\n",
-						   ptr->tid);
-				} else if (EOK != queue_enqueue(&dead_queue, &temp->header)) {
-					kerrprintf("failed killing TID %d\n", temp->tid);
-				} else {
-					temp->state = THREAD_DEAD;
-				}
-			} else if (ptr->flags & THREAD_FLAG_WAIT_TIMEOUT) {
-				if (ptr->delay <= expiration) {
-					if (EOK != queue_dequeue(&wait_queue, (queue_node **) & temp)) {
-						kerrprintf("failed extracting TID %d from wait queue\n",
-							   ptr->tid);
-					} else {
-						if (!scheduler_resume_thread
-						(temp->flags & THREAD_MASK_EVENTS, temp->tid)) {
-							kerrprintf("failed resuming TID %d\n", temp->tid);
-						} else if (EOK !=
-							queue_enqueue(rqueue, &temp->header)) {
-							kerrprintf("failed moving TID %d to ready queue\n",
-								   temp->tid);
-						}
-					}
-				} else {
-					update_new_delay(expiration, ptr, &new_delay_wq);
-				}
-			}
-			break;
+	sched_cpu_t *cpu;
+	unsigned id;
 
-		case THREAD_READY:
-			if (EOK != queue_dequeue(&wait_queue, (queue_node **) & temp)) {
-				kerrprintf("failed extracting TID %d from wait queue\n", ptr->tid);
-			} else if (EOK !=
-				   queue_enqueue(rqueue, &temp->header)) {
-				kerrprintf("failed moving TID %d to ready queue\n", temp->tid);
-			}
-			break;
+	update_schedule();
 
-		default:
-			kerrprintf("TID %d in wrong state %d in wait queue\n", ptr->tid, ptr->state);
+	/*
+	 * Select the next thread to run, starting from the highest priority.
+	 * new_runner() clears the bit of a queue once it is empty, so the loop
+	 * only repeats if the queue held nothing but terminated threads.
+	 */
+	lock();
+	id = SCHED_CPU();
+	cpu = &cpus[id];
+#ifdef ENABLE_SMP
+	/*
+	 * Nothing but the idle thread to run here, take some work
+	 * from the other processors.
+	 */
+	if (!(cpu->ready_map & STEAL_MASK)) {
+		ready_steal(id);
+	}
+#endif
+	while (cpu->ready_map) {
+		if (new_runner(id, ready_first(cpu->ready_map))) {
 			break;
 		}
+	}
+	unlock();
 
-		if (EOK != queue_roll(&wait_queue)) {
-			kerrprintf("failed rolling wait queue\n");
-			return;
-		}
+	/*
+	 * Dead queue management.
+	 * Keep it here as the running thread might have called
+	 * thread_terminate in which case it is not possible to
+	 * destroy the thread in its own context, i.e. the running thread
+	 * must change to destroy the previous running thread.
+	 */
+	if (should_do_house_keeping(cpu->running)) {
+		house_keeping(cpu->running);
 	}
 }
 
-/*
- * Check the delayed queue for threads whose delay has expired
- * and resume them.
- * It is assumed that threads in the delay queue are sorted by delay
- * expiration time, so the head of the queue is always the next
- * thread to be resumed.
- * Also, the threads in the delay queue have their delay field set
- * to the absolute expiration time (in milliseconds since boot).
- */
-static void schedule_delayed(void)
+void update_schedule()
 {
-	uint64_t expiration = clock_get_milliseconds();
-	thread_t *ptr = queue_head(&delay_queue);
-	thread_t *temp;
+	uint32_t new_delay = SCHED_DELAY_MAX;
 
-	new_delay_dq = SCHED_DELAY_MAX;
+	/*
+	 * Waiting threads are moved to the ready queues by the objects
+	 * they wait on, expired delays and timeouts by the timer queue.
+	 * Only the clock period enforcing the time slices is left.
+	 */
+#ifdef ENABLE_PREEMPTION
+	if (quantum_min && (quantum_min < new_delay))
+		new_delay = quantum_min;
+#endif
 
-	while (ptr && (ptr->delay <= expiration)) {
-		if (EOK != queue_dequeue(&delay_queue, (queue_node **) & temp)) {
-			kerrprintf("failed resuming delayed TID %u\n", ptr->tid);
-			/*
-			 * Break the loop as much probably the data structure is
-			 * corrupted, probably an assert or abort would be better
-			 * since the existence of other delayed threads will bring
-			 * the scheduler here in the future....
-			 */
-			break;
-		} else {
-			if (!scheduler_resume_thread(THREAD_FLAG_WAIT_TIMEOUT, temp->tid)) {
-				kerrprintf("failed resuming delayed TID %d\n", temp->tid);
-			} else if (EOK !=
-				   queue_enqueue(&ready_queues[temp->priority], &temp->header)) {
-				kerrprintf("failed moving delayed TID %d to ready queue\n",
-					   temp->tid);
+	if (FALSE == clock_set_period(new_delay, CLK_INST_SCHEDULER)) {
+		kerrprintf("Clock device failed in %s\n", __FUNCTION__);
+	}
+}
+
+BOOL scheduler_init()
+{
+	unsigned i, j;
+
+	for (i = 0; i < NELEMENTS(cpus); i++) {
+		for (j = 0; j < NELEMENTS(cpus[i].ready_queues); j++) {
+			if (EOK != queue_init(&cpus[i].ready_queues[j])) {
+				return (FALSE);
 			}
 		}
-		ptr = queue_head(&delay_queue);
 	}
 
-	if (ptr) {
-		update_new_delay(expiration, ptr, &new_delay_dq);
+	if (EOK != queue_init(&dead_queue)) {
+		return (FALSE);
+	}
+
+#ifdef ENABLE_PREEMPTION
+	for (i = 0; i < NELEMENTS(quantum); i++) {
+		quantum[i] = DEFAULT_TIME_SLICE;
+	}
+
+	if (!clock_add_cb(scheduler_clock_cb, CLK_INST_SCHEDULER)) {
+		return (FALSE);
 	}
+#endif
+
+	return (TRUE);
 }
 
-void schedule_thread()
+BOOL scheduler_suspend_thread()
 {
-	unsigned i = 0;
+	thread_t *running;
+	STATUS retcode;
 
-	update_schedule();
+	lock();
+	running = this_cpu()->running;
+	retcode = ready_enqueue(running);
+	if (EOK == retcode) {
+		running->state = THREAD_READY;
+	}
+	unlock();
 
-	/*
-	* Select the next thread to run, starting from the highest priority.
-	*/
-	while (i < NELEMENTS(ready_queues)) {
-		if (queue_count(&ready_queues[i])) {
-			if (new_runner(i)) {
-				break;
-			}
-		}
-		++i;
+	if (EOK != retcode) {
+		kerrprintf("failed suspending TID %d\n", running->tid);
+		return (FALSE);
 	}
 
-	/*
-	 * Dead queue management.
-	 * Keep it here as the running thread might have called
-	 * thread_terminate in which case it is not possible to
-	 * destroy the thread in its own context, i.e. the running thread
-	 * must change to destroy the previous running thread.
-	 */
-	if (should_do_house_keeping()) {
-		house_keeping();
+	return (TRUE);
+}
+
+BOOL scheduler_resume_thread(uint32_t flags, tid_t tid)
+{
+	thread_t *ptr = get_thread(tid);
+	BOOL retval;
+
+	if (!ptr) {
+		kerrprintf("No process with TID %d\n", tid);
+		return (FALSE);
 	}
+
+	lock();
+	retval = wake_thread(ptr, NULL, flags);
+	unlock();
+
+	return (retval);
 }
 
-void update_schedule()
+BOOL scheduler_resume_node(wait_node_t *node, uint32_t flags)
 {
-	uint32_t new_delay = SCHED_DELAY_MAX;
+	BOOL retval;
 
-	/*
-	 * Wait queue management, update waiting threads state
-	 */
-	resume_on_events();
-	resume_on_barriers();
-	resume_on_io_wait();
-	resume_on_poll();
+	if (!node || !node->thread) {
+		return (FALSE);
+	}
 
-	/*
-	 * Wait queue management, fill in the ready queues if needed
-	 */
-	if (queue_count(&wait_queue)) {
-		schedule_waiting();
+	lock();
+	retval = wake_thread(node->thread, node, flags);
+	unlock();
+
+	return (retval);
+}
+
+unsigned scheduler_resume_waiters(list_inst *waiters, uint32_t flags, unsigned max)
+{
+	wait_node_t *node;
+	unsigned count = 0;
+
+	lock();
+	while (list_count(waiters) && (!max || (count < max))) {
+		node = list_head(waiters);
+		if (!wake_thread(node->thread, node, flags)) {
+			/* Not waiting for flags, drop it anyway */
+			node_unlink(node);
+			continue;
+		}
+		++count;
+	}
+	unlock();
+
+	return (count);
+}
+
+BOOL scheduler_delay_thread(uint64_t msecs)
+{
+	sched_cpu_t *cpu = this_cpu();
+	thread_t *running = cpu->running;
+	BOOL retcode;
+
+	if ((running == cpu->idle) || (THREAD_TID_TMRS == running->tid)) {
+		return (FALSE);
+	}
+
+	msecs += clock_get_milliseconds();
+
+	lock();
+	tq_node_init(&running->timeout, thread_timeout_cb);
+	retcode = tq_arm(&running->timeout, msecs);
+	if (retcode) {
+		running->flags &= ~THREAD_MASK_WAIT;
+		running->flags |= THREAD_FLAG_WAIT_TIMEOUT;
+		running->state = THREAD_WAITING;
+	}
+	unlock();
+
+	if (!retcode) {
+		kerrprintf("failed delaying TID %d\n", running->tid);
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+BOOL scheduler_edf_admit(thread_t *ptr, unsigned runtime, unsigned deadline, unsigned period)
+{
+	sched_cpu_t *cpu;
+	unsigned util;
+
+	if (!ptr || ptr->edf_period || !runtime || (runtime > deadline) || (deadline > period)) {
+		return (FALSE);
 	}
 
 	/*
-	 * delayed queue management, fill in the ready queues if needed
+	 * Density test, runtime over the shorter of deadline and period
 	 */
-	if (queue_count(&delay_queue)) {
-		schedule_delayed();
-	}
+	util = (runtime * 1000 + deadline - 1) / deadline;
 
-	if (new_delay_dq < new_delay_wq)
-		new_delay = new_delay_dq;
-	else
-		new_delay = new_delay_wq;
+	lock();
 
-	if (FALSE == clock_set_period(new_delay, CLK_INST_SCHEDULER)) {
-		kerrprintf("Clock device failed in %s\n", __FUNCTION__);
+	cpu = this_cpu();
+	if (cpu->edf_util + util > EDF_UTIL_MAX) {
+		unlock();
+		kerrprintf("EDF bandwidth exhausted, %u/1000 in use\n", cpu->edf_util);
+		return (FALSE);
 	}
+
+	cpu->edf_util += util;
+
+	ptr->cpu = SCHED_CPU();
+	ptr->priority = THREAD_PRIO_EDF;
+	ptr->base_priority = THREAD_PRIO_EDF;
+	ptr->edf_runtime = runtime;
+	ptr->edf_deadline = deadline;
+	ptr->edf_period = period;
+	ptr->edf_util = util;
+	ptr->edf_budget = (uint64_t) runtime *cycles_per_msec();
+	ptr->edf_used = 0;
+	ptr->edf_release = clock_get_milliseconds();
+	ptr->edf_abs_deadline = ptr->edf_release + deadline;
+
+	unlock();
+
+	return (TRUE);
 }
 
-BOOL scheduler_init()
+BOOL scheduler_edf_wait()
 {
-	unsigned i;
+	sched_cpu_t *cpu = this_cpu();
+	thread_t *running = cpu->running;
+	uint64_t now;
+	BOOL retcode = TRUE;
+
+	if (!running->edf_period) {
+		return (FALSE);
+	}
+
+	lock();
+
+	edf_charge(running);
+	now = clock_get_milliseconds();
 
-	for (i = 0; i < NELEMENTS(ready_queues); i++) {
-		if (EOK != queue_init(&ready_queues[i])) {
-			return (FALSE);
-		}
+	++running->edf_jobs;
+	if (now > running->edf_abs_deadline) {
+		++running->edf_misses;
 	}
 
-	if (EOK != queue_init(&delay_queue)) {
-		return (FALSE);
+	/*
+	 * Periods entirely elapsed are jobs never run
+	 */
+	running->edf_release += running->edf_period;
+	while (running->edf_release + running->edf_period <= now) {
+		running->edf_release += running->edf_period;
+		++running->edf_misses;
 	}
 
-	if (EOK != queue_init(&dead_queue)) {
-		return (FALSE);
+	running->edf_abs_deadline = running->edf_release + running->edf_deadline;
+	running->edf_used = 0;
+
+	if (running->edf_release <= now) {
+		/* Late, the next job is already released */
+		if (EOK == ready_enqueue(running)) {
+			running->state = THREAD_READY;
+		} else {
+			retcode = FALSE;
+		}
+	} else {
+		tq_node_init(&running->timeout, thread_timeout_cb);
+		retcode = tq_arm(&running->timeout, running->edf_release);
+		if (retcode) {
+			running->flags &= ~THREAD_MASK_WAIT;
+			running->flags |= THREAD_FLAG_WAIT_TIMEOUT;
+			running->state = THREAD_WAITING;
+		}
 	}
 
-	if (EOK != queue_init(&wait_queue)) {
-		return (FALSE);
+	unlock();
+
+	if (!retcode) {
+		kerrprintf("failed releasing TID %d\n", running->tid);
 	}
 
-	return (TRUE);
+	return (retcode);
 }
 
-BOOL scheduler_suspend_thread()
+/*
+ * Flag the running thread as WAITING for flags, with an optional timeout.
+ * Interrupts must be disabled.
+ */
+static void wait_running(thread_t *running, uint32_t flags, uint64_t msecs)
 {
-	if (EOK != queue_enqueue(&ready_queues[running->priority], &running->header)) {
-		kerrprintf("failed suspending TID %d\n", running->tid);
-		return (FALSE);
-	}
+	running->wake_flags = 0;
+	running->wake_node = NULL;
+	running->flags &= ~THREAD_MASK_WAIT;
+	running->flags |= flags & THREAD_MASK_EVENTS;
 
-	running->state = THREAD_READY;
+	tq_node_init(&running->timeout, thread_timeout_cb);
+	if (msecs && tq_arm(&running->timeout, clock_get_milliseconds() + msecs)) {
+		running->flags |= THREAD_FLAG_WAIT_TIMEOUT;
+	}
 
-	return (TRUE);
+	running->state = THREAD_WAITING;
 }
 
-BOOL scheduler_resume_thread(uint32_t flags, uint8_t tid)
+BOOL scheduler_wait_thread(uint32_t flags, uint64_t msecs, list_inst *waiters)
 {
-	thread_t *ptr = get_thread(tid);
-	uint32_t check;
+	sched_cpu_t *cpu = this_cpu();
+	thread_t *running = cpu->running;
 
-	if (!ptr) {
-		kerrprintf("No process with TID %d\n", tid);
+	if (running == cpu->idle) {
 		return (FALSE);
 	}
 
-	if (THREAD_WAITING != ptr->state) {
-		kerrprintf("TID %d state %s flags %s, cannot resume\n", tid, state2str(ptr->state),
-			   flags2str(ptr->flags));
+	if (!(THREAD_MASK_EVENTS & flags)) {
+		kerrprintf("Unknown flag 0x%X\n", flags);
 		return (FALSE);
 	}
 
-	check = flags & (ptr->flags & THREAD_MASK_WAIT);
-	if (check == 0) {
-		kerrprintf("TID %d flags %x %s mismatches flags %x %s\n",
-			   tid, ptr->flags & THREAD_MASK_WAIT,
-			   flags2str(ptr->flags & THREAD_MASK_WAIT), flags, flags2str(flags));
+	lock();
+
+	if (waiters && (EOK != waiters_insert(waiters, &running->wait_node))) {
+		unlock();
+		kerrprintf("failed waiting TID %d\n", running->tid);
 		return (FALSE);
 	}
 
-	ptr->flags &= ~THREAD_MASK_WAIT;
-	ptr->state = THREAD_READY;
-	ptr->delay = 0;
+	wait_running(running, flags, msecs);
+
+	unlock();
 
 	return (TRUE);
 }
 
-BOOL scheduler_delay_thread(uint64_t msecs)
+BOOL scheduler_wait_set(uint32_t flags, uint64_t msecs, wait_node_t *set, unsigned count)
 {
-	thread_t *ptr, *ptr2;
+	sched_cpu_t *cpu = this_cpu();
+	thread_t *running = cpu->running;
+	list_inst *waiters;
+	unsigned i;
 
-	if ((THREAD_TID_IDLE == running->tid) || (THREAD_TID_TMRS == running->tid)) {
+	if ((running == cpu->idle) || !set || !count) {
 		return (FALSE);
 	}
 
-	msecs += clock_get_milliseconds();
+	if (!(THREAD_MASK_EVENTS & flags)) {
+		kerrprintf("Unknown flag 0x%X\n", flags);
+		return (FALSE);
+	}
 
-	ptr = queue_head(&delay_queue);
-	if (!ptr || (msecs < ptr->delay)) {
-		if (EOK != queue_insert(&delay_queue, &running->header, NULL)) {
-			kerrprintf("failed delaying TID %d\n", running->tid);
-			return (FALSE);
-		}
-	} else {
-		while (ptr->header.next) {
-			ptr2 = (thread_t *) ptr->header.next;
-			if (msecs < ptr2->delay) {
-				break;
+	lock();
+
+	for (i = 0; i < count; i++) {
+		waiters = set[i].list;
+		set[i].list = NULL;
+		set[i].thread = running;
+
+		if (waiters && (EOK != waiters_insert(waiters, &set[i]))) {
+			while (i--) {
+				node_unlink(&set[i]);
 			}
-			ptr = (thread_t *) ptr->header.next;
-		}
-		if (EOK != queue_insert(&delay_queue, &running->header, &ptr->header)) {
-			kerrprintf("failed delaying TID %d\n", running->tid);
+			unlock();
+			kerrprintf("failed waiting TID %d\n", running->tid);
 			return (FALSE);
 		}
 	}
 
-	running->flags &= ~THREAD_MASK_WAIT;
-	running->flags |= THREAD_FLAG_WAIT_TIMEOUT;
-	running->state = THREAD_WAITING;
-	running->delay = msecs;
+	running->wait_set = set;
+	running->wait_set_size = count;
+
+	wait_running(running, flags, msecs);
+
+	unlock();
 
 	return (TRUE);
 }
 
-BOOL scheduler_wait_thread(uint32_t flags, uint64_t msecs)
+BOOL scheduler_requeue_thread(thread_t *ptr, uint32_t flags, list_inst *waiters)
 {
-	if (THREAD_TID_IDLE == running->tid) {
+	if (!ptr || !waiters || !(THREAD_MASK_EVENTS & flags)) {
 		return (FALSE);
 	}
 
-	if (!(THREAD_MASK_EVENTS & flags)) {
-		kerrprintf("Unknown flag 0x%X\n", flags);
+	lock();
+
+	if (THREAD_WAITING != ptr->state) {
+		unlock();
 		return (FALSE);
 	}
 
-	if (EOK != queue_enqueue(&wait_queue, &running->header)) {
-		kerrprintf("failed waiting TID %d\n", running->tid);
+	wait_unlink(ptr);
+
+	ptr->flags |= flags & THREAD_MASK_EVENTS;
+
+	if (EOK != waiters_insert(waiters, &ptr->wait_node)) {
+		unlock();
+		kerrprintf("failed requeueing TID %d\n", ptr->tid);
 		return (FALSE);
 	}
 
-	flags &= THREAD_MASK_EVENTS;
-	running->flags &= ~THREAD_MASK_WAIT;
-	running->flags |= flags;
-	running->state = THREAD_WAITING;
-	if (msecs) {
-		running->delay = clock_get_milliseconds() + msecs;
-		running->flags |= THREAD_FLAG_WAIT_TIMEOUT;
-	} else {
-		running->delay = 0;
-	}
+	unlock();
 
 	return (TRUE);
 }
 
-BOOL scheduler_add_thread(uint8_t tid)
+BOOL scheduler_add_thread(tid_t tid)
 {
 	STATUS retcode;
 	thread_t *ptr = get_thread(tid);
@@ -529,7 +1081,10 @@ BOOL scheduler_add_thread(uint8_t tid)
 		return (FALSE);
 	}
 
-	retcode = queue_enqueue(&ready_queues[ptr->priority], &ptr->header);
+	lock();
+	ptr->cpu = SCHED_CPU();
+	retcode = ready_enqueue(ptr);
+	unlock();
 
 	if (EOK != retcode) {
 		kerrprintf("failed scheduling TID %d\n", tid);
@@ -538,7 +1093,7 @@ BOOL scheduler_add_thread(uint8_t tid)
 	return ((EOK == retcode) ? (TRUE) : (FALSE));
 }
 
-BOOL scheduler_remove_thread(uint8_t tid)
+BOOL scheduler_remove_thread(tid_t tid)
 {
 	thread_t *ptr = get_thread(tid);
 
@@ -556,163 +1111,440 @@ BOOL scheduler_remove_thread(uint8_t tid)
 		return (FALSE);
 	}
 
+	lock();
+
 	switch (ptr->state) {
 		/*
 		 * RUNNING thread is not linked in a ready queue
 		 */
 	case THREAD_RUNNING:
-		ptr->state = THREAD_DEAD;
-		if (EOK != queue_enqueue(&dead_queue, &ptr->header)) {
-			kerrprintf("failed killing TID %d\n", tid);
-			return (FALSE);
+#ifdef ENABLE_SMP
+		/*
+		 * Running on another processor, flag it and kill it
+		 * as soon as it leaves the processor
+		 */
+		if (ptr->cpu != SCHED_CPU()) {
+			ptr->flags |= THREAD_FLAG_TERMINATE;
+			scheduler_preempt_pending[ptr->cpu] = 1;
+			cpu_resched(ptr->cpu);
+			unlock();
+			return (TRUE);
 		}
+#endif
+		ptr->state = THREAD_DEAD;
 		break;
 
+		/*
+		 * WAITING threads are unlinked from the objects they wait on
+		 * and from the timer queue, then they are put directly in the
+		 * dead queue as if they were running threads.
+		 */
 	case THREAD_WAITING:
-		switch (ptr->flags & THREAD_MASK_WAIT) {
-		case THREAD_FLAG_WAIT_EVENT:
-			if (EOK != cancel_wait_for_events(tid)) {
-				kerrprintf("failed killing TID %d\n", tid);
-				return (FALSE);
-			}
-			break;
-
-		case THREAD_FLAG_WAIT_BARRIER:
-			if (EOK != cancel_wait_for_barrier(tid)) {
-				kerrprintf("failed killing TID %d\n", tid);
-				return (FALSE);
-			}
-			break;
-
-		case THREAD_FLAG_WAIT_COMPLETION:
-			if (EOK != cancel_io_waits(tid)) {
-				kerrprintf("failed killing TID %d\n", tid);
-				return (FALSE);
-			}
-			break;
+		if ((ptr->flags & THREAD_FLAG_WAIT_MUTEX) && (EOK != cancel_wait_on_mutex(tid))) {
+			unlock();
+			kerrprintf("failed killing TID %d\n", tid);
+			return (FALSE);
+		}
 
-		case THREAD_FLAG_WAIT_TIMEOUT:
-			break;
+		if ((ptr->flags & THREAD_FLAG_WAIT_EVENT) && (EOK != cancel_wait_for_events(tid))) {
+			unlock();
+			kerrprintf("failed killing TID %d\n", tid);
+			return (FALSE);
+		}
 
-		case THREAD_FLAG_WAIT_MUTEX:
-			/*
-			 * Threads waiting on mutexes are stored in lists and queues,
-			 * when cancelled are orphaned so we need to put them directly in the dead queue
-			 * as if they were running threads.
-			 */
-			if (EOK != cancel_wait_on_mutex(tid)) {
-				kerrprintf("failed killing TID %d\n", tid);
-				return (FALSE);
-			} else {
-				ptr->state = THREAD_DEAD;
-				if (EOK != queue_enqueue(&dead_queue, &ptr->header)) {
-					kerrprintf("failed killing TID %d\n", tid);
-					return (FALSE);
-				}
-			}
-			break;
+		if ((ptr->flags & THREAD_FLAG_WAIT_COMPLETION) && (EOK != cancel_io_waits(tid))) {
+			unlock();
+			kerrprintf("failed killing TID %d\n", tid);
+			return (FALSE);
 		}
 
-		ptr->flags &= ~THREAD_MASK_WAIT;
-		/* FALLTHRU */
+		wait_unlink(ptr);
+		ptr->state = THREAD_DEAD;
+		break;
+
 		/*
 		 * READY threads are linked in a ready queue, so flag them and remove
 		 * them when executing new_runner()
 		 */
 	case THREAD_READY:
 		ptr->flags |= THREAD_FLAG_TERMINATE;
-		break;
+		unlock();
+		return (TRUE);
 
 		/*
 		 * A DEAD thread is already dead....
 		 */
 	case THREAD_DEAD:
+		unlock();
 		kprintf("I am DEAD !!!\n");
 		return (FALSE);
 	}
 
+	unlock();
+
+	if (EOK != queue_enqueue(&dead_queue, &ptr->header)) {
+		kerrprintf("failed killing TID %d\n", tid);
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+void scheduler_set_priority(thread_t *ptr, uint8_t prio)
+{
+	sched_cpu_t *cpu;
+	uint64_t stamp;
+	unsigned i;
+
+	if (!ptr || !(prio < THREAD_PRIORITIES)) {
+		return;
+	}
+
+	lock();
+
+	if (prio == ptr->priority) {
+		unlock();
+		return;
+	}
+
+	switch (ptr->state) {
+	case THREAD_READY:
+		cpu = &cpus[ptr->cpu];
+		if (EOK == queue_remove(&cpu->ready_queues[ptr->priority], &ptr->header)) {
+			if (!queue_count(&cpu->ready_queues[ptr->priority])) {
+				cpu->ready_map &= ~(1UL << ptr->priority);
+			}
+			ptr->priority = prio;
+			/*
+			 * Keep the time already spent in the ready queue
+			 */
+			stamp = ptr->ready_stamp;
+			if (EOK != ready_enqueue(ptr)) {
+				kerrprintf("TID %d lost changing priority\n", ptr->tid);
+			}
+			ptr->ready_stamp = stamp;
+		} else {
+			ptr->priority = prio;
+		}
+		break;
+
+		/*
+		 * Keep the waiters list of the object sorted
+		 */
+	case THREAD_WAITING:
+		ptr->priority = prio;
+		node_resort(&ptr->wait_node);
+		for (i = 0; ptr->wait_set && (i < ptr->wait_set_size); i++) {
+			node_resort(&ptr->wait_set[i]);
+		}
+		break;
+
+	default:
+		ptr->priority = prio;
+		break;
+	}
+
+#ifdef ENABLE_PREEMPTION
+	cpu = this_cpu();
+	if (cpu->running && (cpu->ready_map & ((1UL << cpu->running->priority) - 1))) {
+		scheduler_preempt_pending[SCHED_CPU()] = 1;
+	}
+#endif
+
+	unlock();
+}
+
+BOOL scheduler_set_quantum(uint8_t prio, unsigned msecs)
+{
+#ifdef ENABLE_PREEMPTION
+	unsigned i;
+
+	if (!(prio < THREAD_PRIORITIES)) {
+		return (FALSE);
+	}
+
+	quantum[prio] = msecs;
+
+	quantum_min = 0;
+	for (i = 0; i < NELEMENTS(quantum); i++) {
+		if (quantum[i] && (!quantum_min || (quantum[i] < quantum_min))) {
+			quantum_min = quantum[i];
+		}
+	}
+
 	return (TRUE);
+#else
+	return (FALSE);
+#endif
+}
+
+#ifdef ENABLE_SMP
+void scheduler_preempt_disable()
+{
+	unsigned flags = cpu_irq_save();
+	thread_t *ptr = this_cpu()->running;
+
+	/*
+	 * From the first level on the thread is neither preempted
+	 * nor moved to another processor, take the kernel lock.
+	 */
+	if (ptr && !ptr->preempt_off++) {
+		cpu_irq_restore(flags);
+		kernel_lock_acquire();
+		return;
+	}
+
+	cpu_irq_restore(flags);
+}
+
+void scheduler_preempt_enable()
+{
+	unsigned flags = cpu_irq_save();
+	unsigned id = SCHED_CPU();
+	thread_t *ptr = cpus[id].running;
+
+	if (ptr && ptr->preempt_off && !--ptr->preempt_off) {
+		kernel_lock_release();
+		if (scheduler_preempt_pending[id]) {
+			cpu_irq_restore(flags);
+			scheduler_preempt();
+			return;
+		}
+	}
+
+	cpu_irq_restore(flags);
+}
+
+void scheduler_thread_start()
+{
+	void (*entry_ptr)(void) = this_cpu()->running->entry_ptr;
+
+	/*
+	 * Every switch takes place with the kernel lock held once,
+	 * the switching thread releases it when switched in again.
+	 */
+	kernel_lock_release();
+
+	entry_ptr();
 }
 
-uint8_t scheduler_running_tid()
+void scheduler_ipi()
 {
-	return ((running) ? (running->tid) : (THREAD_TID_INVALID));
+	/*
+	 * The clock device is programmed by the boot processor only
+	 */
+	if (!SCHED_CPU()) {
+		clock_sync();
+	}
 }
 
-uint8_t scheduler_ready_threads(uint8_t prio)
+BOOL scheduler_idle_work()
 {
-	unsigned i = 0;
-	uint8_t total = 0;
+	unsigned i;
 
-	while (i < prio) {
-		total += queue_count(&ready_queues[i++]);
+	for (i = 0; i < SCHED_CPUS; i++) {
+		if (cpus[i].ready_map & ((i == SCHED_CPU()) ? LOCAL_MASK : STEAL_MASK)) {
+			return (TRUE);
+		}
 	}
 
-	return (total);
+	return (FALSE);
+}
+#elif defined(ENABLE_PREEMPTION)
+void scheduler_preempt_disable()
+{
+	thread_t *ptr = cpus[0].running;
+
+	if (ptr) {
+		++ptr->preempt_off;
+	}
+}
+
+void scheduler_preempt_enable()
+{
+	thread_t *ptr = cpus[0].running;
+
+	if (ptr && ptr->preempt_off) {
+		if (!--ptr->preempt_off && scheduler_preempt_pending[0]) {
+			scheduler_preempt();
+		}
+	}
+}
+#endif
+
+void scheduler_preempt()
+{
+	unsigned flags = cpu_irq_save();
+	unsigned id = SCHED_CPU();
+#ifdef ENABLE_PREEMPTION
+	sched_cpu_t *cpu = &cpus[id];
+	thread_t *prev = cpu->running, *next;
+
+	if (!prev || (THREAD_RUNNING != prev->state)) {
+		scheduler_preempt_pending[id] = 0;
+		cpu_irq_restore(flags);
+		return;
+	}
+
+	/*
+	 * Not preemptible now, the request is kept for the
+	 * outermost scheduler_preempt_enable().
+	 * Softirq callbacks run inside the interrupt exit path, on the
+	 * interrupt stack: switching there would leave the nesting level
+	 * raised for the next thread. preempt_point honours the request
+	 * once back on the thread stack.
+	 */
+	if (scheduler_switch_pending[id] || prev->preempt_off || int_nesting_level()) {
+		cpu_irq_restore(flags);
+		return;
+	}
+
+	scheduler_preempt_pending[id] = 0;
+
+	/*
+	 * Interrupts might be enabled again while rescheduling,
+	 * do not let a nested interrupt preempt us twice.
+	 */
+	++prev->preempt_off;
+	cpu_irq_restore(flags);
+#ifdef ENABLE_SMP
+	kernel_lock_acquire();
+#endif
+
+	if (scheduler_suspend_thread()) {
+		cpu->preempting = TRUE;
+		schedule_thread();
+		cpu->preempting = FALSE;
+		next = cpu->running;
+		if (prev != next) {
+			switch_context(&prev->context, next->context);
+		}
+	}
+
+	/*
+	 * Back again, maybe on another processor
+	 */
+	flags = cpu_irq_save();
+	--prev->preempt_off;
+#ifdef ENABLE_SMP
+	kernel_lock_release();
+#endif
+	cpu_irq_restore(flags);
+#else
+	scheduler_preempt_pending[id] = 0;
+	cpu_irq_restore(flags);
+#endif
+}
+
+tid_t scheduler_running_tid()
+{
+	thread_t *ptr = scheduler_running_thread();
+
+	return ((ptr) ? (ptr->tid) : (THREAD_TID_INVALID));
+}
+
+unsigned scheduler_ready_threads(uint8_t prio)
+{
+	uint32_t map = (prio < THREAD_PRIORITIES) ? ((1UL << prio) - 1) : (-1UL);
+
+	return (ready_count(this_cpu(), map));
 }
 
 thread_t *scheduler_running_thread()
 {
-	return (running);
+	unsigned flags = cpu_irq_save();
+	thread_t *ptr = this_cpu()->running;
+
+	cpu_irq_restore(flags);
+
+	return (ptr);
+}
+
+BOOL scheduler_add_idle(tid_t tid)
+{
+	thread_t *ptr = get_thread(tid);
+
+	if (!ptr) {
+		return (FALSE);
+	}
+
+	lock();
+	this_cpu()->idle = ptr;
+	unlock();
+
+	return (scheduler_add_thread(tid));
 }
 
 void scheduler_dump()
 {
-	unsigned i;
+	sched_cpu_t *cpu;
+	unsigned i, j;
 
 	printf("\n--- SCHEDULER TABLE -----------------------------------------------\n");
-	printf("Running TID: %d\n", scheduler_running_tid());
-	for (i = 0; i < NELEMENTS(ready_queues); i++) {
-		printf("%-3d ready   threads with priority %d\n", queue_count(&ready_queues[i]), i);
+	for (j = 0; j < NELEMENTS(cpus); j++) {
+		cpu = &cpus[j];
+		if (!cpu->running) {
+			continue;
+		}
+		printf("CPU %u running TID: %d\n", j, cpu->running->tid);
+		printf("Ready bitmap: 0x%08X\n", cpu->ready_map);
+		printf("EDF bandwidth: %u/1000\n", cpu->edf_util);
+		for (i = 0; i < NELEMENTS(cpu->ready_queues); i++) {
+			if (queue_count(&cpu->ready_queues[i])) {
+				printf("%-3d ready   threads with priority %d\n",
+				       queue_count(&cpu->ready_queues[i]), i);
+			}
+		}
 	}
-	printf("%-3d delayed threads\n", queue_count(&delay_queue));
-	printf("%-3d waiting threads\n", queue_count(&wait_queue));
 	printf("%-3d dead    threads\n", queue_count(&dead_queue));
 
 	printf("\n--- READY QUEUES -------------------------------------------\n");
 
-	for (i = 0; i < NELEMENTS(ready_queues); i++) {
-		printf("priority %d: %d threads\n", i, queue_count(&ready_queues[i]));
-		if (queue_count(&ready_queues[i])) {
-			printf("%-3s   %-15s   %-8s   %s\n", "TID", "THREAD NAME", "STATE",
-			       "FLAGS");
-			printf("______________________________________________\n");
-			thread_t *ptr = queue_head(&ready_queues[i]);
-			while (ptr) {
-				printf("%-3d %-15s %-8s %s\n", ptr->tid,
-				       ptr->name, state2str(ptr->state), flags2str(ptr->flags));
-				ptr = (thread_t *) ptr->header.next;
+	for (j = 0; j < NELEMENTS(cpus); j++) {
+		cpu = &cpus[j];
+		for (i = 0; i < NELEMENTS(cpu->ready_queues); i++) {
+			if (queue_count(&cpu->ready_queues[i])) {
+				printf("CPU %u priority %d: %d threads\n", j, i,
+				       queue_count(&cpu->ready_queues[i]));
+				printf("%-3s   %-15s   %-8s   %s\n", "TID", "THREAD NAME", "STATE",
+				       "FLAGS");
+				printf("______________________________________________\n");
+				thread_t *ptr = queue_head(&cpu->ready_queues[i]);
+				while (ptr) {
+					printf("%-3d %-15s %-8s %s\n", ptr->tid,
+					       ptr->name, state2str(ptr->state),
+					       flags2str(ptr->flags));
+					ptr = (thread_t *) ptr->header.next;
+				}
 			}
 		}
 	}
 
-	printf("\n--- DELAYED QUEUE -------------------------------------------\n");
-
-	printf("%d threads\n", queue_count(&delay_queue));
-	if (queue_count(&delay_queue)) {
-		printf("%-3s   %-4s   %-15s   %-8s   %s\n", "TID", "PRIO", "THREAD NAME", "STATE",
-		       "FLAGS");
-		printf("______________________________________________________\n");
-		thread_t *ptr = queue_head(&delay_queue);
-		while (ptr) {
-			printf("%-3d %-3d %-15s %-8s %s\n", ptr->tid, ptr->priority,
-			       ptr->name, state2str(ptr->state), flags2str(ptr->flags));
-			ptr = (thread_t *) ptr->header.next;
+	printf("\n--- WAITING THREADS -----------------------------------------\n");
+
+	printf("%-3s   %-4s   %-15s   %-10s   %s\n", "TID", "PRIO", "THREAD NAME", "TIMEOUT",
+	       "FLAGS");
+	printf("______________________________________________________\n");
+	for (i = 0; i < thread_table_size(); i++) {
+		thread_t *ptr = get_thread(i);
+		if (ptr && (THREAD_WAITING == ptr->state)) {
+			printf("%-3d %-3d %-15s %-10llu %s\n", ptr->tid, ptr->priority,
+			       ptr->name, (ptr->timeout.armed) ? ptr->timeout.deadline : 0ULL,
+			       flags2str(ptr->flags));
 		}
 	}
 
-	printf("\n--- WAIT QUEUE ----------------------------------------------\n");
-
-	printf("%d threads\n", queue_count(&wait_queue));
-	if (queue_count(&wait_queue)) {
-		printf("%-3s   %-4s   %-15s   %-8s   %s\n", "TID", "PRIO", "THREAD NAME", "STATE",
-		       "FLAGS");
-		printf("______________________________________________________\n");
-		thread_t *ptr = queue_head(&wait_queue);
-		while (ptr) {
-			printf("%-3d %-3d %-15s %-8s %s\n", ptr->tid, ptr->priority,
-			       ptr->name, state2str(ptr->state), flags2str(ptr->flags));
-			ptr = (thread_t *) ptr->header.next;
+	printf("\n--- EDF THREADS ---------------------------------------------\n");
+
+	printf("%-3s   %-15s   %-17s   %-8s   %-8s   %s\n", "TID", "THREAD NAME",
+	       "RUN/DEADLN/PERIOD", "JOBS", "MISSES", "OVERRUNS");
+	printf("______________________________________________________________\n");
+	for (i = 0; i < thread_table_size(); i++) {
+		thread_t *ptr = get_thread(i);
+		if (ptr && ptr->edf_period) {
+			printf("%-3d %-15s %5u/%5u/%5u %-8u %-8u %u\n", ptr->tid, ptr->name,
+			       ptr->edf_runtime, ptr->edf_deadline, ptr->edf_period, ptr->edf_jobs,
+			       ptr->edf_misses, ptr->edf_overruns);
 		}
 	}
 
@@ -21,11 +21,11 @@
 #define SCHEDULER_H_INCLUDED
 
 #include "threads_data.h"
+#include <libs/list.h>
 
 /*
  * Initializes the scheduler, must be called before any other scheduler procedure.
- * This procedure initializes the ready queues, the delayed queue,
- * the wait queue and the dead queue.
+ * This procedure initializes the ready queues and the dead queue.
  *
  * RETURNS
  * TRUE on success
@@ -64,23 +64,54 @@ BOOL scheduler_suspend_thread(void);
 /*
  * Resumes a thread that was waiting on an event, a barrier, an I/O wait or a poll.
  * The thread is identified by its TID and the flags that caused it to wait.
- * The thread is flagged as READY and moved to the ready queue by update_schedule().
- * update_schedule() is not invoked directly by this procedure, but the thread will
- * be resumed at the next call to schedule_thread()/update_schedule().
+ * The thread is unlinked from the object it waits on and from the timer queue,
+ * flagged as READY and moved straight into its ready queue.
+ * Can be called from an interrupt context.
  *
  * PARAMETERS IN
  * uint32_t flags - the flags that caused the thread to wait, this is used to check if the thread is waiting for the event that is being signaled.
- * uint8_t  tid   - the TID of the thread to be resumed.
+ * tid_t    tid   - the TID of the thread to be resumed.
  *
  * RETURNS
  * TRUE on success
- * FALSE on failure
+ * FALSE if the thread does not exist or is not waiting for flags
+ */
+BOOL scheduler_resume_thread(uint32_t flags, tid_t tid);
+
+/*
+ * Resumes the thread linked by a node of a waiters list, the node
+ * is recorded as the one that resumed the thread.
+ * Can be called from an interrupt context.
+ *
+ * PARAMETERS IN
+ * wait_node_t *node - the node, usually the head of the waiters list
+ * uint32_t flags    - the flags that caused the thread to wait
+ *
+ * RETURNS
+ * TRUE on success
+ * FALSE if the thread is not waiting for flags
+ */
+BOOL scheduler_resume_node(wait_node_t *node, uint32_t flags);
+
+/*
+ * Resumes the threads in a waiters list, in priority order.
+ * Every resumed thread is unlinked from the list and moved straight
+ * into its ready queue.
+ * Can be called from an interrupt context.
+ *
+ * PARAMETERS IN
+ * list_inst *waiters - the waiters list of the signalled object
+ * uint32_t flags     - the flags that caused the threads to wait
+ * unsigned max       - the maximum number of threads to resume, 0 resumes all of them
+ *
+ * RETURNS
+ * the number of threads resumed
  */
-BOOL scheduler_resume_thread(uint32_t flags, uint8_t tid);
+unsigned scheduler_resume_waiters(list_inst *waiters, uint32_t flags, unsigned max);
 
 /*
  * Delays the currently running thread for a specified number of milliseconds.
- * The thread is moved to the delayed queue and marked as DELAYED.
+ * The thread is armed in the timer queue and marked as WAITING.
  * The thread will be resumed at the end of the delay period.
  *
  * PARAMETERS IN
@@ -92,48 +123,141 @@ BOOL scheduler_resume_thread(uint32_t flags, uint8_t tid);
  */
 BOOL scheduler_delay_thread(uint64_t msecs);
 
+/*
+ * Admit a new thread in the earliest deadline first class on the running
+ * processor, the thread must not be scheduled yet.
+ * The bandwidth of the thread (runtime / deadline) is reserved until the
+ * thread is destroyed; the first job is released immediately.
+ *
+ * PARAMETERS IN
+ * thread_t *ptr     - the thread
+ * unsigned runtime  - milliseconds of processor time per period
+ * unsigned deadline - milliseconds from the release to the deadline
+ * unsigned period   - milliseconds between two releases
+ *
+ * RETURNS
+ * TRUE if the thread is admitted
+ * FALSE if the parameters are invalid or the bandwidth is not available
+ */
+BOOL scheduler_edf_admit(thread_t *ptr, unsigned runtime, unsigned deadline, unsigned period);
+
+/*
+ * Ends the job of the running EDF thread, counting a miss if the deadline
+ * is past. The thread is armed in the timer queue and marked as WAITING
+ * until the next release, or moved to its ready queue if the next job
+ * is already released.
+ *
+ * RETURNS
+ * TRUE on success
+ * FALSE if the running thread is not an EDF one or on failure
+ */
+BOOL scheduler_edf_wait(void);
+
 /*
  * Waits for a specific event or condition to occur.
- * The thread is moved to the wait queue and marked as WAITING.
- * The thread will be resumed when the event occurs or when a timeout occurs.
+ * The thread is inserted in the waiters list of the object by priority, after
+ * the waiters of the same priority, and marked as WAITING;
+ * with a timeout it is also armed in the timer queue.
+ * The thread will be resumed by the object when the event occurs, or by the
+ * scheduler when the timeout expires.
+ * Callers checking the object state must disable interrupts until this call
+ * returns, otherwise a wakeup could be lost.
+ *
+ * PARAMETERS IN
+ * uint32_t flags     - the flags that define what event or condition to wait for.
+ * uint64_t msecs     - the number of milliseconds to wait before timing out (0 means no timeout).
+ * list_inst *waiters - the waiters list of the object, NULL if the object resumes the thread by TID.
+ *
+ * RETURNS
+ * TRUE on success (thread is waiting)
+ * FALSE on failure (thread is not waiting)
+ */
+BOOL scheduler_wait_thread(uint32_t flags, uint64_t msecs, list_inst *waiters);
+
+/*
+ * Waits on multiple objects at once.
+ * Every node of the set is inserted in the waiters list set in its list
+ * field on entry, nodes with no list are skipped; the thread is marked
+ * as WAITING for any of flags.
+ * The first object signalled resumes the thread and every node is
+ * unlinked; the node of the object, if known, is recorded in wake_node.
+ * The set must stay valid until the thread is resumed.
+ * Callers checking the objects state must disable interrupts until this call
+ * returns, otherwise a wakeup could be lost.
  *
  * PARAMETERS IN
- * uint32_t flags - the flags that define what event or condition to wait for.
- * uint64_t msecs - the number of milliseconds to wait before timing out (0 means no timeout).
+ * uint32_t flags     - the flags of all the objects waited on.
+ * uint64_t msecs     - the number of milliseconds to wait before timing out (0 means no timeout).
+ * wait_node_t *set   - the set of nodes, one per object.
+ * unsigned count     - the number of nodes.
  *
  * RETURNS
- * TRUE on success (thread was added to wait queue)
- * FALSE on failure (thread was not added to wait queue)
+ * TRUE on success (thread is waiting)
+ * FALSE on failure (thread is not waiting)
+ */
+BOOL scheduler_wait_set(uint32_t flags, uint64_t msecs, wait_node_t *set, unsigned count);
+
+/*
+ * Moves a waiting thread to the waiters list of another object, without
+ * resuming it. The timeout of the wait, if any, is cancelled: the thread
+ * waits on the new object until it is signalled.
+ * Used to hand a thread over from a condition variable to its mutex.
+ * Interrupts must be disabled.
+ *
+ * PARAMETERS IN
+ * thread_t *ptr      - the waiting thread
+ * uint32_t flags     - the flags of the new wait
+ * list_inst *waiters - the waiters list of the new object
+ *
+ * RETURNS
+ * TRUE on success
+ * FALSE if the thread is not waiting
  */
-BOOL scheduler_wait_thread(uint32_t flags, uint64_t msecs);
+BOOL scheduler_requeue_thread(thread_t *ptr, uint32_t flags, list_inst *waiters);
 
 /*
  * Adds a new thread to the scheduler's ready queues.
  *
  * PARAMETERS IN
- * uint8_t tid - the TID of the thread to be added.
+ * tid_t tid - the TID of the thread to be added.
  *
  * RETURNS
  * TRUE on success
  * FALSE on failure
  */
-BOOL scheduler_add_thread(uint8_t tid);
+BOOL scheduler_add_thread(tid_t tid);
+
+/*
+ * Adds the idle thread of the running processor to the scheduler's
+ * ready queues. The idle thread runs when nothing else is ready
+ * and never moves to another processor.
+ *
+ * PARAMETERS IN
+ * tid_t tid - the TID of the idle thread.
+ *
+ * RETURNS
+ * TRUE on success
+ * FALSE on failure
+ */
+BOOL scheduler_add_idle(tid_t tid);
 
 /*
  * Removes a thread from the scheduler's queues and marks it as DEAD.
  * The thread will be moved to the dead queue and its resources will be freed by the scheduler.
  * If the thread was waiting on an event, a barrier, an I/O wait or a poll, it will be removed
- * from the wait queue and its flags will be cleared.
+ * from the waiters list of the object and from the timer queue.
  * This function is a cancellation point.
+ * With SMP a thread running on another processor is flagged and
+ * killed as soon as it leaves the processor.
  *
  * PARAMETERS IN
- * uint8_t tid - the TID of the thread to be removed.
+ * tid_t tid - the TID of the thread to be removed.
  *
  * RETURNS
  * TRUE on success
  * FALSE on failure
  */
-BOOL scheduler_remove_thread(uint8_t tid);
+BOOL scheduler_remove_thread(tid_t tid);
 
 /*
  * Returns the TID of the currently running thread.
@@ -141,7 +265,7 @@ BOOL scheduler_remove_thread(uint8_t tid);
  * RETURNS
  * the TID of the currently running thread, or THREAD_TID_INVALID if no thread is running.
  */
-uint8_t scheduler_running_tid(void);
+tid_t scheduler_running_tid(void);
 
 /*
  * Returns a pointer to the running thread's context.
@@ -155,12 +279,99 @@ thread_t *scheduler_running_thread(void);
  * Returns the number of threads in the ready queues with priority higher than the specified one.
  *
  * PARAMETERS IN
- * uint8_t prio - the priority level to check, threads with priority lower than this will be counted.
+ * uint8_t prio - the priority level to check, threads with priority lower than this will be counted,
+ *                THREAD_PRIORITIES counts all ready threads.
  *
  * RETURNS
  * the number of threads in the ready queues with priority higher than the specified one.
  */
-uint8_t scheduler_ready_threads(uint8_t prio);
+unsigned scheduler_ready_threads(uint8_t prio);
+
+/*
+ * Change the priority of a thread, used by priority inheritance.
+ * A READY thread is moved to the ready queue of the new priority,
+ * a WAITING thread is moved to its new position in the waiters list.
+ * Can be called with interrupts disabled.
+ *
+ * PARAMETERS IN
+ * thread_t *ptr   - the thread
+ * uint8_t prio    - the new priority
+ */
+void scheduler_set_priority(thread_t *ptr, uint8_t prio);
+
+/*
+ * Set the time slice of a priority level, used when preemption is enabled.
+ * Threads at the same priority level are scheduled round robin, a thread
+ * running longer than the time slice is preempted and moved to the tail
+ * of its ready queue.
+ *
+ * PARAMETERS IN
+ * uint8_t prio    - the priority level
+ * unsigned msecs  - the time slice in milliseconds, 0 disables time slicing
+ *
+ * RETURNS
+ * TRUE on success
+ * FALSE if the priority is out of range or preemption is not enabled
+ */
+BOOL scheduler_set_quantum(uint8_t prio, unsigned msecs);
+
+/*
+ * Disable or enable preemption of the running thread, calls nest.
+ * Kernel procedures changing the scheduler state or objects shared among
+ * threads must run with preemption disabled; a preemption requested
+ * in between is serviced by the outermost scheduler_preempt_enable().
+ */
+#if defined(ENABLE_PREEMPTION) || defined(ENABLE_SMP)
+void scheduler_preempt_disable(void);
+
+void scheduler_preempt_enable(void);
+#else
+static inline void scheduler_preempt_disable(void)
+{
+}
+
+static inline void scheduler_preempt_enable(void)
+{
+}
+#endif
+
+/*
+ * Preemption point, invoked by the platform on exit from the outermost
+ * interrupt when scheduler_preempt_pending is set.
+ * The running thread is moved to the tail of its ready queue and the
+ * next thread is switched in, unless the running thread is not preemptible.
+ * The interrupted context is saved on the thread stack and resumed when
+ * the thread is scheduled again.
+ */
+void scheduler_preempt(void);
+
+extern volatile unsigned scheduler_preempt_pending[];
+
+extern volatile unsigned scheduler_switch_pending[];
+
+#ifdef ENABLE_SMP
+/*
+ * First code run by a new thread, releases the kernel lock taken by
+ * the processor switching to it and calls the thread entry point.
+ */
+void scheduler_thread_start(void);
+
+/*
+ * Called by the platform on every inter processor interrupt.
+ */
+void scheduler_ipi(void);
+
+/*
+ * Check if an idle processor has something to run, either on its own
+ * or stolen from another processor.
+ * Interrupts must be disabled.
+ *
+ * RETURNS
+ * TRUE if any processor has ready threads, the idle ones excluded
+ * FALSE in any other case
+ */
+BOOL scheduler_idle_work(void);
+#endif
 
 /*
  * This is a default fail-safe function which is set as final return point for all threads,
@@ -172,8 +383,8 @@ uint8_t scheduler_ready_threads(uint8_t prio);
 void scheduler_fail_safe(void);
 
 /*
- * Dumps the scheduler state, including the running thread, the ready queues, the delayed queue,
- * the wait queue and the dead queue.
+ * Dumps the scheduler state, including the running thread, the ready queues,
+ * the waiting threads and the dead queue.
  * This function is useful for debugging purposes and can be called from a thread or from
  * an interrupt context.
  * The output is printed to the console.
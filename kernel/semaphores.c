@@ -0,0 +1,221 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <libs/list.h>
+#include <diegos/semaphores.h>
+#include <diegos/interrupts.h>
+
+#include "semaphores_private.h"
+#include "threads.h"
+#include "scheduler.h"
+#include "platform_include.h"
+#include "kprintf.h"
+
+struct semaphore {
+	list_node header;
+	list_inst waiters;
+	char name[16];
+	unsigned count;
+};
+
+static list_inst semaphores_list;
+
+sem_t *semaphore_create(const char *name, unsigned count)
+{
+	struct semaphore *ptr = malloc(sizeof(struct semaphore));
+
+	if (!ptr) {
+		return (NULL);
+	}
+
+	list_init(&ptr->waiters);
+	ptr->count = count;
+
+	if (name) {
+		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
+	} else {
+		snprintf(ptr->name, sizeof(ptr->name), "Sem%x", (intptr_t) ptr);
+	}
+
+	lock();
+	if (EOK != list_append(&semaphores_list, &ptr->header)) {
+		unlock();
+		free(ptr);
+		return (NULL);
+	}
+	unlock();
+
+	return (ptr);
+}
+
+int semaphore_done(sem_t *sem)
+{
+	int retval;
+
+	if (!sem) {
+		return (EINVAL);
+	}
+
+	lock();
+	if (list_count(&sem->waiters)) {
+		unlock();
+		return (EBUSY);
+	}
+	retval = list_remove(&semaphores_list, &sem->header);
+	unlock();
+
+	if (retval != EOK) {
+		kerrprintf("Invalid semaphore");
+	} else {
+		free(sem);
+	}
+
+	return (retval);
+}
+
+int semaphore_wait(sem_t *sem)
+{
+	return (semaphore_wait_timed(sem, 0));
+}
+
+int semaphore_wait_timed(sem_t *sem, unsigned msecs)
+{
+	thread_t *prev, *next;
+
+	if (!sem) {
+		return (EINVAL);
+	}
+
+	scheduler_preempt_disable();
+
+	/*
+	 * Semaphores may be posted by interrupt handlers, check and wait
+	 * with interrupts disabled or a wakeup could be lost.
+	 */
+	lock();
+
+	if (sem->count) {
+		--sem->count;
+		unlock();
+		scheduler_preempt_enable();
+		return (EOK);
+	}
+
+	prev = scheduler_running_thread();
+	if (!scheduler_wait_thread(THREAD_FLAG_WAIT_SEMAPHORE, msecs, &sem->waiters)) {
+		unlock();
+		scheduler_preempt_enable();
+		return (EPERM);
+	}
+
+	unlock();
+
+	schedule_thread();
+
+	next = scheduler_running_thread();
+	switch_context(&prev->context, next->context);
+
+	scheduler_preempt_enable();
+
+	/*
+	 * The unit is handed over by semaphore_post before resuming the thread
+	 */
+	return ((prev->wake_flags & THREAD_FLAG_WAIT_SEMAPHORE) ? (EOK) : (ETIMEDOUT));
+}
+
+int semaphore_trywait(sem_t *sem)
+{
+	int retval = EAGAIN;
+
+	if (!sem) {
+		return (EINVAL);
+	}
+
+	lock();
+	if (sem->count) {
+		--sem->count;
+		retval = EOK;
+	}
+	unlock();
+
+	return (retval);
+}
+
+int semaphore_post(sem_t *sem)
+{
+	if (!sem) {
+		return (EINVAL);
+	}
+
+	lock();
+	if (!scheduler_resume_waiters(&sem->waiters, THREAD_FLAG_WAIT_SEMAPHORE, 1)) {
+		++sem->count;
+	}
+	unlock();
+
+	return (EOK);
+}
+
+int semaphore_wait_prepare(sem_t *sem, wait_node_t *node)
+{
+	if (sem->count) {
+		--sem->count;
+		return (EOK);
+	}
+
+	node->list = &sem->waiters;
+
+	return (EAGAIN);
+}
+
+BOOL init_semaphores_lib()
+{
+	if (EOK != list_init(&semaphores_list)) {
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+static void dump_internal(const sem_t *sem)
+{
+	printf("%-15s | %5u | %u\n", sem->name, sem->count, sem->waiters.counter);
+}
+
+void semaphore_dump(const sem_t *sem)
+{
+	if (!sem) {
+		printf("\n--- SEMAPHORES TABLE --------------------\n\n");
+	}
+	printf("%-15s   %5s   %s\n", "SEMAPHORE NAME", "UNITS", "WAITING THREADS");
+	printf("________________________________________\n");
+	if (sem) {
+		dump_internal(sem);
+	} else {
+		sem = list_head(&semaphores_list);
+		while (sem) {
+			dump_internal(sem);
+			sem = (const sem_t *)sem->header.next;
+		}
+	}
+	printf("----------------------------------------\n\n");
+}
@@ -0,0 +1,50 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SEMAPHORES_PRIVATE_H_
+#define _SEMAPHORES_PRIVATE_H_
+
+#include <diegos/semaphores.h>
+#include "threads_data.h"
+
+/*
+ * Initialize the semaphores library.
+ * Must be called internally by the kernel init
+ * routine.
+ *
+ * RETURN VALUES
+ *
+ * TRUE if initialization succeded
+ * FALSE in any other case
+ */
+BOOL init_semaphores_lib(void);
+
+/*
+ * Prepare a wait on a semaphore as one of multiple objects.
+ * If a unit is available it is taken, otherwise the list field of node
+ * is set to the waiters list to link.
+ * Interrupts must be disabled.
+ *
+ * RETURNS
+ * EOK a unit is taken
+ * EAGAIN the thread must wait
+ */
+int semaphore_wait_prepare(sem_t * sem, wait_node_t * node);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <libs/list.h>
+#include <diegos/softirqs.h>
+#include <diegos/interrupts.h>
+
+#include "softirqs_private.h"
+#include "platform_include.h"
+
+struct softirq {
+	list_node header;
+	/*
+	 * Next queued softirq
+	 */
+	struct softirq *next;
+	softirq_fn fn;
+	void *arg;
+	char name[16];
+	BOOL queued;
+	/*
+	 * Cycles stamp of the last raise
+	 */
+	uint64_t raised;
+	uint32_t runs;
+	uint64_t total_latency;
+	uint64_t max_latency;
+	uint64_t max_run;
+};
+
+static list_inst softirqs_list;
+
+/*
+ * FIFO of queued softirqs
+ */
+static softirq_t *queue_head = NULL;
+static softirq_t *queue_tail = NULL;
+
+volatile unsigned softirq_pending = 0;
+
+softirq_t *softirq_create(const char *name, softirq_fn fn, void *arg)
+{
+	struct softirq *ptr;
+
+	if (!fn) {
+		return (NULL);
+	}
+
+	ptr = calloc(1, sizeof(struct softirq));
+	if (!ptr) {
+		return (NULL);
+	}
+
+	ptr->fn = fn;
+	ptr->arg = arg;
+
+	if (name) {
+		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
+	} else {
+		snprintf(ptr->name, sizeof(ptr->name), "SoftIRQ%x", (intptr_t) ptr);
+	}
+
+	lock();
+	if (EOK != list_append(&softirqs_list, &ptr->header)) {
+		unlock();
+		free(ptr);
+		return (NULL);
+	}
+	unlock();
+
+	return (ptr);
+}
+
+BOOL softirq_raise(softirq_t *sirq)
+{
+	if (!sirq) {
+		return (FALSE);
+	}
+
+	lock();
+
+	if (sirq->queued) {
+		unlock();
+		return (FALSE);
+	}
+
+	sirq->queued = TRUE;
+	sirq->next = NULL;
+	sirq->raised = read_cycles();
+
+	if (queue_tail) {
+		queue_tail->next = sirq;
+	} else {
+		queue_head = sirq;
+	}
+	queue_tail = sirq;
+
+	softirq_pending = 1;
+
+	unlock();
+
+	return (TRUE);
+}
+
+void softirq_run()
+{
+	softirq_t *sirq;
+	uint64_t start, elapsed;
+
+	while (TRUE) {
+		lock();
+
+		sirq = queue_head;
+		if (!sirq) {
+			softirq_pending = 0;
+			unlock();
+			break;
+		}
+
+		queue_head = sirq->next;
+		if (!queue_head) {
+			queue_tail = NULL;
+		}
+		sirq->queued = FALSE;
+
+		/*
+		 * Interrupts are enabled from here on, a nested handler
+		 * does not run softirqs, it just queues them
+		 */
+		unlock();
+
+		start = read_cycles();
+		elapsed = start - sirq->raised;
+
+		++sirq->runs;
+		sirq->total_latency += elapsed;
+		if (elapsed > sirq->max_latency) {
+			sirq->max_latency = elapsed;
+		}
+
+		sirq->fn(sirq->arg);
+
+		elapsed = read_cycles() - start;
+		if (elapsed > sirq->max_run) {
+			sirq->max_run = elapsed;
+		}
+	}
+
+	/*
+	 * Back to the interrupt exit path with interrupts disabled
+	 */
+	(void)cpu_irq_save();
+}
+
+BOOL init_softirqs_lib()
+{
+	if (EOK != list_init(&softirqs_list)) {
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+static void dump_internal(const softirq_t *sirq)
+{
+	printf("%-15s | %10u | %12llu | %12llu | %llu\n", sirq->name, sirq->runs,
+	       (sirq->runs) ? (sirq->total_latency / sirq->runs) : (0ULL), sirq->max_latency,
+	       sirq->max_run);
+}
+
+void softirq_dump(const softirq_t *sirq)
+{
+	if (!sirq) {
+		printf("\n--- SOFTIRQS TABLE ---------------------------------------------\n\n");
+	}
+	printf("%-15s   %10s   %12s   %12s   %s\n", "SOFTIRQ NAME", "RUNS", "AVG LATENCY",
+	       "MAX LATENCY", "MAX RUN");
+	printf("________________________________________________________________\n");
+	if (sirq) {
+		dump_internal(sirq);
+	} else {
+		sirq = list_head(&softirqs_list);
+		while (sirq) {
+			dump_internal(sirq);
+			sirq = (const softirq_t *)sirq->header.next;
+		}
+	}
+	printf("----------------------------------------------------------------\n\n");
+}
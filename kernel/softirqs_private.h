@@ -0,0 +1,47 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOFTIRQS_PRIVATE_H_
+#define _SOFTIRQS_PRIVATE_H_
+
+/*
+ * Set when at least a softirq is queued, tested on interrupt exit.
+ */
+extern volatile unsigned softirq_pending;
+
+/*
+ * Initialize the softirqs library.
+ * Must be called internally by the kernel init
+ * routine.
+ *
+ * RETURN VALUES
+ *
+ * TRUE if initialization succeded
+ * FALSE in any other case
+ */
+BOOL init_softirqs_lib(void);
+
+/*
+ * Run the queued softirqs, called by the outermost interrupt handler
+ * with interrupts disabled; they are enabled while the callbacks run and
+ * disabled again on return.
+ */
+void softirq_run(void);
+
+#endif
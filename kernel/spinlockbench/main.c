@@ -0,0 +1,258 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <types_common.h>
+#include <diegos/spinlocks.h>
+#include <diegos/kernel.h>
+
+/*
+ * Host stress benchmark of the kernel spinlocks.
+ * WORKERS pthreads increment a shared counter TOTAL_LOOPS times overall,
+ * holding the lock under test, for the test-and-set lock the ticket lock
+ * replaced, the ticket lock and the MCS lock. The counter must match at
+ * the end. The spread is the time between the first and the last worker
+ * finishing, in percent of the run: an unfair lock lets some workers
+ * run ahead of the others.
+ * Workers go up to the online processors, or to the first argument: with
+ * more workers than processors FIFO locks wait for preempted waiters and
+ * the figures measure the host scheduler rather than the lock.
+ */
+
+#define MAX_WORKERS	(8)
+#define TOTAL_LOOPS	(2000000UL)
+#define SPIN_YIELD	(1024)
+
+enum {
+	LOCK_TAS,
+	LOCK_TICKET,
+	LOCK_MCS
+};
+
+static const char *lock_names[] = { "tas", "ticket", "mcs" };
+
+static volatile BOOL tas;
+static spinlock_stats_t tas_stats;
+static uint64_t tas_acquired;
+static spinlock_t ticket;
+static mcslock_t mcs;
+
+static volatile unsigned long counter;
+static unsigned long loops;
+static unsigned lock_type;
+static uint64_t finished[MAX_WORKERS];
+static pthread_barrier_t start_line;
+
+/*
+ * The platform and scheduler services used by ../spinlocks.c
+ */
+void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+unsigned cpu_irq_save(void)
+{
+	return (0);
+}
+
+void cpu_irq_restore(unsigned flags)
+{
+}
+
+void thread_suspend(void)
+{
+	sched_yield();
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+uint64_t read_cycles(void)
+{
+	return (now_ns());
+}
+
+/*
+ * The lock of the previous implementation, made atomic for the host,
+ * spinning with the same policy and keeping the same statistics of the
+ * ticket and MCS locks.
+ */
+static void tas_lock(void)
+{
+	unsigned spins = 0;
+
+	while (__sync_lock_test_and_set(&tas, TRUE)) {
+		while (tas) {
+			cpu_relax();
+			if (!(++spins % SPIN_YIELD)) {
+				thread_suspend();
+			}
+		}
+	}
+
+	tas_stats.acquisitions++;
+	if (spins) {
+		tas_stats.contended++;
+		tas_stats.spins += spins;
+	}
+	tas_acquired = read_cycles();
+}
+
+static void tas_unlock(void)
+{
+	uint64_t now = read_cycles();
+
+	if ((now > tas_acquired) && ((now - tas_acquired) > tas_stats.max_hold)) {
+		tas_stats.max_hold = now - tas_acquired;
+	}
+	__sync_lock_release(&tas);
+}
+
+static void *worker_entry(void *arg)
+{
+	unsigned id = (unsigned)(uintptr_t) arg;
+	mcs_node_t node;
+	unsigned long i;
+
+	pthread_barrier_wait(&start_line);
+
+	for (i = 0; i < loops; i++) {
+		switch (lock_type) {
+		case LOCK_TAS:
+			tas_lock();
+			++counter;
+			tas_unlock();
+			break;
+		case LOCK_TICKET:
+			spinlock_lock(&ticket);
+			++counter;
+			spinlock_unlock(&ticket);
+			break;
+		default:
+			mcslock_lock(&mcs, &node);
+			++counter;
+			mcslock_unlock(&mcs, &node);
+			break;
+		}
+	}
+
+	finished[id] = now_ns();
+
+	return (NULL);
+}
+
+static void run(unsigned type, unsigned workers)
+{
+	pthread_t threads[MAX_WORKERS];
+	spinlock_stats_t stats;
+	uint64_t start, elapsed, first, last;
+	unsigned i;
+
+	lock_type = type;
+	loops = TOTAL_LOOPS / workers;
+	counter = 0;
+	memset(&tas_stats, 0, sizeof(tas_stats));
+
+	pthread_barrier_init(&start_line, NULL, workers + 1);
+
+	for (i = 0; i < workers; i++) {
+		if (pthread_create(&threads[i], NULL, worker_entry, (void *)(uintptr_t) i)) {
+			printf("cannot create worker %u\n", i);
+			exit(1);
+		}
+	}
+
+	start = now_ns();
+	pthread_barrier_wait(&start_line);
+
+	for (i = 0; i < workers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	elapsed = now_ns() - start;
+	pthread_barrier_destroy(&start_line);
+
+	first = last = finished[0];
+	for (i = 1; i < workers; i++) {
+		if (finished[i] < first) {
+			first = finished[i];
+		}
+		if (finished[i] > last) {
+			last = finished[i];
+		}
+	}
+
+	if (LOCK_TICKET == type) {
+		spinlock_get_stats(&ticket, &stats, TRUE);
+	} else if (LOCK_MCS == type) {
+		mcslock_get_stats(&mcs, &stats, TRUE);
+	} else {
+		stats = tas_stats;
+	}
+
+	printf("%-6s  %-7u  %-6llu  %-7llu  %-6llu  %-9u  %-12llu  %s\n",
+	       lock_names[type], workers,
+	       (unsigned long long)(elapsed / 1000000ULL),
+	       (unsigned long long)(elapsed / (loops * workers)),
+	       (unsigned long long)(((last - first) * 100ULL) / elapsed),
+	       stats.contended, (unsigned long long)stats.spins,
+	       (counter == loops * workers) ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned type, workers;
+	long max_workers;
+
+	max_workers = (argc > 1) ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+	if ((max_workers < 1) || (max_workers > MAX_WORKERS)) {
+		max_workers = MAX_WORKERS;
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	spinlock_init_flags(&ticket, SPINLOCK_STATS);
+	mcslock_init(&mcs, SPINLOCK_STATS);
+
+	printf("lock    workers  msecs   ns/lock  spread  contended  spins         counter\n");
+
+	for (workers = 1; workers <= max_workers; workers *= 2) {
+		for (type = LOCK_TAS; type <= LOCK_MCS; type++) {
+			run(type, workers);
+		}
+	}
+
+	return (0);
+}
@@ -21,21 +21,264 @@
 #include <diegos/spinlocks.h>
 #include <diegos/kernel.h>
 
+#include "platform_include.h"
+
+/*
+ * Spins before a waiter yields the CPU: on a single processor the owner
+ * cannot release the lock while the waiter runs, so it yields at once.
+ */
+#ifdef ENABLE_SMP
+#define SPIN_YIELD	(1024)
+#else
+#define SPIN_YIELD	(1)
+#endif
+
+/*
+ * Compiler barrier, x86 does not reorder loads with loads nor stores
+ * with stores, the compiler must not move accesses out of the lock.
+ */
+#define barrier()	__asm__ __volatile__("" : : : "memory")
+
+static void spin_wait(unsigned spins, BOOL can_yield)
+{
+	cpu_relax();
+
+	if (can_yield && !(spins % SPIN_YIELD)) {
+		thread_suspend();
+	}
+}
+
+static void stats_acquired(unsigned flags, uint64_t *acquired, spinlock_stats_t *stats,
+			   unsigned spins)
+{
+	if (flags & SPINLOCK_STATS) {
+		stats->acquisitions++;
+		if (spins) {
+			stats->contended++;
+			stats->spins += spins;
+		}
+		*acquired = read_cycles();
+	}
+}
+
+static void stats_released(unsigned flags, uint64_t *acquired, spinlock_stats_t *stats)
+{
+	uint64_t now;
+
+	if (flags & SPINLOCK_STATS) {
+		now = read_cycles();
+		if ((now > *acquired) && ((now - *acquired) > stats->max_hold)) {
+			stats->max_hold = now - *acquired;
+		}
+	}
+}
+
+static void stats_copy(spinlock_stats_t *from, spinlock_stats_t *to, BOOL reset)
+{
+	if (to) {
+		*to = *from;
+	}
+
+	if (reset) {
+		from->acquisitions = 0;
+		from->contended = 0;
+		from->spins = 0;
+		from->max_hold = 0;
+	}
+}
+
+static unsigned ticket_acquire(spinlock_t *sl, BOOL can_yield)
+{
+	unsigned ticket = __sync_fetch_and_add(&sl->next, 1);
+	unsigned spins = 0;
+
+	while (ticket != sl->owner) {
+		spin_wait(++spins, can_yield);
+	}
+
+	barrier();
+
+	return (spins);
+}
+
+static void ticket_release(spinlock_t *sl)
+{
+	barrier();
+
+	/*
+	 * Only the owner writes this field
+	 */
+	sl->owner++;
+}
+
 void spinlock_init(spinlock_t *sl)
 {
-	*sl = FALSE;
+	spinlock_init_flags(sl, 0);
+}
+
+void spinlock_init_flags(spinlock_t *sl, unsigned flags)
+{
+	sl->next = 0;
+	sl->owner = 0;
+	sl->flags = flags;
+	sl->acquired = 0;
+	stats_copy(&sl->stats, NULL, TRUE);
 }
 
 void spinlock_lock(spinlock_t *sl)
 {
-	while (TRUE == *sl) {
-		thread_suspend();
+	unsigned spins = ticket_acquire(sl, TRUE);
+
+	stats_acquired(sl->flags, &sl->acquired, &sl->stats, spins);
+}
+
+BOOL spinlock_trylock(spinlock_t *sl)
+{
+	unsigned ticket = sl->owner;
+
+	if ((ticket != sl->next) || !__sync_bool_compare_and_swap(&sl->next, ticket, ticket + 1)) {
+		return (FALSE);
 	}
 
-	*sl = TRUE;
+	barrier();
+
+	stats_acquired(sl->flags, &sl->acquired, &sl->stats, 0);
+
+	return (TRUE);
 }
 
 void spinlock_unlock(spinlock_t *sl)
 {
-	*sl = FALSE;
+	stats_released(sl->flags, &sl->acquired, &sl->stats);
+	ticket_release(sl);
+}
+
+unsigned spinlock_lock_irqsave(spinlock_t *sl)
+{
+	unsigned flags = cpu_irq_save();
+	unsigned spins = ticket_acquire(sl, FALSE);
+
+	stats_acquired(sl->flags, &sl->acquired, &sl->stats, spins);
+
+	return (flags);
+}
+
+void spinlock_unlock_irqrestore(spinlock_t *sl, unsigned flags)
+{
+	stats_released(sl->flags, &sl->acquired, &sl->stats);
+	ticket_release(sl);
+	cpu_irq_restore(flags);
+}
+
+BOOL spinlock_get_stats(spinlock_t *sl, spinlock_stats_t *stats, BOOL reset)
+{
+	if (!(sl->flags & SPINLOCK_STATS)) {
+		return (FALSE);
+	}
+
+	ticket_acquire(sl, TRUE);
+	stats_copy(&sl->stats, stats, reset);
+	ticket_release(sl);
+
+	return (TRUE);
+}
+
+static unsigned mcs_acquire(mcslock_t *ml, mcs_node_t *node, BOOL can_yield)
+{
+	mcs_node_t *pred;
+	unsigned spins = 0;
+
+	node->next = NULL;
+	node->locked = TRUE;
+
+	/*
+	 * Queue the node, then spin on it until the predecessor hands
+	 * the lock over.
+	 */
+	pred = __sync_lock_test_and_set(&ml->tail, node);
+	if (pred) {
+		pred->next = node;
+		while (node->locked) {
+			spin_wait(++spins, can_yield);
+		}
+	}
+
+	barrier();
+
+	return (spins);
+}
+
+static void mcs_release(mcslock_t *ml, mcs_node_t *node, BOOL can_yield)
+{
+	unsigned spins = 0;
+
+	barrier();
+
+	if (!node->next) {
+		if (__sync_bool_compare_and_swap(&ml->tail, node, NULL)) {
+			return;
+		}
+
+		/*
+		 * A successor swapped the tail but has not linked itself yet
+		 */
+		while (!node->next) {
+			spin_wait(++spins, can_yield);
+		}
+	}
+
+	node->next->locked = FALSE;
+}
+
+void mcslock_init(mcslock_t *ml, unsigned flags)
+{
+	ml->tail = NULL;
+	ml->flags = flags;
+	ml->acquired = 0;
+	stats_copy(&ml->stats, NULL, TRUE);
+}
+
+void mcslock_lock(mcslock_t *ml, mcs_node_t *node)
+{
+	unsigned spins = mcs_acquire(ml, node, TRUE);
+
+	stats_acquired(ml->flags, &ml->acquired, &ml->stats, spins);
+}
+
+void mcslock_unlock(mcslock_t *ml, mcs_node_t *node)
+{
+	stats_released(ml->flags, &ml->acquired, &ml->stats);
+	mcs_release(ml, node, TRUE);
+}
+
+unsigned mcslock_lock_irqsave(mcslock_t *ml, mcs_node_t *node)
+{
+	unsigned flags = cpu_irq_save();
+	unsigned spins = mcs_acquire(ml, node, FALSE);
+
+	stats_acquired(ml->flags, &ml->acquired, &ml->stats, spins);
+
+	return (flags);
+}
+
+void mcslock_unlock_irqrestore(mcslock_t *ml, mcs_node_t *node, unsigned flags)
+{
+	stats_released(ml->flags, &ml->acquired, &ml->stats);
+	mcs_release(ml, node, FALSE);
+	cpu_irq_restore(flags);
+}
+
+BOOL mcslock_get_stats(mcslock_t *ml, spinlock_stats_t *stats, BOOL reset)
+{
+	mcs_node_t node;
+
+	if (!(ml->flags & SPINLOCK_STATS)) {
+		return (FALSE);
+	}
+
+	mcs_acquire(ml, &node, TRUE);
+	stats_copy(&ml->stats, stats, reset);
+	mcs_release(ml, &node, TRUE);
+
+	return (TRUE);
 }
@@ -0,0 +1,505 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <diegos/interrupts.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/tasks.h>
+#include <libs/list.h>
+#include <libs/queue.h>
+#include <libs/red_black_tree.h>
+
+#include "tasks_private.h"
+#include "io_waits_private.h"
+#include "events_private.h"
+#include "scheduler.h"
+#include "kprintf.h"
+
+struct task_runner {
+	list_node header;
+	queue_inst ready;
+	/*
+	 * Sleeping tasks sorted by deadline and the cached earliest one
+	 */
+	rbtree_node_t *sleeping;
+	task_t *earliest;
+	/*
+	 * The runner thread waits on evq while no task is ready,
+	 * kick is queued to wake it up.
+	 */
+	ev_queue_t *evq;
+	event_t kick;
+	BOOL idle;
+	task_exit_fn exitfn;
+	tid_t tid;
+	char name[16];
+	unsigned tasks;
+	unsigned sleepers;
+	unsigned max_ready;
+	uint64_t resumes;
+	uint64_t wakeups;
+	uint64_t idles;
+};
+
+#define READY_TO_TASK(ptr)	\
+	((task_t *)((char *)(ptr) - offsetof(task_t, ready)))
+
+static list_inst runners_list;
+
+/*
+ * Tasks sleeping until the same time are sorted by address,
+ * the tree does not accept duplicated keys.
+ */
+static int task_cmp(const rbtree_node_t *a, const rbtree_node_t *b)
+{
+	const task_t *ta = (const task_t *)a;
+	const task_t *tb = (const task_t *)b;
+
+	if (ta->deadline != tb->deadline) {
+		return ((ta->deadline < tb->deadline) ? KEY_LOWER : KEY_GREATER);
+	}
+
+	if (ta != tb) {
+		return ((ta < tb) ? KEY_LOWER : KEY_GREATER);
+	}
+
+	return (KEY_EQUAL);
+}
+
+/*
+ * Put a task to sleep until now + msecs, interrupts must be disabled
+ */
+static BOOL task_arm(task_t *task, unsigned msecs)
+{
+	task_runner_t *runner = task->runner;
+
+	task->deadline = clock_get_milliseconds() + msecs;
+
+	if (!rbtree_insert(&runner->sleeping, &task->header, task_cmp)) {
+		kerrprintf("failed arming task %p in runner %s\n", task, runner->name);
+		return (FALSE);
+	}
+
+	++runner->sleepers;
+
+	if (!runner->earliest || (KEY_LOWER == task_cmp(&task->header, &runner->earliest->header))) {
+		runner->earliest = task;
+	}
+
+	return (TRUE);
+}
+
+/*
+ * Wake a sleeping task before its deadline, interrupts must be disabled
+ */
+static void task_disarm(task_t *task)
+{
+	task_runner_t *runner = task->runner;
+
+	rbtree_extract(&runner->sleeping, &task->header, task_cmp);
+	--runner->sleepers;
+
+	if (task == runner->earliest) {
+		runner->earliest = (task_t *)rbtree_first(runner->sleeping);
+	}
+}
+
+/*
+ * Queue a task to the runner, the runner thread is woken up if idle.
+ * Interrupts must be disabled.
+ */
+static void task_ready(task_t *task, unsigned reason)
+{
+	task_runner_t *runner = task->runner;
+
+	if (task->wait & TASK_WAKE_TIMER) {
+		task_disarm(task);
+	}
+
+	task->wait = TASK_WAKE_READY;
+	task->woken = reason;
+
+	queue_enqueue(&runner->ready, &task->ready);
+	if (queue_count(&runner->ready) > runner->max_ready) {
+		runner->max_ready = queue_count(&runner->ready);
+	}
+
+	if (runner->idle) {
+		runner->idle = FALSE;
+		event_put(runner->evq, &runner->kick, NULL);
+	}
+}
+
+/*
+ * Wake a task if it is waiting for reason, interrupts must be disabled
+ */
+static void task_wakeup(task_t *task, unsigned reason)
+{
+	if (task->runner && (task->wait & reason)) {
+		++task->runner->wakeups;
+		task_ready(task, reason);
+	}
+}
+
+/*
+ * Release the events left in the mailbox of a terminated task
+ */
+static void task_exit(task_runner_t *runner, task_t *task)
+{
+	queue_node *ptr;
+
+	lock();
+
+	if (queue_count(&task->mailbox)) {
+		kwrnprintf("there are %d events left to a task of runner %s\n",
+			   queue_count(&task->mailbox), runner->name);
+		while (EOK == queue_dequeue(&task->mailbox, &ptr)) {
+			event_free((event_t *)ptr);
+		}
+	}
+
+	task->runner = NULL;
+	task->wait = 0;
+	--runner->tasks;
+
+	unlock();
+
+	if (runner->exitfn) {
+		runner->exitfn(task);
+	}
+}
+
+/*
+ * Wake the sleeping tasks whose deadline is past
+ * and compute the time to the next deadline.
+ * Interrupts must be disabled.
+ *
+ * RETURNS
+ * the milliseconds to the earliest deadline, 0 if no task sleeps.
+ */
+static unsigned task_expire(task_runner_t *runner, uint64_t now)
+{
+	uint64_t delta;
+
+	while (runner->earliest && (runner->earliest->deadline <= now)) {
+		task_wakeup(runner->earliest, TASK_WAKE_TIMER);
+	}
+
+	if (!runner->earliest) {
+		return (0);
+	}
+
+	delta = runner->earliest->deadline - now;
+	if (delta > -1U) {
+		delta = -1U;
+	}
+
+	return ((unsigned)delta);
+}
+
+task_runner_t *task_runner_create(const char *name, task_exit_fn exitfn)
+{
+	task_runner_t *runner = calloc(1, sizeof(task_runner_t));
+
+	if (!runner) {
+		return (NULL);
+	}
+
+	if (name) {
+		snprintf(runner->name, sizeof(runner->name), "%s", name);
+	} else {
+		snprintf(runner->name, sizeof(runner->name), "Runner%x", (intptr_t) runner);
+	}
+
+	runner->evq = event_init_queue(runner->name);
+	if (!runner->evq) {
+		free(runner);
+		return (NULL);
+	}
+
+	if ((EOK != queue_init(&runner->ready)) ||
+	    (EOK != list_append(&runners_list, &runner->header))) {
+		event_done_queue(runner->evq);
+		free(runner);
+		return (NULL);
+	}
+
+	runner->exitfn = exitfn;
+	runner->tid = THREAD_TID_INVALID;
+
+	return (runner);
+}
+
+int task_runner_run(task_runner_t *runner)
+{
+	queue_node *ptr;
+	task_t *task;
+	unsigned batch, msecs;
+
+	if (!runner || (EOK != event_watch_queue(runner->evq))) {
+		return (EINVAL);
+	}
+
+	runner->tid = scheduler_running_tid();
+
+	while (TRUE) {
+		lock();
+		msecs = task_expire(runner, clock_get_milliseconds());
+		batch = queue_count(&runner->ready);
+		if (!batch) {
+			runner->idle = TRUE;
+			++runner->idles;
+		}
+		unlock();
+
+		if (!batch) {
+			/*
+			 * Tasks made ready after the check kick the queue,
+			 * the wait returns at once.
+			 */
+			event_wait_quiet(runner->evq, msecs);
+			lock();
+			runner->idle = FALSE;
+			unlock();
+			while (event_get(runner->evq)) {
+			}
+			continue;
+		}
+
+		/*
+		 * Tasks made ready while running the batch run in the next one,
+		 * after the sleepers have been expired again.
+		 */
+		while (batch--) {
+			lock();
+			if (EOK != queue_dequeue(&runner->ready, &ptr)) {
+				unlock();
+				break;
+			}
+			task = READY_TO_TASK(ptr);
+			task->wait = 0;
+			++runner->resumes;
+			unlock();
+
+			if (TASK_EXITED == task->fn(task)) {
+				task_exit(runner, task);
+			}
+		}
+
+		thread_may_suspend();
+	}
+
+	return (EOK);
+}
+
+int task_start(task_runner_t *runner, task_t *task, task_fn fn, void *arg)
+{
+	if (!runner || !task || !fn) {
+		return (EINVAL);
+	}
+
+	task->header.left = NULL;
+	task->header.right = NULL;
+	task->header.flags = 0;
+	task->ready.next = NULL;
+	queue_init(&task->mailbox);
+	task->deadline = 0;
+	task->fn = fn;
+	task->arg = arg;
+	task->runner = runner;
+	task->lc = 0;
+	task->wait = 0;
+	task->woken = 0;
+
+	lock();
+	++runner->tasks;
+	task_ready(task, TASK_WAKE_READY);
+	unlock();
+
+	return (EOK);
+}
+
+int task_send(task_t *task, event_t *ev, event_freefn fncb)
+{
+	if (!task || !ev) {
+		return (EINVAL);
+	}
+
+	ev->freefn = fncb;
+
+	lock();
+
+	if (!task->runner || (EOK != queue_enqueue(&task->mailbox, &ev->header))) {
+		unlock();
+		return (EPERM);
+	}
+
+	task_wakeup(task, TASK_WAKE_EVENT);
+
+	unlock();
+
+	return (EOK);
+}
+
+void task_yield(task_t *task)
+{
+	if (task && task->runner) {
+		lock();
+		task_ready(task, TASK_WAKE_READY);
+		unlock();
+	}
+}
+
+int task_sleep(task_t *task, unsigned msecs)
+{
+	if (!task || !task->runner) {
+		return (EINVAL);
+	}
+
+	lock();
+
+	if (msecs && task_arm(task, msecs)) {
+		task->wait = TASK_WAKE_TIMER;
+	} else {
+		task_ready(task, TASK_WAKE_READY);
+	}
+
+	unlock();
+
+	return (EAGAIN);
+}
+
+int task_event_wait(task_t *task, event_t **ev, unsigned msecs)
+{
+	if (!task || !task->runner || !ev) {
+		return (EINVAL);
+	}
+
+	lock();
+
+	if (EOK == queue_dequeue(&task->mailbox, (queue_node **) ev)) {
+		unlock();
+		return (EOK);
+	}
+
+	task->wait = TASK_WAKE_EVENT;
+	if (msecs && task_arm(task, msecs)) {
+		task->wait |= TASK_WAKE_TIMER;
+	}
+
+	unlock();
+
+	*ev = NULL;
+
+	return (EAGAIN);
+}
+
+event_t *task_event_get(task_t *task)
+{
+	queue_node *ptr = NULL;
+
+	if (!task) {
+		return (NULL);
+	}
+
+	lock();
+	if (EOK != queue_dequeue(&task->mailbox, &ptr)) {
+		ptr = NULL;
+	}
+	unlock();
+
+	return ((event_t *)ptr);
+}
+
+int task_io_wait(task_t *task, wait_queue_t *wq)
+{
+	struct wait_queue_item *item;
+
+	if (!task || !task->runner || !wq) {
+		return (EINVAL);
+	}
+
+	item = io_wait_get_item();
+	if (!item) {
+		return (EPERM);
+	}
+
+	item->flags = IO_WAIT_TASK;
+	item->pt = task;
+
+	lock();
+
+	task->wait = TASK_WAKE_IO;
+	if (EOK != io_wait_add(item, wq)) {
+		task->wait = 0;
+		unlock();
+		io_wait_put_item(item);
+		return (EPERM);
+	}
+
+	unlock();
+
+	return (EAGAIN);
+}
+
+static void dump_internal(const task_runner_t *runner)
+{
+	printf("%-15s | %5u | %8u | %8u | %8u | %10llu | %10llu | %8llu | %u\n", runner->name,
+	       runner->tid, runner->tasks, queue_count((queue_inst *)&runner->ready),
+	       runner->sleepers, runner->resumes, runner->wakeups, runner->idles,
+	       runner->max_ready);
+}
+
+void task_runner_dump(task_runner_t *runner)
+{
+	if (!runner) {
+		printf("\n--- TASK RUNNERS TABLE (%u bytes per task) ------------------------------------\n\n",
+		       (unsigned)sizeof(task_t));
+	}
+	printf("%-15s   %5s   %8s   %8s   %8s   %10s   %10s   %8s   %s\n", "RUNNER NAME", "TID",
+	       "TASKS", "READY", "SLEEPING", "RESUMES", "WAKEUPS", "IDLES", "MAX READY");
+	printf("_________________________________________________________________________________________________\n");
+	if (runner) {
+		dump_internal(runner);
+	} else {
+		runner = list_head(&runners_list);
+		while (runner) {
+			dump_internal(runner);
+			runner = (task_runner_t *)runner->header.next;
+		}
+	}
+	printf("-------------------------------------------------------------------------------------------------\n\n");
+}
+
+/*
+ * Private section
+ */
+
+void task_io_resume(void *task)
+{
+	task_wakeup((task_t *)task, TASK_WAKE_IO);
+}
+
+BOOL init_tasks_lib()
+{
+	return ((EOK == list_init(&runners_list)) ? TRUE : FALSE);
+}
@@ -20,106 +20,197 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <diegos/interrupts.h>
+
 #include "platform_include.h"
 #include "threads.h"
 #include "scheduler.h"
 #include "fail_safe.h"
 #include "kprintf.h"
 
-static thread_t *thread_storage = NULL;
+/*
+ * One interrupt stack per processor, see int_stack_used()
+ */
+#ifdef ENABLE_SMP
+#define INT_STACKS	(DIEGOS_MAX_CPUS)
+#else
+#define INT_STACKS	(1)
+#endif
+
+/*
+ * Thread table, indexed by TID.
+ * Threads are allocated one by one so that their address never changes,
+ * the table holds pointers only and doubles its size when all TIDs are
+ * in use, a TID lookup is always O(1).
+ */
+static thread_t **thread_table = NULL;
+
+static tid_t table_size = 0;
+
+/*
+ * Stack of free TIDs. A grown table starts with its lowest new TID on
+ * top, released TIDs are pushed back and reused first (LIFO).
+ */
+static tid_t *free_tids = NULL;
+
+static tid_t free_count = 0;
 
 static unsigned thread_num = 0;
 
-BOOL init_thread_lib()
+/*
+ * Double the thread table, the first call allocates DIEGOS_MAX_THREADS
+ * entries. It is called only when no TID is free.
+ */
+static BOOL grow_thread_table(void)
 {
-	unsigned i;
+	thread_t **new_table, **old_table;
+	tid_t *new_free, *old_free;
+	tid_t i, new_size;
 
-	if (DIEGOS_MAX_THREADS >= THREAD_TID_INVALID) {
+	new_size = (table_size) ? (table_size * 2) : (DIEGOS_MAX_THREADS);
+	if ((new_size <= table_size) || (new_size >= THREAD_TID_INVALID) ||
+	    (new_size > ((size_t)-1) / sizeof(*new_table))) {
 		return (FALSE);
 	}
 
-	thread_storage = (thread_t *) malloc(DIEGOS_MAX_THREADS * sizeof(*thread_storage));
-	if (!thread_storage) {
+	new_table = (thread_t **) malloc(new_size * sizeof(*new_table));
+	new_free = (tid_t *) malloc(new_size * sizeof(*new_free));
+	if (!new_table || !new_free) {
+		free(new_table);
+		free(new_free);
 		return (FALSE);
 	}
 
-	memset(thread_storage, 0, DIEGOS_MAX_THREADS * sizeof(*thread_storage));
+	memset(new_table, 0, new_size * sizeof(*new_table));
+	if (table_size) {
+		memcpy(new_table, thread_table, table_size * sizeof(*new_table));
+	}
 
-	for (i = 0; i < DIEGOS_MAX_THREADS; i++) {
-		thread_storage[i].tid = THREAD_TID_INVALID;
+	/*
+	 * The free stack is empty, push the new TIDs highest first
+	 */
+	for (i = 0; i < new_size - table_size; i++) {
+		new_free[i] = new_size - 1 - i;
 	}
 
+	lock();
+	old_table = thread_table;
+	old_free = free_tids;
+	thread_table = new_table;
+	free_tids = new_free;
+	free_count = new_size - table_size;
+	table_size = new_size;
+	unlock();
+
+	free(old_table);
+	free(old_free);
+
+	kmsgprintf("Thread table grown to %u entries\n", new_size);
+
 	return (TRUE);
 }
 
-uint8_t init_thread(const char *name,
-		    uint8_t prio, void (*entry_ptr)(void), void *stack, uint32_t stack_size)
+BOOL init_thread_lib()
+{
+	if (DIEGOS_MAX_THREADS < 2) {
+		return (FALSE);
+	}
+
+	return (grow_thread_table());
+}
+
+tid_t init_thread(const char *name,
+		  uint8_t prio, void (*entry_ptr)(void), void *stack, uint32_t stack_size)
 {
-	uint32_t i, new_tid = THREAD_TID_INVALID;
+	thread_t *th;
+	tid_t i, new_tid;
 
-	if ((DIEGOS_MAX_THREADS == thread_num) || (!name) || (!entry_ptr)
-	    || !(prio < THREAD_PRIORITIES)) {
+	if ((!name) || (!entry_ptr) || !(prio < THREAD_PRIORITIES)) {
 		return THREAD_TID_INVALID;
 	}
 
 	/*
-	 * Double function : trace first available slot,
-	 * seek no other processes have his name.
-	 * Do NOT bail out once an empty slot is found, need to go all
-	 * way down to DIEGOS_MAX_THREADS to check all names.
+	 * Names must be unique
 	 */
-	for (i = 0; i < DIEGOS_MAX_THREADS; i++) {
-		if ((new_tid == THREAD_TID_INVALID) &&
-		    !thread_storage[i].name[0] && (thread_storage[i].tid == THREAD_TID_INVALID)) {
-			new_tid = i;
-		} else if (!strncmp(thread_storage[i].name, name, THREAD_NAME_MAX)) {
+	for (i = 0; i < table_size; i++) {
+		if (thread_table[i] && !strncmp(thread_table[i]->name, name, THREAD_NAME_MAX)) {
 			return THREAD_TID_INVALID;
 		}
 	}
 
+	if (!free_count && !grow_thread_table()) {
+		return THREAD_TID_INVALID;
+	}
+
+	th = (thread_t *) malloc(sizeof(*th));
+	if (!th) {
+		return THREAD_TID_INVALID;
+	}
+
+	memset(th, 0, sizeof(*th));
+
 	/*
 	 * Stack check ...
 	 */
 	if (stack) {
-		thread_storage[new_tid].stack = stack;
+		th->stack = stack;
 	} else {
-		thread_storage[new_tid].stack = malloc(stack_size);
-		thread_storage[new_tid].flags |= THREAD_FLAG_REL_STACK;
+		th->stack = malloc(stack_size);
+		th->flags |= THREAD_FLAG_REL_STACK;
+	}
+
+	if (!th->stack) {
+		free(th);
+		return THREAD_TID_INVALID;
 	}
 
-	if (!thread_storage[new_tid].stack) {
-		thread_storage[new_tid].flags = 0;
+	new_tid = free_tids[free_count - 1];
+
+	if (!prepare_context(new_tid)) {
+		if (th->flags & THREAD_FLAG_REL_STACK) {
+			free(th->stack);
+		}
+		free(th);
 		return THREAD_TID_INVALID;
 	}
 
-	thread_storage[new_tid].stack_size = stack_size;
+	th->stack_size = stack_size;
 
 	/* Mark stack space for tracing */
-	memset(thread_storage[new_tid].stack, 0xdf, stack_size);
+	memset(th->stack, 0xdf, stack_size);
 
 	/*
 	 * OK GO!
 	 */
-	strncpy(thread_storage[new_tid].name, name, THREAD_NAME_MAX);
-	thread_storage[new_tid].name[THREAD_NAME_MAX] = 0;
-	thread_storage[new_tid].priority = prio;
-	thread_storage[new_tid].state = THREAD_READY;
-	thread_storage[new_tid].tid = new_tid;
-	thread_storage[new_tid].entry_ptr = entry_ptr;
-	thread_storage[new_tid].delay = 0;
+	strncpy(th->name, name, THREAD_NAME_MAX);
+	th->name[THREAD_NAME_MAX] = 0;
+	th->priority = prio;
+	th->base_priority = prio;
+	th->wait_node.thread = th;
+	th->state = THREAD_READY;
+	th->tid = new_tid;
+	th->entry_ptr = entry_ptr;
+	tq_node_init(&th->timeout, NULL);
+
+#ifdef ENABLE_SMP
+	setup_context(th->stack + stack_size, scheduler_fail_safe, scheduler_thread_start,
+		      &th->context);
+#else
+	setup_context(th->stack + stack_size, scheduler_fail_safe, th->entry_ptr, &th->context);
+#endif
+
+	lock();
+	--free_count;
+	thread_table[new_tid] = th;
+	unlock();
 
 	thread_num++;
 
-	setup_context(thread_storage[new_tid].stack + stack_size,
-		      scheduler_fail_safe,
-		      thread_storage[new_tid].entry_ptr, &thread_storage[new_tid].context);
-
-	kmsgprintf("Created thread %s TID %u Stack is at %p\n",
-		   thread_storage[new_tid].name, new_tid, thread_storage[new_tid].stack);
+	kmsgprintf("Created thread %s TID %u Stack is at %p\n", th->name, new_tid, th->stack);
 	return (new_tid);
 }
 
-BOOL done_thread(uint8_t tid)
+BOOL done_thread(tid_t tid)
 {
 	char name[THREAD_NAME_MAX + 1];
 	thread_t *th = get_thread(tid);
@@ -131,8 +222,13 @@ BOOL done_thread(uint8_t tid)
 			free(th->stack);
 		}
 		cleanup_context(th->context, tid);
-		memset(th, 0, sizeof(*th));
-		th->tid = THREAD_TID_INVALID;
+
+		lock();
+		thread_table[tid] = NULL;
+		free_tids[free_count++] = tid;
+		unlock();
+
+		free(th);
 		--thread_num;
 		kprintf("TID %u [%s] killed\n", tid, name);
 		return (TRUE);
@@ -141,16 +237,25 @@ BOOL done_thread(uint8_t tid)
 	return (FALSE);
 }
 
-thread_t *get_thread(uint8_t tid)
+thread_t *get_thread(tid_t tid)
 {
-	if ((tid < THREAD_TID_INVALID) &&
-	    (tid < DIEGOS_MAX_THREADS) && (thread_storage[tid].tid == tid)) {
-		return (&thread_storage[tid]);
+	if (tid < table_size) {
+		return (thread_table[tid]);
 	}
 
 	return (NULL);
 }
 
+tid_t thread_table_size()
+{
+	return (table_size);
+}
+
+unsigned thread_count()
+{
+	return (thread_num);
+}
+
 const char *state2str(uint8_t state)
 {
 	switch (state) {
@@ -169,7 +274,7 @@ const char *state2str(uint8_t state)
 
 const char *flags2str(uint32_t flags)
 {
-	static char flagstr[36];
+	static char flagstr[52];
 
 	flagstr[0] = 0;
 
@@ -194,30 +299,57 @@ const char *flags2str(uint32_t flags)
 	if (flags & THREAD_FLAG_WAIT_COMPLETION) {
 		strcat(flagstr, "WCOM ");
 	}
+	if (flags & THREAD_FLAG_WAIT_SEMAPHORE) {
+		strcat(flagstr, "WSEM ");
+	}
+	if (flags & THREAD_FLAG_WAIT_CONDVAR) {
+		strcat(flagstr, "WCND ");
+	}
+	if (flags & THREAD_FLAG_WAIT_RWLOCK) {
+		strcat(flagstr, "WRWL ");
+	}
 
 	return (flagstr);
 }
 
+uint32_t thread_stack_used(const thread_t *th)
+{
+	const uint32_t *stack_top = (const uint32_t *)(th->stack);
+	uint32_t j = 0;
+
+	while ((j < th->stack_size / sizeof(uint32_t)) && (0xdfdfdfdfUL == stack_top[j])) {
+		++j;
+	}
+
+	return (th->stack_size - j * sizeof(uint32_t));
+}
+
 void check_thread_stack()
 {
-	unsigned i, j;
-	uint32_t *stack_top;
+	thread_t *th;
+	unsigned i, used, size;
 
-	for (i = 0; i < DIEGOS_MAX_THREADS; i++) {
-		if (thread_storage[i].tid == THREAD_TID_INVALID) {
+	for (i = 0; i < table_size; i++) {
+		th = thread_table[i];
+		if (!th) {
 			continue;
 		}
-		j = 0;
-		stack_top = (uint32_t *) (thread_storage[i].stack);
-		while (0xdfdfdfdfUL == *stack_top++) {
-			++j;
-		}
-		if (!j) {
+		used = thread_stack_used(th);
+		if (used >= th->stack_size) {
 			kerrprintf("Thread %u [%s] stack overflow !!!\n",
-				   i, thread_storage[i].name);
+				   i, th->name);
+		} else {
+			kprintf("Thread %u [%s] stack used: %u of %u Bytes\n",
+				i, th->name, used, th->stack_size);
+		}
+	}
+
+	for (i = 0; i < INT_STACKS; i++) {
+		used = int_stack_used(i, &size);
+		if (used >= size) {
+			kerrprintf("CPU %u interrupt stack overflow !!!\n", i);
 		} else {
-			kprintf("Thread %u [%s] stack free: %u Bytes\n",
-				i, thread_storage[i].name, j * 4);
+			kprintf("CPU %u interrupt stack used: %u of %u Bytes\n", i, used, size);
 		}
 	}
 }
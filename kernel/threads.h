@@ -24,17 +24,35 @@
 
 BOOL init_thread_lib(void);
 
-uint8_t init_thread(const char *name,
-		    uint8_t prio, void (*entry_ptr)(void), void *stack, uint32_t stack_size);
+tid_t init_thread(const char *name,
+		  uint8_t prio, void (*entry_ptr)(void), void *stack, uint32_t stack_size);
 
-BOOL done_thread(uint8_t tid);
+BOOL done_thread(tid_t tid);
 
-thread_t *get_thread(uint8_t tid);
+thread_t *get_thread(tid_t tid);
+
+/*
+ * Current size of the thread table, all valid TIDs are lower;
+ * the table grows at runtime.
+ */
+tid_t thread_table_size(void);
+
+/*
+ * Number of existing threads
+ */
+unsigned thread_count(void);
 
 const char *state2str(uint8_t state);
 
 const char *flags2str(uint32_t flags);
 
+/*
+ * High water mark of a thread stack in bytes, the stack is filled
+ * with a pattern at thread creation and scanned up to the first
+ * overwritten word.
+ */
+uint32_t thread_stack_used(const thread_t * th);
+
 void check_thread_stack(void);
 
 #endif				// THREADS_H_INCLUDED
@@ -21,15 +21,21 @@
 #define THREADS_DATA_H_INCLUDED
 
 #include <types_common.h>
+#include <stddef.h>
 #include <libs/queue.h>
+#include <libs/list_type.h>
+#include <diegos/kernel.h>
+#include "timer_queue.h"
 
 #define THREAD_TID_IDLE     (0)
 #define THREAD_TID_TMRS     (1)
-#define THREAD_TID_INVALID  (255)
+#define THREAD_TID_INVALID  ((tid_t)-1)
 #define THREAD_NAME_MAX     (15)
-#define THREAD_PRIORITIES   (4)
+#define THREAD_PRIORITIES   (THREAD_PRIO_LEVELS)
 #define THREAD_DEF_STACK    (2*1024)
 
+struct mutex;
+
 enum {
 	THREAD_RUNNING,
 	THREAD_WAITING,
@@ -45,15 +51,40 @@ enum {
 	THREAD_FLAG_WAIT_EVENT = 1 << 4,
 	THREAD_FLAG_WAIT_BARRIER = 1 << 5,
 	THREAD_FLAG_WAIT_COMPLETION = 1 << 6,
+	THREAD_FLAG_WAIT_SEMAPHORE = 1 << 7,
+	THREAD_FLAG_WAIT_CONDVAR = 1 << 8,
+	THREAD_FLAG_WAIT_RWLOCK = 1 << 9,
 	THREAD_MASK_WAIT = (THREAD_FLAG_WAIT_TIMEOUT |
 			    THREAD_FLAG_WAIT_MUTEX |
 			    THREAD_FLAG_WAIT_EVENT |
-			    THREAD_FLAG_WAIT_BARRIER | THREAD_FLAG_WAIT_COMPLETION),
+			    THREAD_FLAG_WAIT_BARRIER | THREAD_FLAG_WAIT_COMPLETION |
+			    THREAD_FLAG_WAIT_SEMAPHORE | THREAD_FLAG_WAIT_CONDVAR |
+			    THREAD_FLAG_WAIT_RWLOCK),
 	THREAD_MASK_EVENTS = (THREAD_FLAG_WAIT_MUTEX |
 			      THREAD_FLAG_WAIT_EVENT |
-			      THREAD_FLAG_WAIT_BARRIER | THREAD_FLAG_WAIT_COMPLETION)
+			      THREAD_FLAG_WAIT_BARRIER | THREAD_FLAG_WAIT_COMPLETION |
+			      THREAD_FLAG_WAIT_SEMAPHORE | THREAD_FLAG_WAIT_CONDVAR |
+			      THREAD_FLAG_WAIT_RWLOCK)
 };
 
+/*
+ * Link of a waiting thread in the waiters list of an object.
+ * A thread waiting on a single object uses the node embedded in its
+ * thread_t, a thread waiting on multiple objects at once uses a set of
+ * nodes, one per object, all pointing back to it.
+ */
+typedef struct wait_node {
+	/*
+	 * Must be the first field
+	 */
+	list_node header;
+	/*
+	 * The waiters list the node is linked in, NULL if unlinked
+	 */
+	list_inst *list;
+	struct thread *thread;
+} wait_node_t;
+
 typedef struct thread {
 	/*
 	 * Container structure is a single linked list (queue)
@@ -71,25 +102,106 @@ typedef struct thread {
 	 * Thread properties: priority, state machine's state,
 	 * flags (mainly for event wait loops), thread id.
 	 */
-	uint32_t priority:4;
-	uint32_t state:8;
+	uint32_t priority:5;
+	uint32_t state:7;
 	uint32_t flags:12;
-	uint32_t tid:8;
+	tid_t tid;
+	/*
+	 * Processor the thread runs on, or whose ready queues hold it
+	 */
+	uint32_t cpu;
 	/*
 	 * Thread entry point, NO return value, NO parameters
 	 */
 	void (*entry_ptr)(void);
 	/*
-	 * Thread's own stack, this will be used by interrupts
-	 * if they happen while this thread is executing - there
-	 * is a minimum stack size requirement.
+	 * Thread's own stack; interrupts happening while this thread
+	 * is executing only push the interrupted context here, handlers
+	 * run on the interrupt stack of the processor.
 	 */
 	void *stack;
 	uint32_t stack_size;
 	/*
-	 * Delay in milliseconds for sleeping/waiting threads
+	 * Timer queue node for sleeping threads and for
+	 * threads waiting with a timeout
+	 */
+	tq_node_t timeout;
+	/*
+	 * Preemption disable nesting counter, the thread cannot
+	 * be preempted while this is not 0
+	 */
+	uint32_t preempt_off;
+	/*
+	 * Involuntary context switches (preemptions) suffered
+	 * by the thread
+	 */
+	uint32_t involuntary;
+	/*
+	 * Voluntary context switches: waits, delays and yields
+	 */
+	uint32_t voluntary;
+	/*
+	 * CPU accounting in processor cycles: time spent running and time
+	 * spent in the ready queues, with the stamps of the last switch in
+	 * and of the last enqueue in a ready queue
 	 */
-	uint64_t delay;
+	uint64_t run_cycles;
+	uint64_t ready_cycles;
+	uint64_t run_stamp;
+	uint64_t ready_stamp;
+	/*
+	 * Link in the waiters list of the object the thread is waiting on;
+	 * when waiting on multiple objects, the set of links instead
+	 */
+	wait_node_t wait_node;
+	wait_node_t *wait_set;
+	uint32_t wait_set_size;
+	/*
+	 * Wait flags the thread was resumed with, THREAD_FLAG_WAIT_TIMEOUT
+	 * alone if the wait timed out, and the link of the object that
+	 * resumed it, if known
+	 */
+	uint32_t wake_flags;
+	wait_node_t *wake_node;
+	/*
+	 * Priority assigned at creation, priority may be temporarily
+	 * raised above it by priority inheritance
+	 */
+	uint8_t base_priority;
+	/*
+	 * Mutex the thread is blocked on, used to walk chains of owners
+	 */
+	struct mutex *blocked_on;
+	/*
+	 * Mutexes the thread holds, linked by their held field
+	 */
+	list_inst held_mutexes;
+	/*
+	 * Earliest deadline first class, edf_period is 0 for fixed
+	 * priority threads. Parameters in milliseconds and bandwidth
+	 * reserved on the processor in thousandths.
+	 */
+	uint32_t edf_runtime;
+	uint32_t edf_deadline;
+	uint32_t edf_period;
+	uint32_t edf_util;
+	/*
+	 * Current job: release time and absolute deadline in milliseconds
+	 * since boot, runtime budget and runtime used in processor cycles
+	 */
+	uint64_t edf_release;
+	uint64_t edf_abs_deadline;
+	uint64_t edf_budget;
+	uint64_t edf_used;
+	/*
+	 * Completed jobs, deadline misses and jobs postponed
+	 * for exceeding their runtime
+	 */
+	uint32_t edf_jobs;
+	uint32_t edf_misses;
+	uint32_t edf_overruns;
 } thread_t;
 
+#define WAIT_NODE_TO_THREAD(node)	(((wait_node_t *)(node))->thread)
+
 #endif				// THREADS_DATA_H_INCLUDED
@@ -0,0 +1,270 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <diegos/interrupts.h>
+#include <diegos/kernel_ticks.h>
+
+#include "timer_queue.h"
+#include "clock.h"
+#include "kprintf.h"
+
+/*
+ * Deadlines sorted by expiration time
+ */
+static rbtree_node_t *root = NULL;
+
+/*
+ * Cached leftmost node, the earliest deadline
+ */
+static tq_node_t *earliest = NULL;
+
+/*
+ * Interrupts expiring nodes, expired nodes and interrupts saved by slacks
+ */
+static uint64_t batches = 0;
+static uint64_t expirations = 0;
+static uint64_t saved = 0;
+
+/*
+ * Expiration time the clock has been programmed for, when slacks
+ * delayed it past the earliest deadline, 0 otherwise
+ */
+static uint64_t slack_target = 0;
+
+/*
+ * Nodes expiring at the same time are sorted by address,
+ * the tree does not accept duplicated keys.
+ */
+static int tq_cmp(const rbtree_node_t *a, const rbtree_node_t *b)
+{
+	const tq_node_t *na = (const tq_node_t *)a;
+	const tq_node_t *nb = (const tq_node_t *)b;
+
+	if (na->deadline != nb->deadline) {
+		return ((na->deadline < nb->deadline) ? KEY_LOWER : KEY_GREATER);
+	}
+
+	if (na != nb) {
+		return ((na < nb) ? KEY_LOWER : KEY_GREATER);
+	}
+
+	return (KEY_EQUAL);
+}
+
+/*
+ * Latest expiration time within the slack windows of the earliest nodes,
+ * interrupts must be disabled
+ */
+static uint64_t tq_coalesce(void)
+{
+	uint64_t target = earliest->deadline + earliest->slack;
+	rbtree_node_t *cursor = &earliest->header;
+	const tq_node_t *node;
+
+	while (target > earliest->deadline) {
+		cursor = rbtree_next(root, cursor, tq_cmp);
+		node = (const tq_node_t *)cursor;
+		if (!node || (node->deadline > target)) {
+			break;
+		}
+		if (node->deadline + node->slack < target) {
+			target = node->deadline + node->slack;
+		}
+	}
+
+	return (target);
+}
+
+/*
+ * Program the clock to expire at the earliest deadline, delayed
+ * within the slack windows.
+ * Interrupts must be disabled.
+ */
+static void tq_program(uint64_t now)
+{
+	uint64_t delta, target;
+
+	slack_target = 0;
+
+	if (!earliest) {
+		clock_set_period(-1U, CLK_INST_TIMER_QUEUE);
+		return;
+	}
+
+	target = (earliest->slack) ? tq_coalesce() : earliest->deadline;
+	if (target > earliest->deadline) {
+		slack_target = target;
+	}
+
+	delta = (target > now) ? (target - now) : 1;
+	if (delta > -1U) {
+		delta = -1U;
+	}
+
+	clock_set_period((unsigned)delta, CLK_INST_TIMER_QUEUE);
+}
+
+/*
+ * Unlink a node, interrupts must be disabled
+ */
+static void tq_unlink(tq_node_t *node)
+{
+	if (node->armed) {
+		rbtree_extract(&root, &node->header, tq_cmp);
+		node->armed = FALSE;
+		if (node == earliest) {
+			earliest = (tq_node_t *) rbtree_first(root);
+		}
+	}
+}
+
+/*
+ * Clock callback, expire all nodes whose deadline is past
+ */
+static void tq_clock_cb(uint64_t msecs)
+{
+	tq_node_t *node;
+	uint64_t last, target;
+
+	lock();
+
+	if (earliest && (earliest->deadline <= msecs)) {
+		++batches;
+		last = earliest->deadline;
+
+		/*
+		 * Only an interrupt delayed by slacks saves interrupts
+		 */
+		target = (slack_target && (slack_target <= msecs)) ? (slack_target) : (0);
+
+		while (earliest && (earliest->deadline <= msecs)) {
+			node = earliest;
+			/*
+			 * Without slacks each deadline up to the delayed
+			 * expiration would require an interrupt
+			 */
+			if ((node->deadline != last) && (node->deadline <= target)) {
+				last = node->deadline;
+				++saved;
+			}
+			++expirations;
+			tq_unlink(node);
+			node->expire(node, msecs);
+		}
+	}
+
+	tq_program(msecs);
+
+	unlock();
+}
+
+BOOL timer_queue_init()
+{
+	root = NULL;
+	earliest = NULL;
+
+	return (clock_add_cb(tq_clock_cb, CLK_INST_TIMER_QUEUE));
+}
+
+void tq_node_init(tq_node_t *node, tq_expire_fn fn)
+{
+	node->header.left = NULL;
+	node->header.right = NULL;
+	node->header.flags = 0;
+	node->deadline = 0;
+	node->slack = 0;
+	node->expire = fn;
+	node->armed = FALSE;
+}
+
+void tq_set_slack(tq_node_t *node, unsigned slack)
+{
+	if (node) {
+		node->slack = slack;
+	}
+}
+
+BOOL tq_arm(tq_node_t *node, uint64_t deadline)
+{
+	if (!node || !node->expire) {
+		return (FALSE);
+	}
+
+	lock();
+
+	tq_unlink(node);
+
+	node->deadline = deadline;
+
+	if (!rbtree_insert(&root, &node->header, tq_cmp)) {
+		unlock();
+		kerrprintf("failed arming timer queue node %p\n", node);
+		return (FALSE);
+	}
+
+	node->armed = TRUE;
+
+	if (!earliest || (KEY_LOWER == tq_cmp(&node->header, &earliest->header))) {
+		earliest = node;
+		tq_program(clock_get_milliseconds());
+	} else if (earliest->slack) {
+		/* the node can shorten the slack window of the earliest ones */
+		tq_program(clock_get_milliseconds());
+	}
+
+	unlock();
+
+	return (TRUE);
+}
+
+void tq_cancel(tq_node_t *node)
+{
+	if (!node) {
+		return;
+	}
+
+	lock();
+	tq_unlink(node);
+	unlock();
+}
+
+uint64_t tq_earliest()
+{
+	uint64_t retval;
+
+	lock();
+	retval = (earliest) ? (earliest->deadline) : (-1ULL);
+	unlock();
+
+	return (retval);
+}
+
+void tq_dump()
+{
+	uint64_t b, e, s;
+
+	lock();
+	b = batches;
+	e = expirations;
+	s = saved;
+	unlock();
+
+	printf("timer queue: %llu interrupts, %llu expirations, %llu interrupts saved\n\n", b, e, s);
+}
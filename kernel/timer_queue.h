@@ -0,0 +1,128 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TIMER_QUEUE_H_
+#define _TIMER_QUEUE_H_
+
+#include <types_common.h>
+#include <libs/red_black_tree.h>
+
+/*
+ * Kernel timer queue.
+ * All kernel deadlines (thread delays and wait timeouts, timers, alarms)
+ * are kept in a single red black tree sorted by expiration time.
+ * Arming and cancelling cost O(log n), the earliest deadline is cached
+ * and the clock is programmed to expire exactly there, so the cost of a
+ * clock interrupt depends on the number of expired entries only.
+ * A node can tolerate a slack, i.e. expire up to slack milliseconds late:
+ * the clock is programmed at the latest time falling in the slack windows
+ * of the earliest nodes, so that they expire in a single interrupt.
+ */
+
+typedef struct tq_node tq_node_t;
+
+/*
+ * Expiration callback, invoked in interrupt context with interrupts disabled.
+ * The node is already unlinked from the queue and can be armed again.
+ *
+ * PARAMS
+ * tq_node_t *node - the expired node
+ * uint64_t msecs  - system counter of milliseconds elapsed since boot time.
+ */
+typedef void (*tq_expire_fn)(tq_node_t *node, uint64_t msecs);
+
+struct tq_node {
+	/*
+	 * Must be the first field
+	 */
+	rbtree_node_t header;
+	uint64_t deadline;
+	uint32_t slack;
+	tq_expire_fn expire;
+	BOOL armed;
+};
+
+/*
+ * Init the timer queue and register it as a clock client.
+ * Must be called internally by kernel init routine, after clock_init.
+ *
+ * RETURN VALUES
+ * TRUE if initialization is successful
+ * FALSE in any other case
+ */
+BOOL timer_queue_init(void);
+
+/*
+ * Init a node, must be done once before arming it.
+ *
+ * PARAMETERS IN
+ * tq_node_t *node    - the node
+ * tq_expire_fn fn    - the expiration callback
+ */
+void tq_node_init(tq_node_t *node, tq_expire_fn fn);
+
+/*
+ * Set the slack of a node, effective from the next arm.
+ *
+ * PARAMETERS IN
+ * tq_node_t *node    - the node
+ * unsigned slack     - milliseconds the expiration can be delayed
+ */
+void tq_set_slack(tq_node_t *node, unsigned slack);
+
+/*
+ * Arm a node to expire at deadline, an armed node is re-armed.
+ * Can be called from an interrupt context.
+ *
+ * PARAMETERS IN
+ * tq_node_t *node    - the node
+ * uint64_t deadline  - expiration time in milliseconds since boot
+ *
+ * RETURN VALUES
+ * TRUE if the node is armed
+ * FALSE in any other case
+ */
+BOOL tq_arm(tq_node_t *node, uint64_t deadline);
+
+/*
+ * Disarm a node, nothing is done if the node is not armed.
+ * Can be called from an interrupt context.
+ *
+ * PARAMETERS IN
+ * tq_node_t *node    - the node
+ */
+void tq_cancel(tq_node_t *node);
+
+/*
+ * Earliest deadline in the queue.
+ *
+ * RETURN VALUES
+ * the earliest expiration time in milliseconds since boot,
+ * (uint64_t)-1 if the queue is empty
+ */
+uint64_t tq_earliest(void);
+
+/*
+ * Print the timer queue statistics: clock interrupts expiring nodes,
+ * expired nodes and interrupts saved coalescing expirations with
+ * different deadlines.
+ */
+void tq_dump(void);
+
+#endif
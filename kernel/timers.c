@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -27,10 +28,13 @@
 #include <diegos/barriers.h>
 #include <diegos/timers.h>
 #include <libs/list.h>
+#include <libs/queue.h>
+#include <libs/slab.h>
 
 #include "timers_private.h"
 #include "kernel_private.h"
 #include "clock.h"
+#include "timer_queue.h"
 #include "kprintf.h"
 
 enum {
@@ -40,10 +44,14 @@ enum {
 	TMR_TRIGGERED = (1 << 1),
 	/* Timer has expired */
 	TMR_EXPIRED = (1 << 2),
+	/* Timer is in the expired queue */
+	TMR_QUEUED = (1 << 3)
 };
 
 struct timer {
 	list_node header;
+	queue_node expired;
+	tq_node_t node;
 	uint64_t expiration;
 	uint32_t flags;
 	char name[16];
@@ -54,47 +62,64 @@ struct timer {
 
 static list_inst timers_list;
 
-static uint32_t period = -1U;
+static slab_cache_t *timers_cache = NULL;
+
+/*
+ * Expired timers waiting for the timers thread to run their callbacks
+ */
+static queue_inst expired_queue;
 
 static barrier_t *bar = NULL;
 
-static void timer_cb(uint64_t msecs)
+#define EXPIRED_TO_TIMER(ptr)	\
+	((struct timer *)((char *)(ptr) - offsetof(struct timer, expired)))
+
+/*
+ * Timer queue callback, invoked in interrupt context.
+ * Recursive timers are armed again by the timers thread once their
+ * callback has been executed.
+ */
+static void timer_expire_cb(tq_node_t *node, uint64_t msecs)
 {
-	struct timer *cursor;
-	unsigned expired = 0;
-	period = -1U;
-
-	cursor = list_head(&timers_list);
-
-	while (cursor) {
-		if (TMR_TRIGGERED == (cursor->flags & (TMR_TRIGGERED | TMR_EXPIRED))) {
-			if (msecs >= cursor->expiration) {
-				cursor->flags |= TMR_EXPIRED;
-				expired++;
-				/* One shot */
-				if (!(cursor->flags & TMR_RECURSIVE)) {
-					cursor->flags &= ~TMR_TRIGGERED;
-				} else {
-					if (cursor->msecs < period)
-						period = cursor->msecs;
-				}
-			}
-		}
-		cursor = (timer_t *) cursor->header.next;
+	struct timer *tmr = (struct timer *)((char *)node - offsetof(struct timer, node));
+	BOOL wakeup;
+
+	(void)msecs;
+
+	tmr->flags |= TMR_EXPIRED;
+	/* One shot */
+	if (!(tmr->flags & TMR_RECURSIVE)) {
+		tmr->flags &= ~TMR_TRIGGERED;
 	}
 
-	clock_set_period(period, CLK_INST_ALARMS);
-	if (expired)
+	/*
+	 * The timers thread drains the whole queue, timers expiring
+	 * in the same clock interrupt wake it up once.
+	 */
+	wakeup = (queue_count(&expired_queue)) ? FALSE : TRUE;
+
+	if (!(tmr->flags & TMR_QUEUED) && (EOK == queue_enqueue(&expired_queue, &tmr->expired))) {
+		tmr->flags |= TMR_QUEUED;
+	}
+
+	if (wakeup) {
 		barrier_open(bar);
+	}
 }
 
 BOOL init_timers_lib()
 {
-	if (EOK != list_init(&timers_list)) {
+	if ((EOK != list_init(&timers_list)) || (EOK != queue_init(&expired_queue))) {
 		kerrprintf("failed initing timer lib.\n");
 		return (FALSE);
 	}
 
+	timers_cache = slab_cache_create("timers", sizeof(struct timer), 0, 0, NULL, NULL);
+	if (!timers_cache) {
+		kerrprintf("failed creating timers cache.\n");
+		return (FALSE);
+	}
+
 	/*
 	 * The timers API need a running thread, its entry point is
 	 * timers_thread_entry.
@@ -115,28 +140,19 @@ timer_t *timer_create(const char *name, unsigned millisecs, BOOL recursive, tmr_
 		return (NULL);
 	}
 
-	ptr = malloc(sizeof(struct timer));
+	lock();
+
+	ptr = slab_alloc(timers_cache);
 
 	if (!ptr) {
+		unlock();
 		errno = ENOMEM;
 		return (NULL);
 	}
 
-	lock();
-
-	if (list_count(&timers_list) == 0) {
-		if (!clock_add_cb(timer_cb, CLK_INST_TIMERS)) {
-			unlock();
-			free(ptr);
-			kerrprintf("failed adding timer callback!\n");
-			errno = EPERM;
-			return (NULL);
-		}
-	}
-
 	if (EOK != list_prepend(&timers_list, &ptr->header)) {
+		slab_free(timers_cache, ptr);
 		unlock();
-		free(ptr);
 		errno = EPERM;
 		return (NULL);
 	}
@@ -157,15 +173,7 @@ timer_t *timer_create(const char *name, unsigned millisecs, BOOL recursive, tmr_
 	ptr->msecs = millisecs;
 	ptr->cb = cb;
 	ptr->arg = arg;
-
-	/* 
-	 * Shorten clock expiration if the required timeout
-	 * is lower than the last computed period.
-	 * Do not update the computed period, that's up to the
-	 * interrupt routine.
-	 */
-	if (millisecs < period)
-		clock_set_period(millisecs, CLK_INST_TIMERS);
+	tq_node_init(&ptr->node, timer_expire_cb);
 
 	unlock();
 
@@ -189,7 +197,9 @@ void timer_set(timer_t *tmr, BOOL start)
 		tmr->flags |= TMR_TRIGGERED;
 		tmr->flags &= ~TMR_EXPIRED;
 		tmr->expiration = tmr->msecs + clock_get_milliseconds();
+		tq_arm(&tmr->node, tmr->expiration);
 	} else {
+		tq_cancel(&tmr->node);
 		tmr->flags &= ~TMR_TRIGGERED;
 		tmr->flags |= TMR_EXPIRED;
 		tmr->expiration = 0;
@@ -206,17 +216,8 @@ int timer_update(timer_t *tmr, unsigned millisecs, BOOL recursive)
 
 	lock();
 
-	if (millisecs != tmr->msecs) {
-		tmr->msecs = millisecs;
-		/* 
-		 * Shorten clock expiration if the required timeout
-		 * is lower than the last computed period.
-		 * Do not update the computed period, that's up to the
-		 * interrupt routine.
-		 */
-		if (millisecs < period)
-			clock_set_period(millisecs, CLK_INST_TIMERS);
-	}
+	/* The new period is effective from the next expiration */
+	tmr->msecs = millisecs;
 
 	if (recursive && !(tmr->flags & TMR_RECURSIVE)) {
 		tmr->flags |= TMR_RECURSIVE;
@@ -229,6 +230,19 @@ int timer_update(timer_t *tmr, unsigned millisecs, BOOL recursive)
 	return (EOK);
 }
 
+int timer_set_slack(timer_t *tmr, unsigned millisecs)
+{
+	if (!tmr) {
+		return (EINVAL);
+	}
+
+	lock();
+	tq_set_slack(&tmr->node, millisecs);
+	unlock();
+
+	return (EOK);
+}
+
 int timer_done(timer_t *tmr)
 {
 	if (!tmr) {
@@ -242,15 +256,15 @@ int timer_done(timer_t *tmr)
 		return (EPERM);
 	}
 
-	if (list_count(&timers_list) == 0) {
-		clock_set_period(-1U, CLK_INST_TIMERS);
-		if (!clock_del_cb(timer_cb, CLK_INST_TIMERS))
-			kerrprintf("failed removing timer callback!\n");
+	tq_cancel(&tmr->node);
+
+	if (tmr->flags & TMR_QUEUED) {
+		queue_remove(&expired_queue, &tmr->expired);
 	}
 
-	unlock();
+	slab_free(timers_cache, tmr);
 
-	free(tmr);
+	unlock();
 
 	return (EOK);
 }
@@ -272,16 +286,18 @@ static void dump_internal(const timer_t *tmr)
 	if (!tmr->flags) {
 		strcat(tempbuf, "DISABLED");
 	}
-	printf("%-15s | %6u | %10llu | %s\n", tmr->name, tmr->msecs, tmr->expiration, tempbuf);
+	printf("%-15s | %6u | %5u | %10llu | %s\n", tmr->name, tmr->msecs, tmr->node.slack,
+	       tmr->expiration, tempbuf);
 }
 
 void timers_dump(const timer_t *tmr)
 {
 	if (!tmr) {
-		printf("\n--- TIMERS TABLE -------------------------------------\n\n");
+		printf("\n--- TIMERS TABLE ---------------------------------------------\n\n");
 	}
-	printf("%-15s   %6s   %10s    %s\n", "TIMER NAME", "PERIOD", "EXPIRATION", "FLAGS");
-	printf("______________________________________________________\n");
+	printf("%-15s   %6s   %5s   %10s    %s\n", "TIMER NAME", "PERIOD", "SLACK", "EXPIRATION",
+	       "FLAGS");
+	printf("______________________________________________________________\n");
 	if (tmr) {
 		dump_internal(tmr);
 	} else {
@@ -291,12 +307,13 @@ void timers_dump(const timer_t *tmr)
 			tmr = (timer_t *) tmr->header.next;
 		}
 	}
-	printf("------------------------------------------------------\n\n");
+	printf("--------------------------------------------------------------\n\n");
 }
 
 void timers_thread_entry(void)
 {
 	struct timer *cursor;
+	queue_node *ptr;
 
 	bar = barrier_create("Timers", TRUE);
 
@@ -307,22 +324,18 @@ void timers_thread_entry(void)
 
 		lock();
 
-		if (!list_count(&timers_list)) {
-			unlock();
-			continue;
-		}
-
-		cursor = list_head(&timers_list);
-
-		while (cursor) {
+		while (EOK == queue_dequeue(&expired_queue, &ptr)) {
+			cursor = EXPIRED_TO_TIMER(ptr);
+			cursor->flags &= ~TMR_QUEUED;
 			if (cursor->flags & TMR_EXPIRED) {
 				cursor->cb(cursor->arg);
 				cursor->flags &= ~TMR_EXPIRED;
-				if (cursor->flags & TMR_RECURSIVE)
+				if ((cursor->flags & TMR_RECURSIVE) && (cursor->flags & TMR_TRIGGERED)) {
 					cursor->expiration =
 					    cursor->msecs + clock_get_milliseconds();
+					tq_arm(&cursor->node, cursor->expiration);
+				}
 			}
-			cursor = (timer_t *) cursor->header.next;
 		}
 
 		unlock();
@@ -0,0 +1,237 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <diegos/wait_objects.h>
+#include <diegos/kernel_ticks.h>
+#include <diegos/interrupts.h>
+
+#include "threads.h"
+#include "scheduler.h"
+#include "events_private.h"
+#include "barriers_private.h"
+#include "semaphores_private.h"
+#include "mutex_private.h"
+#include "poll_private.h"
+#include "platform_include.h"
+#include "kprintf.h"
+
+/*
+ * Find the first file descriptor with events
+ */
+static int fd_fired(wait_obj_t objs[], unsigned count, unsigned *fired)
+{
+	unsigned i;
+	int retval;
+
+	for (i = 0; i < count; i++) {
+		if (WAIT_OBJ_FD != objs[i].type) {
+			continue;
+		}
+
+		retval = poll_table_add(NULL, objs[i].obj.fd, objs[i].revents, &objs[i].events);
+		if (EOK != retval) {
+			return (retval);
+		}
+
+		if (objs[i].events) {
+			*fired = i;
+			return (EOK);
+		}
+	}
+
+	return (EAGAIN);
+}
+
+/*
+ * Check all objects and wait on them if none is ready.
+ * EAGAIN means the thread was resumed but no object was found signalled.
+ */
+static int wait_internal(wait_obj_t objs[], unsigned count, unsigned msecs, unsigned *fired,
+			 wait_node_t *set)
+{
+	poll_table_t *table = NULL;
+	thread_t *prev, *next;
+	uint32_t flags = 0;
+	unsigned i;
+	int retval = EOK;
+
+	/*
+	 * Devices are polled with interrupts enabled, they signal
+	 * the table if their state changes afterwards.
+	 */
+	for (i = 0; i < count; i++) {
+		if (WAIT_OBJ_FD != objs[i].type) {
+			continue;
+		}
+
+		if (!table) {
+			table = poll_table_create();
+			if (!table) {
+				return (ENOMEM);
+			}
+		}
+
+		retval = poll_table_add(table, objs[i].obj.fd, objs[i].revents, &objs[i].events);
+		if (EOK != retval) {
+			goto out;
+		}
+
+		if (objs[i].events) {
+			*fired = i;
+			goto out;
+		}
+
+		flags |= THREAD_FLAG_WAIT_COMPLETION;
+	}
+
+	/*
+	 * Objects may be signalled by interrupt handlers, check and wait
+	 * with interrupts disabled or a wakeup could be lost.
+	 */
+	lock();
+
+	for (i = 0; i < count; i++) {
+		set[i].list = NULL;
+
+		switch (objs[i].type) {
+		case WAIT_OBJ_EVENTS:
+			retval = event_wait_prepare(objs[i].obj.evqueue, &set[i]);
+			flags |= THREAD_FLAG_WAIT_EVENT;
+			break;
+		case WAIT_OBJ_BARRIER:
+			retval = barrier_wait_prepare(objs[i].obj.barrier, &set[i]);
+			flags |= THREAD_FLAG_WAIT_BARRIER;
+			break;
+		case WAIT_OBJ_MUTEX:
+			retval = mutex_wait_prepare(objs[i].obj.mutex, &set[i]);
+			flags |= THREAD_FLAG_WAIT_MUTEX;
+			break;
+		case WAIT_OBJ_SEMAPHORE:
+			retval = semaphore_wait_prepare(objs[i].obj.sem, &set[i]);
+			flags |= THREAD_FLAG_WAIT_SEMAPHORE;
+			break;
+		case WAIT_OBJ_FD:
+			retval = EAGAIN;
+			break;
+		default:
+			retval = EINVAL;
+			break;
+		}
+
+		if (EAGAIN != retval) {
+			unlock();
+			if (EOK == retval) {
+				*fired = i;
+			}
+			goto out;
+		}
+	}
+
+	if (table && poll_table_signalled(table)) {
+		unlock();
+		retval = fd_fired(objs, count, fired);
+		goto out;
+	}
+
+	prev = scheduler_running_thread();
+	if (!scheduler_wait_set(flags, msecs, set, count)) {
+		unlock();
+		retval = EPERM;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (WAIT_OBJ_MUTEX == objs[i].type) {
+			mutex_boost_owner(objs[i].obj.mutex, prev->priority);
+		}
+	}
+
+	unlock();
+
+	schedule_thread();
+	next = scheduler_running_thread();
+	switch_context(&prev->context, next->context);
+
+	/*
+	 * Objects with a waiters list record the node resuming the thread,
+	 * devices resume it by TID.
+	 */
+	if (prev->wake_node) {
+		*fired = prev->wake_node - set;
+		retval = EOK;
+	} else if (prev->wake_flags & THREAD_FLAG_WAIT_COMPLETION) {
+		retval = fd_fired(objs, count, fired);
+	} else {
+		retval = ETIMEDOUT;
+	}
+
+	/*
+	 * Owners of the mutexes not acquired lose the boost given above
+	 */
+	lock();
+	for (i = 0; i < count; i++) {
+		if ((WAIT_OBJ_MUTEX == objs[i].type) && ((EOK != retval) || (*fired != i))) {
+			mutex_restore_owner(objs[i].obj.mutex);
+		}
+	}
+	unlock();
+
+ out:
+	poll_table_destroy(table);
+
+	return (retval);
+}
+
+int wait_for_objects(wait_obj_t objs[], unsigned count, unsigned msecs, unsigned *fired)
+{
+	wait_node_t set[WAIT_OBJECTS_MAX];
+	uint64_t deadline, now;
+	unsigned i;
+	int retval;
+
+	if (!objs || !fired || !count || (count > WAIT_OBJECTS_MAX)) {
+		return (EINVAL);
+	}
+
+	for (i = 0; i < count; i++) {
+		if ((WAIT_OBJ_FD != objs[i].type) && !objs[i].obj.evqueue) {
+			return (EINVAL);
+		}
+	}
+
+	deadline = clock_get_milliseconds() + msecs;
+
+	scheduler_preempt_disable();
+
+	while (EAGAIN == (retval = wait_internal(objs, count, msecs, fired, set))) {
+		if (msecs) {
+			now = clock_get_milliseconds();
+			if (now >= deadline) {
+				retval = ETIMEDOUT;
+				break;
+			}
+			msecs = deadline - now;
+		}
+	}
+
+	scheduler_preempt_enable();
+
+	return (retval);
+}
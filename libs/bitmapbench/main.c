@@ -0,0 +1,353 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <libs/bitmaps.h>
+
+/*
+ * Host check and benchmark of the bitmap library.
+ * The word level searches are compared with the bit by bit loops they
+ * replaced on random bitmaps of every length up to MAX_BITS, then both
+ * are timed on MAP_BITS long bitmaps shaped after their kernel users:
+ * a nearly full allocation map, a sparse ready map and a half full map
+ * walked bit by bit.
+ */
+
+#define MAX_BITS	(300)
+#define CHECK_ROUNDS	(20)
+#define MAP_BITS	(4096)
+#define LOOPS		(20000)
+
+static long map[BITMAPLEN(MAP_BITS)];
+static uint32_t seed = 1;
+static unsigned long failures;
+static unsigned long visits;
+
+static uint32_t next_rand(void)
+{
+	seed = seed * 1103515245U + 12345U;
+	return (seed >> 8);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/*
+ * The loops of the previous library
+ */
+static unsigned old_first_is_set(long *bitmap, unsigned leninlongs)
+{
+	unsigned long j;
+	unsigned i = 0, k;
+
+	while (i < leninlongs) {
+		if (bitmap[i]) {
+			for (j = 1, k = 0; j; j += j, k++) {
+				if (bitmap[i] & j) {
+					return (i * BINL + k);
+				}
+			}
+		}
+		++i;
+	}
+
+	return (leninlongs * BINL);
+}
+
+static unsigned old_first_is_clear(long *bitmap, unsigned leninlongs)
+{
+	unsigned long j;
+	unsigned i = 0, k;
+
+	while (i < leninlongs) {
+		if (!bitmap[i]) {
+			return (i * BINL);
+		}
+		for (j = 1, k = 0; j; j += j, k++) {
+			if (!(bitmap[i] & j)) {
+				return (i * BINL + k);
+			}
+		}
+		++i;
+	}
+
+	return (leninlongs * BINL);
+}
+
+static void old_for_each_set(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param)
+{
+	unsigned long j;
+	unsigned i = 0, k;
+
+	while (i < leninlongs) {
+		if (bitmap[i]) {
+			for (j = 1, k = 0; j; j += j, k++) {
+				if (bitmap[i] & j) {
+					cbfn(bitmap, i * BINL + k, param);
+				}
+			}
+		}
+		++i;
+	}
+}
+
+/*
+ * References for the new operations
+ */
+static unsigned ref_next(long *bitmap, unsigned nbits, unsigned start, BOOL set)
+{
+	for (; start < nbits; start++) {
+		if (bitmap_is_set(bitmap, start) == set) {
+			return (start);
+		}
+	}
+
+	return (nbits);
+}
+
+static unsigned ref_run(long *bitmap, unsigned nbits, unsigned count)
+{
+	unsigned pos, len = 0;
+
+	if (!count) {
+		return (nbits);
+	}
+
+	for (pos = 0; pos < nbits; pos++) {
+		len = (bitmap_is_set(bitmap, pos)) ? 0 : len + 1;
+		if (len == count) {
+			return (pos + 1 - count);
+		}
+	}
+
+	return (nbits);
+}
+
+static void expect(const char *what, unsigned nbits, unsigned arg, unsigned got, unsigned ref)
+{
+	if (got != ref) {
+		if (++failures < 10) {
+			printf("%s nbits %u arg %u: got %u expected %u\n", what, nbits, arg, got,
+			       ref);
+		}
+	}
+}
+
+static void fill_random(long *bitmap, unsigned nbits)
+{
+	unsigned i, density = next_rand() % 4;
+
+	memset(bitmap, 0, BITMAPBYTES(nbits));
+
+	for (i = 0; i < nbits; i++) {
+		switch (density) {
+		case 0:
+			if (!(next_rand() % 32)) {
+				bitmap_set(bitmap, i);
+			}
+			break;
+		case 1:
+			if (next_rand() % 2) {
+				bitmap_set(bitmap, i);
+			}
+			break;
+		default:
+			if (next_rand() % 32) {
+				bitmap_set(bitmap, i);
+			}
+			break;
+		}
+	}
+}
+
+static void visit(long *bitmap, unsigned bitpos, void *param)
+{
+	unsigned *sum = param;
+
+	*sum += bitpos + 1;
+	++visits;
+}
+
+static void check_bitmap(unsigned nbits)
+{
+	long bitmap[BITMAPLEN(MAX_BITS)], ref[BITMAPLEN(MAX_BITS)];
+	unsigned i, start, count, weight, sum, refsum, last;
+
+	fill_random(bitmap, nbits);
+
+	weight = 0;
+	last = nbits;
+	for (i = 0; i < nbits; i++) {
+		if (bitmap_is_set(bitmap, i)) {
+			++weight;
+			last = i;
+		}
+	}
+
+	for (start = 0; start <= nbits; start++) {
+		expect("next set", nbits, start, bitmap_find_next_set(bitmap, nbits, start),
+		       ref_next(bitmap, nbits, start, TRUE));
+		expect("next clear", nbits, start, bitmap_find_next_clear(bitmap, nbits, start),
+		       ref_next(bitmap, nbits, start, FALSE));
+	}
+
+	expect("last set", nbits, 0, bitmap_find_last_set(bitmap, nbits), last);
+	expect("weight", nbits, 0, bitmap_weight(bitmap, nbits), weight);
+
+	for (count = 0; count <= 24; count++) {
+		expect("clear run", nbits, count, bitmap_find_clear_run(bitmap, nbits, count),
+		       ref_run(bitmap, nbits, count));
+	}
+
+	/*
+	 * The enumerations work on whole longs
+	 */
+	if (!(nbits % BINL)) {
+		sum = refsum = 0;
+		bitmap_for_each_set(bitmap, nbits / BINL, visit, &sum);
+		old_for_each_set(bitmap, nbits / BINL, visit, &refsum);
+		expect("for each set", nbits, 0, sum, refsum);
+
+		sum = refsum = 0;
+		bitmap_for_each_clear(bitmap, nbits / BINL, visit, &sum);
+		for (i = 0; i < nbits; i++) {
+			refsum += (bitmap_is_set(bitmap, i)) ? 0 : i + 1;
+		}
+		expect("for each clear", nbits, 0, sum, refsum);
+
+		expect("first set", nbits, 0, bitmap_first_is_set(bitmap, nbits / BINL),
+		       old_first_is_set(bitmap, nbits / BINL));
+		expect("first clear", nbits, 0, bitmap_first_is_clear(bitmap, nbits / BINL),
+		       old_first_is_clear(bitmap, nbits / BINL));
+	}
+
+	start = next_rand() % nbits;
+	count = next_rand() % (nbits - start + 1);
+	memcpy(ref, bitmap, BITMAPBYTES(nbits));
+
+	bitmap_set_range(bitmap, start, count);
+	for (i = start; i < start + count; i++) {
+		bitmap_set(ref, i);
+	}
+	expect("set range", nbits, start, memcmp(bitmap, ref, BITMAPBYTES(nbits)), 0);
+
+	bitmap_clear_range(bitmap, start, count);
+	for (i = start; i < start + count; i++) {
+		bitmap_clear(ref, i);
+	}
+	expect("clear range", nbits, start, memcmp(bitmap, ref, BITMAPBYTES(nbits)), 0);
+}
+
+static void report(const char *name, uint64_t oldns, uint64_t newns)
+{
+	printf("%-28s %10.1f %10.1f %8.1fx\n", name, (double)oldns / LOOPS,
+	       (double)newns / LOOPS, (double)oldns / (double)newns);
+}
+
+static void bench(void)
+{
+	volatile unsigned sink = 0;
+	uint64_t start, oldns, newns;
+	unsigned i, sum = 0;
+
+	printf("\n%-28s %10s %10s %9s\n", "ns per call", "old", "new", "speedup");
+
+	/*
+	 * Allocation map with the only free slot at the end
+	 */
+	memset(map, 0xff, sizeof(map));
+	bitmap_clear(map, MAP_BITS - 1);
+
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		sink += old_first_is_clear(map, BITMAPLEN(MAP_BITS));
+	}
+	oldns = now_ns() - start;
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		sink += bitmap_first_is_clear(map, BITMAPLEN(MAP_BITS));
+	}
+	newns = now_ns() - start;
+	report("first clear, full map", oldns, newns);
+
+	/*
+	 * Ready map with a single bit in the middle
+	 */
+	memset(map, 0, sizeof(map));
+	bitmap_set(map, MAP_BITS / 2 + BINL - 1);
+
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		sink += old_first_is_set(map, BITMAPLEN(MAP_BITS));
+	}
+	oldns = now_ns() - start;
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		sink += bitmap_first_is_set(map, BITMAPLEN(MAP_BITS));
+	}
+	newns = now_ns() - start;
+	report("first set, sparse map", oldns, newns);
+
+	/*
+	 * One bit every 64 set, walked by the callbacks
+	 */
+	for (i = 0; i < MAP_BITS; i += 64) {
+		bitmap_set(map, i);
+	}
+
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		old_for_each_set(map, BITMAPLEN(MAP_BITS), visit, &sum);
+	}
+	oldns = now_ns() - start;
+	start = now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		bitmap_for_each_set(map, BITMAPLEN(MAP_BITS), visit, &sum);
+	}
+	newns = now_ns() - start;
+	report("for each set, 1/64 set", oldns, newns);
+
+	sink += sum;
+}
+
+int main(void)
+{
+	unsigned nbits, round;
+
+	for (round = 0; round < CHECK_ROUNDS; round++) {
+		for (nbits = 1; nbits <= MAX_BITS; nbits++) {
+			check_bitmap(nbits);
+		}
+	}
+
+	printf("%u bitmaps checked, %lu failures\n", CHECK_ROUNDS * MAX_BITS, failures);
+
+	bench();
+
+	return ((failures) ? 1 : 0);
+}
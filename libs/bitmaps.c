@@ -0,0 +1,211 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libs/bitmaps.h>
+
+/*
+ * Mask of the bits at or above pos in its word
+ */
+#define FIRST_WORD_MASK(pos)	(~0UL << ((pos) % BINL))
+
+/*
+ * Mask of the bits below end in its last word, end is excluded
+ */
+#define LAST_WORD_MASK(end)	(~0UL >> (-(end) % BINL))
+
+/*
+ * bsf and bsr
+ */
+static inline unsigned word_first_set(unsigned long word)
+{
+	return ((unsigned)__builtin_ctzl(word));
+}
+
+static inline unsigned word_last_set(unsigned long word)
+{
+	return ((unsigned)(BINL - 1 - __builtin_clzl(word)));
+}
+
+static inline unsigned word_weight(unsigned long word)
+{
+	word = word - ((word >> 1) & (~0UL / 3));
+	word = (word & (~0UL / 5)) + ((word >> 2) & (~0UL / 5));
+	word = (word + (word >> 4)) & (~0UL / 17);
+
+	return ((unsigned)((word * (~0UL / 255)) >> (BINL - 8)));
+}
+
+/*
+ * Shared by the searches, invert flips the words to look for clear bits
+ */
+static inline unsigned find_next(const long *bitmap, unsigned nbits, unsigned start,
+				 unsigned long invert)
+{
+	unsigned i;
+	unsigned long word;
+
+	if (start >= nbits) {
+		return (nbits);
+	}
+
+	i = start / BINL;
+	word = ((unsigned long)bitmap[i] ^ invert) & FIRST_WORD_MASK(start);
+
+	while (!word) {
+		if (++i >= BITMAPLEN(nbits)) {
+			return (nbits);
+		}
+		word = (unsigned long)bitmap[i] ^ invert;
+	}
+
+	start = i * BINL + word_first_set(word);
+
+	return ((start < nbits) ? start : nbits);
+}
+
+unsigned bitmap_find_next_set(const long *bitmap, unsigned nbits, unsigned start)
+{
+	return (find_next(bitmap, nbits, start, 0UL));
+}
+
+unsigned bitmap_find_next_clear(const long *bitmap, unsigned nbits, unsigned start)
+{
+	return (find_next(bitmap, nbits, start, ~0UL));
+}
+
+unsigned bitmap_find_last_set(const long *bitmap, unsigned nbits)
+{
+	unsigned i = BITMAPLEN(nbits);
+	unsigned long word;
+
+	if (!nbits) {
+		return (nbits);
+	}
+
+	word = (unsigned long)bitmap[--i] & LAST_WORD_MASK(nbits);
+
+	while (!word) {
+		if (!i) {
+			return (nbits);
+		}
+		word = (unsigned long)bitmap[--i];
+	}
+
+	return (i * BINL + word_last_set(word));
+}
+
+unsigned bitmap_find_clear_run(const long *bitmap, unsigned nbits, unsigned count)
+{
+	unsigned pos, end;
+
+	if (!count || (count > nbits)) {
+		return (nbits);
+	}
+
+	pos = bitmap_find_next_clear(bitmap, nbits, 0);
+
+	while (pos + count <= nbits) {
+		/*
+		 * A set bit inside the candidate run restarts the search
+		 * past it
+		 */
+		end = bitmap_find_next_set(bitmap, pos + count, pos);
+		if (end == pos + count) {
+			return (pos);
+		}
+		pos = bitmap_find_next_clear(bitmap, nbits, end);
+	}
+
+	return (nbits);
+}
+
+void bitmap_set_range(long *bitmap, unsigned start, unsigned count)
+{
+	unsigned long *word = (unsigned long *)bitmap + start / BINL;
+	unsigned long mask = FIRST_WORD_MASK(start);
+	unsigned end = start + count;
+	unsigned bits = BINL - start % BINL;
+
+	while (count >= bits) {
+		*word++ |= mask;
+		count -= bits;
+		bits = BINL;
+		mask = ~0UL;
+	}
+
+	if (count) {
+		*word |= mask & LAST_WORD_MASK(end);
+	}
+}
+
+void bitmap_clear_range(long *bitmap, unsigned start, unsigned count)
+{
+	unsigned long *word = (unsigned long *)bitmap + start / BINL;
+	unsigned long mask = FIRST_WORD_MASK(start);
+	unsigned end = start + count;
+	unsigned bits = BINL - start % BINL;
+
+	while (count >= bits) {
+		*word++ &= ~mask;
+		count -= bits;
+		bits = BINL;
+		mask = ~0UL;
+	}
+
+	if (count) {
+		*word &= ~(mask & LAST_WORD_MASK(end));
+	}
+}
+
+unsigned bitmap_weight(const long *bitmap, unsigned nbits)
+{
+	unsigned i, retval = 0;
+
+	for (i = 0; i < nbits / BINL; i++) {
+		retval += word_weight((unsigned long)bitmap[i]);
+	}
+
+	if (nbits % BINL) {
+		retval += word_weight((unsigned long)bitmap[i] & LAST_WORD_MASK(nbits));
+	}
+
+	return (retval);
+}
+
+void bitmap_for_each_set(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param)
+{
+	unsigned nbits = leninlongs * BINL;
+	unsigned pos;
+
+	for (pos = bitmap_find_next_set(bitmap, nbits, 0); pos < nbits;
+	     pos = bitmap_find_next_set(bitmap, nbits, pos + 1)) {
+		cbfn(bitmap, pos, param);
+	}
+}
+
+void bitmap_for_each_clear(long *bitmap, unsigned leninlongs, bitmapcb cbfn, void *param)
+{
+	unsigned nbits = leninlongs * BINL;
+	unsigned pos;
+
+	for (pos = bitmap_find_next_clear(bitmap, nbits, 0); pos < nbits;
+	     pos = bitmap_find_next_clear(bitmap, nbits, pos + 1)) {
+		cbfn(bitmap, pos, param);
+	}
+}
@@ -22,90 +22,18 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <libs/list.h>
+#include <libs/slab.h>
 #include <libs/chunks.h>
-#include <libs/bitmaps.h>
 
+/*
+ * Chunks pools are slab caches, the initial chunks are reserved and
+ * never released, the cache grows by delta chunks at a time.
+ */
 typedef struct chunks_pool {
-	unsigned aln;
-	unsigned size;
-	unsigned delta;
-	list_inst pools;
-	char name[16];
+	slab_cache_t *cache;
+	size_t size;
 } chunks_pool_t;
 
-typedef struct pool_array {
-	list_node header;
-	void *buffer;
-	void *bufstart;
-	unsigned numitems;
-	unsigned free;
-	long *bitmap;
-} pool_array_t;
-
-static STATUS create_pool(chunks_pool_t *ptr, unsigned numitems)
-{
-	unsigned total;
-	pool_array_t *tmp;
-
-	total = ptr->size * numitems + ptr->aln;
-
-	tmp = malloc(sizeof(pool_array_t));
-
-	if (!tmp) {
-		return (ENOMEM);
-	}
-
-	tmp->buffer = malloc(total);
-
-	if (!tmp->buffer) {
-		free(tmp);
-		return (ENOMEM);
-	}
-
-	tmp->bufstart = (void *)MULT((uintptr_t) tmp->buffer, ptr->aln);
-
-	tmp->numitems = numitems;
-	tmp->free = numitems;
-
-	tmp->bitmap = malloc(BITMAPBYTES(numitems));
-
-	if (!tmp->bitmap) {
-		free(tmp->buffer);
-		free(tmp);
-		return (ENOMEM);
-	}
-
-	memset(tmp->bitmap, 0, BITMAPBYTES(numitems));
-
-	if (EOK != list_prepend(&ptr->pools, &tmp->header)) {
-		free(tmp->bitmap);
-		free(tmp->buffer);
-		free(tmp);
-		return (EGENERIC);
-	}
-
-	return (EOK);
-}
-
-static void delete_pool(chunks_pool_t *ptr, pool_array_t *dlt)
-{
-	/*
-	 * Never remove the main pool!
-	 */
-	if (list_tail(&ptr->pools) == dlt) {
-		return;
-	}
-
-	if (EOK != list_remove(&ptr->pools, &dlt->header)) {
-		return;
-	}
-
-	free(dlt->bitmap);
-	free(dlt->buffer);
-	free(dlt);
-}
-
 chunks_pool_t *chunks_pool_create(const char *name,
 				  unsigned aln, unsigned size, unsigned numitems, unsigned delta)
 {
@@ -125,70 +53,31 @@ chunks_pool_t *chunks_pool_create(const char *name,
 		return (NULL);
 	}
 
-	if (name) {
-		snprintf(ptr->name, sizeof(ptr->name), "%s", name);
-	} else {
-		snprintf(ptr->name, sizeof(ptr->name), "Chunk_%p", ptr);
-	}
-
-	ptr->aln = aln;
-	ptr->size = MULT(size, aln);
-	ptr->delta = delta;
+	ptr->cache = slab_cache_create(name, size, aln, (delta) ? delta : numitems, NULL, NULL);
 
-	if (EOK != list_init(&ptr->pools)) {
+	if (!ptr->cache) {
 		free(ptr);
 		return (NULL);
 	}
 
-	if (EOK != create_pool(ptr, numitems)) {
+	if (EOK != slab_cache_reserve(ptr->cache, numitems)) {
+		slab_cache_destroy(ptr->cache);
 		free(ptr);
 		return (NULL);
 	}
 
+	ptr->size = size;
+
 	return (ptr);
 }
 
 void *chunks_pool_malloc(chunks_pool_t *pool)
 {
-	pool_array_t *ptr;
-	unsigned pos;
-	STATUS retcode;
-
 	if (!pool) {
 		return (NULL);
 	}
 
-	ptr = list_head(&pool->pools);
-
-	while (ptr) {
-		if (ptr->free) {
-			pos = bitmap_first_is_clear(ptr->bitmap, BITMAPLEN(ptr->numitems));
-			if (pos < ptr->numitems) {
-				--ptr->free;
-				bitmap_set(ptr->bitmap, pos);
-				return (ptr->bufstart + (pos * pool->size));
-			}
-		}
-		ptr = (pool_array_t *) ptr->header.next;
-	}
-
-	/*
-	 * add another pool to the list, if delta is not 0
-	 */
-	if (pool->delta) {
-		retcode = create_pool(pool, pool->delta);
-	} else {
-		retcode = ENOMEM;
-	}
-	if (EOK != retcode) {
-		return (NULL);
-	}
-
-	ptr = list_head(&pool->pools);
-	--ptr->free;
-	bitmap_set(ptr->bitmap, 0);
-
-	return (ptr->bufstart);
+	return (slab_alloc(pool->cache));
 }
 
 void *chunks_pool_zalloc(chunks_pool_t *pool)
@@ -204,55 +93,21 @@ void *chunks_pool_zalloc(chunks_pool_t *pool)
 
 void chunks_pool_free(chunks_pool_t *pool, void *ptr)
 {
-	pool_array_t *cur;
-	uintptr_t val;
-
 	if (!pool || !ptr) {
 		return;
 	}
 
-	cur = list_head(&pool->pools);
-
-	while (cur) {
-		if ((ptr >= cur->bufstart) &&
-		    (ptr <= cur->bufstart + (pool->size * (cur->numitems - 1)))) {
-			val = (uintptr_t) ptr;
-			val -= (uintptr_t) cur->bufstart;
-			val /= (uintptr_t) pool->size;
-			if (!bitmap_is_set(cur->bitmap, val)) {
-				return;
-			}
-			bitmap_clear(cur->bitmap, val);
-			++cur->free;
-			if (cur->free == cur->numitems) {
-				delete_pool(pool, cur);
-			}
-			return;
-		}
-
-		cur = (pool_array_t *) cur->header.next;
-	}
+	slab_free(pool->cache, ptr);
 }
 
 void chunks_pool_done(chunks_pool_t *pool)
 {
-	pool_array_t *cur;
-
 	if (!pool) {
 		return;
 	}
 
-	while (list_count(&pool->pools)) {
-
-		cur = list_head(&pool->pools);
-
-		if (EOK == list_remove(&pool->pools, &cur->header)) {
-			free(cur->bitmap);
-			free(cur->buffer);
-			free(cur);
-		} else {
-			break;
-		}
+	if (EOK != slab_cache_destroy(pool->cache)) {
+		return;
 	}
 
 	free(pool);
@@ -260,29 +115,9 @@ void chunks_pool_done(chunks_pool_t *pool)
 
 void chunks_pool_dump(chunks_pool_t *pool)
 {
-	pool_array_t *cur;
-	unsigned i = 0;
-
 	if (!pool) {
 		return;
 	}
 
-	printf("\nChunk name: %s\n ============\n Alignment..... %u\n"
-	       " Element size.. %u\n Delta......... %u\n",
-	       pool->name, pool->aln, pool->size, pool->delta);
-
-	cur = list_head(&pool->pools);
-
-	printf(" ------------\n");
-
-	while (cur) {
-		printf("Pool array %u\n", i++);
-
-		printf(" Buffer start 0x%p\n Items... %u\n Free.... %u\n",
-		       cur->bufstart, cur->numitems, cur->free);
-
-		printf(" ------------\n");
-
-		cur = (pool_array_t *) cur->header.next;
-	}
+	slab_cache_dump(pool->cache);
 }
@@ -21,12 +21,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+extern void *diegos_malloc_from(size_t size, void *caller);
+
 void *calloc(size_t nelem, size_t elsize)
 {
 	char *p;
 	size_t size = ALN(nelem * elsize, sizeof(void *));
 
-	p = malloc(size);
+	p = diegos_malloc_from(size, __builtin_return_address(0));
 	if (p)
 		memset(p, 0, size);
 	return (p);
@@ -18,50 +18,81 @@
  */
 
 #include <types_common.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <diegos/kernel.h>
 
-#define MAGIC_ALLOC_NUMBER (0x1A2B3C4DL)
-#define MAGIC_FREE_NUMBER  (0x5E6F8A9BL)
-#define MAGIC_LAST_NUMBER  (0xDEADBEEFL)
+#include "mallocprof.h"
 
 /*
- * Structure of the list
+ * Two level segregated fit allocator (TLSF).
  *
- * (1)			<-- heap_start, allocated
- * MAGIC_ALLOC_NUMBER
- * ....
- * ....
- * ....
- * (2)
- * MAGIC_ALLOC_NUMBER	<-- next item, allocated
- * ....
- * ....
- * ....
- * ....
- * (3)
- * MAGIC_FREE_NUMBER	<-- next item, free'd
- * ....
- * ....
- * ....
- * (heap_end)
- * MAGIC_LAST_NUMBER	<-- last item, unusable
+ * Free blocks are kept in lists of size classes: the first level splits
+ * sizes in powers of two, the second level splits each power of two in
+ * SL_INDEX_COUNT linear classes. Two levels of bitmaps tell which lists
+ * are not empty, so that malloc finds a list whose blocks all fit the
+ * request with a couple of bit scans, and free merges a block with its
+ * free physical neighbours right away: both cost O(1) whatever the heap
+ * size and its fragmentation.
+ *
+ * Structure of the heap
+ *
+ * +-----------+------+-----------+------+----- ... -----+-----------+
+ * | prev_phys | size | payload   | prev_phys | size | ...   | sentinel  |
+ * +-----------+------+-----------+------+----- ... -----+-----------+
+ *
+ * Every block starts with a BLOCK_OVERHEAD bytes header holding the
+ * previous physical block and the payload size, the low bits of the size
+ * tell if the block and its previous physical block are free.
+ * Free blocks link their size class list in the payload.
+ * The sentinel is a zero sized used block closing the heap.
  */
 
+#define ALIGN_SIZE_LOG2		(3)
+#define ALIGN_SIZE		((uintptr_t)1 << ALIGN_SIZE_LOG2)
+
 /*
- * 8 bytes for 32-bit platforms
- * 16 bytes for 64-bit platforms
+ * Sizes below SMALL_BLOCK_SIZE share the first list,
+ * split in SL_INDEX_COUNT classes ALIGN_SIZE bytes wide
  */
-
-struct mempart {
-	struct mempart *next;
-	uintptr_t magic;
+#define SL_INDEX_COUNT_LOG2	(4)
+#define SL_INDEX_COUNT		(1U << SL_INDEX_COUNT_LOG2)
+#define FL_INDEX_MAX		(30)
+#define FL_INDEX_SHIFT		(SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2)
+#define FL_INDEX_COUNT		(FL_INDEX_MAX - FL_INDEX_SHIFT + 1)
+#define SMALL_BLOCK_SIZE	(1U << FL_INDEX_SHIFT)
+
+#define BLOCK_FREE		((size_t)1 << 0)
+#define BLOCK_PREV_FREE		((size_t)1 << 1)
+#define BLOCK_FLAGS		(BLOCK_FREE | BLOCK_PREV_FREE)
+
+struct block {
+	/*
+	 * Previous block in memory, NULL for the first block
+	 */
+	struct block *prev_phys;
+	size_t size;
+	/*
+	 * Size class list, free blocks only
+	 */
+	struct block *next_free;
+	struct block *prev_free;
 };
 
-static struct mempart *heap_start = NULL;
-static struct mempart *heap_end = NULL;
+#define BLOCK_OVERHEAD		(offsetof(struct block, next_free))
+#define BLOCK_SIZE_MIN		(sizeof(struct block) - BLOCK_OVERHEAD)
+#define BLOCK_SIZE_MAX		((size_t)1 << FL_INDEX_MAX)
+
+static unsigned fl_bitmap = 0;
+static unsigned sl_bitmap[FL_INDEX_COUNT];
+static struct block *blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+static struct block *heap_start = NULL;
+static struct block *heap_end = NULL;
+
 /*
  * Yes this should definitively be some typecasted variable,
  * with well known size.
@@ -69,68 +100,251 @@ static struct mempart *heap_end = NULL;
  */
 static unsigned long freebytes = 0;
 static unsigned long allocbytes = 0;
+static unsigned long freeblocks = 0;
+
+/*
+ * The heap is shared by all threads, it must not be
+ * modified by two threads at once.
+ */
+#if defined(ENABLE_PREEMPTION) || defined(ENABLE_SMP)
+#define HEAP_LOCK()	thread_preempt_disable()
+#define HEAP_UNLOCK()	thread_preempt_enable()
+#else
+#define HEAP_LOCK()
+#define HEAP_UNLOCK()
+#endif
+
+/*
+ * Index of the most and of the least significant bit set, x must not be 0
+ */
+static inline unsigned fls_index(size_t x)
+{
+	return ((unsigned)(31 - __builtin_clz((unsigned)x)));
+}
+
+static inline unsigned ffs_index(unsigned x)
+{
+	return ((unsigned)__builtin_ctz(x));
+}
 
-static inline int is_alloc(struct mempart *p)
+static inline size_t block_size(const struct block *b)
 {
-	return (MAGIC_ALLOC_NUMBER == p->magic) ? 1 : 0;
+	return (b->size & ~BLOCK_FLAGS);
 }
 
-static inline int is_free(struct mempart *p)
+static inline void block_set_size(struct block *b, size_t size)
 {
-	return (MAGIC_FREE_NUMBER == p->magic) ? 1 : 0;
+	b->size = size | (b->size & BLOCK_FLAGS);
 }
 
-static inline int is_last(struct mempart *p)
+static inline int is_free(const struct block *b)
 {
-	return (MAGIC_LAST_NUMBER == p->magic) ? 1 : 0;
+	return ((b->size & BLOCK_FREE) ? 1 : 0);
+}
+
+static inline int is_prev_free(const struct block *b)
+{
+	return ((b->size & BLOCK_PREV_FREE) ? 1 : 0);
+}
+
+static inline void *block_to_ptr(struct block *b)
+{
+	return ((void *)((char *)b + BLOCK_OVERHEAD));
+}
+
+static inline struct block *ptr_to_block(void *p)
+{
+	return ((struct block *)((char *)p - BLOCK_OVERHEAD));
+}
+
+static inline struct block *block_next(const struct block *b)
+{
+	return ((struct block *)((char *)b + BLOCK_OVERHEAD + block_size(b)));
 }
 
 /*
- * Available space is equal to the difference between
- * the next descriptor pointer and the actual (this)
- * descriptor pointer, less the size of "this".
- * As it turns out, advancing the "this" pointer by 1 makes
- * the trick.
+ * Mark a block free or used, and tell its next physical block
  */
-static inline unsigned long get_size(struct mempart *p)
+static void block_mark_free(struct block *b)
 {
-	return ((uintptr_t) p->next - (uintptr_t) (p + 1));
+	struct block *next = block_next(b);
+
+	b->size |= BLOCK_FREE;
+	next->size |= BLOCK_PREV_FREE;
+	next->prev_phys = b;
 }
 
-static void defrag_mem(void)
+static void block_mark_used(struct block *b)
 {
-	struct mempart *this = heap_start;
-	struct mempart *merge = NULL;
-	unsigned long bytes = 0;
-
-	while (!is_last(this)) {
-		if (is_free(this)) {
-			merge = this;
-			this = this->next;
-			while (is_free(this)) {
-				this = this->next;
-				/*
-				 * Account for mempart structures
-				 * becoming part of the free space
-				 */
-				bytes += sizeof(struct mempart);
-			}
-			/*
-			 * We fall here even if this points to the last
-			 * item, as it fails the is_free() test just like
-			 * an allocated item.
-			 */
-			if (merge->next != this) {
-				merge->next = this;
+	struct block *next = block_next(b);
+
+	b->size &= ~BLOCK_FREE;
+	next->size &= ~BLOCK_PREV_FREE;
+}
+
+/*
+ * Size class of a block of the given size
+ */
+static void mapping_insert(size_t size, unsigned *fl, unsigned *sl)
+{
+	unsigned f;
+
+	if (size < SMALL_BLOCK_SIZE) {
+		*fl = 0;
+		*sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+		return;
+	}
+
+	f = fls_index(size);
+	*sl = (size >> (f - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+	*fl = f - (FL_INDEX_SHIFT - 1);
+}
+
+/*
+ * Size class whose blocks all fit the given size: the size is rounded
+ * up to the next class, no list is ever searched.
+ */
+static void mapping_search(size_t size, unsigned *fl, unsigned *sl)
+{
+	if (size >= SMALL_BLOCK_SIZE) {
+		size += (1U << (fls_index(size) - SL_INDEX_COUNT_LOG2)) - 1;
+	}
+
+	mapping_insert(size, fl, sl);
+}
+
+/*
+ * First non empty list of class (fl, sl) or of a larger one
+ */
+static struct block *search_suitable_block(unsigned *fl, unsigned *sl)
+{
+	unsigned map;
+
+	map = (*fl < FL_INDEX_COUNT) ? (sl_bitmap[*fl] & (~0U << *sl)) : 0;
+	if (!map) {
+		map = (*fl + 1 < FL_INDEX_COUNT) ? (fl_bitmap & (~0U << (*fl + 1))) : 0;
+		if (!map) {
+			return (NULL);
+		}
+		*fl = ffs_index(map);
+		map = sl_bitmap[*fl];
+	}
+
+	*sl = ffs_index(map);
+
+	return (blocks[*fl][*sl]);
+}
+
+static void remove_free_block(struct block *b, unsigned fl, unsigned sl)
+{
+	if (b->next_free) {
+		b->next_free->prev_free = b->prev_free;
+	}
+	if (b->prev_free) {
+		b->prev_free->next_free = b->next_free;
+	}
+
+	if (blocks[fl][sl] == b) {
+		blocks[fl][sl] = b->next_free;
+		if (!blocks[fl][sl]) {
+			sl_bitmap[fl] &= ~(1U << sl);
+			if (!sl_bitmap[fl]) {
+				fl_bitmap &= ~(1U << fl);
 			}
 		}
-		/*
-		 * This works on the last item as it points to itself.
-		 */
-		this = this->next;
 	}
-	freebytes += bytes;
-	allocbytes -= bytes;
+
+	freebytes -= block_size(b);
+	--freeblocks;
+}
+
+static void insert_free_block(struct block *b)
+{
+	unsigned fl, sl;
+
+	mapping_insert(block_size(b), &fl, &sl);
+
+	b->prev_free = NULL;
+	b->next_free = blocks[fl][sl];
+	if (b->next_free) {
+		b->next_free->prev_free = b;
+	}
+	blocks[fl][sl] = b;
+
+	fl_bitmap |= 1U << fl;
+	sl_bitmap[fl] |= 1U << sl;
+
+	freebytes += block_size(b);
+	++freeblocks;
+}
+
+static void unlink_free_block(struct block *b)
+{
+	unsigned fl, sl;
+
+	mapping_insert(block_size(b), &fl, &sl);
+	remove_free_block(b, fl, sl);
+}
+
+/*
+ * Merge a free block, not linked to any list, with its free neighbours,
+ * blocks are never merged beyond the largest size class
+ */
+static struct block *block_merge(struct block *b)
+{
+	struct block *next;
+
+	if (is_prev_free(b) &&
+	    (block_size(b->prev_phys) + BLOCK_OVERHEAD + block_size(b) < BLOCK_SIZE_MAX)) {
+		unlink_free_block(b->prev_phys);
+		b->prev_phys->size += BLOCK_OVERHEAD + block_size(b);
+		b = b->prev_phys;
+		allocbytes -= BLOCK_OVERHEAD;
+	}
+
+	next = block_next(b);
+	if (is_free(next) && (block_size(b) + BLOCK_OVERHEAD + block_size(next) < BLOCK_SIZE_MAX)) {
+		unlink_free_block(next);
+		b->size += BLOCK_OVERHEAD + block_size(next);
+		allocbytes -= BLOCK_OVERHEAD;
+	}
+
+	block_mark_free(b);
+
+	return (b);
+}
+
+/*
+ * Carve a new free block from the tail of a used block,
+ * if the tail can hold a block.
+ */
+static void block_trim(struct block *b, size_t size)
+{
+	struct block *rest;
+
+	if (block_size(b) < size + sizeof(struct block)) {
+		return;
+	}
+
+	rest = (struct block *)((char *)block_to_ptr(b) + size);
+	rest->size = block_size(b) - size - BLOCK_OVERHEAD;
+	rest->prev_phys = b;
+	block_set_size(b, size);
+
+	allocbytes -= block_size(rest);
+	block_next(rest)->prev_phys = rest;
+	insert_free_block(block_merge(rest));
+}
+
+static size_t adjust_size(size_t size)
+{
+	if (!size || (size > BLOCK_SIZE_MAX)) {
+		return (0);
+	}
+
+	size = ALN(size, ALIGN_SIZE);
+
+	return ((size < BLOCK_SIZE_MIN) ? (BLOCK_SIZE_MIN) : (size));
 }
 
 /*
@@ -140,180 +354,207 @@ static void defrag_mem(void)
  */
 STATUS malloc_init(const void *heapstart, const void *heapend)
 {
-	if (heapstart > heapend)
-		return (EINVAL);
+	uintptr_t start = ALN((uintptr_t) heapstart, ALIGN_SIZE);
+	uintptr_t end = ((uintptr_t) heapend) & ~(ALIGN_SIZE - 1);
+	struct block *b, *prev;
+	size_t size;
 
-	if (((uintptr_t) (heapstart) ^ (uintptr_t) (heapend)) & (sizeof(struct mempart) - 1))
+	if ((start > end) || (end - start < 2 * sizeof(struct block))) {
 		return (EINVAL);
+	}
 
-	heap_start = (struct mempart *)heapstart;
-	heap_end = (struct mempart *)heapend;
-	/*
-	 * Step back one structure, as the end of the heap IS
-	 * the end of the heap !!!
-	 */
-	heap_end -= sizeof(*heap_end);
-
-	/*
-	 * Link start and end of the heap
-	 */
-	heap_start->next = heap_end;
-	heap_start->magic = MAGIC_FREE_NUMBER;
-
-	heap_end->next = heap_end;
-	heap_end->magic = MAGIC_LAST_NUMBER;
+	memset(sl_bitmap, 0, sizeof(sl_bitmap));
+	memset(blocks, 0, sizeof(blocks));
+	fl_bitmap = 0;
+	freebytes = 0;
+	freeblocks = 0;
 
 	/*
-	 * Account for free and allocated space
+	 * A single free block followed by the sentinel, blocks larger
+	 * than BLOCK_SIZE_MAX are split.
 	 */
-	allocbytes = 2 * sizeof(struct mempart);
-	freebytes = (uintptr_t) (heap_end) - (uintptr_t) (heap_start) - allocbytes;
-
-	return (EOK);
-}
-
-static void *malloc_internal(size_t newsize)
-{
-	struct mempart *this = heap_start;
-	struct mempart *middle;
-	void *split;
-	unsigned long available;
-
-	while (!is_last(this)) {
-		while (is_alloc(this))
-			this = this->next;
-		if (is_last(this))
-			break;
-
-		available = get_size(this);
-		/* 
-		 * Available space cannot fit the requested size, keep on searching
-		 */
-		if (available < newsize) {
-			this = this->next;
-			continue;
+	heap_start = (struct block *)start;
+	heap_end = (struct block *)(end - BLOCK_OVERHEAD);
+	heap_end->size = 0;
+	allocbytes = BLOCK_OVERHEAD;
+
+	for (b = heap_start, prev = NULL; b != heap_end; prev = b, b = block_next(b)) {
+		size = (uintptr_t) heap_end - (uintptr_t) b - BLOCK_OVERHEAD;
+		if (size >= BLOCK_SIZE_MAX) {
+			size = BLOCK_SIZE_MAX / 2;
 		}
-		/*
-		 * This slot can be allocated.
-		 */
-		this->magic = MAGIC_ALLOC_NUMBER;
-		/*
-		 * Available space fits the requested size; the slot is considered
-		 * to be a good fit if it offers no more than sizeof(struct mempart)
-		 * bytes in addition to newsize.
-		 * This check is required to understand if we could split the slot
-		 * leaving free space.
-		 * In other words, if we have residual space for a struct mempart and more,
-		 * we can fragment the memory leaving some free space.
-		 */
-		if (available < newsize + sizeof(struct mempart)) {
-			allocbytes += available;
-			freebytes -= available;
-			return (void *)(this + 1);
-		}
-		/*
-		 * Available space fits the requested size and new free space 
-		 * can be carved from this slot.
-		 */
-		split = (void *)(this + 1) + newsize;
-		middle = (struct mempart *)split;
-		middle->magic = MAGIC_FREE_NUMBER;
-		middle->next = this->next;
-		this->next = middle;
-		allocbytes += newsize + sizeof(struct mempart);
-		freebytes -= newsize + sizeof(struct mempart);
-		return (void *)(this + 1);
+		b->prev_phys = prev;
+		b->size = size | ((prev) ? (BLOCK_PREV_FREE) : (0));
+		allocbytes += BLOCK_OVERHEAD;
+		block_mark_free(b);
+		insert_free_block(b);
 	}
 
-	return NULL;
+	return (EOK);
 }
 
-void *malloc(size_t size)
+/*
+ * This is a custom call for DiegOS: malloc on behalf of caller, the
+ * call site accounted by the heap profiler.
+ */
+void *diegos_malloc_from(size_t size, void *caller)
 {
-	size_t newsize;
-	void *retval;
+	struct block *b;
+	size_t request = size;
+	unsigned fl, sl;
 
+	size = adjust_size(size);
 	if (!size) {
 		return (NULL);
 	}
 
-	/*
-	 * Make size a nice multiple of.
-	 */
-	newsize = MULT(size, sizeof(void *));
-	retval = malloc_internal(newsize);
-	/*
-	 * First run was unsuccessful, try defragmenting the list
-	 */
-	if (!retval) {
-		defrag_mem();
-		retval = malloc_internal(newsize);
-	}
+	HEAP_LOCK();
 
-	/*
-	 * Nope, we cannot accomodate this request...
-	 */
-	if (!retval)
+	mapping_search(size, &fl, &sl);
+	b = search_suitable_block(&fl, &sl);
+	if (!b) {
+		HEAP_UNLOCK();
+		/*
+		 * Nope, we cannot accomodate this request...
+		 */
 		errno = ENOMEM;
-	return (retval);
+		return (NULL);
+	}
+
+	remove_free_block(b, fl, sl);
+	block_mark_used(b);
+	allocbytes += block_size(b);
+	block_trim(b, size);
+	heap_profile_alloc(block_to_ptr(b), request, caller);
+
+	HEAP_UNLOCK();
+
+	return (block_to_ptr(b));
+}
+
+void *malloc(size_t size)
+{
+	return (diegos_malloc_from(size, __builtin_return_address(0)));
 }
 
 void *realloc(void *p, size_t size)
 {
-	struct mempart *this = (struct mempart *)p;
+	struct block *b, *next;
+	size_t adjusted, oldsize;
 	void *temp;
-	unsigned long oldsize;
 
 	if (!p)
-		return malloc(size);
+		return diegos_malloc_from(size, __builtin_return_address(0));
 
 	if (!size) {
 		free(p);
 		return (NULL);
 	}
 
-	this--;
-	if (!is_alloc(this)) {
+	b = ptr_to_block(p);
+	if (is_free(b)) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+
+	adjusted = adjust_size(size);
+	if (!adjusted) {
 		errno = ENOMEM;
 		return (NULL);
 	}
 
-	/* Now pointer is valid */
-	oldsize = get_size(this);
-	if (oldsize >= size) {
+	HEAP_LOCK();
+
+	oldsize = block_size(b);
+
+	/*
+	 * Grow in place into the next block if it is free and large enough,
+	 * shrink in place releasing the tail.
+	 */
+	if (adjusted > oldsize) {
+		next = block_next(b);
+		if (is_free(next) && (oldsize + BLOCK_OVERHEAD + block_size(next) >= adjusted)) {
+			unlink_free_block(next);
+			b->size += BLOCK_OVERHEAD + block_size(next);
+			allocbytes += block_size(next);
+			block_mark_used(b);
+		}
+	}
+
+	if (adjusted <= block_size(b)) {
+		block_trim(b, adjusted);
+		heap_profile_resize(p, size);
+		HEAP_UNLOCK();
 		return (p);
 	}
 
+	HEAP_UNLOCK();
+
 	/* Need more space, alloc */
-	temp = malloc(size);
+	temp = diegos_malloc_from(size, __builtin_return_address(0));
 	if (temp) {
 		memcpy(temp, p, oldsize);
 		free(p);
-	} else {
-		errno = ENOMEM;
 	}
 	return (temp);
 }
 
 void free(void *p)
 {
-	struct mempart *this = (struct mempart *)p;
+	struct block *b;
 
 	if (!p)
 		return;
 
-	this--;
-	assert(is_alloc(this) == 1);
-	this->magic = MAGIC_FREE_NUMBER;
-	allocbytes -= get_size(this);
-	freebytes += get_size(this);
+	b = ptr_to_block(p);
+	assert(is_free(b) == 0);
+
+	HEAP_LOCK();
+	heap_profile_free(p);
+	allocbytes -= block_size(b);
+	insert_free_block(block_merge(b));
+	HEAP_UNLOCK();
 }
 
 /*
- * This is a custom call for DiegOS
+ * This is a custom call for DiegOS:
+ * bytes[0] free bytes, bytes[1] allocated bytes, headers included
  */
 void diegos_malloc_stats(unsigned long bytes[2])
 {
 	bytes[0] = freebytes;
 	bytes[1] = allocbytes;
 }
+
+/*
+ * This is a custom call for DiegOS, heap fragmentation:
+ * frag[0] number of free blocks
+ * frag[1] largest free block in bytes, the largest allocation that
+ *         can succeed
+ * frag[2] fragmentation in percent, the share of the free bytes
+ *         that is not in the largest free block
+ */
+void diegos_malloc_frag(unsigned long frag[3])
+{
+	const struct block *b;
+	unsigned long largest = 0;
+	unsigned fl, sl;
+
+	HEAP_LOCK();
+
+	if (fl_bitmap) {
+		fl = fls_index(fl_bitmap);
+		sl = fls_index(sl_bitmap[fl]);
+		for (b = blocks[fl][sl]; b; b = b->next_free) {
+			if (block_size(b) > largest) {
+				largest = block_size(b);
+			}
+		}
+	}
+
+	frag[0] = freeblocks;
+	frag[1] = largest;
+	frag[2] = (freebytes) ? (((freebytes - largest) * 100UL) / freebytes) : (0);
+
+	HEAP_UNLOCK();
+}
@@ -0,0 +1,314 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Host benchmark of the heap allocators on traces shaped after the kernel
+ * use of the heap: long and short lived objects of mixed sizes, FIFO
+ * network buffers and buffers growing by realloc.
+ * Each trace runs on a fresh heap of HEAP_SIZE bytes, with the same
+ * pseudo random sequence for both allocators; the heap statistics are
+ * taken at the end of the trace, before the live blocks are released.
+ */
+
+#define HEAP_SIZE	(8UL * 1024UL * 1024UL)
+
+typedef int STATUS;
+
+extern STATUS tlsf_init(const void *heapstart, const void *heapend);
+extern void *tlsf_malloc(size_t size);
+extern void *tlsf_realloc(void *p, size_t size);
+extern void tlsf_free(void *p);
+extern void tlsf_stats(unsigned long bytes[2]);
+extern void tlsf_frag(unsigned long frag[3]);
+
+extern STATUS ff_init(const void *heapstart, const void *heapend);
+extern void *ff_malloc(size_t size);
+extern void *ff_realloc(void *p, size_t size);
+extern void ff_free(void *p);
+extern void ff_stats(unsigned long bytes[2]);
+
+struct allocator {
+	const char *name;
+	STATUS (*init)(const void *heapstart, const void *heapend);
+	void *(*alloc)(size_t size);
+	void *(*resize)(void *p, size_t size);
+	void (*release)(void *p);
+	void (*stats)(unsigned long bytes[2]);
+	void (*frag)(unsigned long frag[3]);
+};
+
+static const struct allocator allocators[] = {
+	{"first-fit", ff_init, ff_malloc, ff_realloc, ff_free, ff_stats, NULL},
+	{"tlsf", tlsf_init, tlsf_malloc, tlsf_realloc, tlsf_free, tlsf_stats, tlsf_frag}
+};
+
+static uint64_t heap[HEAP_SIZE / sizeof(uint64_t)];
+
+static const struct allocator *cur;
+static unsigned long ops, failures;
+static uint64_t total_ns, max_ns;
+static uint32_t seed;
+static unsigned long snap_bytes[2], snap_frag[3];
+
+static uint32_t next_rand(void)
+{
+	seed = seed * 1103515245U + 12345U;
+	return (seed >> 8);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void account(uint64_t start)
+{
+	uint64_t elapsed = now_ns() - start;
+
+	++ops;
+	total_ns += elapsed;
+	if (elapsed > max_ns) {
+		max_ns = elapsed;
+	}
+}
+
+static void *do_alloc(size_t size)
+{
+	uint64_t start = now_ns();
+	void *p = cur->alloc(size);
+
+	account(start);
+	if (!p) {
+		++failures;
+	}
+
+	return (p);
+}
+
+static void *do_resize(void *p, size_t size)
+{
+	uint64_t start = now_ns();
+	void *q = cur->resize(p, size);
+
+	account(start);
+	if (!q) {
+		++failures;
+	}
+
+	return (q);
+}
+
+/*
+ * Heap state at the end of a trace, before the live blocks are released
+ */
+static void snapshot(void)
+{
+	cur->stats(snap_bytes);
+	if (cur->frag) {
+		cur->frag(snap_frag);
+	}
+}
+
+static void do_free(void *p)
+{
+	uint64_t start = now_ns();
+
+	cur->release(p);
+	account(start);
+}
+
+/*
+ * Mostly small objects, some buffers and a few thread stacks,
+ * freed in random order
+ */
+static size_t object_size(void)
+{
+	uint32_t r = next_rand() % 100;
+
+	if (r < 70) {
+		return (16 + next_rand() % 112);
+	}
+	if (r < 95) {
+		return (128 + next_rand() % 1920);
+	}
+	return (2048 + next_rand() % 14336);
+}
+
+static void trace_objects(void)
+{
+	static void *live[2000];
+	unsigned i, slot;
+
+	memset(live, 0, sizeof(live));
+
+	for (i = 0; i < 200000; i++) {
+		slot = next_rand() % 2000;
+		if (live[slot]) {
+			do_free(live[slot]);
+		}
+		live[slot] = do_alloc(object_size());
+	}
+
+	snapshot();
+
+	for (slot = 0; slot < 2000; slot++) {
+		if (live[slot]) {
+			do_free(live[slot]);
+		}
+	}
+}
+
+/*
+ * Network buffers allocated in bursts and released in FIFO order,
+ * while a few long lived objects are allocated in between
+ */
+static void trace_packets(void)
+{
+	static void *ring[512];
+	static void *keep[256];
+	unsigned head = 0, tail = 0, queued = 0, kept = 0;
+	unsigned i, burst;
+
+	for (i = 0; i < 20000; i++) {
+		burst = 1 + next_rand() % 32;
+		while (burst-- && (queued < 512)) {
+			ring[head] = do_alloc(64 + next_rand() % 1536);
+			head = (head + 1) % 512;
+			++queued;
+		}
+		burst = 1 + next_rand() % 32;
+		while (burst-- && queued) {
+			if (ring[tail]) {
+				do_free(ring[tail]);
+			}
+			tail = (tail + 1) % 512;
+			--queued;
+		}
+		if (!(i % 100) && (kept < 256)) {
+			keep[kept++] = do_alloc(32 + next_rand() % 256);
+		}
+	}
+
+	snapshot();
+
+	while (queued--) {
+		if (ring[tail]) {
+			do_free(ring[tail]);
+		}
+		tail = (tail + 1) % 512;
+	}
+	while (kept--) {
+		if (keep[kept]) {
+			do_free(keep[kept]);
+		}
+	}
+}
+
+/*
+ * Buffers growing by realloc up to a random limit, then released
+ */
+static void trace_realloc(void)
+{
+	static void *bufs[64];
+	static size_t sizes[64], limits[64];
+	unsigned i, slot;
+	void *p;
+
+	memset(bufs, 0, sizeof(bufs));
+	memset(sizes, 0, sizeof(sizes));
+
+	for (i = 0; i < 100000; i++) {
+		slot = next_rand() % 64;
+		if (!sizes[slot]) {
+			limits[slot] = 256 + next_rand() % 32768;
+		}
+		sizes[slot] += 16 + next_rand() % 496;
+		if (sizes[slot] > limits[slot]) {
+			if (bufs[slot]) {
+				do_free(bufs[slot]);
+			}
+			bufs[slot] = NULL;
+			sizes[slot] = 0;
+			continue;
+		}
+		p = do_resize(bufs[slot], sizes[slot]);
+		if (p) {
+			bufs[slot] = p;
+		}
+	}
+
+	snapshot();
+
+	for (slot = 0; slot < 64; slot++) {
+		if (bufs[slot]) {
+			do_free(bufs[slot]);
+		}
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*run)(void);
+} traces[] = {
+	{"objects", trace_objects},
+	{"packets", trace_packets},
+	{"realloc", trace_realloc}
+};
+
+int main(void)
+{
+	unsigned t, a;
+
+	printf("%-8s   %-9s   %8s   %7s   %8s   %8s   %10s   %s\n", "TRACE", "ALLOCATOR",
+	       "OPS", "AVG NS", "MAX NS", "FAILURES", "FREE BYTES", "FREE BLOCKS/LARGEST/FRAG%");
+
+	for (t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+		for (a = 0; a < sizeof(allocators) / sizeof(allocators[0]); a++) {
+			cur = &allocators[a];
+			if (cur->init(heap, (char *)heap + sizeof(heap))) {
+				printf("cannot init %s\n", cur->name);
+				return (1);
+			}
+			ops = failures = 0;
+			total_ns = max_ns = 0;
+			seed = 1;
+
+			traces[t].run();
+
+			printf("%-8s   %-9s   %8lu   %7llu   %8llu   %8lu   %10lu   ", traces[t].name,
+			       cur->name, ops, (unsigned long long)(total_ns / ops),
+			       (unsigned long long)max_ns, failures, snap_bytes[0]);
+			if (cur->frag) {
+				printf("%lu/%lu/%lu\n", snap_frag[0], snap_frag[1], snap_frag[2]);
+			} else {
+				printf("-\n");
+			}
+		}
+	}
+
+	return (0);
+}
@@ -0,0 +1,417 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <types_common.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <diegos/kernel.h>
+#include <diegos/kernel_ticks.h>
+
+#include "mallocprof.h"
+
+#ifdef ENABLE_HEAP_PROFILE
+
+/*
+ * Heap profiler.
+ * Each live allocation has a record in a side table, hashed by address,
+ * telling its size, the call site and the thread that allocated it.
+ * Call sites and threads are accounted in two more tables, so that the
+ * report does not need to walk the live allocations.
+ * The tables are static, the profiler never allocates from the heap:
+ * when a table is full the allocation is accounted to the "other" entry
+ * of the sites or threads table, or not tracked at all if the records
+ * table is full.
+ */
+
+#define PROFILE_RECORDS		(4096)
+#define PROFILE_SITES		(256)
+#define PROFILE_THREADS		(64)
+#define PROFILE_BUCKETS		(24)
+#define PROFILE_TOP		(16)
+
+/*
+ * The last entry of the sites and threads tables collects
+ * the allocations that do not fit
+ */
+#define SITE_OTHER		(PROFILE_SITES - 1)
+#define THREAD_OTHER		(PROFILE_THREADS - 1)
+
+/*
+ * my_thread_id() before the scheduler runs the first thread
+ */
+#define TID_NONE		((tid_t)-1)
+
+struct record {
+	uintptr_t ptr;
+	uint32_t size;
+	uint8_t site;
+	uint8_t thread;
+};
+
+struct site {
+	void *caller;
+	unsigned live;
+	unsigned long live_bytes;
+	unsigned long allocs;
+	unsigned long long bytes;
+};
+
+struct tid_stats {
+	tid_t tid;
+	BOOL used;
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long live_bytes;
+	unsigned long last_allocs;
+};
+
+struct bucket {
+	unsigned long allocs;
+	unsigned live;
+};
+
+static struct record records[PROFILE_RECORDS];
+static struct site sites[PROFILE_SITES];
+static struct tid_stats threads[PROFILE_THREADS];
+static struct bucket buckets[PROFILE_BUCKETS];
+
+static unsigned tracked = 0;
+static unsigned long untracked = 0;
+static uint64_t last_report = 0;
+
+/*
+ * Report copies, taken with the heap locked and printed without
+ */
+static struct site sites_snap[PROFILE_SITES];
+static struct tid_stats threads_snap[PROFILE_THREADS];
+static struct bucket buckets_snap[PROFILE_BUCKETS];
+
+/*
+ * Same lock of the heap, the hooks already hold it
+ */
+#if defined(ENABLE_PREEMPTION) || defined(ENABLE_SMP)
+#define PROFILE_LOCK()		thread_preempt_disable()
+#define PROFILE_UNLOCK()	thread_preempt_enable()
+#else
+#define PROFILE_LOCK()
+#define PROFILE_UNLOCK()
+#endif
+
+static inline unsigned hash(uintptr_t key, unsigned size)
+{
+	return (((uint32_t) key * 2654435761U) >> 7) & (size - 1);
+}
+
+/*
+ * Like hash() for tables whose last slot is reserved as overflow: the
+ * home slot is taken modulo the usable slots, never the reserved one.
+ */
+static inline unsigned hash_mod(uintptr_t key, unsigned slots)
+{
+	return (((uint32_t) key * 2654435761U) >> 7) % slots;
+}
+
+static inline unsigned bucket_of(size_t size)
+{
+	unsigned i = 0;
+
+	while ((i < PROFILE_BUCKETS - 1) && (((size_t)8 << i) < size)) {
+		++i;
+	}
+
+	return (i);
+}
+
+static unsigned site_of(void *caller)
+{
+	unsigned i, n;
+
+	i = hash_mod((uintptr_t) caller, SITE_OTHER);
+
+	for (n = 0; n < SITE_OTHER; n++) {
+		if (sites[i].caller == caller) {
+			return (i);
+		}
+		if (!sites[i].caller) {
+			sites[i].caller = caller;
+			return (i);
+		}
+		if (++i >= SITE_OTHER) {
+			i = 0;
+		}
+	}
+
+	return (SITE_OTHER);
+}
+
+static unsigned thread_of(tid_t tid)
+{
+	unsigned i, n;
+
+	i = hash_mod(tid, THREAD_OTHER);
+
+	for (n = 0; n < THREAD_OTHER; n++) {
+		if (threads[i].used && (threads[i].tid == tid)) {
+			return (i);
+		}
+		if (!threads[i].used) {
+			threads[i].used = TRUE;
+			threads[i].tid = tid;
+			return (i);
+		}
+		if (++i >= THREAD_OTHER) {
+			i = 0;
+		}
+	}
+
+	return (THREAD_OTHER);
+}
+
+static struct record *record_of(void *ptr)
+{
+	unsigned i = hash((uintptr_t) ptr >> 3, PROFILE_RECORDS);
+
+	while (records[i].ptr) {
+		if (records[i].ptr == (uintptr_t) ptr) {
+			return (&records[i]);
+		}
+		i = (i + 1) & (PROFILE_RECORDS - 1);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Remove a record, the records following it in the probe sequence
+ * are moved back to fill the hole.
+ */
+static void record_remove(struct record *r)
+{
+	unsigned hole = r - records;
+	unsigned i = hole, home;
+
+	while (TRUE) {
+		i = (i + 1) & (PROFILE_RECORDS - 1);
+		if (!records[i].ptr) {
+			break;
+		}
+		home = hash(records[i].ptr >> 3, PROFILE_RECORDS);
+		/*
+		 * Move it if its home slot is not between the hole and i
+		 */
+		if (((i - home) & (PROFILE_RECORDS - 1)) >= ((i - hole) & (PROFILE_RECORDS - 1))) {
+			records[hole] = records[i];
+			hole = i;
+		}
+	}
+
+	records[hole].ptr = 0;
+	--tracked;
+}
+
+void heap_profile_alloc(void *ptr, size_t size, void *caller)
+{
+	struct record *r;
+	unsigned i;
+
+	/*
+	 * Keep the table at most 3/4 full, the probe sequences
+	 * stay short
+	 */
+	if (tracked >= PROFILE_RECORDS / 4 * 3) {
+		++untracked;
+		return;
+	}
+
+	i = hash((uintptr_t) ptr >> 3, PROFILE_RECORDS);
+	while (records[i].ptr) {
+		i = (i + 1) & (PROFILE_RECORDS - 1);
+	}
+
+	r = &records[i];
+	r->ptr = (uintptr_t) ptr;
+	r->size = size;
+	r->site = site_of(caller);
+	r->thread = thread_of(my_thread_id());
+	++tracked;
+
+	++sites[r->site].allocs;
+	++sites[r->site].live;
+	sites[r->site].live_bytes += size;
+	sites[r->site].bytes += size;
+
+	++threads[r->thread].allocs;
+	threads[r->thread].live_bytes += size;
+
+	++buckets[bucket_of(size)].allocs;
+	++buckets[bucket_of(size)].live;
+}
+
+void heap_profile_resize(void *ptr, size_t size)
+{
+	struct record *r = record_of(ptr);
+
+	if (!r) {
+		return;
+	}
+
+	--buckets[bucket_of(r->size)].live;
+	++buckets[bucket_of(size)].live;
+
+	sites[r->site].live_bytes += size - r->size;
+	threads[r->thread].live_bytes += size - r->size;
+	r->size = size;
+}
+
+void heap_profile_free(void *ptr)
+{
+	struct record *r = record_of(ptr);
+
+	if (!r) {
+		return;
+	}
+
+	--sites[r->site].live;
+	sites[r->site].live_bytes -= r->size;
+
+	++threads[r->thread].frees;
+	threads[r->thread].live_bytes -= r->size;
+
+	--buckets[bucket_of(r->size)].live;
+
+	record_remove(r);
+}
+
+/*
+ * Sort sites by live bytes, largest first
+ */
+static int site_cmp(const void *a, const void *b)
+{
+	const struct site *sa = a;
+	const struct site *sb = b;
+
+	if (sa->live_bytes != sb->live_bytes) {
+		return ((sa->live_bytes < sb->live_bytes) ? 1 : -1);
+	}
+
+	return ((sa->allocs < sb->allocs) ? 1 : (sa->allocs > sb->allocs) ? -1 : 0);
+}
+
+/*
+ * This is a custom call for DiegOS: print the call sites holding most
+ * of the heap, the allocations of each thread with their rate since
+ * the previous report and the histogram of the allocation sizes.
+ * Call sites are return addresses, to be resolved against the image
+ * symbols.
+ */
+void diegos_heap_profile_dump(void)
+{
+	uint64_t now, elapsed;
+	unsigned i, records_live;
+	unsigned long lost;
+
+	PROFILE_LOCK();
+
+	memcpy(sites_snap, sites, sizeof(sites));
+	memcpy(threads_snap, threads, sizeof(threads));
+	memcpy(buckets_snap, buckets, sizeof(buckets));
+	records_live = tracked;
+	lost = untracked;
+
+	now = clock_get_milliseconds();
+	elapsed = now - last_report;
+	last_report = now;
+	for (i = 0; i < PROFILE_THREADS; i++) {
+		threads[i].last_allocs = threads[i].allocs;
+	}
+
+	PROFILE_UNLOCK();
+
+	if (!elapsed) {
+		elapsed = 1;
+	}
+
+	printf("\n--- HEAP PROFILE (%u live allocations, %lu not tracked) ----------------------\n\n",
+	       records_live, lost);
+
+	qsort(sites_snap, PROFILE_SITES, sizeof(sites_snap[0]), site_cmp);
+
+	printf("%-10s   %10s   %7s   %10s   %12s\n", "CALL SITE", "LIVE BYTES", "LIVE", "ALLOCS",
+	       "TOTAL BYTES");
+	printf("_______________________________________________________________\n");
+	for (i = 0; (i < PROFILE_TOP) && sites_snap[i].allocs; i++) {
+		if (sites_snap[i].caller) {
+			printf("%#-10lx | %10lu | %7u | %10lu | %12llu\n",
+			       (unsigned long)sites_snap[i].caller, sites_snap[i].live_bytes,
+			       sites_snap[i].live, sites_snap[i].allocs, sites_snap[i].bytes);
+		} else {
+			printf("%-10s | %10lu | %7u | %10lu | %12llu\n", "other",
+			       sites_snap[i].live_bytes, sites_snap[i].live, sites_snap[i].allocs,
+			       sites_snap[i].bytes);
+		}
+	}
+	printf("---------------------------------------------------------------\n\n");
+
+	printf("%-10s   %10s   %10s   %10s   %10s\n", "TID", "ALLOCS", "FREES", "LIVE BYTES",
+	       "ALLOCS/SEC");
+	printf("__________________________________________________________\n");
+	for (i = 0; i < PROFILE_THREADS; i++) {
+		if (!threads_snap[i].allocs) {
+			continue;
+		}
+		if (i == THREAD_OTHER) {
+			printf("%-10s", "other");
+		} else if (TID_NONE == threads_snap[i].tid) {
+			printf("%-10s", "boot");
+		} else {
+			printf("%-10u", threads_snap[i].tid);
+		}
+		printf(" | %10lu | %10lu | %10lu | %10llu\n", threads_snap[i].allocs,
+		       threads_snap[i].frees, threads_snap[i].live_bytes,
+		       ((threads_snap[i].allocs - threads_snap[i].last_allocs) * 1000ULL) / elapsed);
+	}
+	printf("----------------------------------------------------------\n\n");
+
+	printf("%-10s   %10s   %7s\n", "SIZE UP TO", "ALLOCS", "LIVE");
+	printf("_________________________________\n");
+	for (i = 0; i < PROFILE_BUCKETS; i++) {
+		if (!buckets_snap[i].allocs) {
+			continue;
+		}
+		if (i == PROFILE_BUCKETS - 1) {
+			printf("%-10s", "larger");
+		} else {
+			printf("%-10lu", 8UL << i);
+		}
+		printf(" | %10lu | %7u\n", buckets_snap[i].allocs, buckets_snap[i].live);
+	}
+	printf("---------------------------------\n\n");
+}
+
+#else
+
+void diegos_heap_profile_dump(void)
+{
+	printf("Heap profiling is disabled, build with HEAP_PROFILE = y\n\n");
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MALLOCPROF_H_
+#define _MALLOCPROF_H_
+
+#include <stddef.h>
+
+/*
+ * Heap profiler hooks, invoked by the allocator with the heap locked.
+ * Without HEAP_PROFILE they compile to nothing.
+ */
+#ifdef ENABLE_HEAP_PROFILE
+
+/*
+ * A block of size bytes was allocated at ptr on behalf of caller
+ */
+void heap_profile_alloc(void *ptr, size_t size, void *caller);
+
+/*
+ * The block at ptr was resized in place to size bytes
+ */
+void heap_profile_resize(void *ptr, size_t size);
+
+/*
+ * The block at ptr was released
+ */
+void heap_profile_free(void *ptr);
+
+#else
+
+#define heap_profile_alloc(ptr, size, caller)	((void)(size), (void)(caller))
+#define heap_profile_resize(ptr, size)
+#define heap_profile_free(ptr)
+
+#endif
+
+#endif
@@ -119,3 +119,38 @@ STATUS queue_insert(queue_inst *queue, queue_node *data, queue_node *after)
 
 	return (EOK);
 }
+
+STATUS queue_remove(queue_inst *queue, queue_node *data)
+{
+	queue_node *prev = NULL, *cur;
+
+	if (!queue || !data) {
+		return (EINVAL);
+	}
+
+	cur = queue->head;
+
+	while (cur && (cur != data)) {
+		prev = cur;
+		cur = cur->next;
+	}
+
+	if (!cur) {
+		return (ENOENT);
+	}
+
+	if (prev) {
+		prev->next = data->next;
+	} else {
+		queue->head = data->next;
+	}
+
+	if (queue->tail == data) {
+		queue->tail = prev;
+	}
+
+	data->next = NULL;
+	queue->counter--;
+
+	return (EOK);
+}
@@ -0,0 +1,412 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libs/list.h>
+#include <libs/slab.h>
+
+/*
+ * Slabs are sized in multiples of the granule
+ */
+#define SLAB_GRANULE	(1024)
+
+/*
+ * Marks the objects handed out, to reject double frees
+ */
+#define BUFCTL_INUSE	((struct bufctl *)-1)
+
+/*
+ * Control block following each object in the slab
+ */
+struct bufctl {
+	struct bufctl *next;
+	struct slab *slab;
+};
+
+/*
+ * Header at the start of the slab buffer, objects follow
+ */
+struct slab {
+	list_node header;
+	slab_cache_t *cache;
+	struct bufctl *free;
+	unsigned inuse;
+	uint8_t *objs;
+};
+
+struct slab_cache {
+	list_node header;
+	list_inst partial;
+	list_inst full;
+	list_inst empty;
+	size_t size;
+	size_t aln;
+	size_t objoff;
+	size_t slot;
+	size_t slabsize;
+	unsigned objs;
+	unsigned step;
+	unsigned colours;
+	unsigned colour;
+	unsigned slabs;
+	unsigned minslabs;
+	unsigned active;
+	unsigned max_active;
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long grows;
+	unsigned long reaps;
+	slab_ctor_fn ctor;
+	slab_dtor_fn dtor;
+	char name[16];
+};
+
+static LIST_STATIC_INIT(caches);
+
+static size_t aln_pow2(size_t aln)
+{
+	size_t retval = sizeof(void *);
+
+	while (retval < aln) {
+		retval <<= 1;
+	}
+
+	return (retval);
+}
+
+/*
+ * Allocate a new slab, construct its objects and add it to
+ * the empty slabs
+ */
+static int slab_grow(slab_cache_t *cache)
+{
+	struct slab *slab;
+	struct bufctl *bc;
+	uint8_t *obj;
+	unsigned i;
+
+	slab = malloc(cache->slabsize);
+	if (!slab) {
+		return (ENOMEM);
+	}
+
+	slab->cache = cache;
+	slab->free = NULL;
+	slab->inuse = 0;
+	slab->objs = (uint8_t *)ALN((uintptr_t)(slab + 1), cache->aln) +
+	    cache->colour * cache->step;
+
+	if (++cache->colour == cache->colours) {
+		cache->colour = 0;
+	}
+
+	for (i = cache->objs; i; i--) {
+		obj = slab->objs + (i - 1) * cache->slot;
+		bc = (struct bufctl *)(obj + cache->objoff);
+		bc->slab = slab;
+		bc->next = slab->free;
+		slab->free = bc;
+		if (cache->ctor) {
+			cache->ctor(obj);
+		}
+	}
+
+	list_prepend(&cache->empty, &slab->header);
+	++cache->slabs;
+	++cache->grows;
+
+	return (EOK);
+}
+
+/*
+ * Destroy the objects and return the slab to the heap,
+ * the slab must be empty and unlinked
+ */
+static void slab_release(slab_cache_t *cache, struct slab *slab)
+{
+	unsigned i;
+
+	if (cache->dtor) {
+		for (i = 0; i < cache->objs; i++) {
+			cache->dtor(slab->objs + i * cache->slot);
+		}
+	}
+
+	free(slab);
+	--cache->slabs;
+	++cache->reaps;
+}
+
+slab_cache_t *slab_cache_create(const char *name, size_t size, size_t aln,
+				unsigned objs, slab_ctor_fn ctor, slab_dtor_fn dtor)
+{
+	slab_cache_t *cache;
+	size_t hdr;
+
+	if (!size) {
+		return (NULL);
+	}
+
+	cache = malloc(sizeof(slab_cache_t));
+	if (!cache) {
+		return (NULL);
+	}
+
+	if (name) {
+		snprintf(cache->name, sizeof(cache->name), "%s", name);
+	} else {
+		snprintf(cache->name, sizeof(cache->name), "Slab_%p", cache);
+	}
+
+	list_init(&cache->partial);
+	list_init(&cache->full);
+	list_init(&cache->empty);
+
+	cache->size = size;
+	cache->aln = aln_pow2(aln);
+	cache->objoff = ALN(size, sizeof(void *));
+	cache->slot = ALN(cache->objoff + sizeof(struct bufctl), cache->aln);
+
+	/*
+	 * The heap does not honour the objects alignment, reserve
+	 * room to align the first one
+	 */
+	hdr = sizeof(struct slab) + cache->aln;
+	cache->slabsize = MULT(hdr + cache->slot * ((objs) ? objs : 1), SLAB_GRANULE);
+	cache->objs = (cache->slabsize - hdr) / cache->slot;
+
+	/*
+	 * The space left at the end of the slab shifts the objects of
+	 * consecutive slabs by a cache line
+	 */
+	cache->step = (cache->aln > CACHE_ALN) ? cache->aln : CACHE_ALN;
+	cache->colours = (cache->slabsize - hdr - cache->objs * cache->slot) / cache->step + 1;
+	cache->colour = 0;
+
+	cache->slabs = 0;
+	cache->minslabs = 0;
+	cache->active = 0;
+	cache->max_active = 0;
+	cache->allocs = 0;
+	cache->frees = 0;
+	cache->grows = 0;
+	cache->reaps = 0;
+	cache->ctor = ctor;
+	cache->dtor = dtor;
+
+	list_append(&caches, &cache->header);
+
+	return (cache);
+}
+
+int slab_cache_reserve(slab_cache_t *cache, unsigned nobjs)
+{
+	if (!cache) {
+		return (EINVAL);
+	}
+
+	cache->minslabs = (nobjs + cache->objs - 1) / cache->objs;
+
+	while (cache->slabs < cache->minslabs) {
+		if (EOK != slab_grow(cache)) {
+			return (ENOMEM);
+		}
+	}
+
+	return (EOK);
+}
+
+void *slab_alloc(slab_cache_t *cache)
+{
+	struct slab *slab;
+	struct bufctl *bc;
+
+	if (!cache) {
+		return (NULL);
+	}
+
+	slab = list_head(&cache->partial);
+
+	if (!slab) {
+		if (!list_count(&cache->empty) && (EOK != slab_grow(cache))) {
+			return (NULL);
+		}
+		slab = list_head(&cache->empty);
+		list_remove(&cache->empty, &slab->header);
+		list_prepend(&cache->partial, &slab->header);
+	}
+
+	bc = slab->free;
+	slab->free = bc->next;
+	bc->next = BUFCTL_INUSE;
+	++slab->inuse;
+
+	if (!slab->free) {
+		list_remove(&cache->partial, &slab->header);
+		list_prepend(&cache->full, &slab->header);
+	}
+
+	++cache->allocs;
+	if (++cache->active > cache->max_active) {
+		cache->max_active = cache->active;
+	}
+
+	return ((uint8_t *)bc - cache->objoff);
+}
+
+void slab_free(slab_cache_t *cache, void *obj)
+{
+	struct slab *slab;
+	struct bufctl *bc;
+	size_t offset;
+
+	if (!cache || !obj) {
+		return;
+	}
+
+	bc = (struct bufctl *)((uint8_t *)obj + cache->objoff);
+	slab = bc->slab;
+
+	if ((BUFCTL_INUSE != bc->next) || !slab || (slab->cache != cache)) {
+		return;
+	}
+
+	offset = (size_t)((uint8_t *)obj - slab->objs);
+	if ((offset % cache->slot) || (offset >= cache->objs * cache->slot)) {
+		return;
+	}
+
+	if (!slab->free) {
+		list_remove(&cache->full, &slab->header);
+		list_prepend(&cache->partial, &slab->header);
+	}
+
+	bc->next = slab->free;
+	slab->free = bc;
+	--cache->active;
+	++cache->frees;
+
+	if (--slab->inuse) {
+		return;
+	}
+
+	list_remove(&cache->partial, &slab->header);
+	list_prepend(&cache->empty, &slab->header);
+
+	/*
+	 * Keep a single empty slab, to avoid trashing the heap when
+	 * an object is allocated and freed over and over
+	 */
+	if ((list_count(&cache->empty) > 1) && (cache->slabs > cache->minslabs)) {
+		slab = list_tail(&cache->empty);
+		list_remove(&cache->empty, &slab->header);
+		slab_release(cache, slab);
+	}
+}
+
+unsigned slab_cache_reap(slab_cache_t *cache)
+{
+	struct slab *slab;
+	unsigned retval = 0;
+
+	if (!cache) {
+		return (0);
+	}
+
+	while ((cache->slabs > cache->minslabs) && list_count(&cache->empty)) {
+		slab = list_tail(&cache->empty);
+		list_remove(&cache->empty, &slab->header);
+		slab_release(cache, slab);
+		++retval;
+	}
+
+	return (retval);
+}
+
+unsigned slab_caches_reap()
+{
+	slab_cache_t *cache = list_head(&caches);
+	unsigned retval = 0;
+
+	while (cache) {
+		retval += slab_cache_reap(cache);
+		cache = (slab_cache_t *)cache->header.next;
+	}
+
+	return (retval);
+}
+
+int slab_cache_destroy(slab_cache_t *cache)
+{
+	struct slab *slab;
+
+	if (!cache) {
+		return (EINVAL);
+	}
+
+	if (cache->active) {
+		return (EBUSY);
+	}
+
+	while (list_count(&cache->empty)) {
+		slab = list_head(&cache->empty);
+		list_remove(&cache->empty, &slab->header);
+		slab_release(cache, slab);
+	}
+
+	list_remove(&caches, &cache->header);
+	free(cache);
+
+	return (EOK);
+}
+
+size_t slab_cache_objsize(const slab_cache_t *cache)
+{
+	return ((cache) ? cache->size : 0);
+}
+
+static void dump_internal(const slab_cache_t *cache)
+{
+	printf("%-15s | %6u | %5u | %4u | %5u | %6u | %6u | %10lu | %7lu | %7lu\n", cache->name,
+	       (unsigned)cache->size, (unsigned)cache->slot, cache->objs, cache->slabs,
+	       cache->active, cache->max_active, cache->allocs, cache->grows, cache->reaps);
+}
+
+void slab_cache_dump(const slab_cache_t *cache)
+{
+	if (!cache) {
+		printf("\n--- SLAB CACHES TABLE -----------------------------------------------------------------------\n\n");
+	}
+	printf("%-15s   %6s   %5s   %4s   %5s   %6s   %6s   %10s   %7s   %7s\n", "CACHE NAME",
+	       "SIZE", "SLOT", "OBJS", "SLABS", "ACTIVE", "MAX", "ALLOCS", "GROWS", "REAPS");
+	printf("_____________________________________________________________________________________________\n");
+	if (cache) {
+		dump_internal(cache);
+	} else {
+		cache = list_head(&caches);
+		while (cache) {
+			dump_internal(cache);
+			cache = (const slab_cache_t *)cache->header.next;
+		}
+	}
+	printf("---------------------------------------------------------------------------------------------\n\n");
+}
@@ -125,3 +125,27 @@ unsigned apic_read_version()
 
 	return apic_base[0x30 / sizeof(*apic_base)];
 }
+
+unsigned apic_read_id()
+{
+	if (!apic_base)
+		return (0);
+
+	return (apic_base[0x20 / sizeof(*apic_base)] >> 24);
+}
+
+BOOL apic_send_ipi(unsigned dest, unsigned command)
+{
+	if (!apic_base)
+		return (FALSE);
+
+	/*
+	 * Wait for the previous IPI to be delivered
+	 */
+	while (apic_base[0x300 / sizeof(*apic_base)] & APIC_ICR_PENDING) ;
+
+	apic_base[0x310 / sizeof(*apic_base)] = dest << 24;
+	apic_base[0x300 / sizeof(*apic_base)] = command;
+
+	return (TRUE);
+}
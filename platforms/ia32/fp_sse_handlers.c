@@ -17,13 +17,21 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <diegos/kernel.h>
-#include <libs/bitmaps.h>
+#include <diegos/interrupts.h>
 
 #if defined(ENABLE_SIMD) || defined(ENABLE_FP)
 
-static uint8_t last_context = (uint8_t) - 1U;
-static long context_valid[BITMAPLEN(DIEGOS_MAX_THREADS)] = { 0 };
+/*
+ * The lazy save keeps a single owner of the FP/SIMD registers,
+ * each processor would need its own.
+ */
+#if defined(ENABLE_SMP)
+#error "FP/SIMD support is not available with SMP"
+#endif
 
 /*
  * ENABLE_SIMD FIRST. SIMD exception handler will handle FP/MMX too, but
@@ -34,54 +42,101 @@ static long context_valid[BITMAPLEN(DIEGOS_MAX_THREADS)] = { 0 };
 /*
  * Must be aligned to 16 bytes
  */
-static char simd_context[DIEGOS_MAX_THREADS][512] __attribute__((aligned(16)));
+#define CONTEXT_SIZE	(512)
+#define CONTEXT_ALIGN	(16)
 
 #elif defined(ENABLE_FP)
 /*
  * There is no real requirement for alignment in case of FP as we are using
  * fsave/frstor but doubles are natually aligned to 8...
  */
-static char fp_context[DIEGOS_MAX_THREADS][108] __attribute__((aligned(8)));
+#define CONTEXT_SIZE	(108)
+#define CONTEXT_ALIGN	(8)
 #endif
 
+/*
+ * Per thread save area, allocated when the thread is created.
+ * raw is the pointer returned by malloc, regs is aligned.
+ */
+typedef struct fp_area {
+	char *regs;
+	void *raw;
+	BOOL valid;
+} fp_area_t;
+
+/*
+ * Save areas indexed by TID, the table grows with the TID space
+ */
+static fp_area_t **areas = NULL;
+static unsigned areas_size = 0;
+
+static tid_t last_context = (tid_t) - 1U;
+
+static BOOL grow_areas(unsigned tid)
+{
+	fp_area_t **new_areas, **old_areas;
+	unsigned new_size = (areas_size) ? (areas_size) : (16);
+
+	while (new_size <= tid) {
+		new_size *= 2;
+	}
+
+	new_areas = (fp_area_t **) malloc(new_size * sizeof(*new_areas));
+	if (!new_areas) {
+		return (FALSE);
+	}
+
+	memset(new_areas, 0, new_size * sizeof(*new_areas));
+	if (areas_size) {
+		memcpy(new_areas, areas, areas_size * sizeof(*new_areas));
+	}
+
+	lock();
+	old_areas = areas;
+	areas = new_areas;
+	areas_size = new_size;
+	unlock();
+
+	free(old_areas);
+
+	return (TRUE);
+}
+
 void exc_handler_fp(void)
 {
-	uint8_t tid = my_thread_id();
+	tid_t tid = my_thread_id();
 
 	/*
 	 * We need to clean up the TS bit at all times!
 	 */
 	__asm__ volatile ("clts\n\t":::);
 
-	/*
-	 * First instruction ever - mark the context to be saved
-	 */
-	if ((uint8_t) - 1U == last_context) {
-		last_context = tid;
-	}
 	/*
 	 * Same context running - same running thread is using fp instructions,
 	 * no interference from other threads.
 	 * If tid != last_fp_context, then they are different
 	 */
-	else if (tid != last_context) {
+	if (tid != last_context) {
 		/*
-		 * Save context
+		 * Save context, unless this is the first instruction ever
+		 * or the owner of the FPU state is dead
 		 */
+		if ((tid_t) - 1U != last_context) {
 #if defined(ENABLE_SIMD)
-		__asm__ volatile ("fxsave %0\n\t"::"m" (simd_context[last_context]):);
+			__asm__ volatile ("fxsave (%0)\n\t"::"r" (areas[last_context]->regs):"memory");
 #elif defined(ENABLE_FP)
-		__asm__ volatile ("fsave %0\n\t"::"m" (fp_context[last_context]):);
+			__asm__ volatile ("fsave (%0)\n\t"::"r" (areas[last_context]->regs):"memory");
 #endif
-		bitmap_set(context_valid, last_context);
-		if (bitmap_is_set(context_valid, tid)) {
+			areas[last_context]->valid = TRUE;
+		}
+		if (areas[tid]->valid) {
 			/*
 			 * Restore context
 			 */
 #if defined(ENABLE_SIMD)
-			__asm__ volatile ("fxrstor %0\n\t"::"m" (simd_context[tid]):);
+			__asm__ volatile ("fxrstor (%0)\n\t"::"r" (areas[tid]->regs):"memory");
 #elif defined(ENABLE_FP)
-			__asm__ volatile ("frstor %0\n\t"::"m" (fp_context[tid]):);
+			__asm__ volatile ("frstor (%0)\n\t"::"r" (areas[tid]->regs):"memory");
 #endif
 		}
 #if defined(ENABLE_SIMD)
@@ -95,9 +150,61 @@ void exc_handler_fp(void)
 
 #endif
 
+BOOL prepare_context(unsigned tid)
+{
+#if defined(ENABLE_SIMD) || defined(ENABLE_FP)
+	fp_area_t *area;
+
+	if ((tid >= areas_size) && !grow_areas(tid)) {
+		return (FALSE);
+	}
+
+	area = (fp_area_t *) malloc(sizeof(*area));
+	if (!area) {
+		return (FALSE);
+	}
+
+	area->raw = malloc(CONTEXT_SIZE + CONTEXT_ALIGN - 1);
+	if (!area->raw) {
+		free(area);
+		return (FALSE);
+	}
+
+	area->regs = (char *)(((uintptr_t) area->raw + CONTEXT_ALIGN - 1) &
+			      ~((uintptr_t) CONTEXT_ALIGN - 1));
+	area->valid = FALSE;
+
+	lock();
+	areas[tid] = area;
+	unlock();
+#endif
+	return (TRUE);
+}
+
 void cleanup_context(void *ctx, unsigned tid)
 {
 #if defined(ENABLE_SIMD) || defined(ENABLE_FP)
-	bitmap_clear(context_valid, tid);
+	fp_area_t *area;
+
+	if (tid >= areas_size) {
+		return;
+	}
+
+	lock();
+	area = areas[tid];
+	areas[tid] = NULL;
+	/*
+	 * The FPU holds the state of a dead thread, it must
+	 * not be saved to a released area.
+	 */
+	if (last_context == tid) {
+		last_context = (tid_t) - 1U;
+	}
+	unlock();
+
+	if (area) {
+		free(area->raw);
+		free(area);
+	}
 #endif
 }
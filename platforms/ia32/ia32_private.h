@@ -29,6 +29,18 @@ void idt_init(void);
 
 void exc_handler_fp(void);
 
+/*
+ * Initial stack pointers of the per processor interrupt stacks
+ */
+extern void *int_stack_top[];
+
+#ifndef ENABLE_SMP
+/*
+ * Interrupt nesting level, see ints.S
+ */
+extern volatile unsigned int_nesting;
+#endif
+
 /*
  * externs for hw_interrupts.s and
  * sw_interrupts.s and exceptions.s
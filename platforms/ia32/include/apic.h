@@ -39,6 +39,16 @@ enum {
 	APIC_DIV_1
 };
 
+/*
+ * Interrupt Command Register fields, the low 8 bits hold the vector
+ */
+#define APIC_ICR_FIXED		(0UL << 8)
+#define APIC_ICR_INIT		(5UL << 8)
+#define APIC_ICR_STARTUP	(6UL << 8)
+#define APIC_ICR_PENDING	(1UL << 12)
+#define APIC_ICR_ASSERT		(1UL << 14)
+#define APIC_ICR_ALL_BUT_SELF	(3UL << 18)
+
 BOOL is_apic_supported(void);
 
 BOOL apic_configure(char oneshot, char enableint, char vector, char divisor);
@@ -51,4 +61,23 @@ void apic_write_eoi(void);
 
 unsigned apic_read_version();
 
+/*
+ * ID of the local APIC of the running processor
+ */
+unsigned apic_read_id(void);
+
+/*
+ * Send an inter processor interrupt, waits for the previous one to be
+ * delivered first.
+ *
+ * PARAMETERS IN
+ * unsigned dest    - the APIC ID of the destination, ignored by shorthands
+ * unsigned command - the ICR command, APIC_ICR_* flags and vector
+ *
+ * RETURNS
+ * TRUE if the IPI has been sent
+ * FALSE if the APIC is not initialized
+ */
+BOOL apic_send_ipi(unsigned dest, unsigned command);
+
 #endif
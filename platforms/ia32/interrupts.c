@@ -140,6 +140,28 @@ int_handler_t int_table[MAX_INT];
  */
 exc_handler_t exc_table[MAX_EXC];
 
+/*
+ * Interrupt stacks, one per processor.
+ * The outermost interrupt handler switches from the interrupted thread's
+ * stack to the stack of its processor, see int_enter in ints_equ.s,
+ * nested handlers and softirqs run there too.
+ * Stacks are filled with 0xdf like thread stacks to trace their usage.
+ */
+#define INT_STACK_SIZE	(8192)
+
+#ifdef ENABLE_SMP
+#define INT_STACKS	(DIEGOS_MAX_CPUS)
+#else
+#define INT_STACKS	(1)
+#endif
+
+static uint32_t int_stacks[INT_STACKS][INT_STACK_SIZE / sizeof(uint32_t)];
+
+/*
+ * Initial stack pointers, used by ints_equ.s and smp.c
+ */
+void *int_stack_top[INT_STACKS];
+
 /*
  * Helper functions used to set a handler in the IDT.
  */
@@ -229,7 +251,14 @@ static void exc13_handler(void)
 
 void idt_init()
 {
-	unsigned i;
+	unsigned i, j;
+
+	for (i = 0; i < INT_STACKS; i++) {
+		for (j = 0; j < NELEMENTS(int_stacks[i]); j++) {
+			int_stacks[i][j] = 0xdfdfdfdfUL;
+		}
+		int_stack_top[i] = &int_stacks[i][NELEMENTS(int_stacks[i])];
+	}
 
 	/*
 	 * Initialize all handlers to defaults.
@@ -385,6 +414,32 @@ void idt_init()
 	}
 }
 
+unsigned int_stack_used(unsigned cpu, unsigned *size)
+{
+	unsigned j = 0;
+
+	if (cpu >= INT_STACKS) {
+		return (0);
+	}
+
+	if (size) {
+		*size = INT_STACK_SIZE;
+	}
+
+	while ((j < NELEMENTS(int_stacks[cpu])) && (0xdfdfdfdfUL == int_stacks[cpu][j])) {
+		++j;
+	}
+
+	return (INT_STACK_SIZE - j * sizeof(uint32_t));
+}
+
+#ifndef ENABLE_SMP
+unsigned int_nesting_level(void)
+{
+	return (int_nesting);
+}
+#endif
+
 void enable_int(unsigned intno)
 {
 	if (intno > 31) {
@@ -28,3 +28,94 @@
 .equ    SPEC_EOI,       0x60
 .equ    CASCADE_IRQ,    0x02
 
+/*
+ * int_enter
+ *
+ * Expanded on entry to every interrupt handler, right after pusha,
+ * with interrupts disabled.
+ * The outermost handler switches to the interrupt stack of the processor
+ * and pushes there the stack pointer of the interrupted thread, which
+ * is restored by preempt_point: thread stacks only hold the frame pushed
+ * by the processor and pusha.
+ * With SMP the handler also takes the kernel lock, the nesting level
+ * is kept per processor and smp_int_enter() returns the interrupt
+ * stack to switch to, 0 if nested.
+ */
+.macro int_enter
+#if defined(ENABLE_SMP)
+call    smp_int_enter
+testl   %eax, %eax
+jz      3f
+xchgl   %eax, %esp
+pushl   %eax
+3:
+#else
+incl    int_nesting
+cmpl    $1, int_nesting
+jne     3f
+movl    %esp, %eax
+movl    int_stack_top, %esp
+pushl   %eax
+3:
+#endif
+.endm
+
+/*
+ * softirq_point
+ *
+ * Expanded on exit from every interrupt handler with interrupts disabled,
+ * before preempt_point.
+ * The outermost handler runs the queued softirqs on the interrupt stack,
+ * softirq_run() enables interrupts while the callbacks run and returns
+ * with them disabled.
+ */
+.macro softirq_point
+#if defined(ENABLE_SMP)
+call    smp_softirq_point
+#else
+cmpl    $1, int_nesting
+jne     2f
+cmpl    $0, softirq_pending
+je      2f
+call    softirq_run
+2:
+#endif
+.endm
+
+/*
+ * preempt_point
+ *
+ * Safe preemption point, expanded on exit from every interrupt handler with
+ * interrupts disabled and the interrupt controller already acknowledged.
+ * Leaving the outermost interrupt the stack of the interrupted thread
+ * is restored; if the scheduler has a pending preemption request, the
+ * running thread is switched out here: its interrupted context stays on
+ * its own stack, below the frame of scheduler_preempt(), and is restored
+ * by popa/iretl once the thread runs again.
+ * With SMP the kernel lock taken by int_enter is released first,
+ * smp_int_exit() returns INT_EXIT_NESTED, INT_EXIT_OUTERMOST or
+ * INT_EXIT_PREEMPT.
+ */
+.equ    INT_EXIT_NESTED,        0
+.equ    INT_EXIT_OUTERMOST,     1
+.equ    INT_EXIT_PREEMPT,       2
+
+.macro preempt_point
+#if defined(ENABLE_SMP)
+call    smp_int_exit
+cmpl    $INT_EXIT_NESTED, %eax
+je      1f
+popl    %esp
+cmpl    $INT_EXIT_PREEMPT, %eax
+jne     1f
+#else
+decl    int_nesting
+jnz     1f
+popl    %esp
+cmpl    $0, scheduler_preempt_pending
+je      1f
+#endif
+call    scheduler_preempt
+cli
+1:
+.endm
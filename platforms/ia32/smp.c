@@ -0,0 +1,330 @@
+/*
+ * DiegOS Operating System source code
+ *
+ * Copyright (C) 2012 - 2026 Diego Gallizioli
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <types_common.h>
+#include <diegos/interrupts.h>
+#include <diegos/delays.h>
+#include <processor/ia32.h>
+#include <processor/apic.h>
+#include "../../kernel/platform_include.h"
+#include "ia32_private.h"
+
+#ifdef ENABLE_SMP
+
+/*
+ * Copy address of the startup code, see ap_boot.S
+ */
+#define AP_BOOT_BASE	(0x8000UL)
+
+/*
+ * Stack of an application processor until it loads its idle thread
+ */
+#define AP_STACK_SIZE	(2 * 1024)
+
+/*
+ * Inter processor interrupt vector, right below the LAPIC timer
+ */
+#define SMP_IPI_VECTOR	(94)
+
+/*
+ * Startup code, see ap_boot.S
+ */
+extern char ap_boot_start[], ap_boot_end[];
+extern unsigned ap_boot_stacks, ap_boot_stack_size, ap_boot_count, ap_boot_max;
+extern void ap_boot_setup(void);
+
+/*
+ * Kernel hooks, see kernel/scheduler.c and kernel/softirqs.c
+ */
+extern volatile unsigned scheduler_preempt_pending[];
+extern void scheduler_ipi(void);
+extern volatile unsigned softirq_pending;
+extern void softirq_run(void);
+
+/*
+ * Processor index of each local APIC ID and back
+ */
+static uint8_t cpu_of_apic[256];
+static uint8_t apic_of_cpu[DIEGOS_MAX_CPUS];
+
+/*
+ * Processors online, the boot one included
+ */
+static volatile unsigned cpus_online = 1;
+
+/*
+ * Set once the boot processor is registered, cpu_id() is 0 until then
+ */
+static BOOL smp_started = FALSE;
+
+/*
+ * Kernel entry point of the application processors
+ */
+static void (*ap_entry)(void) = NULL;
+
+/*
+ * The kernel lock: owner is the processor index plus 1, 0 if free.
+ * depth counts the nested acquisitions of the owner.
+ */
+static volatile unsigned kl_owner = 0;
+static unsigned kl_depth = 0;
+
+/*
+ * Per processor lock() and interrupt nesting levels
+ */
+static unsigned lock_depth[DIEGOS_MAX_CPUS];
+static unsigned int_nesting[DIEGOS_MAX_CPUS];
+
+unsigned cpu_id(void)
+{
+	return ((smp_started) ? (cpu_of_apic[apic_read_id()]) : (0));
+}
+
+void kernel_lock_acquire(void)
+{
+	unsigned flags = cpu_irq_save();
+	unsigned me = cpu_id() + 1;
+
+	if (kl_owner == me) {
+		++kl_depth;
+		cpu_irq_restore(flags);
+		return;
+	}
+
+	/*
+	 * Spin with interrupts in their previous state, an interrupt
+	 * handler on this processor takes the lock on its own
+	 */
+	while (!__sync_bool_compare_and_swap(&kl_owner, 0, me)) {
+		cpu_irq_restore(flags);
+		while (kl_owner) {
+			cpu_relax();
+		}
+		flags = cpu_irq_save();
+	}
+
+	kl_depth = 1;
+	cpu_irq_restore(flags);
+}
+
+void kernel_lock_release(void)
+{
+	unsigned flags = cpu_irq_save();
+
+	if (kl_depth && !--kl_depth) {
+		__sync_lock_release(&kl_owner);
+	}
+
+	cpu_irq_restore(flags);
+}
+
+void lock(void)
+{
+	cpu_irq_save();
+	kernel_lock_acquire();
+	++lock_depth[cpu_id()];
+}
+
+void unlock(void)
+{
+	unsigned flags = cpu_irq_save();
+	unsigned cpu = cpu_id();
+
+	if (!lock_depth[cpu]) {
+		cpu_irq_restore(flags);
+		return;
+	}
+
+	kernel_lock_release();
+
+	if (!--lock_depth[cpu]) {
+		__asm__ volatile ("sti\n\t":::"memory");
+	}
+}
+
+/*
+ * Called by power_save_unlock() with interrupts disabled,
+ * drop all lock() levels and the kernel lock with them
+ */
+void smp_unlock_idle(void)
+{
+	unsigned cpu = cpu_id();
+
+	while (lock_depth[cpu]) {
+		kernel_lock_release();
+		--lock_depth[cpu];
+	}
+}
+
+/*
+ * smp_int_exit() return values, see preempt_point in ints_equ.s
+ */
+enum {
+	INT_EXIT_NESTED,
+	INT_EXIT_OUTERMOST,
+	INT_EXIT_PREEMPT
+};
+
+/*
+ * Called on entry to every interrupt handler, see ints_equ.s.
+ * Returns the interrupt stack of the processor if entering the
+ * outermost handler, NULL if nested.
+ */
+void *smp_int_enter(void)
+{
+	unsigned cpu;
+
+	kernel_lock_acquire();
+	cpu = cpu_id();
+
+	return ((1 == ++int_nesting[cpu]) ? (int_stack_top[cpu]) : (NULL));
+}
+
+unsigned int_nesting_level(void)
+{
+	return (int_nesting[cpu_id()]);
+}
+
+/*
+ * Called on exit from every interrupt handler, returns INT_EXIT_PREEMPT
+ * if the outermost handler must call scheduler_preempt()
+ */
+unsigned smp_int_exit(void)
+{
+	unsigned cpu = cpu_id();
+
+	kernel_lock_release();
+
+	if (--int_nesting[cpu]) {
+		return (INT_EXIT_NESTED);
+	}
+
+	return ((scheduler_preempt_pending[cpu]) ? (INT_EXIT_PREEMPT) : (INT_EXIT_OUTERMOST));
+}
+
+/*
+ * Called on exit from every interrupt handler, the outermost one runs
+ * the queued softirqs
+ */
+void smp_softirq_point(void)
+{
+	if ((1 == int_nesting[cpu_id()]) && softirq_pending) {
+		softirq_run();
+	}
+}
+
+static BOOL smp_ipi_handler(void)
+{
+	apic_write_eoi();
+	scheduler_ipi();
+
+	return (TRUE);
+}
+
+void cpu_resched(unsigned cpu)
+{
+	if ((cpu < DIEGOS_MAX_CPUS) && (cpu != cpu_id())) {
+		apic_send_ipi(apic_of_cpu[cpu], APIC_ICR_FIXED | APIC_ICR_ASSERT | SMP_IPI_VECTOR);
+	}
+}
+
+/*
+ * C entry point of the application processors, on the startup stack
+ */
+void ap_main(unsigned index)
+{
+	unsigned apic, cpu = index + 1;
+
+	/*
+	 * Register the processor first, cpu_id() is used by lock()
+	 */
+	apic = apic_read_id();
+	cpu_of_apic[apic] = cpu;
+	apic_of_cpu[cpu] = apic;
+
+	init_apic();
+
+	__sync_fetch_and_add(&cpus_online, 1);
+
+	ap_entry();
+}
+
+unsigned start_cpus(void (*entry)(void), unsigned max)
+{
+	unsigned i, apic;
+	char *stacks;
+
+	if (max > DIEGOS_MAX_CPUS) {
+		max = DIEGOS_MAX_CPUS;
+	}
+
+	if (!entry || (max < 2) || !cpu_check_capability(1, APIC)) {
+		return (cpus_online);
+	}
+
+	stacks = malloc((max - 1) * AP_STACK_SIZE);
+	if (!stacks) {
+		return (cpus_online);
+	}
+
+	if (EOK != add_int_cb(smp_ipi_handler, SMP_IPI_VECTOR)) {
+		free(stacks);
+		return (cpus_online);
+	}
+
+	ap_entry = entry;
+
+	ap_boot_setup();
+	ap_boot_stacks = (unsigned)stacks;
+	ap_boot_stack_size = AP_STACK_SIZE;
+	ap_boot_count = 0;
+	ap_boot_max = max - 1;
+	memcpy((void *)AP_BOOT_BASE, ap_boot_start, ap_boot_end - ap_boot_start);
+
+	apic = apic_read_id();
+	cpu_of_apic[apic] = 0;
+	apic_of_cpu[0] = apic;
+	smp_started = TRUE;
+
+	/*
+	 * INIT, then STARTUP twice, to all processors but this one.
+	 */
+	apic_send_ipi(0, APIC_ICR_ALL_BUT_SELF | APIC_ICR_ASSERT | APIC_ICR_INIT);
+	mdelay(10);
+
+	for (i = 0; i < 2; i++) {
+		apic_send_ipi(0, APIC_ICR_ALL_BUT_SELF | APIC_ICR_ASSERT | APIC_ICR_STARTUP |
+			      (AP_BOOT_BASE >> 12));
+		udelay(200);
+	}
+
+	/*
+	 * The number of processors is not known, give them time to show up
+	 */
+	for (i = 0; (i < 100) && (cpus_online < max); i++) {
+		mdelay(1);
+	}
+
+	return (cpus_online);
+}
+
+#endif
@@ -53,6 +53,10 @@
 #define TIMER0 0x40
 #define TMRMOD 0x43
 
+/*
+ * The i8253 PIT counts at 1193182 Hz
+ */
+#define PIT_HZ 1193182ULL
 /*
  * 1 Delta tick is aprox. 999.8474 msecs
  */
@@ -63,10 +67,13 @@
  * so we load 64422 or 0xFBA6.
  */
 #define TVAL   (TDELTA*54)
+/*
+ * PIT counts measured to calibrate the TSC, about 50 msecs
+ */
+#define TCAL   (TDELTA*50)
 
-static unsigned long tickfn(void)
+static unsigned pit_read(void)
 {
-	static unsigned long ticks = 0;
 	unsigned rval = 0;
 	uint8_t *cval = (uint8_t *) & rval;
 
@@ -75,19 +82,33 @@ static unsigned long tickfn(void)
 	cval[0] = in_byte(TIMER0);
 	cval[1] = in_byte(TIMER0);
 
-	ticks += (TVAL - rval) / TDELTA;
+	return (rval);
+}
 
-	/*
-	 * Hardware timer need no update right now
-	 */
-	if (rval > TDELTA * 53)
-		return ticks;
+/*
+ * Measure the TSC frequency while the PIT counts down from TVAL,
+ * the whole measure never waits for a PIT reload.
+ */
+static void calibrate_tsc(void)
+{
+	uint64_t start, end;
+	unsigned first, last;
 
-	/* Start counter value */
-	out_byte(TIMER0, (uint8_t) TVAL);
-	out_byte(TIMER0, (uint8_t) (TVAL >> 8));
+	first = pit_read();
+	start = read_cycles();
+
+	do {
+		last = pit_read();
+	} while ((last <= first) && ((first - last) < TCAL));
+
+	end = read_cycles();
+
+	if (last > first) {
+		kdrvprintf("TSC calibration failed\n");
+		return;
+	}
 
-	return ticks;
+	set_cycles((unsigned long)(((end - start) * PIT_HZ) / (1000ULL * (first - last))));
 }
 
 static int drivers_list_init(void)
@@ -170,16 +191,16 @@ void platform_init()
 	out_byte(TIMER0, (uint8_t) (TVAL >> 8));
 
 	/*
-	 * Now we are updating ticks !!! Go calibrate.
+	 * Now the PIT is counting !!! Go calibrate.
 	 */
-	calibrate_delay(tickfn);
+	calibrate_tsc();
 
 	/*
 	 * Stop the i8253 PIT
 	 */
 	out_byte(TIMER0, 0);
 
-	srand(loops_per_second() / 123);
+	srand((unsigned)read_cycles());
 }
 
 void tty_init()